@@ -26,6 +26,8 @@
 #include "in_mem_storage.h"
 #include "vertex_index.h"
 #include "safs_file.h"
+#include "ts_graph.h"
+#include "graph_builder.h"
 
 using namespace safs;
 
@@ -61,7 +63,12 @@ FG_graph::ptr FG_graph::create(const std::string &graph_file,
 	}
 
 	in_mem_graph::ptr graph_data;
-	if (graph_conf.use_in_mem_graph() && graph_in_safs)
+	// The graph in shared memory is loaded by the first process and
+	// the other processes attach to it.
+	if (!graph_conf.get_shm_graph().empty() && !graph_in_safs)
+		graph_data = in_mem_graph::load_shared_graph(graph_file,
+				graph_conf.get_shm_graph());
+	else if (graph_conf.use_in_mem_graph() && graph_in_safs)
 		graph_data = in_mem_graph::load_safs_graph(graph_file);
 	else if (!graph_in_safs)
 		// If we can't initialize SAFS, we assume the graph file is
@@ -76,10 +83,13 @@ FG_graph::ptr FG_graph::create(const std::string &graph_file,
 		// in the local filesystem.
 		index_data = vertex_index::load(index_file);
 
+	ptr fg;
 	if (graph_data)
-		return ptr(new FG_graph(graph_data, index_data, graph_file, configs));
+		fg = ptr(new FG_graph(graph_data, index_data, graph_file, configs));
 	else
-		return ptr(new FG_graph(graph_file, index_data, configs));
+		fg = ptr(new FG_graph(graph_file, index_data, configs));
+	fg->index_file = index_file;
+	return fg;
 }
 
 FG_graph::FG_graph(const std::string &graph_file, vertex_index::ptr index_data,
@@ -264,6 +274,198 @@ in_mem_subgraph::ptr fetch_subgraph(FG_graph::ptr fg,
 	return subg;
 }
 
+/************* Implementation of folding a graph delta to an image ************/
+
+namespace {
+
+/*
+ * The merged adjacency lists of a range of vertices. Each vertex is
+ * processed by one thread, so threads write to different entries.
+ */
+struct fold_range
+{
+	typedef std::shared_ptr<fold_range> ptr;
+
+	vertex_id_t start;
+	// The in-edges of a vertex in a directed graph or the edges of
+	// a vertex in an undirected graph.
+	std::vector<std::vector<vertex_id_t> > in_neighs;
+	std::vector<std::vector<vertex_id_t> > out_neighs;
+
+	void reset(vertex_id_t start, vertex_id_t end, graph_type type) {
+		this->start = start;
+		in_neighs.clear();
+		out_neighs.clear();
+		in_neighs.resize(end - start);
+		if (type == DIRECTED)
+			out_neighs.resize(end - start);
+	}
+};
+
+class fold_vertex: public compute_vertex
+{
+public:
+	fold_vertex(vertex_id_t id): compute_vertex(id) {
+	}
+
+	void run(vertex_program &prog) {
+		vertex_id_t id = prog.get_vertex_id(*this);
+		request_vertices(&id, 1);
+	}
+
+	void run(vertex_program &prog, const page_vertex &vertex);
+};
+
+class fold_vertex_program: public vertex_program_impl<fold_vertex>
+{
+	graph_type type;
+	fold_range::ptr range;
+public:
+	fold_vertex_program(graph_type type, fold_range::ptr range) {
+		this->type = type;
+		this->range = range;
+	}
+
+	void add_vertex(const page_vertex &vertex);
+};
+
+class fold_vertex_program_creater: public vertex_program_creater
+{
+	graph_type type;
+	fold_range::ptr range;
+public:
+	fold_vertex_program_creater(graph_type type, fold_range::ptr range) {
+		this->type = type;
+		this->range = range;
+	}
+
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new fold_vertex_program(type, range));
+	}
+};
+
+void fold_vertex::run(vertex_program &prog, const page_vertex &vertex)
+{
+	((fold_vertex_program &) prog).add_vertex(vertex);
+}
+
+void read_neighbors(const page_vertex &vertex, edge_type type,
+		std::vector<vertex_id_t> &neighs)
+{
+	edge_seq_iterator it = vertex.get_neigh_seq_it(type);
+	neighs.reserve(vertex.get_num_edges(type));
+	while (it.has_next())
+		neighs.push_back(it.next());
+}
+
+void fold_vertex_program::add_vertex(const page_vertex &vertex)
+{
+	size_t idx = vertex.get_id() - range->start;
+	if (type == UNDIRECTED)
+		read_neighbors(vertex, edge_type::BOTH_EDGES, range->in_neighs[idx]);
+	else {
+		read_neighbors(vertex, edge_type::IN_EDGE, range->in_neighs[idx]);
+		read_neighbors(vertex, edge_type::OUT_EDGE, range->out_neighs[idx]);
+	}
+}
+
+/*
+ * The max number of edges of the vertices merged in a range. It bounds
+ * the memory used for folding.
+ */
+const size_t FOLD_RANGE_NUM_EDGES = 16 * 1024 * 1024;
+
+FG_graph::ptr fold_and_load(FG_graph::ptr fg, const std::string &graph_file,
+		const std::string &index_file)
+{
+	if (!fold_graph_delta(fg, graph_file, index_file))
+		return FG_graph::ptr();
+	return FG_graph::create(graph_file, index_file, fg->get_configs());
+}
+
+}
+
+bool fold_graph_delta(FG_graph::ptr fg, const std::string &graph_file,
+		const std::string &index_file)
+{
+	if (fg->get_delta() == NULL) {
+		BOOST_LOG_TRIVIAL(error) << "The graph doesn't have a delta to fold";
+		return false;
+	}
+
+	graph_index::ptr index = NUMA_graph_index<fold_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+
+	graph_type type = graph->get_graph_header().get_graph_type();
+	size_t num_vertices = graph->get_num_vertices();
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	// The new image is written to temporary files first, so readers never
+	// see a partial image.
+	std::string tmp_graph_file = graph_file + ".fold";
+	std::string tmp_index_file = index_file + ".fold";
+	size_t loc = graph_file.rfind('/');
+	std::string dir = loc == std::string::npos ? "." : graph_file.substr(0, loc);
+	utils::ext_mem_image_writer writer(tmp_graph_file, type == DIRECTED, dir);
+
+	// We merge the adjacency lists in ranges of vertex IDs and write them
+	// in the order of vertex IDs, so we only keep a range in memory.
+	fold_range::ptr range(new fold_range());
+	std::vector<vertex_id_t> ids;
+	for (vertex_id_t range_start = 0; range_start < num_vertices; ) {
+		size_t num_edges = 0;
+		ids.clear();
+		vertex_id_t range_end = range_start;
+		while (range_end < num_vertices && (ids.empty()
+					|| num_edges < FOLD_RANGE_NUM_EDGES)) {
+			num_edges += graph->get_num_edges(range_end);
+			ids.push_back(range_end++);
+		}
+		range->reset(range_start, range_end, type);
+		graph->start(ids.data(), ids.size(), vertex_initializer::ptr(),
+				vertex_program_creater::ptr(new fold_vertex_program_creater(
+						type, range)));
+		graph->wait4complete();
+
+		for (vertex_id_t id = range_start; id < range_end; id++) {
+			const std::vector<vertex_id_t> &in = range->in_neighs[id - range_start];
+			if (type == DIRECTED) {
+				const std::vector<vertex_id_t> &out
+					= range->out_neighs[id - range_start];
+				writer.add_vertex(id, in.data(), in.size(), out.data(),
+						out.size());
+			}
+			else
+				writer.add_vertex(id, in.data(), in.size());
+		}
+		range_start = range_end;
+	}
+	range->reset(0, 0, type);
+	writer.close(num_vertices, tmp_index_file);
+
+	// The index is renamed last. Once it exists, the image is complete.
+	if (rename(tmp_graph_file.c_str(), graph_file.c_str()) < 0
+			|| rename(tmp_index_file.c_str(), index_file.c_str()) < 0) {
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"can't move the new image to %1%: %2%")
+			% graph_file % strerror(errno);
+		return false;
+	}
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"folding %1% updated edges to a new image takes %2% seconds")
+		% fg->get_delta()->get_num_updates() % time_diff(start, end);
+	return true;
+}
+
+std::future<FG_graph::ptr> fold_graph_delta_async(FG_graph::ptr fg,
+		const std::string &graph_file, const std::string &index_file)
+{
+	return std::async(std::launch::async, fold_and_load, fg, graph_file,
+			index_file);
+}
+
 /********************** Get the degree of vertices ****************************/
 
 namespace {
@@ -356,10 +558,7 @@ public:
 	ts_degree_vertex(vertex_id_t id): compute_vertex(id) {
 	}
 
-	void run(vertex_program &prog) {
-		vertex_id_t id = prog.get_vertex_id(*this);
-		request_vertices(&id, 1);
-	}
+	void run(vertex_program &prog);
 
 	void run(vertex_program &prog, const page_vertex &vertex);
 
@@ -373,13 +572,20 @@ class ts_degree_vertex_program: public vertex_program_impl<ts_degree_vertex>
 	time_t time_interval;
 	edge_type type;
 	FG_vector<vsize_t>::ptr degree_vec;
+	ts_vertex_index::ptr ts_index;
 public:
 	ts_degree_vertex_program(FG_vector<vsize_t>::ptr degree_vec, edge_type type,
-			time_t start_time, time_t time_interval) {
+			time_t start_time, time_t time_interval,
+			ts_vertex_index::ptr ts_index) {
 		this->degree_vec = degree_vec;
 		this->type = type;
 		this->start_time = start_time;
 		this->time_interval = time_interval;
+		this->ts_index = ts_index;
+	}
+
+	const ts_vertex_index *get_ts_index() const {
+		return ts_index.get();
 	}
 
 	time_t get_start_time() const {
@@ -405,22 +611,42 @@ class ts_degree_vertex_program_creater: public vertex_program_creater
 	time_t time_interval;
 	FG_vector<vertex_id_t>::ptr degree_vec;
 	edge_type type;
+	ts_vertex_index::ptr ts_index;
 public:
 	ts_degree_vertex_program_creater(
 			FG_vector<vertex_id_t>::ptr degree_vec, edge_type type,
-			time_t start_time, time_t time_interval) {
+			time_t start_time, time_t time_interval,
+			ts_vertex_index::ptr ts_index) {
 		this->degree_vec = degree_vec;
 		this->type = type;
 		this->start_time = start_time;
 		this->time_interval = time_interval;
+		this->ts_index = ts_index;
 	}
 
 	vertex_program::ptr create() const {
 		return vertex_program::ptr(new ts_degree_vertex_program(
-					degree_vec, type, start_time, time_interval));
+					degree_vec, type, start_time, time_interval, ts_index));
 	}
 };
 
+void ts_degree_vertex::run(vertex_program &prog)
+{
+	ts_degree_vertex_program &degree_vprog = (ts_degree_vertex_program &) prog;
+	vertex_id_t id = prog.get_vertex_id(*this);
+	const ts_vertex_index *ts_index = degree_vprog.get_ts_index();
+	vsize_t degree;
+	// We don't need to read the vertex if the temporal index knows
+	// its degree in the time interval.
+	if (ts_index && ts_index->get_num_edges(id, degree_vprog.get_edge_type(),
+				degree_vprog.get_start_time(),
+				degree_vprog.get_time_interval(), degree)) {
+		degree_vprog.set_degree(id, degree);
+		return;
+	}
+	request_vertices(&id, 1);
+}
+
 void ts_degree_vertex::run(vertex_program &prog, const page_vertex &vertex)
 {
 	ts_degree_vertex_program &degree_vprog = (ts_degree_vertex_program &) prog;
@@ -430,16 +656,11 @@ void ts_degree_vertex::run(vertex_program &prog, const page_vertex &vertex)
 
 	if (prog.get_graph().is_directed()) {
 		const page_directed_vertex &dv = (const page_directed_vertex &) vertex;
-
-		page_byte_array::const_iterator<ts_edge_data> begin_it
-			= dv.get_data_begin<ts_edge_data>(type);
-		page_byte_array::const_iterator<ts_edge_data> end_it
-			= dv.get_data_end<ts_edge_data>(type);
-		page_byte_array::const_iterator<ts_edge_data> ts_it = std::lower_bound(
-				begin_it, end_it, ts_edge_data(start_time));
-		page_byte_array::const_iterator<ts_edge_data> ts_end_it = std::lower_bound(
-				begin_it, end_it, start_time + time_interval);
-		degree_vprog.set_degree(vertex.get_id(), ts_end_it - ts_it);
+		const ts_vertex_index *ts_index = degree_vprog.get_ts_index();
+		edge_seq_iterator it = ts_index ? get_ts_iterator(dv, type,
+				start_time, time_interval, *ts_index) : get_ts_iterator(dv,
+				type, start_time, time_interval);
+		degree_vprog.set_degree(vertex.get_id(), it.get_num_tot_entries());
 	}
 	else {
 		ABORT_MSG("undirected graph isn't supported");
@@ -449,7 +670,7 @@ void ts_degree_vertex::run(vertex_program &prog, const page_vertex &vertex)
 }
 
 FG_vector<vsize_t>::ptr get_ts_degree(FG_graph::ptr fg, edge_type type,
-		time_t start_time, time_t time_interval)
+		time_t start_time, time_t time_interval, ts_vertex_index::ptr ts_index)
 {
 	graph_index::ptr index = NUMA_graph_index<ts_degree_vertex>::create(
 			fg->get_graph_header());
@@ -459,7 +680,7 @@ FG_vector<vsize_t>::ptr get_ts_degree(FG_graph::ptr fg, edge_type type,
 	FG_vector<vsize_t>::ptr degree_vec = FG_vector<vsize_t>::create(graph);
 	graph->start_all(vertex_initializer::ptr(), vertex_program_creater::ptr(
 				new ts_degree_vertex_program_creater(degree_vec, type,
-					start_time, time_interval)));
+					start_time, time_interval, ts_index)));
 	graph->wait4complete();
 	return degree_vec;
 }
@@ -577,4 +798,92 @@ std::pair<time_t, time_t> get_time_range(FG_graph::ptr fg)
 	return std::pair<time_t, time_t>(start_time, end_time);
 }
 
+/************** Build the temporal index of a time-series graph ***************/
+
+namespace {
+
+class ts_index_vertex: public compute_vertex
+{
+public:
+	ts_index_vertex(vertex_id_t id): compute_vertex(id) {
+	}
+
+	void run(vertex_program &prog) {
+		vertex_id_t id = prog.get_vertex_id(*this);
+		request_vertices(&id, 1);
+	}
+
+	void run(vertex_program &prog, const page_vertex &vertex);
+
+	void run_on_message(vertex_program &, const vertex_message &msg) {
+	}
+};
+
+class ts_index_vertex_program: public vertex_program_impl<ts_index_vertex>
+{
+	ts_vertex_index::ptr ts_index;
+public:
+	ts_index_vertex_program(ts_vertex_index::ptr ts_index) {
+		this->ts_index = ts_index;
+	}
+
+	ts_vertex_index &get_ts_index() {
+		return *ts_index;
+	}
+};
+
+class ts_index_vertex_program_creater: public vertex_program_creater
+{
+	ts_vertex_index::ptr ts_index;
+public:
+	ts_index_vertex_program_creater(ts_vertex_index::ptr ts_index) {
+		this->ts_index = ts_index;
+	}
+
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new ts_index_vertex_program(ts_index));
+	}
+};
+
+void ts_index_vertex::run(vertex_program &prog, const page_vertex &vertex)
+{
+	ts_vertex_index &ts_index = ((ts_index_vertex_program &) prog).get_ts_index();
+	const page_directed_vertex &dv = (const page_directed_vertex &) vertex;
+	ts_index.set_timestamps(vertex.get_id(), IN_EDGE,
+			dv.get_data_begin<ts_edge_data>(IN_EDGE));
+	ts_index.set_timestamps(vertex.get_id(), OUT_EDGE,
+			dv.get_data_begin<ts_edge_data>(OUT_EDGE));
+}
+
+}
+
+ts_vertex_index::ptr build_ts_vertex_index(FG_graph::ptr fg)
+{
+	graph_index::ptr index = NUMA_graph_index<ts_index_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	assert(graph->get_graph_header().get_graph_type() == graph_type::DIRECTED);
+	assert(graph->get_graph_header().has_edge_data());
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	size_t num_vertices = graph->get_num_vertices();
+	std::vector<vsize_t> num_in_edges(num_vertices);
+	std::vector<vsize_t> num_out_edges(num_vertices);
+	for (vertex_id_t id = 0; id < num_vertices; id++) {
+		num_in_edges[id] = graph->get_num_edges(id, IN_EDGE);
+		num_out_edges[id] = graph->get_num_edges(id, OUT_EDGE);
+	}
+	ts_vertex_index::ptr ts_index = ts_vertex_index::create(num_vertices,
+			num_in_edges.data(), num_out_edges.data());
+	graph->start_all(vertex_initializer::ptr(), vertex_program_creater::ptr(
+				new ts_index_vertex_program_creater(ts_index)));
+	graph->wait4complete();
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"build a temporal index of %1% bytes in %2% seconds")
+		% ts_index->get_mem_size() % time_diff(start, end);
+	return ts_index;
+}
+
 }
@@ -20,10 +20,13 @@
  * limitations under the License.
  */
 
+#include <future>
+
 #include "graph_engine.h"
 #include "graph.h"
 #include "FG_vector.h"
 #include "graph_file_header.h"
+#include "graph_delta.h"
 
 namespace safs
 {
@@ -33,6 +36,8 @@ namespace safs
 namespace fg
 {
 
+class ts_vertex_index;
+
 /**
   * \brief A user-friendly wrapper for FlashGraph's raw graph type.
   *         Very usefule when when utilizing FlashGraph 
@@ -46,6 +51,7 @@ class FG_graph
 	std::string index_file;
 	std::shared_ptr<in_mem_graph> graph_data;
 	std::shared_ptr<vertex_index> index_data;
+	graph_delta::ptr delta;
 	config_map::ptr configs;
 
 	// In this case, the graph file is kept in SAFS and the index is read to
@@ -112,6 +118,33 @@ public:
 
 	std::shared_ptr<vertex_index> get_index_data() const;
 
+	/**
+	 * \brief Get the name of the index file of the graph.
+	 * \return The index file name. It's empty if the graph was created
+	 *         from in-memory data.
+	 */
+	const std::string &get_index_file() const {
+		return index_file;
+	}
+
+	/**
+	 * \brief Attach the edge updates applied after the graph image was
+	 *        constructed. Graph engines created afterwards run on
+	 *        the graph image merged with the updates.
+	 * \param delta The edge updates of the graph.
+	 */
+	void set_delta(graph_delta::ptr delta) {
+		this->delta = delta;
+	}
+
+	/**
+	 * \brief Get the edge updates attached to the graph.
+	 * \return The edge updates. It's NULL if the graph doesn't have any.
+	 */
+	graph_delta::ptr get_delta() const {
+		return delta;
+	}
+
 	graph_engine::ptr create_engine(graph_index::ptr index);
 
 	/**
@@ -150,14 +183,93 @@ enum directed_triangle_type
 
 FG_vector<vertex_id_t>::ptr compute_cc(FG_graph::ptr fg);
 
+/**
+ * \brief The work done by an incremental computation. A computation from
+ *        scratch processes all vertices in the graph in the first level.
+ */
+struct incremental_stats
+{
+	/** The number of times vertices are processed with their edge lists. */
+	size_t num_vertex_runs;
+	/** The number of levels (iterations) of the computation. */
+	int num_levels;
+	/** The number of vertices in the graph. */
+	size_t num_vertices;
+
+	incremental_stats() {
+		num_vertex_runs = 0;
+		num_levels = 0;
+		num_vertices = 0;
+	}
+};
+
+/**
+ * \brief A value estimated from samples and its error bound.
+ */
+struct approx_value
+{
+	/** The estimate. */
+	double value;
+	/** The half width of the 95% confidence interval of the estimate. */
+	double error;
+
+	approx_value() {
+		value = 0;
+		error = 0;
+	}
+
+	approx_value(double value, double error) {
+		this->value = value;
+		this->error = error;
+	}
+};
+
 /**
   * \brief Compute all weakly connectected components of a graph.
   *
   * \param fg The FlashGraph graph object for which you want to compute.
+  * \param async Run without synchronization at the end of iterations.
   * \return A vector with a component ID for each vertex in the graph.
   *
 */
-FG_vector<vertex_id_t>::ptr compute_wcc(FG_graph::ptr fg);
+FG_vector<vertex_id_t>::ptr compute_wcc(FG_graph::ptr fg, bool async = false);
+
+/**
+ * \brief Compute all weakly connected components of a graph with
+ *        Afforest, which links vertices in concurrent union-find trees.
+ *        Every vertex first links a few of its out-neighbors, which puts
+ *        most vertices in the largest component. Then only the vertices
+ *        outside the largest component read their edge lists again and
+ *        link the remaining neighbors, so most edge lists are read once,
+ *        instead of once in every level of label propagation.
+ *        It works on both directed and undirected graphs.
+ *
+ * \param fg The FlashGraph graph object for which you want to compute.
+ * \param num_samples The number of neighbors linked by a vertex first.
+ * \return A vector with a component ID for each vertex in the graph.
+ *         The component ID is the smallest vertex ID in the component.
+ */
+FG_vector<vertex_id_t>::ptr compute_wcc_afforest(FG_graph::ptr fg,
+		size_t num_samples = 2);
+
+/**
+ * \brief Update the weakly connected components of a graph after some of
+ *        its edges are changed, starting from the previous result.
+ *        Only the changed vertices are activated, and component IDs are
+ *        propagated from them until convergence. If edges were deleted,
+ *        the components that contain the changed vertices are recomputed.
+ *
+ * \param fg The FlashGraph graph object for which you want to compute.
+ * \param prev The result of `compute_wcc' before the edges changed.
+ * \param changed The endpoints of the inserted and deleted edges.
+ * \param has_deletions Whether any edges were deleted.
+ * \param stats The work done by the computation. It's ignored if NULL.
+ * \return A vector with a component ID for each vertex in the graph.
+ */
+FG_vector<vertex_id_t>::ptr compute_wcc_incremental(FG_graph::ptr fg,
+		FG_vector<vertex_id_t>::ptr prev,
+		const std::vector<vertex_id_t> &changed, bool has_deletions,
+		incremental_stats *stats = NULL);
 
 /**
   * \brief Compute all weakly connectected components of a graph synchronously.
@@ -186,10 +298,13 @@ FG_vector<vertex_id_t>::ptr compute_ts_wcc(FG_graph::ptr fg,
   * \brief Compute all strongly connected components of a graph.
   *
   * \param fg The FlashGraph graph object for which you want to compute.
+  * \param giant_only Only compute the giant SCC. The vertices that
+  *        aren't trimmed nor in the giant SCC get INVALID_VERTEX_ID.
   * \return A vector with a component ID for each vertex in the graph.
   *
 */
-FG_vector<vertex_id_t>::ptr compute_scc(FG_graph::ptr fg);
+FG_vector<vertex_id_t>::ptr compute_scc(FG_graph::ptr fg,
+		bool giant_only = false);
 
 /**
   * \brief Compute the directed triangle count for each each vertex.
@@ -237,6 +352,40 @@ FG_vector<size_t>::ptr compute_local_scan2(FG_graph::ptr fg);
 FG_vector<std::pair<vertex_id_t, size_t> >::ptr compute_topK_scan(
 		FG_graph::ptr, size_t topK);
 
+/**
+  * \brief Estimate the number of triangles in an undirected graph with
+  *        vertex sampling and wedge sampling. Only the adjacency lists of
+  *        the sampled vertices and of the endpoints of their sampled wedges
+  *        are read.
+  * \param fg The FlashGraph graph object for which you want to compute.
+  * \param sample_rate The probability that a vertex is sampled.
+  * \param num_wedges The number of wedges checked on a sampled vertex.
+  *        A vertex with fewer wedges checks all of them. Higher values are
+  *        more accurate and read more adjacency lists.
+  * \param seed The seed of the random samples.
+  * \return The estimated number of triangles in the graph and its error bound.
+  */
+approx_value approx_undirected_triangles(FG_graph::ptr fg, double sample_rate,
+		int num_wedges = 64, uint64_t seed = 0);
+
+/**
+  * \brief Estimate the top K vertices with the largest local scan statistic.
+  *        Only the `num_candidates' vertices with the largest degree are
+  *        considered, and the edges among their neighbors are estimated with
+  *        wedge sampling. Edges in both directions between two neighbors
+  *        count as two edges; duplicated edges count once.
+  * \param fg The FlashGraph graph object for which you want to compute.
+  * \param topK The value for K used for the `top K` vertices.
+  * \param num_candidates The number of vertices whose local scan is estimated.
+  * \param num_wedges The number of wedges checked on a candidate vertex.
+  * \param seed The seed of the random samples.
+  * \return A vector of the top K vertices and their estimated local scan,
+  *         in the descending order of the estimates.
+  */
+FG_vector<std::pair<vertex_id_t, approx_value> >::ptr approx_topK_scan(
+		FG_graph::ptr fg, size_t topK, size_t num_candidates,
+		int num_wedges = 64, uint64_t seed = 0);
+
 /**
   * \brief Compute the diameter estimation for a graph. 
   * \param fg The FlashGraph graph object for which you want to compute.
@@ -269,16 +418,61 @@ FG_vector<float>::ptr compute_pagerank(FG_graph::ptr fg, int num_iters,
   * \param fg The FlashGraph graph object for which you want to compute.
   * \param num_iters The maximum number of iterations for PageRank.
   * \param damping_factor The damping factor. Originally .85.
+  * \param async Run without synchronization at the end of iterations.
+  *        `num_iters' then limits the iterations of each worker thread.
   *
   * \return A vector with an entry for each vertex in the graph's
   *         PageRank value.
   *
 */
 FG_vector<float>::ptr compute_pagerank2(FG_graph::ptr, int num_iters,
-		float damping_factor);
+		float damping_factor, bool async = false);
+
+/**
+  * \brief Compute PageRank with edge_map. It computes the same PageRank
+  *        as `compute_pagerank2', but the vertices iterate their edges
+  *        with the edge function inlined.
+  *
+  * \param fg The FlashGraph graph object for which you want to compute.
+  * \param num_iters The maximum number of iterations for PageRank.
+  * \param damping_factor The damping factor. Originally .85.
+  *
+  * \return A vector with an entry for each vertex in the graph's
+  *         PageRank value.
+*/
+FG_vector<float>::ptr compute_pagerank_edge_map(FG_graph::ptr fg,
+		int num_iters, float damping_factor);
 
+/**
+  * \brief Update the PageRank of a graph after some of its edges are
+  *        changed, starting from the previous PageRank values.
+  *        Only the changed vertices are activated in the first iteration,
+  *        and the changes are propagated until the PageRank converges.
+  *
+  * \param fg The FlashGraph graph object for which you want to compute.
+  * \param prev The result of `compute_pagerank' before the edges changed.
+  * \param changed The endpoints of the inserted and deleted edges.
+  * \param num_iters The maximum number of iterations for PageRank.
+  * \param damping_factor The damping factor. Originally .85.
+  * \param stats The work done by the computation. It's ignored if NULL.
+  *
+  * \return A vector with an entry for each vertex in the graph's
+  *         PageRank value.
+*/
+FG_vector<float>::ptr compute_pagerank_incremental(FG_graph::ptr fg,
+		FG_vector<float>::ptr prev, const std::vector<vertex_id_t> &changed,
+		int num_iters, float damping_factor, incremental_stats *stats = NULL);
+
+/**
+ * \brief Compute the scan statistics of a time-series graph in the time
+ *        interval starting at `start_time' and the previous intervals.
+ * \param ts_index The temporal index of the graph. If it's provided,
+ *        the vertices without edges in the time intervals aren't read.
+ */
 FG_vector<float>::ptr compute_sstsg(FG_graph::ptr fg, time_t start_time,
-		time_t interval, int num_intervals);
+		time_t interval, int num_intervals,
+		std::shared_ptr<ts_vertex_index> ts_index
+		= std::shared_ptr<ts_vertex_index>());
 
 /**
  * \brief Fetch the clusters with the wanted cluster IDs.
@@ -290,6 +484,42 @@ FG_vector<float>::ptr compute_sstsg(FG_graph::ptr fg, time_t start_time,
 in_mem_subgraph::ptr fetch_subgraph(FG_graph::ptr graph,
 		const std::vector<vertex_id_t> &vertices);
 
+/**
+ * \brief Fold the edge updates of a graph into a new graph image.
+ *        It only reads the current image, so the image can still be used
+ *        while the new one is constructed, e.g., in a background thread.
+ *        The updates can't be modified until it returns.
+ *        The adjacency lists are merged in ranges of vertex IDs and
+ *        streamed to the new image, so the memory used doesn't grow with
+ *        the size of the graph. The new image is written to temporary
+ *        files, which are renamed to `graph_file' and `index_file' when
+ *        the image is complete.
+ *
+ * \param fg The FlashGraph graph object with edge updates.
+ * \param graph_file The file of the adjacency lists in the new image.
+ * \param index_file The file of the index in the new image.
+ * \return false if the graph doesn't have updates.
+ */
+bool fold_graph_delta(FG_graph::ptr fg, const std::string &graph_file,
+		const std::string &index_file);
+
+/**
+ * \brief Fold the edge updates of a graph into a new graph image in
+ *        a background thread, so queries keep running on `fg'. Once the
+ *        new image is complete, it's loaded to a new graph object and
+ *        the caller switches to it by replacing its pointer; the old image
+ *        is released when the last query on it completes.
+ *        The updates can't be modified until the future is ready.
+ *
+ * \param fg The FlashGraph graph object with edge updates.
+ * \param graph_file The file of the adjacency lists in the new image.
+ * \param index_file The file of the index in the new image.
+ * \return The future of the graph object of the new image. The graph
+ *         object is NULL if the graph doesn't have updates.
+ */
+std::future<FG_graph::ptr> fold_graph_delta_async(FG_graph::ptr fg,
+		const std::string &graph_file, const std::string &index_file);
+
 /**
  * \brief Compute the k-core/coreness of a graph. The algorithm will 
  *        determine which vertices are between core `k` and `kmax` --
@@ -297,8 +527,10 @@ in_mem_subgraph::ptr fetch_subgraph(FG_graph::ptr graph,
  * \param fg The FlashGraph graph object for which you want to compute.
  * \param k The core value to be computed.
  * \param kmax (Optional) The kmax value. If omitted then all cores are
- *        computed i.e., coreness. *This is not recommended for very large
- *        graphs.*
+ *        computed i.e., coreness. Vertices are peeled from buckets of
+ *        degrees, so the full coreness reads each edge list once.
+ *        If checkpointing is enabled, the decomposition is checkpointed
+ *        between rounds and resumes from the last checkpoint.
  * \return An `FG_vector` containing the core of each vertex between `k`
  *         and `kmax`. All other vertices are assigned to core 0.
  */
@@ -327,11 +559,53 @@ FG_vector<float>::ptr compute_transitivity(FG_graph::ptr fg);
   *
   * \param fg The FlashGraph graph object for which you want to compute.
   * \param vids The vertex IDs for which BC should be computed
+  * \param num_para_bfs The number of BFS that run at the same time (1-512).
+  *        Every vertex reached in a batch keeps 12 bytes of state for each
+  *        BFS, so a batch needs up to V * num_para_bfs * 12 bytes of memory
+  *        for a graph with V vertices.
   * \return A vector with an entry for each vertex in the graph's
   *         betweennesss centrality value.
 */
 FG_vector<float>::ptr compute_betweenness_centrality(FG_graph::ptr fg,
-		const std::vector<vertex_id_t>& vids);
+		const std::vector<vertex_id_t>& vids, size_t num_para_bfs = 64);
+
+/**
+  * \brief Compute the closeness centrality of vertices in a graph.
+  *        The closeness of a vertex is the number of vertices it can reach
+  *        divided by the sum of the distances to these vertices.
+  *
+  * \param fg The FlashGraph graph object for which you want to compute.
+  * \param vids The vertex IDs for which closeness should be computed.
+  * \param traverse_e The type of edges to traverse: IN_EDGE, OUT_EDGE,
+  *        BOTH_EDGES.
+  * \param num_para_bfs The number of BFS that run at the same time (1-512).
+  * \return A vector with an entry for each vertex in `vids'.
+*/
+FG_vector<float>::ptr compute_closeness_centrality(FG_graph::ptr fg,
+		const std::vector<vertex_id_t>& vids,
+		edge_type traverse_e = edge_type::OUT_EDGE, size_t num_para_bfs = 64);
+
+/**
+  * \brief Compute the shortest distances from a vertex to all vertices
+  *        in a weighted graph with delta-stepping. The edge weights are
+  *        stored as the edge data of the graph and have to be non-negative.
+  *
+  * \param fg The FlashGraph graph object for which you want to compute.
+  * \param start_vertex The vertex where the shortest paths start.
+  * \param traverse_e The type of edges to traverse: IN_EDGE, OUT_EDGE,
+  *        BOTH_EDGES.
+  * \param weight_type The type of edge weights: "I" (int), "L" (long),
+  *        "F" (float) or "D" (double).
+  * \param delta The width of a bucket. The edges with weights <= delta are
+  *        light edges.
+  * \param async Whether to run without buckets in the asynchronous mode,
+  *        where the vertices with shorter distances run first.
+  * \return A vector with an entry for each vertex's distance from
+  *         `start_vertex'. The distance is infinity if it can't be reached.
+*/
+FG_vector<double>::ptr compute_sssp(FG_graph::ptr fg, vertex_id_t start_vertex,
+		edge_type traverse_e, const std::string &weight_type, double delta,
+		bool async = false);
 
 /**
  * \brief Get the degree of all vertices in a specified time interval in
@@ -340,10 +614,23 @@ FG_vector<float>::ptr compute_betweenness_centrality(FG_graph::ptr fg,
  * \param type The edge type: IN_EDGE, OUT_EDGE, BOTH_EDGES.
  * \param start_time The start time of the time interval.
  * \param time_interval length of the time interval.
+ * \param ts_index The temporal index of the graph. If it's provided,
+ *        the vertices whose degree is decided by the index aren't read.
  * \return A vector with an entry for each vertex degree.
  */
 FG_vector<vsize_t>::ptr get_ts_degree(FG_graph::ptr fg, edge_type type,
-		time_t start_time, time_t time_interval);
+		time_t start_time, time_t time_interval,
+		std::shared_ptr<ts_vertex_index> ts_index
+		= std::shared_ptr<ts_vertex_index>());
+
+/**
+ * \brief Build the temporal index of a time-series graph. It reads all
+ *        vertices once. The index can be saved with `ts_vertex_index::dump'
+ *        and loaded with `ts_vertex_index::load' later.
+ * \param fg The FlashGraph graph object.
+ * \return The temporal index of the graph.
+ */
+std::shared_ptr<ts_vertex_index> build_ts_vertex_index(FG_graph::ptr fg);
 
 /**
  * \brief Get the time range in which the time-series graph is.
@@ -370,10 +657,20 @@ void compute_overlap(FG_graph::ptr fg, const std::vector<vertex_id_t> &vids,
 FG_vector<float>::ptr compute_transitivity(FG_graph::ptr fg);
 
 /**
- * \brief Compute louvain clustering for a graph.
+ * \brief Find communities in a graph with the multi-level Louvain method.
+ *        A directed graph is treated as undirected. If the edges have
+ *        `edge_count' as edge data, the counts are used as edge weights.
+ *        The first level runs on the graph in SAFS and the following
+ *        levels run on the coarse graphs in memory.
  * \param fg The FlashGraph graph object for which you want to compute.
- * \param levels The number of levels of the hierarchy to do.
+ * \param levels The max number of levels of the hierarchy. It stops
+ *        earlier if a level doesn't merge any communities.
+ * \param max_iters The max number of iterations of moving vertices in
+ *        a level.
+ * \return A vector with the community ID of each vertex. The community IDs
+ *        are consecutive, starting from 0.
  */
-void compute_louvain(FG_graph::ptr fg, const uint32_t levels);
+FG_vector<vertex_id_t>::ptr compute_louvain(FG_graph::ptr fg, uint32_t levels,
+		int max_iters = 30);
 }
 #endif
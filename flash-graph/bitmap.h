@@ -42,9 +42,11 @@ class bitmap
 
 	template<class T>
 	static void get_set_bits_long(long value, size_t idx, std::vector<T> &v) {
-		for (int i = 0; i < NUM_BITS_LONG; i++) {
-			if (value & (1L << i))
-				v.push_back(i + idx * NUM_BITS_LONG);
+		// Only visit the bits that are set.
+		unsigned long bits = value;
+		while (bits) {
+			v.push_back(__builtin_ctzl(bits) + idx * NUM_BITS_LONG);
+			bits &= bits - 1;
 		}
 	}
 public:
@@ -0,0 +1,337 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <boost/format.hpp>
+
+#include "thread.h"
+#include "io_interface.h"
+#include "safs_file.h"
+#include "safs_exception.h"
+#include "comm_exception.h"
+#include "log.h"
+
+#include "checkpoint.h"
+#include "graph_exception.h"
+
+using namespace safs;
+
+namespace fg
+{
+
+namespace
+{
+
+const uint64_t CHECKPOINT_MAGIC = 0x4647434b50543031UL;
+
+/*
+ * The metadata of the last complete checkpoint. It's stored as the user
+ * metadata of the SAFS file with the name of the checkpoint and it's
+ * followed by the driver state.
+ */
+struct checkpoint_meta
+{
+	uint64_t magic;
+	int32_t level;
+	int32_t slot;
+	int32_t num_parts;
+	uint64_t vertex_size;
+	uint64_t num_vertices;
+	uint64_t driver_state_size;
+};
+
+/*
+ * The header in the first page of a partition file.
+ */
+struct part_header
+{
+	uint64_t magic;
+	int32_t level;
+	int32_t part_id;
+	uint64_t vertex_size;
+	uint64_t data_size;
+	uint64_t num_active;
+};
+
+/*
+ * This writes data to a SAFS file sequentially. The data is copied to
+ * two page-aligned buffers, so we can fill one buffer while the other
+ * is being written.
+ */
+class seq_file_writer
+{
+	static const size_t BUF_SIZE = 16 * 1024 * 1024;
+	io_interface::ptr io;
+	char *bufs[2];
+	int curr;
+	size_t buf_off;
+	off_t file_off;
+
+	void flush_buf() {
+		size_t size = ROUNDUP_PAGE(buf_off);
+		memset(bufs[curr] + buf_off, 0, size - buf_off);
+		data_loc_t loc(io->get_file_id(), file_off);
+		io_request req(bufs[curr], loc, size, WRITE);
+		io->access(&req, 1);
+		file_off += size;
+		buf_off = 0;
+		curr = 1 - curr;
+		// The other buffer can't be reused until it's written.
+		while (io->num_pending_ios() > 1)
+			io->wait4complete(1);
+	}
+public:
+	seq_file_writer(io_interface::ptr io) {
+		this->io = io;
+		for (int i = 0; i < 2; i++) {
+			int ret = posix_memalign((void **) &bufs[i], PAGE_SIZE, BUF_SIZE);
+			if (ret != 0)
+				throw oom_exception("can't allocate the checkpoint buffer");
+		}
+		curr = 0;
+		buf_off = 0;
+		file_off = 0;
+	}
+
+	~seq_file_writer() {
+		free(bufs[0]);
+		free(bufs[1]);
+	}
+
+	void append(const char *data, size_t size) {
+		while (size > 0) {
+			size_t copy_size = std::min(size, BUF_SIZE - buf_off);
+			memcpy(bufs[curr] + buf_off, data, copy_size);
+			buf_off += copy_size;
+			data += copy_size;
+			size -= copy_size;
+			if (buf_off == BUF_SIZE)
+				flush_buf();
+		}
+	}
+
+	/*
+	 * The next data starts from a new page.
+	 */
+	void align() {
+		size_t new_off = ROUNDUP_PAGE(buf_off);
+		memset(bufs[curr] + buf_off, 0, new_off - buf_off);
+		buf_off = new_off;
+		if (buf_off == BUF_SIZE)
+			flush_buf();
+	}
+
+	size_t finish() {
+		if (buf_off > 0)
+			flush_buf();
+		if (io->num_pending_ios() > 0)
+			io->wait4complete(io->num_pending_ios());
+		return file_off;
+	}
+};
+
+/*
+ * This reads data from a SAFS file sequentially.
+ */
+class seq_file_reader
+{
+	static const size_t BUF_SIZE = 16 * 1024 * 1024;
+	io_interface::ptr io;
+	size_t file_size;
+	char *buf;
+	size_t buf_off;
+	size_t buf_size;
+	off_t file_off;
+
+	void fill_buf() {
+		if ((size_t) file_off >= file_size)
+			throw wrong_format("the checkpoint file is truncated");
+		buf_size = std::min(BUF_SIZE, file_size - file_off);
+		data_loc_t loc(io->get_file_id(), file_off);
+		io_request req(buf, loc, buf_size, READ);
+		io->access(&req, 1);
+		io->wait4complete(1);
+		file_off += buf_size;
+		buf_off = 0;
+	}
+public:
+	seq_file_reader(io_interface::ptr io, size_t file_size) {
+		this->io = io;
+		this->file_size = file_size;
+		int ret = posix_memalign((void **) &buf, PAGE_SIZE, BUF_SIZE);
+		if (ret != 0)
+			throw oom_exception("can't allocate the checkpoint buffer");
+		buf_off = 0;
+		buf_size = 0;
+		file_off = 0;
+	}
+
+	~seq_file_reader() {
+		free(buf);
+	}
+
+	void read(char *data, size_t size) {
+		while (size > 0) {
+			if (buf_off == buf_size)
+				fill_buf();
+			size_t copy_size = std::min(size, buf_size - buf_off);
+			memcpy(data, buf + buf_off, copy_size);
+			buf_off += copy_size;
+			data += copy_size;
+			size -= copy_size;
+		}
+	}
+
+	void align() {
+		buf_off = std::min((size_t) ROUNDUP_PAGE(buf_off), buf_size);
+	}
+};
+
+}
+
+graph_checkpoint::graph_checkpoint(const std::string &name, int num_parts,
+		size_t vertex_size, size_t num_vertices)
+{
+	this->name = name;
+	this->num_parts = num_parts;
+	this->vertex_size = vertex_size;
+	this->num_vertices = num_vertices;
+	last_slot = 1;
+	last_level = -1;
+
+	safs_file meta_f(get_sys_RAID_conf(), name);
+	if (!meta_f.exist()) {
+		// The file only carries the metadata.
+		if (!meta_f.create_file(PAGE_SIZE))
+			throw io_exception(boost::str(boost::format(
+							"can't create the checkpoint %1%") % name));
+		return;
+	}
+
+	std::vector<char> data = meta_f.get_user_metadata();
+	if (data.size() < sizeof(checkpoint_meta))
+		return;
+	const checkpoint_meta *meta = (const checkpoint_meta *) data.data();
+	if (meta->magic != CHECKPOINT_MAGIC
+			|| data.size() - sizeof(*meta) < meta->driver_state_size
+			|| meta->num_parts != num_parts
+			|| meta->vertex_size != vertex_size
+			|| meta->num_vertices != num_vertices) {
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"checkpoint %1% doesn't match the graph engine, ignore it")
+			% name;
+		return;
+	}
+	last_slot = meta->slot;
+	last_level = meta->level;
+	const char *state = (const char *) (meta + 1);
+	driver_state.assign(state, state + meta->driver_state_size);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"checkpoint %1% can resume from level %2%") % name % last_level;
+}
+
+std::string graph_checkpoint::get_part_file(int slot, int part_id) const
+{
+	return boost::str(boost::format("%1%-%2%-%3%") % name % slot % part_id);
+}
+
+size_t graph_checkpoint::write_part(int level, int part_id, const char *data,
+		size_t size, const std::vector<vertex_id_t> &local_ids) const
+{
+	// We never overwrite the last complete checkpoint.
+	int slot = 1 - last_slot;
+	std::string file_name = get_part_file(slot, part_id);
+	// A partition file can hold all vertices of the partition being active.
+	size_t file_size = PAGE_SIZE + ROUNDUP_PAGE(size)
+		+ ROUNDUP_PAGE(sizeof(vertex_id_t) * size / vertex_size);
+	safs_file part_f(get_sys_RAID_conf(), file_name);
+	if (part_f.exist() && (size_t) part_f.get_size() < file_size)
+		part_f.delete_file();
+	if (!part_f.exist() && !part_f.create_file(file_size))
+		throw io_exception(boost::str(boost::format(
+						"can't create the checkpoint file %1%") % file_name));
+
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	seq_file_writer writer(io);
+	part_header header;
+	header.magic = CHECKPOINT_MAGIC;
+	header.level = level;
+	header.part_id = part_id;
+	header.vertex_size = vertex_size;
+	header.data_size = size;
+	header.num_active = local_ids.size();
+	writer.append((const char *) &header, sizeof(header));
+	writer.align();
+	writer.append(data, size);
+	writer.align();
+	writer.append((const char *) local_ids.data(),
+			sizeof(local_ids[0]) * local_ids.size());
+	return writer.finish();
+}
+
+void graph_checkpoint::commit(int level,
+		const std::vector<char> &driver_state)
+{
+	checkpoint_meta meta;
+	meta.magic = CHECKPOINT_MAGIC;
+	meta.level = level;
+	meta.slot = 1 - last_slot;
+	meta.num_parts = num_parts;
+	meta.vertex_size = vertex_size;
+	meta.num_vertices = num_vertices;
+	meta.driver_state_size = driver_state.size();
+	std::vector<char> data((char *) &meta, (char *) (&meta + 1));
+	data.insert(data.end(), driver_state.begin(), driver_state.end());
+	safs_file meta_f(get_sys_RAID_conf(), name);
+	if (!meta_f.set_user_metadata(data))
+		throw io_exception(boost::str(boost::format(
+						"can't commit the checkpoint %1%") % name));
+	last_slot = meta.slot;
+	last_level = level;
+	this->driver_state = driver_state;
+}
+
+void graph_checkpoint::read_part(int part_id, char *data, size_t size,
+		std::vector<vertex_id_t> &local_ids) const
+{
+	assert(last_level >= 0);
+	std::string file_name = get_part_file(last_slot, part_id);
+	file_io_factory::shared_ptr factory = create_io_factory(file_name,
+			REMOTE_ACCESS);
+	io_interface::ptr io = create_io(factory, thread::get_curr_thread());
+	seq_file_reader reader(io, factory->get_file_size());
+	part_header header;
+	reader.read((char *) &header, sizeof(header));
+	if (header.magic != CHECKPOINT_MAGIC || header.level != last_level
+			|| header.part_id != part_id || header.data_size != size)
+		throw wrong_format(boost::str(boost::format(
+						"wrong checkpoint file %1%") % file_name));
+	reader.align();
+	reader.read(data, size);
+	reader.align();
+	local_ids.resize(header.num_active);
+	reader.read((char *) local_ids.data(),
+			sizeof(local_ids[0]) * local_ids.size());
+}
+
+}
@@ -0,0 +1,119 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FG_basic_types.h"
+
+namespace fg
+{
+
+/*
+ * This stores the checkpoints of the graph engine in SAFS.
+ *
+ * A checkpoint is taken at the boundary of two levels. At this point, all
+ * messages sent in the level have been processed, so the vertex state and
+ * the vertices activated for the next level are all we need to resume
+ * the graph algorithm. Each worker thread writes the vertex state and
+ * the active vertices of its own partition to a separate SAFS file with
+ * large sequential writes, so all threads write in parallel.
+ *
+ * The partition files are kept in two slots. A new checkpoint is written
+ * to the slot that doesn't contain the last complete checkpoint, and it
+ * becomes the last complete checkpoint after all partitions are written
+ * and the metadata in the file `name' is updated. As such, we can always
+ * resume from a complete checkpoint even if the process dies while it's
+ * writing a checkpoint.
+ *
+ * A graph algorithm that runs the graph engine multiple times keeps its own
+ * state between runs, e.g., the stage of the algorithm. This driver state
+ * is stored with the metadata, so it's always consistent with the vertex
+ * state in the checkpoint.
+ */
+class graph_checkpoint
+{
+	std::string name;
+	int num_parts;
+	size_t vertex_size;
+	size_t num_vertices;
+	// The slot and the level of the last complete checkpoint.
+	// The level is -1 if there isn't a complete checkpoint.
+	int last_slot;
+	int last_level;
+	// The driver state of the last complete checkpoint.
+	std::vector<char> driver_state;
+
+	graph_checkpoint(const std::string &name, int num_parts,
+			size_t vertex_size, size_t num_vertices);
+
+	std::string get_part_file(int slot, int part_id) const;
+public:
+	typedef std::shared_ptr<graph_checkpoint> ptr;
+
+	/*
+	 * The checkpoint files are named after `name'. The number of partitions,
+	 * the size of a vertex and the number of vertices are used to verify
+	 * an existing checkpoint.
+	 */
+	static ptr create(const std::string &name, int num_parts,
+			size_t vertex_size, size_t num_vertices) {
+		return ptr(new graph_checkpoint(name, num_parts, vertex_size,
+					num_vertices));
+	}
+
+	/*
+	 * Get the level that runs after the last complete checkpoint.
+	 * It returns -1 if there isn't a complete checkpoint.
+	 */
+	int get_last_level() const {
+		return last_level;
+	}
+
+	const std::vector<char> &get_driver_state() const {
+		return driver_state;
+	}
+
+	/*
+	 * Write a partition to the checkpoint of a level. It's invoked by
+	 * the worker thread that owns the partition.
+	 * It returns the number of bytes written.
+	 */
+	size_t write_part(int level, int part_id, const char *data, size_t size,
+			const std::vector<vertex_id_t> &local_ids) const;
+	/*
+	 * Mark the checkpoint of a level complete after all partitions
+	 * are written. The driver state is stored with the checkpoint.
+	 */
+	void commit(int level,
+			const std::vector<char> &driver_state = std::vector<char>());
+	/*
+	 * Read a partition from the last complete checkpoint.
+	 */
+	void read_part(int part_id, char *data, size_t size,
+			std::vector<vertex_id_t> &local_ids) const;
+};
+
+}
+
+#endif
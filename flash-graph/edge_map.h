@@ -0,0 +1,300 @@
+#ifndef __EDGE_MAP_H__
+#define __EDGE_MAP_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+#include <memory>
+
+#include <boost/foreach.hpp>
+
+#include "graph_engine.h"
+#include "vertex_program.h"
+#include "frontier.h"
+
+namespace fg
+{
+
+/*
+ * edge_map applies a function on the edges of a frontier of vertices in
+ * the style of Ligra. The state of vertices is kept by the application in
+ * arrays indexed by vertex IDs, and the function is a class that provides
+ * the following methods:
+ *
+ *	// Update `dst' with the edge from `src' in the pull mode. Only
+ *	// the worker thread that runs `dst' updates it. It returns true if
+ *	// `dst' should be in the output frontier.
+ *	bool update(vertex_id_t src, vertex_id_t dst);
+ *	// Update `dst' with the edge from `src' in the push mode. `dst' can
+ *	// be updated by multiple threads at the same time.
+ *	bool update_atomic(vertex_id_t src, vertex_id_t dst);
+ *	// Whether `dst' still needs to be updated.
+ *	bool cond(vertex_id_t dst) const;
+ *
+ * The function is copied to every worker thread and its methods are
+ * inlined in the loop on the edge lists. The loop runs on the pages
+ * of an edge list directly, so it doesn't check page boundaries for
+ * every edge as edge_seq_iterator does.
+ *
+ * In the push mode, the vertices in the frontier read their edge lists of
+ * the specified type and update their neighbors. In the pull mode,
+ * the vertices whose `cond' is true read their edge lists of the reverse
+ * type and are updated by their neighbors in the frontier. As Ligra does,
+ * edge_map pulls when the frontier and its edges are a large fraction of
+ * the graph.
+ *
+ * The graph engine has to be created with edge_map_vertex. It runs one
+ * level for each edge_map.
+ */
+
+enum edge_map_mode
+{
+	EDGE_MAP_AUTO,
+	EDGE_MAP_PUSH,
+	EDGE_MAP_PULL,
+};
+
+class edge_map_vertex: public compute_directed_vertex
+{
+public:
+	edge_map_vertex(vertex_id_t id): compute_directed_vertex(id) {
+	}
+
+	void request_edges(vertex_id_t id, edge_type type, bool directed) {
+		if (directed) {
+			directed_vertex_request req(id, type);
+			request_partial_vertices(&req, 1);
+		}
+		else
+			request_vertices(&id, 1);
+	}
+
+	// The vertices only run in edge_map_program.
+	void run(vertex_program &) {
+		ABORT_MSG("edge_map_vertex has to run in edge_map");
+	}
+
+	void run(vertex_program &, const page_vertex &) {
+		ABORT_MSG("edge_map_vertex has to run in edge_map");
+	}
+};
+
+template<class Func>
+class edge_map_program: public vertex_program_impl<edge_map_vertex>
+{
+	Func func;
+	// It's only accessed in the pull mode.
+	const vertex_frontier &frontier;
+	// The type of edges read by the vertices that run in the engine.
+	edge_type type;
+	bool pull;
+	bool directed;
+	// The vertices in the output frontier found by the thread.
+	std::vector<vertex_id_t> out;
+
+	void push(vertex_id_t src, const page_vertex &vertex, edge_type type) {
+		edge_seq_iterator it = vertex.get_neigh_seq_it(type);
+		const vertex_id_t *neighs;
+		int num;
+		while ((neighs = it.next_page_span(num)) != NULL) {
+			for (int i = 0; i < num; i++) {
+				vertex_id_t dst = neighs[i];
+				if (func.cond(dst) && func.update_atomic(src, dst))
+					out.push_back(dst);
+			}
+		}
+	}
+
+	/*
+	 * It returns false if `dst' doesn't need to be updated any more.
+	 */
+	bool pull_edges(vertex_id_t dst, const page_vertex &vertex,
+			edge_type type, bool &added) {
+		edge_seq_iterator it = vertex.get_neigh_seq_it(type);
+		const vertex_id_t *neighs;
+		int num;
+		while ((neighs = it.next_page_span(num)) != NULL) {
+			for (int i = 0; i < num; i++) {
+				vertex_id_t src = neighs[i];
+				if (!frontier.contains(src))
+					continue;
+				if (func.update(src, dst) && !added) {
+					out.push_back(dst);
+					added = true;
+				}
+				if (!func.cond(dst))
+					return false;
+			}
+		}
+		return true;
+	}
+public:
+	edge_map_program(const Func &_func, const vertex_frontier &_frontier,
+			edge_type type, bool pull, bool directed): func(_func), frontier(
+				_frontier) {
+		this->type = type;
+		this->pull = pull;
+		this->directed = directed;
+	}
+
+	std::vector<vertex_id_t> &get_out() {
+		return out;
+	}
+
+	virtual void run(compute_vertex &comp_v) {
+		vertex_id_t id = get_vertex_id(comp_v);
+		if (get_graph().get_num_edges(id, type) > 0)
+			((edge_map_vertex &) comp_v).request_edges(id, type, directed);
+	}
+
+	virtual void run(compute_vertex &comp_v, const page_vertex &vertex) {
+		vertex_id_t id = vertex.get_id();
+		// A directed vertex doesn't have an edge list with both types
+		// of edges.
+		if (directed && type == BOTH_EDGES) {
+			if (pull) {
+				bool added = false;
+				if (pull_edges(id, vertex, IN_EDGE, added))
+					pull_edges(id, vertex, OUT_EDGE, added);
+			}
+			else {
+				push(id, vertex, IN_EDGE);
+				push(id, vertex, OUT_EDGE);
+			}
+		}
+		else if (pull) {
+			bool added = false;
+			pull_edges(id, vertex, type, added);
+		}
+		else
+			push(id, vertex, type);
+	}
+};
+
+template<class Func>
+class edge_map_program_creater: public vertex_program_creater
+{
+	const Func &func;
+	const vertex_frontier &frontier;
+	edge_type type;
+	bool pull;
+	bool directed;
+public:
+	edge_map_program_creater(const Func &_func,
+			const vertex_frontier &_frontier, edge_type type, bool pull,
+			bool directed): func(_func), frontier(_frontier) {
+		this->type = type;
+		this->pull = pull;
+		this->directed = directed;
+	}
+
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new edge_map_program<Func>(func, frontier,
+					type, pull, directed));
+	}
+};
+
+/*
+ * In the pull mode, all vertices whose `cond' is true run.
+ */
+template<class Func>
+class edge_map_filter: public vertex_filter
+{
+	Func func;
+public:
+	edge_map_filter(const Func &_func): func(_func) {
+	}
+
+	bool keep(vertex_program &prog, compute_vertex &v) {
+		return func.cond(prog.get_vertex_id(v));
+	}
+};
+
+static inline edge_type reverse_edge_type(edge_type type)
+{
+	switch (type) {
+		case IN_EDGE:
+			return OUT_EDGE;
+		case OUT_EDGE:
+			return IN_EDGE;
+		default:
+			return type;
+	}
+}
+
+/*
+ * Apply `func' on the edges of the specified type from the vertices in
+ * the frontier. It returns the frontier of the vertices updated by `func'.
+ */
+template<class Func>
+vertex_frontier edge_map(graph_engine &graph, vertex_frontier &frontier,
+		edge_type type, const Func &func, edge_map_mode mode = EDGE_MAP_AUTO)
+{
+	size_t num_vertices = graph.get_num_vertices();
+	vertex_frontier next(num_vertices);
+	if (frontier.empty())
+		return next;
+
+	bool directed = graph.is_directed();
+	// An undirected vertex only has one edge list.
+	if (!directed)
+		type = BOTH_EDGES;
+
+	bool pull = mode == EDGE_MAP_PULL;
+	if (mode == EDGE_MAP_AUTO) {
+		size_t num_edges = 0;
+		auto add_edges = [&](vertex_id_t id) {
+			num_edges += graph.get_num_edges(id, type);
+		};
+		frontier.for_each(add_edges);
+		pull = frontier.size() + num_edges
+			> graph.get_graph_header().get_num_edges() / 20;
+	}
+
+	if (pull) {
+		graph.start(std::shared_ptr<vertex_filter>(
+					new edge_map_filter<Func>(func)),
+				vertex_program_creater::ptr(new edge_map_program_creater<Func>(
+						func, frontier, reverse_edge_type(type), true,
+						directed)));
+	}
+	else {
+		std::vector<vertex_id_t> ids;
+		frontier.get_vertices(ids);
+		graph.start(ids.data(), ids.size(), vertex_initializer::ptr(),
+				vertex_program_creater::ptr(new edge_map_program_creater<Func>(
+						func, frontier, type, false, directed)));
+	}
+	graph.wait4complete();
+
+	std::vector<vertex_program::ptr> progs;
+	graph.get_vertex_programs(progs);
+	BOOST_FOREACH(vertex_program::ptr prog, progs) {
+		std::vector<vertex_id_t> &out
+			= ((edge_map_program<Func> &) *prog).get_out();
+		next.add(out.data(), out.size());
+		out.clear();
+	}
+	return next;
+}
+
+}
+
+#endif
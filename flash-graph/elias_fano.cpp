@@ -0,0 +1,102 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "elias_fano.h"
+
+namespace fg
+{
+
+const size_t elias_fano_array::SELECT_SAMPLE;
+
+void elias_fano_array::init(size_t num, uint64_t max_val)
+{
+	this->num_vals = 0;
+	this->capacity = num;
+	this->max_val = max_val;
+	this->last_val = 0;
+	num_low_bits = 0;
+	if (num > 0 && max_val / num > 1)
+		num_low_bits = 63 - __builtin_clzl(max_val / num);
+	low_mask = num_low_bits == 0 ? 0 : (1UL << num_low_bits) - 1;
+
+	// We add an extra word to each array, so we never read beyond
+	// the end of the arrays.
+	lows.clear();
+	lows.resize((num * num_low_bits + 63) / 64 + 1);
+	size_t num_high_bits = num + (max_val >> num_low_bits) + 1;
+	highs.clear();
+	highs.resize((num_high_bits + 63) / 64 + 1);
+	samples.clear();
+}
+
+void elias_fano_array::append(uint64_t val)
+{
+	assert(num_vals < capacity);
+	assert(val >= last_val);
+	assert(val <= max_val);
+	last_val = val;
+
+	if (num_low_bits > 0) {
+		uint64_t low = val & low_mask;
+		size_t bit_off = num_vals * num_low_bits;
+		size_t word_idx = bit_off / 64;
+		int shift = bit_off % 64;
+		lows[word_idx] |= low << shift;
+		if (shift + num_low_bits > 64)
+			lows[word_idx + 1] |= low >> (64 - shift);
+	}
+	size_t high_pos = (val >> num_low_bits) + num_vals;
+	highs[high_pos / 64] |= 1UL << (high_pos % 64);
+	if (num_vals % SELECT_SAMPLE == 0)
+		samples.push_back(high_pos);
+	num_vals++;
+}
+
+void elias_fano_array::finalize()
+{
+	assert(num_vals == capacity);
+	lows.shrink_to_fit();
+	highs.shrink_to_fit();
+	samples.shrink_to_fit();
+}
+
+size_t elias_fano_array::select(size_t idx) const
+{
+	size_t pos = samples[idx / SELECT_SAMPLE];
+	size_t rank = idx % SELECT_SAMPLE;
+	if (rank == 0)
+		return pos;
+
+	// The sample is the set bit at `pos', so we skip it.
+	size_t word_idx = pos / 64;
+	uint64_t word = highs[word_idx] & (~1UL << (pos % 64));
+	while (true) {
+		size_t num_ones = __builtin_popcountl(word);
+		if (rank <= num_ones)
+			break;
+		rank -= num_ones;
+		word = highs[++word_idx];
+	}
+	// Remove the set bits before the one we are looking for.
+	for (size_t i = 1; i < rank; i++)
+		word &= word - 1;
+	return word_idx * 64 + __builtin_ctzl(word);
+}
+
+}
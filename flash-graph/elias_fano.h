@@ -0,0 +1,166 @@
+#ifndef __ELIAS_FANO_H__
+#define __ELIAS_FANO_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <vector>
+
+namespace fg
+{
+
+/*
+ * This stores a non-decreasing sequence of integers with Elias-Fano coding.
+ * Each value is split into the low bits and the high bits. The low bits
+ * are stored in a packed array. The high bits are stored in a bitmap in
+ * unary: the i-th value sets the bit at (high bits + i). A sequence of
+ * n values in [0, U] takes about n * (2 + log2(U / n)) bits.
+ *
+ * We keep the location of every SELECT_SAMPLE-th set bit in the bitmap,
+ * so we can access any value in constant time.
+ */
+class elias_fano_array
+{
+	static const size_t SELECT_SAMPLE = 256;
+
+	size_t num_vals;
+	size_t capacity;
+	uint64_t max_val;
+	int num_low_bits;
+	uint64_t low_mask;
+	std::vector<uint64_t> lows;
+	std::vector<uint64_t> highs;
+	// The locations of every SELECT_SAMPLE-th set bit in `highs'.
+	std::vector<uint64_t> samples;
+	uint64_t last_val;
+
+	uint64_t get_low(size_t idx) const {
+		if (num_low_bits == 0)
+			return 0;
+		size_t bit_off = idx * num_low_bits;
+		size_t word_idx = bit_off / 64;
+		int shift = bit_off % 64;
+		uint64_t val = lows[word_idx] >> shift;
+		if (shift + num_low_bits > 64)
+			val |= lows[word_idx + 1] << (64 - shift);
+		return val & low_mask;
+	}
+
+	/*
+	 * Find the location of the next set bit in `highs' from `pos'.
+	 */
+	size_t next_set_bit(size_t pos) const {
+		size_t word_idx = pos / 64;
+		uint64_t word = highs[word_idx] & (~0UL << (pos % 64));
+		while (word == 0)
+			word = highs[++word_idx];
+		return word_idx * 64 + __builtin_ctzl(word);
+	}
+
+	/*
+	 * Find the location of the idx-th set bit in `highs'.
+	 */
+	size_t select(size_t idx) const;
+public:
+	/*
+	 * An iterator that decodes the values in the array sequentially.
+	 * It's cheaper than accessing values one by one.
+	 */
+	class const_iterator
+	{
+		const elias_fano_array *arr;
+		size_t idx;
+		size_t high_pos;
+	public:
+		const_iterator(const elias_fano_array &arr, size_t idx) {
+			this->arr = &arr;
+			this->idx = idx;
+			this->high_pos = idx < arr.size() ? arr.select(idx) : 0;
+		}
+
+		bool has_next() const {
+			return idx < arr->size();
+		}
+
+		uint64_t next() {
+			assert(has_next());
+			high_pos = arr->next_set_bit(high_pos);
+			uint64_t val = ((high_pos - idx) << arr->num_low_bits)
+				| arr->get_low(idx);
+			high_pos++;
+			idx++;
+			return val;
+		}
+	};
+
+	elias_fano_array() {
+		num_vals = 0;
+		capacity = 0;
+		max_val = 0;
+		num_low_bits = 0;
+		low_mask = 0;
+		last_val = 0;
+	}
+
+	/*
+	 * Prepare to store `num' values that are no larger than `max_val'.
+	 * The values are added with `append' in order.
+	 */
+	void init(size_t num, uint64_t max_val);
+	void append(uint64_t val);
+	/*
+	 * This has to be called after all values are appended.
+	 */
+	void finalize();
+
+	size_t size() const {
+		return num_vals;
+	}
+
+	uint64_t get(size_t idx) const {
+		assert(idx < num_vals);
+		return ((select(idx) - idx) << num_low_bits) | get_low(idx);
+	}
+
+	/*
+	 * Decode `num' values starting from `start'.
+	 */
+	void get_range(size_t start, size_t num, uint64_t vals[]) const {
+		const_iterator it(*this, start);
+		for (size_t i = 0; i < num; i++)
+			vals[i] = it.next();
+	}
+
+	const_iterator get_iterator(size_t idx) const {
+		return const_iterator(*this, idx);
+	}
+
+	size_t get_mem_size() const {
+		return (lows.capacity() + highs.capacity() + samples.capacity())
+			* sizeof(uint64_t);
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <map>
+#include <algorithm>
+
+#include <boost/format.hpp>
+
+#include "log.h"
+
+#include "engine_profiler.h"
+
+namespace fg
+{
+
+namespace
+{
+
+const char *phase_names[] = {
+	"compute",
+	"steal",
+	"msg",
+	"io_wait",
+	"idle",
+};
+
+}
+
+level_profile::level_profile(int run, int level, long start)
+{
+	this->run = run;
+	this->level = level;
+	this->start = start;
+	this->end = start;
+	num_active = 0;
+	num_msgs = 0;
+	num_bytes = 0;
+	num_accesses = 0;
+	num_hits = 0;
+	memset(phase_time, 0, sizeof(phase_time));
+}
+
+void level_profile::add(const level_profile &prof)
+{
+	start = std::min(start, prof.start);
+	end = std::max(end, prof.end);
+	num_active += prof.num_active;
+	num_msgs += prof.num_msgs;
+	num_bytes += prof.num_bytes;
+	num_accesses += prof.num_accesses;
+	num_hits += prof.num_hits;
+	for (int i = 0; i < NUM_PROF_PHASES; i++)
+		phase_time[i] += prof.phase_time[i];
+}
+
+/*
+ * Each phase is a complete event. Each level is also a complete event
+ * that contains the phases in the level, and its arguments carry
+ * the statistics of the thread in the level.
+ */
+void thread_profiler::write_events(FILE *f, int tid, bool &first) const
+{
+	for (size_t i = 0; i < levels.size(); i++) {
+		const level_profile &prof = levels[i];
+		fprintf(f, "%s\n{\"name\":\"level %d\",\"cat\":\"level\",\"ph\":\"X\","
+				"\"ts\":%ld,\"dur\":%ld,\"pid\":0,\"tid\":%d,\"args\":{"
+				"\"run\":%d,\"active_vertices\":%lu,\"messages\":%lu,"
+				"\"bytes_read\":%lu,\"page_accesses\":%lu,\"cache_hits\":%lu",
+				first ? "" : ",", prof.level, prof.start, prof.end - prof.start,
+				tid, prof.run, prof.num_active, prof.num_msgs, prof.num_bytes,
+				prof.num_accesses, prof.num_hits);
+		for (int j = 0; j < NUM_PROF_PHASES; j++)
+			fprintf(f, ",\"%s_us\":%ld", phase_names[j], prof.phase_time[j]);
+		fprintf(f, "}}");
+		first = false;
+	}
+	for (size_t i = 0; i < events.size(); i++) {
+		const prof_event &e = events[i];
+		fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\","
+				"\"ts\":%ld,\"dur\":%ld,\"pid\":0,\"tid\":%d,\"args\":{\"level\":%d}}",
+				phase_names[e.phase], e.start, e.dur, tid, e.level);
+	}
+}
+
+engine_profiler::engine_profiler(const std::string &file, int num_threads)
+{
+	this->file = file;
+	this->run = -1;
+	gettimeofday(&base, NULL);
+	threads.resize(num_threads);
+	for (int i = 0; i < num_threads; i++)
+		threads[i] = std::unique_ptr<thread_profiler>(new thread_profiler(base));
+}
+
+void engine_profiler::start_run()
+{
+	run++;
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i]->start_run(run);
+}
+
+void engine_profiler::print_summary() const
+{
+	// In the asynchronous mode, threads may run different numbers of levels.
+	std::map<int, level_profile> levels;
+	for (size_t i = 0; i < threads.size(); i++) {
+		const std::vector<level_profile> &thread_levels = threads[i]->get_levels();
+		for (size_t j = 0; j < thread_levels.size(); j++) {
+			const level_profile &prof = thread_levels[j];
+			if (prof.run != run)
+				continue;
+			std::map<int, level_profile>::iterator it = levels.find(prof.level);
+			if (it == levels.end())
+				levels.insert(std::pair<int, level_profile>(prof.level, prof));
+			else
+				it->second.add(prof);
+		}
+	}
+
+	// The time of the phases is summed over all threads.
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"%|5| %|12| %|12| %|10| %|6| %|10| %|10| %|10| %|10| %|10|")
+		% "level" % "active" % "messages" % "read(MB)" % "hit%" % "comp(ms)"
+		% "steal(ms)" % "msg(ms)" % "io(ms)" % "idle(ms)";
+	for (std::map<int, level_profile>::const_iterator it = levels.begin();
+			it != levels.end(); it++) {
+		const level_profile &prof = it->second;
+		double hit_ratio = prof.num_accesses == 0 ? 0
+			: ((double) prof.num_hits) / prof.num_accesses * 100;
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"%|5| %|12| %|12| %|10.1f| %|6.1f| %|10.1f| %|10.1f| %|10.1f| %|10.1f| %|10.1f|")
+			% prof.level % prof.num_active % prof.num_msgs
+			% (((double) prof.num_bytes) / 1024 / 1024) % hit_ratio
+			% (prof.phase_time[PROF_COMPUTE] / 1000.0)
+			% (prof.phase_time[PROF_STEAL] / 1000.0)
+			% (prof.phase_time[PROF_MSG] / 1000.0)
+			% (prof.phase_time[PROF_IO_WAIT] / 1000.0)
+			% (prof.phase_time[PROF_IDLE] / 1000.0);
+	}
+}
+
+void engine_profiler::write_trace() const
+{
+	FILE *f = fopen(file.c_str(), "w");
+	if (f == NULL) {
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't open %1%: %2%")
+			% file % strerror(errno);
+		return;
+	}
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	bool first = true;
+	size_t num_dropped = 0;
+	for (size_t i = 0; i < threads.size(); i++) {
+		fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+				"\"tid\":%lu,\"args\":{\"name\":\"worker %lu\"}}",
+				first ? "" : ",", i, i);
+		first = false;
+		threads[i]->write_events(f, i, first);
+		num_dropped += threads[i]->get_num_dropped();
+	}
+	fprintf(f, "\n]}\n");
+	fclose(f);
+	if (num_dropped > 0)
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"%1% events don't fit in the timeline in %2%")
+			% num_dropped % file;
+	BOOST_LOG_TRIVIAL(info) << boost::format("write the timeline to %1%") % file;
+}
+
+}
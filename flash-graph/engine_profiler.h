@@ -0,0 +1,246 @@
+#ifndef __ENGINE_PROFILER_H__
+#define __ENGINE_PROFILER_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace fg
+{
+
+/*
+ * The phases that a worker thread goes through in a level.
+ */
+enum prof_phase
+{
+	// Run the vertices activated in the level.
+	PROF_COMPUTE,
+	// Steal activated vertices from other threads.
+	PROF_STEAL,
+	// Process the messages sent by other threads.
+	PROF_MSG,
+	// Wait for I/O. It includes running vertices on their adjacency lists
+	// when the I/O requests complete.
+	PROF_IO_WAIT,
+	// Wait for other threads at the end of a level.
+	PROF_IDLE,
+	NUM_PROF_PHASES,
+};
+
+/*
+ * The statistics of a worker thread in a level.
+ */
+struct level_profile
+{
+	// Graph engines such as k-core start many times. This identifies
+	// the run that the level belongs to.
+	int run;
+	int level;
+	// In microseconds since the profiler is created.
+	long start;
+	long end;
+	size_t num_active;
+	size_t num_msgs;
+	size_t num_bytes;
+	// The pages accessed in the page cache and the cache hits.
+	size_t num_accesses;
+	size_t num_hits;
+	// In microseconds.
+	long phase_time[NUM_PROF_PHASES];
+
+	level_profile(int run, int level, long start);
+
+	void add(const level_profile &prof);
+};
+
+/*
+ * This profiles a worker thread. It's only accessed by the worker thread
+ * while the graph engine is running, so it doesn't need locking.
+ * The time of all phases is accumulated in the level profiles. Only
+ * the phases longer than MIN_EVENT_TIME are kept in the timeline, so
+ * profiling the tight loop of a worker thread stays cheap.
+ */
+class thread_profiler
+{
+	static const long MIN_EVENT_TIME = 10;
+	static const size_t MAX_EVENTS = 256 * 1024;
+
+	struct prof_event
+	{
+		prof_phase phase;
+		int level;
+		long start;
+		long dur;
+	};
+
+	const struct timeval &base;
+	int run;
+	std::vector<prof_event> events;
+	// The number of events that don't fit in the timeline.
+	size_t num_dropped;
+	std::vector<level_profile> levels;
+	// The cache statistics of the I/O instance when the level starts.
+	size_t start_accesses;
+	size_t start_hits;
+public:
+	thread_profiler(const struct timeval &_base): base(_base) {
+		run = -1;
+		num_dropped = 0;
+		start_accesses = 0;
+		start_hits = 0;
+	}
+
+	/*
+	 * The current time in microseconds since the profiler is created.
+	 */
+	long get_time() const {
+		struct timeval curr;
+		gettimeofday(&curr, NULL);
+		return (curr.tv_sec - base.tv_sec) * 1000000L
+			+ curr.tv_usec - base.tv_usec;
+	}
+
+	void start_run(int run) {
+		this->run = run;
+	}
+
+	void start_level(int level, size_t num_accesses, size_t num_hits) {
+		levels.emplace_back(run, level, get_time());
+		start_accesses = num_accesses;
+		start_hits = num_hits;
+	}
+
+	void end_level(size_t num_accesses, size_t num_hits) {
+		level_profile &prof = levels.back();
+		prof.end = get_time();
+		prof.num_accesses = num_accesses - start_accesses;
+		prof.num_hits = num_hits - start_hits;
+	}
+
+	void add_phase(prof_phase phase, long start, long end) {
+		level_profile &prof = levels.back();
+		prof.phase_time[phase] += end - start;
+		if (end - start < MIN_EVENT_TIME)
+			return;
+		if (events.size() >= MAX_EVENTS) {
+			num_dropped++;
+			return;
+		}
+		prof_event e;
+		e.phase = phase;
+		e.level = prof.level;
+		e.start = start;
+		e.dur = end - start;
+		events.push_back(e);
+	}
+
+	void add_active(size_t num) {
+		levels.back().num_active += num;
+	}
+
+	void add_msgs(size_t num) {
+		levels.back().num_msgs += num;
+	}
+
+	void add_bytes(size_t num) {
+		levels.back().num_bytes += num;
+	}
+
+	const std::vector<level_profile> &get_levels() const {
+		return levels;
+	}
+
+	size_t get_num_dropped() const {
+		return num_dropped;
+	}
+
+	void write_events(FILE *f, int tid, bool &first) const;
+};
+
+/*
+ * This times a phase of a worker thread in its scope.
+ * It does nothing if the profiler is NULL.
+ */
+class prof_timer
+{
+	thread_profiler *prof;
+	prof_phase phase;
+	long start;
+public:
+	prof_timer(thread_profiler *prof, prof_phase phase) {
+		this->prof = prof;
+		this->phase = phase;
+		if (prof)
+			start = prof->get_time();
+	}
+
+	~prof_timer() {
+		if (prof)
+			prof->add_phase(phase, start, prof->get_time());
+	}
+};
+
+/*
+ * The profiler of the graph engine. It keeps a profiler for each worker
+ * thread, prints a summary of every level when the graph engine
+ * completes and writes the timeline of the worker threads in the Chrome
+ * trace format, which can be viewed in chrome://tracing or Perfetto.
+ */
+class engine_profiler
+{
+	std::string file;
+	struct timeval base;
+	int run;
+	std::vector<std::unique_ptr<thread_profiler> > threads;
+
+	engine_profiler(const std::string &file, int num_threads);
+public:
+	typedef std::shared_ptr<engine_profiler> ptr;
+
+	static ptr create(const std::string &file, int num_threads) {
+		return ptr(new engine_profiler(file, num_threads));
+	}
+
+	thread_profiler &get_thread(int worker_id) {
+		return *threads[worker_id];
+	}
+
+	/*
+	 * This is invoked every time the graph engine starts.
+	 */
+	void start_run();
+	/*
+	 * Print the statistics of the levels in the current run.
+	 */
+	void print_summary() const;
+	/*
+	 * Write the timeline of all runs to the profile file.
+	 */
+	void write_trace() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,583 @@
+#ifndef __VERTEX_FRONTIER_H__
+#define __VERTEX_FRONTIER_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <assert.h>
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+
+#include "FG_basic_types.h"
+
+namespace fg
+{
+
+/*
+ * Iterate over the set bits of a 64-bit word and invoke `func' on the index
+ * of each set bit (plus `base'). It uses count-trailing-zeros, so the cost
+ * is proportional to the number of set bits instead of the word size.
+ */
+template<class Func>
+static inline void foreach_set_bit(uint64_t word, size_t base, Func &func)
+{
+	while (word) {
+		func(base + __builtin_ctzl(word));
+		word &= word - 1;
+	}
+}
+
+static inline size_t popcount_words(const uint64_t *words, size_t num)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < num; i++)
+		count += __builtin_popcountl(words[i]);
+	return count;
+}
+
+/**
+ * \brief A set of vertices that adapts its representation to the density
+ * of the set.
+ *
+ * - SPARSE: a sorted array of vertex IDs. It's used for very sparse sets.
+ * - COMPRESSED: the vertex ID space is split into chunks of 64K vertices
+ *   and only non-empty chunks are stored (Roaring-style). A chunk is a sorted
+ *   array of 16-bit offsets if it has few vertices; otherwise, it's a bitmap.
+ * - DENSE: a bitmap over the entire vertex ID space.
+ *
+ * Iteration on bitmaps costs the number of set bits instead of the number
+ * of bits, and union/intersection on bitmaps work on whole words.
+ * After a set operation, the frontier picks the representation based on
+ * the number of vertices in it.
+ *
+ * It's a tool for vertex programs to build and combine sets of vertices.
+ * The engine doesn't use it to track the active vertices of an iteration
+ * (see active_vertex_set), so it doesn't change how the engine schedules
+ * sparse or dense levels.
+ */
+class vertex_frontier
+{
+public:
+	enum rep_type
+	{
+		SPARSE,
+		COMPRESSED,
+		DENSE,
+	};
+private:
+	static const int CHUNK_SIZE_LOG = 16;
+	static const size_t CHUNK_SIZE = 1UL << CHUNK_SIZE_LOG;
+	static const size_t CHUNK_NUM_WORDS = CHUNK_SIZE / 64;
+	// A chunk with more vertices than this is stored as a bitmap.
+	static const size_t MAX_ARRAY_CHUNK_SIZE = 4096;
+	// The frontier is sparse if it has fewer than 1/SPARSE_RATIO of vertices
+	// and is dense if it has more than 1/DENSE_RATIO of vertices.
+	static const size_t SPARSE_RATIO = 64;
+	static const size_t DENSE_RATIO = 16;
+
+	/*
+	 * A chunk in the compressed representation.
+	 */
+	struct chunk
+	{
+		uint32_t key;
+		std::vector<uint16_t> arr;
+		std::vector<uint64_t> words;
+
+		chunk(uint32_t key) {
+			this->key = key;
+		}
+
+		bool is_bitmap() const {
+			return !words.empty();
+		}
+
+		size_t get_num_vertices() const {
+			return is_bitmap() ? popcount_words(words.data(), words.size())
+				: arr.size();
+		}
+
+		bool contains(uint16_t off) const {
+			if (is_bitmap())
+				return words[off / 64] & (1UL << (off % 64));
+			else
+				return std::binary_search(arr.begin(), arr.end(), off);
+		}
+
+		void to_bitmap() {
+			words.resize(CHUNK_NUM_WORDS);
+			for (size_t i = 0; i < arr.size(); i++)
+				words[arr[i] / 64] |= 1UL << (arr[i] % 64);
+			std::vector<uint16_t>().swap(arr);
+		}
+
+		/*
+		 * It returns true if the vertex didn't exist in the chunk.
+		 */
+		bool add(uint16_t off) {
+			if (is_bitmap()) {
+				uint64_t mask = 1UL << (off % 64);
+				bool ret = !(words[off / 64] & mask);
+				words[off / 64] |= mask;
+				return ret;
+			}
+			std::vector<uint16_t>::iterator it = std::lower_bound(arr.begin(),
+					arr.end(), off);
+			if (it != arr.end() && *it == off)
+				return false;
+			arr.insert(it, off);
+			if (arr.size() > MAX_ARRAY_CHUNK_SIZE)
+				to_bitmap();
+			return true;
+		}
+
+		template<class Func>
+		void for_each(Func &func) const {
+			size_t base = ((size_t) key) << CHUNK_SIZE_LOG;
+			if (is_bitmap()) {
+				for (size_t i = 0; i < words.size(); i++)
+					foreach_set_bit(words[i], base + i * 64, func);
+			}
+			else {
+				for (size_t i = 0; i < arr.size(); i++)
+					func(base + arr[i]);
+			}
+		}
+	};
+
+	class id_collector
+	{
+		std::vector<vertex_id_t> &ids;
+	public:
+		id_collector(std::vector<vertex_id_t> &_ids): ids(_ids) {
+		}
+
+		void operator()(vertex_id_t id) {
+			ids.push_back(id);
+		}
+	};
+
+	rep_type type;
+	size_t num_vertices;
+	size_t num_active;
+	// SPARSE representation. It may be unsorted until it's finalized.
+	std::vector<vertex_id_t> sparse;
+	bool sorted;
+	// COMPRESSED representation. Chunks are sorted on their keys.
+	std::vector<chunk> chunks;
+	// DENSE representation.
+	std::vector<uint64_t> dense;
+
+	size_t get_num_words() const {
+		return (num_vertices + 63) / 64;
+	}
+
+	void finalize() {
+		if (type == SPARSE && !sorted) {
+			std::sort(sparse.begin(), sparse.end());
+			sparse.erase(std::unique(sparse.begin(), sparse.end()),
+					sparse.end());
+			num_active = sparse.size();
+			sorted = true;
+		}
+	}
+
+	chunk *find_chunk(uint32_t key) {
+		std::vector<chunk>::iterator it = std::lower_bound(chunks.begin(),
+				chunks.end(), key, chunk_key_less());
+		if (it != chunks.end() && it->key == key)
+			return &(*it);
+		else
+			return NULL;
+	}
+
+	const chunk *find_chunk(uint32_t key) const {
+		std::vector<chunk>::const_iterator it = std::lower_bound(
+				chunks.begin(), chunks.end(), key, chunk_key_less());
+		if (it != chunks.end() && it->key == key)
+			return &(*it);
+		else
+			return NULL;
+	}
+
+	struct chunk_key_less
+	{
+		bool operator()(const chunk &c, uint32_t key) const {
+			return c.key < key;
+		}
+	};
+
+	void clear_reps() {
+		std::vector<vertex_id_t>().swap(sparse);
+		std::vector<chunk>().swap(chunks);
+		std::vector<uint64_t>().swap(dense);
+		sorted = true;
+	}
+
+	void build_sparse(std::vector<vertex_id_t> &ids) {
+		clear_reps();
+		type = SPARSE;
+		sparse.swap(ids);
+		num_active = sparse.size();
+	}
+
+	void build_dense(const std::vector<vertex_id_t> &ids) {
+		clear_reps();
+		type = DENSE;
+		dense.resize(get_num_words());
+		for (size_t i = 0; i < ids.size(); i++)
+			dense[ids[i] / 64] |= 1UL << (ids[i] % 64);
+		num_active = ids.size();
+	}
+
+	/*
+	 * The vertex IDs have to be sorted.
+	 */
+	void build_compressed(const std::vector<vertex_id_t> &ids) {
+		clear_reps();
+		type = COMPRESSED;
+		for (size_t i = 0; i < ids.size(); ) {
+			uint32_t key = ids[i] >> CHUNK_SIZE_LOG;
+			size_t j = i;
+			while (j < ids.size() && (ids[j] >> CHUNK_SIZE_LOG) == key)
+				j++;
+			chunks.push_back(chunk(key));
+			chunk &c = chunks.back();
+			if (j - i > MAX_ARRAY_CHUNK_SIZE) {
+				c.words.resize(CHUNK_NUM_WORDS);
+				for (size_t k = i; k < j; k++)
+					c.words[(ids[k] & (CHUNK_SIZE - 1)) / 64]
+						|= 1UL << (ids[k] % 64);
+			}
+			else {
+				c.arr.resize(j - i);
+				for (size_t k = i; k < j; k++)
+					c.arr[k - i] = ids[k] & (CHUNK_SIZE - 1);
+			}
+			i = j;
+		}
+		num_active = ids.size();
+	}
+
+	void build(std::vector<vertex_id_t> &ids, rep_type type) {
+		switch (type) {
+			case SPARSE:
+				build_sparse(ids);
+				break;
+			case COMPRESSED:
+				build_compressed(ids);
+				break;
+			case DENSE:
+				build_dense(ids);
+				break;
+		}
+	}
+
+	rep_type choose_rep(size_t num) const {
+		if (num * SPARSE_RATIO < num_vertices)
+			return SPARSE;
+		else if (num * DENSE_RATIO < num_vertices)
+			return COMPRESSED;
+		else
+			return DENSE;
+	}
+public:
+	/**
+	 * \brief Create an empty frontier.
+	 * \param num_vertices The size of the vertex ID space.
+	 */
+	vertex_frontier(size_t num_vertices) {
+		this->num_vertices = num_vertices;
+		this->num_active = 0;
+		this->type = SPARSE;
+		this->sorted = true;
+	}
+
+	rep_type get_rep_type() const {
+		return type;
+	}
+
+	size_t get_num_vertices() const {
+		return num_vertices;
+	}
+
+	/**
+	 * \brief Get the number of vertices in the frontier.
+	 */
+	size_t size() {
+		finalize();
+		return num_active;
+	}
+
+	bool empty() {
+		return size() == 0;
+	}
+
+	void clear() {
+		clear_reps();
+		type = SPARSE;
+		num_active = 0;
+	}
+
+	/**
+	 * \brief Add a vertex to the frontier.
+	 */
+	void add(vertex_id_t id) {
+		assert(id < num_vertices);
+		switch (type) {
+			case SPARSE:
+				if (!sparse.empty() && sparse.back() >= id)
+					sorted = false;
+				sparse.push_back(id);
+				num_active++;
+				if (num_active * SPARSE_RATIO >= num_vertices)
+					optimize();
+				break;
+			case COMPRESSED:
+				{
+					uint32_t key = id >> CHUNK_SIZE_LOG;
+					chunk *c = find_chunk(key);
+					if (c == NULL) {
+						std::vector<chunk>::iterator it = std::lower_bound(
+								chunks.begin(), chunks.end(), key,
+								chunk_key_less());
+						c = &(*chunks.insert(it, chunk(key)));
+					}
+					if (c->add(id & (CHUNK_SIZE - 1)))
+						num_active++;
+				}
+				break;
+			case DENSE:
+				{
+					uint64_t mask = 1UL << (id % 64);
+					if (!(dense[id / 64] & mask)) {
+						dense[id / 64] |= mask;
+						num_active++;
+					}
+				}
+				break;
+		}
+	}
+
+	void add(const vertex_id_t ids[], size_t num) {
+		for (size_t i = 0; i < num; i++)
+			add(ids[i]);
+	}
+
+	bool contains(vertex_id_t id) const {
+		if (id >= num_vertices)
+			return false;
+		switch (type) {
+			case SPARSE:
+				if (sorted)
+					return std::binary_search(sparse.begin(), sparse.end(), id);
+				else
+					return std::find(sparse.begin(), sparse.end(), id)
+						!= sparse.end();
+			case COMPRESSED:
+				{
+					const chunk *c = find_chunk(id >> CHUNK_SIZE_LOG);
+					return c && c->contains(id & (CHUNK_SIZE - 1));
+				}
+			case DENSE:
+				return dense[id / 64] & (1UL << (id % 64));
+			default:
+				assert(0);
+				return false;
+		}
+	}
+
+	/**
+	 * \brief Invoke `func' on every vertex in the frontier in the order of
+	 * vertex IDs.
+	 */
+	template<class Func>
+	void for_each(Func &func) {
+		finalize();
+		switch (type) {
+			case SPARSE:
+				for (size_t i = 0; i < sparse.size(); i++)
+					func(sparse[i]);
+				break;
+			case COMPRESSED:
+				for (size_t i = 0; i < chunks.size(); i++)
+					chunks[i].for_each(func);
+				break;
+			case DENSE:
+				for (size_t i = 0; i < dense.size(); i++)
+					foreach_set_bit(dense[i], i * 64, func);
+				break;
+		}
+	}
+
+	/**
+	 * \brief Get all vertices in the frontier in the order of vertex IDs.
+	 */
+	size_t get_vertices(std::vector<vertex_id_t> &ids) {
+		size_t orig_size = ids.size();
+		ids.reserve(orig_size + size());
+		id_collector collector(ids);
+		for_each(collector);
+		return ids.size() - orig_size;
+	}
+
+	/**
+	 * \brief Convert the frontier to the representation that fits
+	 * its density the best.
+	 */
+	void optimize() {
+		finalize();
+		rep_type new_type = choose_rep(num_active);
+		if (new_type == type)
+			return;
+		std::vector<vertex_id_t> ids;
+		get_vertices(ids);
+		build(ids, new_type);
+	}
+
+	/**
+	 * \brief Add all vertices in another frontier to this frontier.
+	 */
+	void union_with(vertex_frontier &other) {
+		assert(num_vertices == other.num_vertices);
+		finalize();
+		other.finalize();
+		if (type == DENSE && other.type == DENSE) {
+			// The loop works on whole words and can be vectorized.
+			uint64_t *dst = dense.data();
+			const uint64_t *src = other.dense.data();
+			size_t num_words = dense.size();
+			for (size_t i = 0; i < num_words; i++)
+				dst[i] |= src[i];
+			num_active = popcount_words(dst, num_words);
+		}
+		else if (type == DENSE) {
+			id_collector_dense adder(*this);
+			other.for_each(adder);
+		}
+		else {
+			std::vector<vertex_id_t> ids1, ids2, res;
+			get_vertices(ids1);
+			other.get_vertices(ids2);
+			res.reserve(ids1.size() + ids2.size());
+			std::set_union(ids1.begin(), ids1.end(), ids2.begin(), ids2.end(),
+					std::back_inserter(res));
+			build(res, choose_rep(res.size()));
+			return;
+		}
+		optimize();
+	}
+
+	/**
+	 * \brief Keep the vertices that also exist in another frontier.
+	 */
+	void intersect_with(vertex_frontier &other) {
+		assert(num_vertices == other.num_vertices);
+		finalize();
+		other.finalize();
+		if (type == DENSE && other.type == DENSE) {
+			uint64_t *dst = dense.data();
+			const uint64_t *src = other.dense.data();
+			size_t num_words = dense.size();
+			for (size_t i = 0; i < num_words; i++)
+				dst[i] &= src[i];
+			num_active = popcount_words(dst, num_words);
+		}
+		else if (type == COMPRESSED && other.type == COMPRESSED) {
+			std::vector<chunk> res;
+			for (size_t i = 0, j = 0; i < chunks.size()
+					&& j < other.chunks.size(); ) {
+				if (chunks[i].key < other.chunks[j].key)
+					i++;
+				else if (chunks[i].key > other.chunks[j].key)
+					j++;
+				else {
+					chunk c = intersect(chunks[i], other.chunks[j]);
+					if (c.is_bitmap() || !c.arr.empty())
+						res.push_back(c);
+					i++;
+					j++;
+				}
+			}
+			chunks.swap(res);
+			num_active = 0;
+			for (size_t i = 0; i < chunks.size(); i++)
+				num_active += chunks[i].get_num_vertices();
+		}
+		else {
+			// Probe the smaller frontier in the larger one.
+			vertex_frontier &small = num_active <= other.num_active
+				? *this : other;
+			vertex_frontier &large = num_active <= other.num_active
+				? other : *this;
+			std::vector<vertex_id_t> ids, res;
+			small.get_vertices(ids);
+			for (size_t i = 0; i < ids.size(); i++)
+				if (large.contains(ids[i]))
+					res.push_back(ids[i]);
+			build(res, choose_rep(res.size()));
+			return;
+		}
+		optimize();
+	}
+private:
+	class id_collector_dense
+	{
+		vertex_frontier &frontier;
+	public:
+		id_collector_dense(vertex_frontier &_frontier): frontier(_frontier) {
+		}
+
+		void operator()(vertex_id_t id) {
+			frontier.add(id);
+		}
+	};
+
+	static chunk intersect(const chunk &c1, const chunk &c2) {
+		chunk res(c1.key);
+		if (c1.is_bitmap() && c2.is_bitmap()) {
+			res.words.resize(CHUNK_NUM_WORDS);
+			for (size_t i = 0; i < CHUNK_NUM_WORDS; i++)
+				res.words[i] = c1.words[i] & c2.words[i];
+			// An empty bitmap is converted to an empty array.
+			if (popcount_words(res.words.data(), CHUNK_NUM_WORDS) == 0)
+				res.words.clear();
+		}
+		else if (!c1.is_bitmap() && !c2.is_bitmap())
+			std::set_intersection(c1.arr.begin(), c1.arr.end(),
+					c2.arr.begin(), c2.arr.end(),
+					std::back_inserter(res.arr));
+		else {
+			const chunk &arr_c = c1.is_bitmap() ? c2 : c1;
+			const chunk &bitmap_c = c1.is_bitmap() ? c1 : c2;
+			for (size_t i = 0; i < arr_c.arr.size(); i++)
+				if (bitmap_c.contains(arr_c.arr[i]))
+					res.arr.push_back(arr_c.arr[i]);
+		}
+		return res;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,1108 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <algorithm>
+#include <type_traits>
+
+#include <boost/format.hpp>
+
+#include "log.h"
+#include "common.h"
+
+#include "vertex.h"
+#include "vertex_index.h"
+#include "graph_file_header.h"
+#include "graph_builder.h"
+
+namespace fg
+{
+
+namespace utils
+{
+
+namespace
+{
+
+// The size of a chunk of an input file parsed by a thread.
+const size_t INPUT_CHUNK_SIZE = 64 * 1024 * 1024;
+// The buffer size for reading a run in a merge.
+const size_t RUN_READ_BUF_SIZE = 1024 * 1024;
+const size_t RUN_WRITE_BUF_SIZE = 4 * 1024 * 1024;
+// We keep the key of every SAMPLE_INTERVAL-th edge in a run, so we can
+// split runs into vertex ranges and search in runs quickly.
+const size_t SAMPLE_INTERVAL = 4096;
+
+struct no_attr
+{
+};
+
+/*
+ * An edge in a run. The key has the vertex in the upper 32 bits and
+ * its neighbor in the lower 32 bits, so sorting the keys sorts edges by
+ * vertices and then by neighbors.
+ */
+template<class AttrType>
+struct edge_rec
+{
+	uint64_t key;
+	AttrType attr;
+};
+
+template<>
+struct edge_rec<no_attr>
+{
+	uint64_t key;
+};
+
+template<class AttrType>
+static inline void set_attr(edge_rec<AttrType> &rec, const AttrType &attr)
+{
+	rec.attr = attr;
+}
+
+static inline void set_attr(edge_rec<no_attr> &rec, const no_attr &attr)
+{
+}
+
+template<class AttrType>
+static inline AttrType get_attr(const edge_rec<AttrType> &rec)
+{
+	return rec.attr;
+}
+
+static inline no_attr get_attr(const edge_rec<no_attr> &rec)
+{
+	return no_attr();
+}
+
+static inline uint64_t make_key(vertex_id_t v, vertex_id_t neigh)
+{
+	return (((uint64_t) v) << 32) | neigh;
+}
+
+static inline vertex_id_t get_key_vertex(uint64_t key)
+{
+	return key >> 32;
+}
+
+static inline vertex_id_t get_key_neighbor(uint64_t key)
+{
+	return (vertex_id_t) key;
+}
+
+/*
+ * LSD radix sort on 16-bit digits. It skips the digits that are the same
+ * in all edges, which is common for the upper bits of vertex IDs.
+ */
+template<class Rec>
+void radix_sort(Rec *recs, Rec *tmp, size_t num)
+{
+	if (num <= 1)
+		return;
+	uint64_t or_keys = 0;
+	uint64_t and_keys = ~0UL;
+	for (size_t i = 0; i < num; i++) {
+		or_keys |= recs[i].key;
+		and_keys &= recs[i].key;
+	}
+
+	std::vector<size_t> counts(1 << 16);
+	Rec *src = recs;
+	Rec *dst = tmp;
+	for (int shift = 0; shift < 64; shift += 16) {
+		if ((((or_keys ^ and_keys) >> shift) & 0xffff) == 0)
+			continue;
+		std::fill(counts.begin(), counts.end(), 0);
+		for (size_t i = 0; i < num; i++)
+			counts[(src[i].key >> shift) & 0xffff]++;
+		size_t sum = 0;
+		for (size_t i = 0; i < counts.size(); i++) {
+			size_t c = counts[i];
+			counts[i] = sum;
+			sum += c;
+		}
+		for (size_t i = 0; i < num; i++)
+			dst[counts[(src[i].key >> shift) & 0xffff]++] = src[i];
+		std::swap(src, dst);
+	}
+	if (src != recs)
+		memcpy(recs, src, sizeof(Rec) * num);
+}
+
+/*
+ * A sorted run of edges on disks.
+ */
+struct run_info
+{
+	std::string file;
+	size_t num_recs;
+	std::vector<uint64_t> samples;
+
+	run_info() {
+		num_recs = 0;
+	}
+};
+
+template<class Rec>
+class run_writer
+{
+	FILE *f;
+	char *buf;
+	run_info run;
+public:
+	run_writer(const std::string &file) {
+		run.file = file;
+		f = fopen(file.c_str(), "w");
+		if (f == NULL)
+			ABORT_MSG(boost::format("fail to open %1%: %2%")
+					% file % strerror(errno));
+		buf = new char[RUN_WRITE_BUF_SIZE];
+		setvbuf(f, buf, _IOFBF, RUN_WRITE_BUF_SIZE);
+	}
+
+	~run_writer() {
+		assert(f == NULL);
+	}
+
+	void append(const Rec *recs, size_t num) {
+		for (size_t i = (SAMPLE_INTERVAL - run.num_recs % SAMPLE_INTERVAL)
+				% SAMPLE_INTERVAL; i < num; i += SAMPLE_INTERVAL)
+			run.samples.push_back(recs[i].key);
+		if (num > 0 && fwrite(recs, sizeof(Rec) * num, 1, f) != 1)
+			ABORT_MSG(boost::format("fail to write %1%: %2%")
+					% run.file % strerror(errno));
+		run.num_recs += num;
+	}
+
+	run_info close() {
+		fclose(f);
+		f = NULL;
+		delete [] buf;
+		return run;
+	}
+};
+
+/*
+ * This reads edges in [start, end) of a run.
+ */
+template<class Rec>
+class run_reader
+{
+	int fd;
+	size_t curr;
+	size_t end;
+	std::vector<Rec> buf;
+	size_t buf_idx;
+	std::string file;
+
+	void fill_buf() {
+		size_t num = std::min(buf.capacity(), end - curr);
+		buf.resize(num);
+		size_t bytes = num * sizeof(Rec);
+		char *addr = (char *) buf.data();
+		off_t off = curr * sizeof(Rec);
+		while (bytes > 0) {
+			ssize_t ret = pread(fd, addr, bytes, off);
+			if (ret <= 0)
+				ABORT_MSG(boost::format("fail to read %1%: %2%")
+						% file % strerror(errno));
+			bytes -= ret;
+			addr += ret;
+			off += ret;
+		}
+		curr += num;
+		buf_idx = 0;
+	}
+public:
+	run_reader(const run_info &run, size_t start, size_t end,
+			size_t buf_size) {
+		file = run.file;
+		fd = open(file.c_str(), O_RDONLY);
+		if (fd < 0)
+			ABORT_MSG(boost::format("fail to open %1%: %2%")
+					% file % strerror(errno));
+		this->curr = start;
+		this->end = end;
+		buf.reserve(std::max(1UL, buf_size / sizeof(Rec)));
+		buf_idx = 0;
+		if (curr < end)
+			fill_buf();
+	}
+
+	~run_reader() {
+		close(fd);
+	}
+
+	bool has_next() const {
+		return buf_idx < buf.size();
+	}
+
+	const Rec &peek() const {
+		return buf[buf_idx];
+	}
+
+	void next() {
+		buf_idx++;
+		if (buf_idx == buf.size() && curr < end)
+			fill_buf();
+		else if (buf_idx == buf.size())
+			buf.clear();
+	}
+};
+
+/*
+ * Find the location of the first edge whose key isn't smaller than `key'
+ * in a run. The samples narrow down the search to SAMPLE_INTERVAL edges.
+ */
+template<class Rec>
+size_t search_run(const run_info &run, uint64_t key)
+{
+	size_t sample_idx = std::lower_bound(run.samples.begin(),
+			run.samples.end(), key) - run.samples.begin();
+	if (sample_idx == 0)
+		return 0;
+	// The edge is between the two samples.
+	size_t start = (sample_idx - 1) * SAMPLE_INTERVAL;
+	size_t end = std::min(run.num_recs, sample_idx * SAMPLE_INTERVAL);
+	run_reader<Rec> reader(run, start, end, (end - start) * sizeof(Rec));
+	size_t loc = start;
+	while (reader.has_next() && reader.peek().key < key) {
+		reader.next();
+		loc++;
+	}
+	return loc;
+}
+
+template<class Rec>
+struct reader_greater
+{
+	bool operator()(const run_reader<Rec> *r1, const run_reader<Rec> *r2) const {
+		return r1->peek().key > r2->peek().key;
+	}
+};
+
+/*
+ * Merge the sorted edges from the readers. Duplicated edges and self
+ * edges are removed if requested. `func' is invoked on each edge in order.
+ */
+template<class Rec, class Func>
+void merge_runs(std::vector<run_reader<Rec> *> &readers,
+		const ext_mem_graph_builder::options &opts, Func &func)
+{
+	std::priority_queue<run_reader<Rec> *, std::vector<run_reader<Rec> *>,
+		reader_greater<Rec> > queue;
+	for (size_t i = 0; i < readers.size(); i++)
+		if (readers[i]->has_next())
+			queue.push(readers[i]);
+
+	bool has_last = false;
+	uint64_t last_key = 0;
+	while (!queue.empty()) {
+		run_reader<Rec> *reader = queue.top();
+		queue.pop();
+		const Rec &rec = reader->peek();
+		bool skip = (opts.dedup && has_last && rec.key == last_key)
+			|| (opts.remove_self_edges
+					&& get_key_vertex(rec.key) == get_key_neighbor(rec.key));
+		if (!skip) {
+			func(rec);
+			has_last = true;
+			last_key = rec.key;
+		}
+		reader->next();
+		if (reader->has_next())
+			queue.push(reader);
+	}
+}
+
+template<class Rec>
+class run_appender
+{
+	run_writer<Rec> &writer;
+	std::vector<Rec> buf;
+public:
+	run_appender(run_writer<Rec> &_writer): writer(_writer) {
+		buf.reserve(RUN_WRITE_BUF_SIZE / sizeof(Rec));
+	}
+
+	void operator()(const Rec &rec) {
+		buf.push_back(rec);
+		if (buf.size() == buf.capacity())
+			flush();
+	}
+
+	void flush() {
+		writer.append(buf.data(), buf.size());
+		buf.clear();
+	}
+};
+
+/*
+ * This serializes the adjacency lists of vertices in a vertex range
+ * to a file. It also records the number of edges of each vertex.
+ */
+template<class AttrType>
+class adj_list_writer
+{
+	typedef edge_rec<AttrType> rec_t;
+	static const bool has_attr = !std::is_same<AttrType, no_attr>::value;
+
+	FILE *f;
+	std::string file;
+	char *f_buf;
+	vertex_id_t next_id;
+	vertex_id_t end_id;
+	vsize_t *num_edges;
+	size_t tot_edges;
+	size_t num_self_edges;
+	size_t tot_size;
+
+	std::vector<vertex_id_t> neighs;
+	std::vector<AttrType> attrs;
+	std::vector<char> vbuf;
+
+	void write_vertex(vertex_id_t id) {
+		size_t edge_data_size = has_attr ? sizeof(AttrType) : 0;
+		size_t size = ext_mem_undirected_vertex::num_edges2vsize(neighs.size(),
+				edge_data_size);
+		vbuf.assign(size, 0);
+		ext_mem_undirected_vertex *v = new (vbuf.data()) ext_mem_undirected_vertex(
+				id, neighs.size(), edge_data_size);
+		for (size_t i = 0; i < neighs.size(); i++)
+			v->set_neighbor(i, neighs[i]);
+		for (size_t i = 0; has_attr && i < attrs.size(); i++)
+			memcpy(v->get_raw_edge_data(i), &attrs[i], sizeof(AttrType));
+		if (fwrite(vbuf.data(), size, 1, f) != 1)
+			ABORT_MSG(boost::format("fail to write %1%: %2%")
+					% file % strerror(errno));
+		num_edges[id] = neighs.size();
+		tot_edges += neighs.size();
+		tot_size += size;
+		neighs.clear();
+		attrs.clear();
+	}
+
+	void write_empty_vertices(vertex_id_t end) {
+		for (; next_id < end; next_id++)
+			write_vertex(next_id);
+	}
+public:
+	adj_list_writer(const std::string &file, vertex_id_t start_id,
+			vertex_id_t end_id, vsize_t *num_edges) {
+		this->file = file;
+		f = fopen(file.c_str(), "w");
+		if (f == NULL)
+			ABORT_MSG(boost::format("fail to open %1%: %2%")
+					% file % strerror(errno));
+		f_buf = new char[RUN_WRITE_BUF_SIZE];
+		setvbuf(f, f_buf, _IOFBF, RUN_WRITE_BUF_SIZE);
+		this->next_id = start_id;
+		this->end_id = end_id;
+		this->num_edges = num_edges;
+		tot_edges = 0;
+		num_self_edges = 0;
+		tot_size = 0;
+	}
+
+	void operator()(const rec_t &rec) {
+		vertex_id_t id = get_key_vertex(rec.key);
+		assert(id >= next_id && id < end_id);
+		// We have got all edges of the current vertex.
+		if (id != next_id) {
+			write_vertex(next_id);
+			next_id++;
+			write_empty_vertices(id);
+		}
+		neighs.push_back(get_key_neighbor(rec.key));
+		if (neighs.back() == id)
+			num_self_edges++;
+		if (has_attr)
+			attrs.push_back(get_attr(rec));
+	}
+
+	void close() {
+		if (next_id < end_id) {
+			write_vertex(next_id);
+			next_id++;
+		}
+		write_empty_vertices(end_id);
+		fclose(f);
+		delete [] f_buf;
+	}
+
+	size_t get_num_edges() const {
+		return tot_edges;
+	}
+
+	size_t get_num_self_edges() const {
+		return num_self_edges;
+	}
+
+	size_t get_size() const {
+		return tot_size;
+	}
+};
+
+/*
+ * Write the graph header in the space reserved in the beginning of
+ * the adjacency list file, close the file and construct the vertex index
+ * from the number of edges of vertices.
+ */
+void write_image_meta(FILE *out, bool directed, size_t num_vertices,
+		size_t num_edges, size_t edge_data_size, const vsize_t *num_in_edges,
+		const vsize_t *num_out_edges, const std::string &index_file)
+{
+	graph_header header(directed ? graph_type::DIRECTED
+			: graph_type::UNDIRECTED, num_vertices, num_edges, edge_data_size);
+	BOOST_VERIFY(fseek(out, 0, SEEK_SET) == 0);
+	BOOST_VERIFY(fwrite(&header, graph_header::get_header_size(), 1, out) == 1);
+	fclose(out);
+
+	vertex_index::ptr index;
+	if (directed)
+		index = cdirected_vertex_index::construct(num_vertices,
+				num_in_edges, num_out_edges, header);
+	else
+		index = cundirected_vertex_index::construct(num_vertices,
+				num_in_edges, header);
+	index->dump(index_file);
+}
+
+class builder_base
+{
+protected:
+	const ext_mem_graph_builder::options &opts;
+	std::string prefix;
+	std::atomic<size_t> run_id;
+public:
+	builder_base(const ext_mem_graph_builder::options &_opts,
+			const std::string &adj_file): opts(_opts) {
+		size_t loc = adj_file.rfind('/');
+		std::string name = loc == std::string::npos
+			? adj_file : adj_file.substr(loc + 1);
+		prefix = opts.tmp_dir + "/" + name + "-"
+			+ std::to_string(getpid());
+		run_id = 0;
+	}
+
+	std::string get_run_file() {
+		return prefix + "-" + std::to_string(run_id++) + ".run";
+	}
+};
+
+template<class AttrType>
+class graph_builder: public builder_base
+{
+	typedef edge_rec<AttrType> rec_t;
+	static const bool has_attr = !std::is_same<AttrType, no_attr>::value;
+
+	// The two sets of runs for a directed graph: the in-edges are sorted by
+	// the destination vertices and the out-edges by the source vertices.
+	// An undirected graph has one set.
+	int num_sets;
+	std::vector<std::vector<run_info> > runs;
+	std::mutex runs_lock;
+	std::atomic<size_t> num_input_edges;
+	std::atomic<vertex_id_t> max_id;
+
+	struct chunk_t
+	{
+		std::string file;
+		off_t start;
+		off_t end;
+	};
+
+	/*
+	 * The per-thread buffers for parsing edges.
+	 */
+	struct parse_buf
+	{
+		std::vector<std::vector<rec_t> > sets;
+		std::vector<rec_t> tmp;
+		vertex_id_t max_id;
+
+		parse_buf(int num_sets, size_t cap) {
+			sets.resize(num_sets);
+			for (int i = 0; i < num_sets; i++)
+				sets[i].reserve(cap);
+			max_id = 0;
+		}
+	};
+
+	void spill(parse_buf &buf, int set_idx);
+	void add_edge(parse_buf &buf, vertex_id_t from, vertex_id_t to,
+			AttrType attr);
+	void parse_chunk(const chunk_t &chunk, parse_buf &buf);
+	bool parse_attr(const char *&p, const char *line_end,
+			AttrType &attr) const;
+
+	size_t get_max_fanin() const {
+		return std::max(2UL, opts.mem_size / opts.num_threads
+				/ RUN_READ_BUF_SIZE);
+	}
+	void merge_groups(int set_idx);
+	size_t write_set(int set_idx, FILE *out, size_t num_vertices,
+			std::vector<vsize_t> &num_edges, size_t &num_self_edges);
+public:
+	graph_builder(const ext_mem_graph_builder::options &opts,
+			const std::string &adj_file): builder_base(opts, adj_file) {
+		num_sets = opts.directed ? 2 : 1;
+		runs.resize(num_sets);
+		num_input_edges = 0;
+		max_id = 0;
+	}
+
+	ext_mem_graph_builder::stats build(const std::vector<std::string> &files,
+			const std::string &adj_file, const std::string &index_file);
+};
+
+template<class AttrType>
+void graph_builder<AttrType>::spill(parse_buf &buf, int set_idx)
+{
+	std::vector<rec_t> &recs = buf.sets[set_idx];
+	if (recs.empty())
+		return;
+	if (buf.tmp.size() < recs.size())
+		buf.tmp.resize(recs.size());
+	radix_sort(recs.data(), buf.tmp.data(), recs.size());
+	run_writer<rec_t> writer(get_run_file());
+	writer.append(recs.data(), recs.size());
+	run_info run = writer.close();
+	recs.clear();
+
+	std::lock_guard<std::mutex> lock(runs_lock);
+	runs[set_idx].push_back(run);
+}
+
+template<class AttrType>
+void graph_builder<AttrType>::add_edge(parse_buf &buf, vertex_id_t from,
+		vertex_id_t to, AttrType attr)
+{
+	rec_t rec;
+	set_attr(rec, attr);
+	buf.max_id = std::max(buf.max_id, std::max(from, to));
+	if (opts.directed) {
+		rec.key = make_key(from, to);
+		buf.sets[1].push_back(rec);
+		rec.key = make_key(to, from);
+		buf.sets[0].push_back(rec);
+	}
+	else {
+		rec.key = make_key(from, to);
+		buf.sets[0].push_back(rec);
+		if (from != to) {
+			rec.key = make_key(to, from);
+			buf.sets[0].push_back(rec);
+		}
+	}
+	for (int i = 0; i < num_sets; i++)
+		// An undirected edge may add two records.
+		if (buf.sets[i].size() + 2 > buf.sets[i].capacity())
+			spill(buf, i);
+}
+
+/*
+ * Parse a number in the line that ends at `line_end'. Unlike strtol, it
+ * never skips the end of the line to parse the next line. It fails if
+ * the field is missing or isn't a number.
+ */
+template<class T>
+static bool parse_field(const char *&p, const char *line_end, T &val)
+{
+	for (; p < line_end && (*p == ' ' || *p == '\t' || *p == '\r'); p++);
+	if (p >= line_end)
+		return false;
+	char *end;
+	if (std::is_floating_point<T>::value)
+		val = strtod(p, &end);
+	else if (std::is_signed<T>::value)
+		val = strtol(p, &end, 10);
+	else
+		val = strtoul(p, &end, 10);
+	if (end == p || end > line_end || (end < line_end && !isspace(*end)))
+		return false;
+	p = end;
+	return true;
+}
+
+template<>
+bool graph_builder<no_attr>::parse_attr(const char *&p, const char *line_end,
+		no_attr &attr) const
+{
+	return true;
+}
+
+template<class AttrType>
+bool graph_builder<AttrType>::parse_attr(const char *&p, const char *line_end,
+		AttrType &attr) const
+{
+	return parse_field(p, line_end, attr);
+}
+
+template<class AttrType>
+void graph_builder<AttrType>::parse_chunk(const chunk_t &chunk, parse_buf &buf)
+{
+	int fd = open(chunk.file.c_str(), O_RDONLY);
+	if (fd < 0)
+		ABORT_MSG(boost::format("fail to open %1%: %2%")
+				% chunk.file % strerror(errno));
+	// A line belongs to the chunk where it starts. We read the byte before
+	// the chunk to know whether the first line starts in the chunk, and
+	// read beyond the chunk to get the entire last line.
+	off_t read_start = chunk.start > 0 ? chunk.start - 1 : 0;
+	std::vector<char> data(chunk.end - read_start);
+	size_t num_bytes = 0;
+	while (true) {
+		ssize_t ret = pread(fd, data.data() + num_bytes,
+				data.size() - num_bytes, read_start + num_bytes);
+		if (ret < 0)
+			ABORT_MSG(boost::format("fail to read %1%: %2%")
+					% chunk.file % strerror(errno));
+		num_bytes += ret;
+		if (ret == 0)
+			break;
+		if (num_bytes < data.size())
+			continue;
+		// The last line that starts in the chunk ends at the first '\n'
+		// from the end of the chunk.
+		off_t last = chunk.end - read_start - 1;
+		if (memchr(data.data() + last, '\n', num_bytes - last))
+			break;
+		data.resize(data.size() + 4096);
+	}
+	close(fd);
+	data.resize(num_bytes);
+	data.push_back('\0');
+
+	const char *p = data.data();
+	const char *end = data.data() + num_bytes;
+	if (chunk.start > 0) {
+		p = (const char *) memchr(p, '\n', num_bytes);
+		p = p ? p + 1 : end;
+	}
+	size_t num_edges = 0;
+	// We stop at the first line that starts after the chunk.
+	const char *chunk_end = data.data() + (chunk.end - read_start);
+	while (p < end && p < chunk_end) {
+		const char *line_end = (const char *) memchr(p, '\n', end - p);
+		if (line_end == NULL)
+			line_end = end;
+		for (; p < line_end && isspace(*p); p++);
+		if (p < line_end && *p != '#') {
+			const char *field = p;
+			unsigned long from, to;
+			AttrType attr;
+			// A line with a missing or bad field is skipped.
+			if (!parse_field(field, line_end, from)
+					|| !parse_field(field, line_end, to)
+					|| !parse_attr(field, line_end, attr))
+				BOOST_LOG_TRIVIAL(error) << "can't parse line: "
+					<< std::string(p, line_end);
+			else {
+				assert(from < MAX_VERTEX_ID && to < MAX_VERTEX_ID);
+				add_edge(buf, from, to, attr);
+				num_edges++;
+			}
+		}
+		p = line_end + 1;
+	}
+	num_input_edges += num_edges;
+}
+
+/*
+ * Merge the runs in groups until a thread can merge all runs at once
+ * in its share of memory.
+ */
+template<class AttrType>
+void graph_builder<AttrType>::merge_groups(int set_idx)
+{
+	size_t max_fanin = get_max_fanin();
+	std::vector<run_info> &set_runs = runs[set_idx];
+	if (set_runs.size() <= max_fanin)
+		return;
+
+	size_t num_groups = (set_runs.size() + max_fanin - 1) / max_fanin;
+	std::vector<run_info> new_runs(num_groups);
+#pragma omp parallel for num_threads(opts.num_threads) schedule(dynamic, 1)
+	for (size_t i = 0; i < num_groups; i++) {
+		size_t start = i * max_fanin;
+		size_t end = std::min(start + max_fanin, set_runs.size());
+		std::vector<run_reader<rec_t> *> readers;
+		for (size_t j = start; j < end; j++)
+			readers.push_back(new run_reader<rec_t>(set_runs[j], 0,
+						set_runs[j].num_recs, RUN_READ_BUF_SIZE));
+		run_writer<rec_t> writer(get_run_file());
+		run_appender<rec_t> appender(writer);
+		// We don't remove self edges in an intermediate merge, but it's
+		// always safe to remove duplicated edges.
+		ext_mem_graph_builder::options merge_opts = opts;
+		merge_opts.remove_self_edges = false;
+		merge_runs(readers, merge_opts, appender);
+		appender.flush();
+		new_runs[i] = writer.close();
+		for (size_t j = 0; j < readers.size(); j++) {
+			delete readers[j];
+			unlink(set_runs[start + j].file.c_str());
+		}
+	}
+	set_runs = new_runs;
+}
+
+/*
+ * Merge the runs of a set in vertex ranges in parallel and append
+ * the adjacency lists of all vertices to the output file.
+ * It returns the number of entries in the adjacency lists and the number
+ * of self edges among them in `num_self_edges'.
+ */
+template<class AttrType>
+size_t graph_builder<AttrType>::write_set(int set_idx, FILE *out,
+		size_t num_vertices, std::vector<vsize_t> &num_edges,
+		size_t &num_self_edges)
+{
+	std::vector<run_info> &set_runs = runs[set_idx];
+	// Split the vertices into ranges with roughly the same number of edges.
+	std::vector<vertex_id_t> samples;
+	for (size_t i = 0; i < set_runs.size(); i++)
+		for (size_t j = 0; j < set_runs[i].samples.size(); j++)
+			samples.push_back(get_key_vertex(set_runs[i].samples[j]));
+	std::sort(samples.begin(), samples.end());
+	size_t num_ranges = opts.num_threads * 4;
+	std::vector<vertex_id_t> bounds;
+	bounds.push_back(0);
+	for (size_t i = 1; i < num_ranges && !samples.empty(); i++) {
+		vertex_id_t id = samples[samples.size() * i / num_ranges];
+		if (id > bounds.back())
+			bounds.push_back(id);
+	}
+	bounds.push_back(num_vertices);
+	num_ranges = bounds.size() - 1;
+
+	std::vector<std::string> part_files(num_ranges);
+	std::vector<size_t> part_edges(num_ranges);
+	std::vector<size_t> part_self_edges(num_ranges);
+	size_t read_buf_size = std::max(4096UL,
+			std::min(RUN_READ_BUF_SIZE, opts.mem_size / opts.num_threads
+				/ std::max(1UL, set_runs.size())));
+#pragma omp parallel for num_threads(opts.num_threads) schedule(dynamic, 1)
+	for (size_t i = 0; i < num_ranges; i++) {
+		std::vector<run_reader<rec_t> *> readers;
+		for (size_t j = 0; j < set_runs.size(); j++) {
+			size_t start = search_run<rec_t>(set_runs[j],
+					make_key(bounds[i], 0));
+			size_t end = i == num_ranges - 1 ? set_runs[j].num_recs
+				: search_run<rec_t>(set_runs[j], make_key(bounds[i + 1], 0));
+			readers.push_back(new run_reader<rec_t>(set_runs[j], start, end,
+						read_buf_size));
+		}
+		part_files[i] = get_run_file();
+		adj_list_writer<AttrType> writer(part_files[i], bounds[i],
+				bounds[i + 1], num_edges.data());
+		merge_runs(readers, opts, writer);
+		writer.close();
+		part_edges[i] = writer.get_num_edges();
+		part_self_edges[i] = writer.get_num_self_edges();
+		for (size_t j = 0; j < readers.size(); j++)
+			delete readers[j];
+	}
+	for (size_t i = 0; i < set_runs.size(); i++)
+		unlink(set_runs[i].file.c_str());
+
+	// Concatenate the vertex ranges.
+	size_t tot_edges = 0;
+	num_self_edges = 0;
+	std::vector<char> buf(RUN_WRITE_BUF_SIZE);
+	for (size_t i = 0; i < num_ranges; i++) {
+		FILE *f = fopen(part_files[i].c_str(), "r");
+		assert(f);
+		size_t ret;
+		while ((ret = fread(buf.data(), 1, buf.size(), f)) > 0)
+			BOOST_VERIFY(fwrite(buf.data(), ret, 1, out) == 1);
+		fclose(f);
+		unlink(part_files[i].c_str());
+		tot_edges += part_edges[i];
+		num_self_edges += part_self_edges[i];
+	}
+	return tot_edges;
+}
+
+template<class AttrType>
+ext_mem_graph_builder::stats graph_builder<AttrType>::build(
+		const std::vector<std::string> &files, const std::string &adj_file,
+		const std::string &index_file)
+{
+	ext_mem_graph_builder::stats stats;
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+
+	// Split the input files into chunks.
+	std::vector<chunk_t> chunks;
+	for (size_t i = 0; i < files.size(); i++) {
+		struct stat st;
+		if (stat(files[i].c_str(), &st) < 0)
+			ABORT_MSG(boost::format("fail to stat %1%: %2%")
+					% files[i] % strerror(errno));
+		for (off_t off = 0; off < st.st_size; off += INPUT_CHUNK_SIZE) {
+			chunk_t chunk;
+			chunk.file = files[i];
+			chunk.start = off;
+			chunk.end = std::min((off_t) (off + INPUT_CHUNK_SIZE), st.st_size);
+			chunks.push_back(chunk);
+		}
+	}
+
+	// Each thread buffers the edges of all sets and has a buffer for sorting.
+	size_t buf_cap = std::max(1024UL, opts.mem_size / opts.num_threads
+			/ (num_sets + 1) / sizeof(rec_t));
+	std::atomic<size_t> chunk_idx(0);
+#pragma omp parallel num_threads(opts.num_threads)
+	{
+		parse_buf buf(num_sets, buf_cap);
+		size_t idx;
+		while ((idx = chunk_idx++) < chunks.size())
+			parse_chunk(chunks[idx], buf);
+		for (int i = 0; i < num_sets; i++)
+			spill(buf, i);
+		vertex_id_t curr = max_id;
+		while (buf.max_id > curr && !max_id.compare_exchange_weak(curr,
+					buf.max_id));
+	}
+	stats.num_input_edges = num_input_edges;
+	stats.num_vertices = num_input_edges > 0 ? max_id + 1 : 0;
+	for (int i = 0; i < num_sets; i++)
+		stats.num_runs += runs[i].size();
+	gettimeofday(&end, NULL);
+	stats.parse_time = time_diff(start, end);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"parse %1% edges of %2% vertices to %3% runs in %4% seconds")
+		% stats.num_input_edges % stats.num_vertices % stats.num_runs
+		% stats.parse_time;
+
+	start = end;
+	for (int i = 0; i < num_sets; i++) {
+		int num_passes = 0;
+		while (runs[i].size() > get_max_fanin()) {
+			merge_groups(i);
+			num_passes++;
+		}
+		stats.num_merge_passes = std::max(stats.num_merge_passes, num_passes);
+	}
+	gettimeofday(&end, NULL);
+	stats.merge_time = time_diff(start, end);
+
+	start = end;
+	FILE *out = fopen(adj_file.c_str(), "w");
+	if (out == NULL)
+		ABORT_MSG(boost::format("fail to open %1%: %2%")
+				% adj_file % strerror(errno));
+	// Leave the space for the graph header.
+	std::vector<char> header_buf(graph_header::get_header_size());
+	BOOST_VERIFY(fwrite(header_buf.data(), header_buf.size(), 1, out) == 1);
+	std::vector<std::vector<vsize_t> > num_edges(num_sets);
+	size_t num_adj_entries = 0;
+	size_t num_self_edges = 0;
+	for (int i = 0; i < num_sets; i++) {
+		num_edges[i].resize(stats.num_vertices);
+		num_adj_entries = write_set(i, out, stats.num_vertices, num_edges[i],
+				num_self_edges);
+	}
+	// Each undirected edge is stored in the adjacency lists of both vertices,
+	// but a self edge is only stored once.
+	stats.num_edges = opts.directed ? num_adj_entries
+		: (num_adj_entries + num_self_edges) / 2;
+
+	size_t edge_data_size = has_attr ? sizeof(AttrType) : 0;
+	write_image_meta(out, opts.directed, stats.num_vertices, stats.num_edges,
+			edge_data_size, num_edges[0].data(),
+			opts.directed ? num_edges[1].data() : NULL, index_file);
+	gettimeofday(&end, NULL);
+	stats.write_time = time_diff(start, end);
+	return stats;
+}
+
+}
+
+ext_mem_graph_builder::stats ext_mem_graph_builder::build(
+		const std::vector<std::string> &files, const std::string &adj_file,
+		const std::string &index_file, const options &opts)
+{
+	assert(opts.num_threads > 0);
+	if (opts.attr_type.empty())
+		return graph_builder<no_attr>(opts, adj_file).build(files, adj_file,
+				index_file);
+	else if (opts.attr_type == "I")
+		return graph_builder<int>(opts, adj_file).build(files, adj_file,
+				index_file);
+	else if (opts.attr_type == "L")
+		return graph_builder<long>(opts, adj_file).build(files, adj_file,
+				index_file);
+	else if (opts.attr_type == "F")
+		return graph_builder<float>(opts, adj_file).build(files, adj_file,
+				index_file);
+	else if (opts.attr_type == "D")
+		return graph_builder<double>(opts, adj_file).build(files, adj_file,
+				index_file);
+	else
+		ABORT_MSG(boost::format("unknown edge attribute type: %1%")
+				% opts.attr_type);
+}
+
+ext_mem_image_writer::ext_mem_image_writer(const std::string &adj_file,
+		bool directed, const std::string &tmp_dir)
+{
+	this->directed = directed;
+	this->adj_file = adj_file;
+	adj_f = fopen(adj_file.c_str(), "w");
+	if (adj_f == NULL)
+		ABORT_MSG(boost::format("fail to open %1%: %2%")
+				% adj_file % strerror(errno));
+	adj_buf.resize(RUN_WRITE_BUF_SIZE);
+	setvbuf(adj_f, adj_buf.data(), _IOFBF, adj_buf.size());
+	// Leave the space for the graph header.
+	std::vector<char> header_buf(graph_header::get_header_size());
+	BOOST_VERIFY(fwrite(header_buf.data(), header_buf.size(), 1, adj_f) == 1);
+
+	out_f = NULL;
+	if (directed) {
+		size_t loc = adj_file.rfind('/');
+		std::string name = loc == std::string::npos
+			? adj_file : adj_file.substr(loc + 1);
+		out_file = tmp_dir + "/" + name + "-" + std::to_string(getpid())
+			+ ".out";
+		out_f = fopen(out_file.c_str(), "w+");
+		if (out_f == NULL)
+			ABORT_MSG(boost::format("fail to open %1%: %2%")
+					% out_file % strerror(errno));
+		out_buf.resize(RUN_WRITE_BUF_SIZE);
+		setvbuf(out_f, out_buf.data(), _IOFBF, out_buf.size());
+	}
+	next_id = 0;
+	num_adj_entries = 0;
+	num_self_entries = 0;
+}
+
+ext_mem_image_writer::~ext_mem_image_writer()
+{
+	// The image wasn't closed.
+	if (adj_f)
+		fclose(adj_f);
+	if (out_f) {
+		fclose(out_f);
+		unlink(out_file.c_str());
+	}
+}
+
+void ext_mem_image_writer::write_list(FILE *f, vertex_id_t id,
+		const vertex_id_t *neighs, size_t num)
+{
+	size_t size = ext_mem_undirected_vertex::num_edges2vsize(num, 0);
+	vbuf.assign(size, 0);
+	ext_mem_undirected_vertex *v = new (vbuf.data()) ext_mem_undirected_vertex(
+			id, num, 0);
+	for (size_t i = 0; i < num; i++) {
+		v->set_neighbor(i, neighs[i]);
+		if (neighs[i] == id)
+			num_self_entries++;
+	}
+	if (fwrite(vbuf.data(), size, 1, f) != 1)
+		ABORT_MSG(boost::format("fail to write the adjacency list of v%1%: %2%")
+				% id % strerror(errno));
+	num_adj_entries += num;
+}
+
+void ext_mem_image_writer::add_empty_vertices(vertex_id_t end)
+{
+	for (; next_id < end; next_id++) {
+		write_list(adj_f, next_id, NULL, 0);
+		num_in_edges.push_back(0);
+		if (directed) {
+			write_list(out_f, next_id, NULL, 0);
+			num_out_edges.push_back(0);
+		}
+	}
+}
+
+void ext_mem_image_writer::add_vertex(vertex_id_t id,
+		const vertex_id_t *neighs, size_t num)
+{
+	assert(!directed);
+	assert(id >= next_id);
+	add_empty_vertices(id);
+	write_list(adj_f, id, neighs, num);
+	num_in_edges.push_back(num);
+	next_id = id + 1;
+}
+
+void ext_mem_image_writer::add_vertex(vertex_id_t id,
+		const vertex_id_t *in_neighs, size_t num_in,
+		const vertex_id_t *out_neighs, size_t num_out)
+{
+	assert(directed);
+	assert(id >= next_id);
+	add_empty_vertices(id);
+	write_list(adj_f, id, in_neighs, num_in);
+	num_in_edges.push_back(num_in);
+	write_list(out_f, id, out_neighs, num_out);
+	num_out_edges.push_back(num_out);
+	next_id = id + 1;
+}
+
+size_t ext_mem_image_writer::close(size_t num_vertices,
+		const std::string &index_file)
+{
+	assert(next_id <= num_vertices);
+	add_empty_vertices(num_vertices);
+	if (directed) {
+		// Append the out-edge lists after the in-edge lists.
+		BOOST_VERIFY(fflush(out_f) == 0);
+		BOOST_VERIFY(fseek(out_f, 0, SEEK_SET) == 0);
+		std::vector<char> buf(RUN_WRITE_BUF_SIZE);
+		size_t ret;
+		while ((ret = fread(buf.data(), 1, buf.size(), out_f)) > 0)
+			BOOST_VERIFY(fwrite(buf.data(), ret, 1, adj_f) == 1);
+		fclose(out_f);
+		unlink(out_file.c_str());
+		out_f = NULL;
+	}
+	// Each edge is stored in the adjacency lists of both of its vertices.
+	// A directed self edge is in the in-edge and out-edge lists of its
+	// vertex, but an undirected self edge is only stored once.
+	size_t num_edges = directed ? num_adj_entries / 2
+		: (num_adj_entries + num_self_entries) / 2;
+	write_image_meta(adj_f, directed, num_vertices, num_edges, 0,
+			num_in_edges.data(), directed ? num_out_edges.data() : NULL,
+			index_file);
+	adj_f = NULL;
+	return num_edges;
+}
+
+}
+
+}
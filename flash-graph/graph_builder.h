@@ -0,0 +1,179 @@
+#ifndef __GRAPH_BUILDER_H__
+#define __GRAPH_BUILDER_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "FG_basic_types.h"
+
+namespace fg
+{
+
+namespace utils
+{
+
+/*
+ * This constructs a FlashGraph image from edge lists in text files with
+ * bounded memory. It works in three stages:
+ *	all threads parse the input files in chunks, sort the edges in their
+ *	buffers with radix sort and spill the sorted runs to disks;
+ *	if there are too many runs, the runs are merged in groups;
+ *	the runs are merged in vertex ranges in parallel. The edges of each
+ *	vertex are deduplicated and written as adjacency lists, and the vertex
+ *	index is built from the number of edges of vertices.
+ *
+ * Besides the edge buffers, it keeps the number of edges of each vertex in
+ * memory to construct the vertex index.
+ */
+class ext_mem_graph_builder
+{
+public:
+	struct options
+	{
+		bool directed;
+		// Remove the duplicated edges.
+		bool dedup;
+		bool remove_self_edges;
+		// The type of edge attributes: "I" (int), "L" (long), "F" (float),
+		// "D" (double). It's empty if edges don't have attributes.
+		std::string attr_type;
+		int num_threads;
+		// The memory (in bytes) used by all threads to buffer edges.
+		size_t mem_size;
+		// The directory where the sorted runs are spilled.
+		std::string tmp_dir;
+
+		options() {
+			directed = true;
+			dedup = false;
+			remove_self_edges = false;
+			num_threads = 4;
+			mem_size = 1024UL * 1024 * 1024;
+			tmp_dir = ".";
+		}
+	};
+
+	struct stats
+	{
+		size_t num_input_edges;
+		size_t num_vertices;
+		size_t num_edges;
+		size_t num_runs;
+		int num_merge_passes;
+		// The time of parsing, sorting and spilling edges.
+		double parse_time;
+		// The time of merging runs before the final merge.
+		double merge_time;
+		// The time of the final merge and writing the graph.
+		double write_time;
+
+		stats() {
+			num_input_edges = 0;
+			num_vertices = 0;
+			num_edges = 0;
+			num_runs = 0;
+			num_merge_passes = 0;
+			parse_time = 0;
+			merge_time = 0;
+			write_time = 0;
+		}
+
+		double get_tot_time() const {
+			return parse_time + merge_time + write_time;
+		}
+	};
+
+	/*
+	 * Construct a graph from the edge lists in `files'. Each line of a file
+	 * has the source vertex, the destination vertex and optionally
+	 * the edge attribute. The lines that start with '#' are ignored.
+	 * The adjacency lists and the vertex index are written to `adj_file'
+	 * and `index_file'.
+	 */
+	static stats build(const std::vector<std::string> &files,
+			const std::string &adj_file, const std::string &index_file,
+			const options &opts);
+};
+
+/*
+ * This writes a FlashGraph image whose adjacency lists are generated in
+ * the order of vertex IDs, e.g., when the adjacency lists of an image are
+ * merged with edge updates. It only keeps the number of edges of each
+ * vertex in memory. The out-edge lists of a directed graph are written to
+ * a temporary file and appended after the in-edge lists when the image is
+ * closed, which is the same layout as ext_mem_graph_builder produces.
+ * The image doesn't have edge attributes.
+ */
+class ext_mem_image_writer
+{
+	bool directed;
+	std::string adj_file;
+	std::string out_file;
+	FILE *adj_f;
+	FILE *out_f;
+	std::vector<char> adj_buf;
+	std::vector<char> out_buf;
+	std::vector<char> vbuf;
+	vertex_id_t next_id;
+	std::vector<vsize_t> num_in_edges;
+	std::vector<vsize_t> num_out_edges;
+	size_t num_adj_entries;
+	size_t num_self_entries;
+
+	void write_list(FILE *f, vertex_id_t id, const vertex_id_t *neighs,
+			size_t num);
+	void add_empty_vertices(vertex_id_t end);
+public:
+	/*
+	 * The temporary file of out-edge lists is created in `tmp_dir'.
+	 */
+	ext_mem_image_writer(const std::string &adj_file, bool directed,
+			const std::string &tmp_dir = ".");
+	~ext_mem_image_writer();
+
+	/*
+	 * Add the adjacency list of a vertex in an undirected graph.
+	 * Vertices have to be added in ascending order of their IDs. A vertex
+	 * that isn't added gets an empty adjacency list.
+	 */
+	void add_vertex(vertex_id_t id, const vertex_id_t *neighs, size_t num);
+	/*
+	 * Add the in-edge and out-edge lists of a vertex in a directed graph.
+	 */
+	void add_vertex(vertex_id_t id, const vertex_id_t *in_neighs,
+			size_t num_in, const vertex_id_t *out_neighs, size_t num_out);
+	/*
+	 * Finish the adjacency lists of the `num_vertices' vertices, write
+	 * the graph header and construct the vertex index in `index_file'.
+	 * It returns the number of edges in the graph.
+	 */
+	size_t close(size_t num_vertices, const std::string &index_file);
+};
+
+}
+
+}
+
+#endif
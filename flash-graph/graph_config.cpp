@@ -37,6 +37,7 @@ void graph_config::print_help()
 	printf("\tthreads: the number of threads processing the graph\n");
 	printf("\tprof_file: the output file containing CPU profiling\n");
 	printf("\ttrace_file: log IO requests\n");
+	printf("\tprofile_file: the output file containing the timeline of the worker threads\n");
 	printf("\tmax_processing_vertices: the max number of vertices being processed\n");
 	printf("\tenable_elevator: enable the elevator algorithm for scheduling vertices\n");
 	printf("\tpart_range_size_log: the log2 of the range size in range partitioning\n");
@@ -47,6 +48,11 @@ void graph_config::print_help()
 	printf("\tmin_vpart_degree: the min degree of a vertex to perform vertical partitioning\n");
 	printf("\tserial_run: run the user code on a vertex in serial\n");
 	printf("\tvertex_merge_gap: the gap size allowed when merging two vertex requests\n");
+	printf("\tedge_balanced_part: partition vertices on the cumulative degree of vertices\n");
+	printf("\tef_index: keep the locations of vertices in memory with Elias-Fano coding\n");
+	printf("\tshm_graph: the file in /dev/shm or hugetlbfs where the in-memory graph is shared by processes\n");
+	printf("\tcheckpoint: the name of the checkpoint files in SAFS\n");
+	printf("\tcheckpoint_interval: the number of levels between two checkpoints\n");
 }
 
 void graph_config::print()
@@ -55,6 +61,7 @@ void graph_config::print()
 	BOOST_LOG_TRIVIAL(info) << "\tthreads: " << num_threads;
 	BOOST_LOG_TRIVIAL(info) << "\tprof_file: " << prof_file;
 	BOOST_LOG_TRIVIAL(info) << "\ttrace_file: " << trace_file;
+	BOOST_LOG_TRIVIAL(info) << "\tprofile_file: " << profile_file;
 	BOOST_LOG_TRIVIAL(info) << "\tmax_processing_vertices: " << max_processing_vertices;
 	BOOST_LOG_TRIVIAL(info) << "\tenable_elevator: " << enable_elevator;
 	BOOST_LOG_TRIVIAL(info) << "\tpart_range_size_log: " << part_range_size_log;
@@ -65,6 +72,11 @@ void graph_config::print()
 	BOOST_LOG_TRIVIAL(info) << "\tmin_vpart_degree: " << min_vpart_degree;
 	BOOST_LOG_TRIVIAL(info) << "\tserial_run: " << serial_run;
 	BOOST_LOG_TRIVIAL(info) << "\tvertex_merge_gap: " << vertex_merge_gap;
+	BOOST_LOG_TRIVIAL(info) << "\tedge_balanced_part: " << edge_balanced_part;
+	BOOST_LOG_TRIVIAL(info) << "\tef_index: " << ef_index;
+	BOOST_LOG_TRIVIAL(info) << "\tshm_graph: " << shm_graph;
+	BOOST_LOG_TRIVIAL(info) << "\tcheckpoint: " << checkpoint;
+	BOOST_LOG_TRIVIAL(info) << "\tcheckpoint_interval: " << checkpoint_interval;
 }
 
 void graph_config::init(config_map::ptr map)
@@ -84,6 +96,7 @@ void graph_config::init(config_map::ptr map)
 		throw conf_exception("The number of worker threads has to be 2^n");
 	map->read_option("prof_file", prof_file);
 	map->read_option("trace_file", trace_file);
+	map->read_option("profile_file", profile_file);
 	map->read_option_int("max_processing_vertices", max_processing_vertices);
 	map->read_option_bool("enable_elevator", enable_elevator);
 	map->read_option_int("part_range_size_log", part_range_size_log);
@@ -94,6 +107,13 @@ void graph_config::init(config_map::ptr map)
 	map->read_option_int("min_vpart_degree", min_vpart_degree);
 	map->read_option_bool("serial_run", serial_run);
 	map->read_option_int("vertex_merge_gap", vertex_merge_gap);
+	map->read_option_bool("edge_balanced_part", edge_balanced_part);
+	map->read_option_bool("ef_index", ef_index);
+	map->read_option("shm_graph", shm_graph);
+	map->read_option("checkpoint", checkpoint);
+	map->read_option_int("checkpoint_interval", checkpoint_interval);
+	if (checkpoint_interval <= 0)
+		throw conf_exception("The checkpoint interval has to be positive");
 }
 
 }
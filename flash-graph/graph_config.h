@@ -37,6 +37,7 @@ class graph_config
 	int num_threads;
 	std::string prof_file;
 	std::string trace_file;
+	std::string profile_file;
 	int max_processing_vertices;
 	bool enable_elevator;
 	int part_range_size_log;
@@ -48,6 +49,11 @@ class graph_config
 	bool serial_run;
 	// in pages.
 	int vertex_merge_gap;
+	bool edge_balanced_part;
+	bool ef_index;
+	std::string shm_graph;
+	std::string checkpoint;
+	int checkpoint_interval;
 public:
 	/**
 	 * \brief The default constructor that set all configurations to
@@ -67,6 +73,9 @@ public:
 		// When the gap is 0, it means two vertices either in the same page
 		// or two adjacent pages.
 		vertex_merge_gap = 0;
+		edge_balanced_part = false;
+		ef_index = false;
+		checkpoint_interval = 1;
 	}
 
 	/**
@@ -117,6 +126,15 @@ public:
 		return trace_file;
 	}
 
+	/**
+	 * \brief Get the file where the graph engine writes the timeline of
+	 * its worker threads in the Chrome trace format.
+	 * \return the file name. It's empty if the engine isn't profiled.
+	 */
+	const std::string &get_profile_file() const {
+		return profile_file;
+	}
+
 	/**
 	 * \brief Get the maximal number of vertices being processed by
 	 * a worker thread.
@@ -196,6 +214,57 @@ public:
 	int get_vertex_merge_gap() const {
 		return vertex_merge_gap;
 	}
+
+	/**
+	 * \brief Determine whether to partition vertices on the cumulative
+	 * degree of vertices, so that each worker thread gets roughly the same
+	 * number of edges.
+	 * \return true if vertices are partitioned on edges; false if they are
+	 * partitioned on vertex ranges of the same size.
+	 */
+	bool use_edge_balanced_part() const {
+		return edge_balanced_part;
+	}
+
+	/**
+	 * \brief Determine whether to keep the locations of vertices in memory
+	 * with Elias-Fano coding. It takes a few more bits for each vertex than
+	 * the compressed vertex index, but it gets the location of any vertex
+	 * in constant time.
+	 * \return true if the in-memory vertex index uses Elias-Fano coding.
+	 */
+	bool use_ef_index() const {
+		return ef_index;
+	}
+
+	/**
+	 * \brief Get the file in a memory filesystem (e.g., /dev/shm or
+	 * hugetlbfs) where the in-memory graph is shared with other processes.
+	 * \return the file name. It's empty if the graph isn't shared.
+	 */
+	const std::string &get_shm_graph() const {
+		return shm_graph;
+	}
+
+	/**
+	 * \brief Get the name of the checkpoint files in SAFS. The graph engine
+	 * checkpoints the vertex state and the active vertices at the boundaries
+	 * of levels, so a long-running graph algorithm can be resumed from
+	 * the last checkpoint.
+	 * \return the name of the checkpoint. It's empty if checkpointing
+	 * is disabled.
+	 */
+	const std::string &get_checkpoint() const {
+		return checkpoint;
+	}
+
+	/**
+	 * \brief Get the number of levels between two checkpoints.
+	 * \return the checkpoint interval.
+	 */
+	int get_checkpoint_interval() const {
+		return checkpoint_interval;
+	}
 };
 
 extern graph_config graph_conf;
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include <boost/format.hpp>
+
+#include "log.h"
+#include "graph_delta.h"
+
+namespace fg
+{
+
+void graph_delta::edge_delta::add(vertex_id_t id)
+{
+	std::vector<vertex_id_t>::iterator it = std::lower_bound(deleted.begin(),
+			deleted.end(), id);
+	if (it != deleted.end() && *it == id)
+		deleted.erase(it);
+	it = std::lower_bound(added.begin(), added.end(), id);
+	if (it == added.end() || *it != id)
+		added.insert(it, id);
+}
+
+void graph_delta::edge_delta::del(vertex_id_t id)
+{
+	std::vector<vertex_id_t>::iterator it = std::lower_bound(added.begin(),
+			added.end(), id);
+	if (it != added.end() && *it == id)
+		added.erase(it);
+	it = std::lower_bound(deleted.begin(), deleted.end(), id);
+	if (it == deleted.end() || *it != id)
+		deleted.insert(it, id);
+}
+
+graph_delta::graph_delta(const graph_header &header): shards(
+		new delta_shard[NUM_SHARDS]), has_delta_map(header.get_num_vertices(),
+		0), num_updates(0)
+{
+	this->header = header;
+}
+
+graph_delta::ptr graph_delta::create(const graph_header &header)
+{
+	if (header.has_edge_data()) {
+		BOOST_LOG_TRIVIAL(error)
+			<< "graph delta doesn't support graphs with edge data";
+		return ptr();
+	}
+	return ptr(new graph_delta(header));
+}
+
+void graph_delta::update_edge(vertex_id_t id, vertex_id_t neighbor,
+		edge_type type, bool add)
+{
+	assert(id < header.get_num_vertices());
+	assert(neighbor < header.get_num_vertices());
+	delta_shard &shard = get_shard(id);
+	pthread_spin_lock(&shard.lock);
+	vertex_delta &vdelta = shard.deltas[id];
+	edge_delta &edelta = type == IN_EDGE ? vdelta.in_edges : vdelta.out_edges;
+	size_t orig_num = edelta.get_num_updates();
+	if (add)
+		edelta.add(neighbor);
+	else
+		edelta.del(neighbor);
+	num_updates += edelta.get_num_updates() - orig_num;
+	pthread_spin_unlock(&shard.lock);
+	has_delta_map.set(id);
+}
+
+void graph_delta::add_edge(vertex_id_t from, vertex_id_t to)
+{
+	if (header.is_directed_graph()) {
+		update_edge(from, to, OUT_EDGE, true);
+		update_edge(to, from, IN_EDGE, true);
+	}
+	else {
+		update_edge(from, to, OUT_EDGE, true);
+		if (from != to)
+			update_edge(to, from, OUT_EDGE, true);
+	}
+}
+
+void graph_delta::delete_edge(vertex_id_t from, vertex_id_t to)
+{
+	if (header.is_directed_graph()) {
+		update_edge(from, to, OUT_EDGE, false);
+		update_edge(to, from, IN_EDGE, false);
+	}
+	else {
+		update_edge(from, to, OUT_EDGE, false);
+		if (from != to)
+			update_edge(to, from, OUT_EDGE, false);
+	}
+}
+
+void graph_delta::get_updated_vertices(std::vector<vertex_id_t> &ids) const
+{
+	for (int i = 0; i < NUM_SHARDS; i++) {
+		const delta_shard &shard = shards[i];
+		for (delta_map_t::const_iterator it = shard.deltas.begin();
+				it != shard.deltas.end(); it++)
+			ids.push_back(it->first);
+	}
+	std::sort(ids.begin(), ids.end());
+}
+
+void graph_delta::merge_edges(vertex_id_t id, edge_type type,
+		const std::vector<vertex_id_t> &base,
+		std::vector<vertex_id_t> &merged) const
+{
+	if (!header.is_directed_graph())
+		type = OUT_EDGE;
+	assert(type == IN_EDGE || type == OUT_EDGE);
+
+	const delta_shard &shard = get_shard(id);
+	delta_map_t::const_iterator it = shard.deltas.find(id);
+	if (it == shard.deltas.end()) {
+		merged = base;
+		return;
+	}
+
+	const edge_delta &edelta = type == IN_EDGE
+		? it->second.in_edges : it->second.out_edges;
+	std::vector<vertex_id_t> remain;
+	remain.reserve(base.size());
+	std::set_difference(base.begin(), base.end(), edelta.deleted.begin(),
+			edelta.deleted.end(), std::back_inserter(remain));
+	merged.clear();
+	merged.reserve(remain.size() + edelta.added.size());
+	std::set_union(remain.begin(), remain.end(), edelta.added.begin(),
+			edelta.added.end(), std::back_inserter(merged));
+}
+
+/*
+ * The header of a delta segment file. It's followed by a list of records,
+ * each of which stores the updates of edges in one direction of a vertex.
+ */
+struct delta_seg_header
+{
+	static const uint64_t MAGIC_NUMBER = 0x4647444C54533031UL;
+
+	uint64_t magic;
+	uint64_t num_vertices;
+	uint64_t num_records;
+	int32_t directed;
+	int32_t pad;
+};
+
+struct delta_seg_record
+{
+	vertex_id_t id;
+	int32_t type;
+	uint32_t num_added;
+	uint32_t num_deleted;
+};
+
+bool graph_delta::dump_segment(const std::string &file) const
+{
+	FILE *f = fopen(file.c_str(), "w");
+	if (f == NULL) {
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"can't open %1% to store the graph delta") % file;
+		return false;
+	}
+
+	std::vector<vertex_id_t> ids;
+	get_updated_vertices(ids);
+
+	delta_seg_header header;
+	header.magic = delta_seg_header::MAGIC_NUMBER;
+	header.num_vertices = this->header.get_num_vertices();
+	header.num_records = 0;
+	header.directed = this->header.is_directed_graph();
+	header.pad = 0;
+	bool ret = fwrite(&header, sizeof(header), 1, f) == 1;
+	for (size_t i = 0; i < ids.size() && ret; i++) {
+		const vertex_delta &vdelta = get_shard(ids[i]).deltas.find(
+				ids[i])->second;
+		const edge_delta *edeltas[2] = {&vdelta.in_edges, &vdelta.out_edges};
+		edge_type types[2] = {IN_EDGE, OUT_EDGE};
+		for (int j = 0; j < 2 && ret; j++) {
+			const edge_delta &edelta = *edeltas[j];
+			if (edelta.get_num_updates() == 0)
+				continue;
+			delta_seg_record rec;
+			rec.id = ids[i];
+			rec.type = types[j];
+			rec.num_added = edelta.added.size();
+			rec.num_deleted = edelta.deleted.size();
+			ret = fwrite(&rec, sizeof(rec), 1, f) == 1
+				&& fwrite(edelta.added.data(), sizeof(vertex_id_t),
+						rec.num_added, f) == rec.num_added
+				&& fwrite(edelta.deleted.data(), sizeof(vertex_id_t),
+						rec.num_deleted, f) == rec.num_deleted;
+			header.num_records++;
+		}
+	}
+	// Write the number of records at last.
+	if (ret) {
+		fseek(f, 0, SEEK_SET);
+		ret = fwrite(&header, sizeof(header), 1, f) == 1;
+	}
+	fclose(f);
+	return ret;
+}
+
+bool graph_delta::load_segment(const std::string &file)
+{
+	FILE *f = fopen(file.c_str(), "r");
+	if (f == NULL) {
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"can't open the delta segment %1%") % file;
+		return false;
+	}
+
+	delta_seg_header header;
+	bool ret = fread(&header, sizeof(header), 1, f) == 1
+		&& header.magic == delta_seg_header::MAGIC_NUMBER
+		&& header.num_vertices == this->header.get_num_vertices()
+		&& (bool) header.directed == this->header.is_directed_graph();
+	std::vector<vertex_id_t> added, deleted;
+	for (size_t i = 0; i < header.num_records && ret; i++) {
+		delta_seg_record rec;
+		ret = fread(&rec, sizeof(rec), 1, f) == 1
+			&& rec.id < header.num_vertices;
+		if (!ret)
+			break;
+		added.resize(rec.num_added);
+		deleted.resize(rec.num_deleted);
+		ret = fread(added.data(), sizeof(vertex_id_t), rec.num_added,
+				f) == rec.num_added
+			&& fread(deleted.data(), sizeof(vertex_id_t), rec.num_deleted,
+					f) == rec.num_deleted;
+		for (size_t j = 0; j < added.size() && ret; j++)
+			update_edge(rec.id, added[j], (edge_type) rec.type, true);
+		for (size_t j = 0; j < deleted.size() && ret; j++)
+			update_edge(rec.id, deleted[j], (edge_type) rec.type, false);
+	}
+	fclose(f);
+	if (!ret)
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"%1% isn't a valid delta segment of the graph") % file;
+	return ret;
+}
+
+merged_page_vertex::merged_page_vertex(const graph_delta &delta,
+		const page_vertex &base)
+{
+	if (base.is_directed()) {
+		const page_directed_vertex &dbase = (const page_directed_vertex &) base;
+		bool has_in = dbase.get_in_size() > 0;
+		bool has_out = dbase.get_out_size() > 0;
+		if (has_in)
+			merge_part(delta, base, IN_EDGE, in_buf, in_arr);
+		if (has_out)
+			merge_part(delta, base, OUT_EDGE, out_buf, out_arr);
+		if (has_in && has_out)
+			merged.reset(new page_directed_vertex(in_arr, out_arr));
+		else if (has_in)
+			merged.reset(new page_directed_vertex(in_arr, true));
+		else
+			merged.reset(new page_directed_vertex(out_arr, false));
+	}
+	else {
+		merge_part(delta, base, OUT_EDGE, out_buf, out_arr);
+		merged.reset(new page_undirected_vertex(out_arr));
+	}
+}
+
+void merged_page_vertex::merge_part(const graph_delta &delta,
+		const page_vertex &base, edge_type type, std::vector<char> &buf,
+		mem_byte_array &arr)
+{
+	std::vector<vertex_id_t> base_edges;
+	base_edges.reserve(base.get_num_edges(type));
+	edge_seq_iterator it = base.get_neigh_seq_it(type);
+	while (it.has_next())
+		base_edges.push_back(it.next());
+	if (!std::is_sorted(base_edges.begin(), base_edges.end()))
+		std::sort(base_edges.begin(), base_edges.end());
+
+	std::vector<vertex_id_t> merged_edges;
+	delta.merge_edges(base.get_id(), type, base_edges, merged_edges);
+
+	// Store the merged edge list in the same format as the one in
+	// the graph image.
+	buf.resize(ext_mem_undirected_vertex::num_edges2vsize(merged_edges.size(),
+				0));
+	ext_mem_undirected_vertex *v = new (buf.data()) ext_mem_undirected_vertex(
+			base.get_id(), merged_edges.size(), 0);
+	for (size_t i = 0; i < merged_edges.size(); i++)
+		v->set_neighbor(i, merged_edges[i]);
+	arr.set_data(buf.data(), buf.size());
+}
+
+}
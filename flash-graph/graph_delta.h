@@ -0,0 +1,268 @@
+#ifndef __GRAPH_DELTA_H__
+#define __GRAPH_DELTA_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <unordered_map>
+
+#include "cache.h"
+
+#include "FG_basic_types.h"
+#include "graph_file_header.h"
+#include "bitmap.h"
+#include "vertex.h"
+
+namespace fg
+{
+
+/**
+ * \brief This stores the edges inserted to and deleted from a graph image
+ * since the image was constructed.
+ *
+ * The updates are kept in memory per vertex. When a graph engine runs on
+ * a graph with a delta, the adjacency list read from the base image is
+ * merged with the delta of the vertex before it's passed to the vertex,
+ * so algorithms run on base+delta without rebuilding the image.
+ * The delta can be written to a compacted segment on SSDs and loaded back,
+ * and it can be folded into a new base image with `fold_graph_delta'.
+ *
+ * Edges are treated as a set: deleting an edge removes it from the graph
+ * regardless of how many times it was inserted, and inserting an edge that
+ * already exists in the base image has no effect. The delta only supports
+ * graphs without edge data and can't add new vertices to the graph.
+ *
+ * The delta can be updated by multiple threads at the same time, but it
+ * can't be updated while a graph engine runs on it.
+ */
+class graph_delta
+{
+	static const int NUM_SHARDS = 64;
+
+	/*
+	 * The updates of the edges in one direction. Both vectors are sorted
+	 * and an edge can't exist in both of them.
+	 */
+	struct edge_delta
+	{
+		std::vector<vertex_id_t> added;
+		std::vector<vertex_id_t> deleted;
+
+		void add(vertex_id_t id);
+		void del(vertex_id_t id);
+		size_t get_num_updates() const {
+			return added.size() + deleted.size();
+		}
+	};
+
+	struct vertex_delta
+	{
+		edge_delta in_edges;
+		edge_delta out_edges;
+	};
+
+	typedef std::unordered_map<vertex_id_t, vertex_delta> delta_map_t;
+
+	struct delta_shard
+	{
+		pthread_spinlock_t lock;
+		delta_map_t deltas;
+
+		delta_shard() {
+			pthread_spin_init(&lock, PTHREAD_PROCESS_PRIVATE);
+		}
+
+		~delta_shard() {
+			pthread_spin_destroy(&lock);
+		}
+	};
+
+	graph_header header;
+	std::unique_ptr<delta_shard[]> shards;
+	// Indicate which vertices have deltas, so merging on read only needs to
+	// look up the hash tables for these vertices.
+	thread_safe_bitmap has_delta_map;
+	std::atomic<size_t> num_updates;
+
+	graph_delta(const graph_header &header);
+
+	delta_shard &get_shard(vertex_id_t id) {
+		return shards[id % NUM_SHARDS];
+	}
+
+	const delta_shard &get_shard(vertex_id_t id) const {
+		return shards[id % NUM_SHARDS];
+	}
+
+	void update_edge(vertex_id_t id, vertex_id_t neighbor, edge_type type,
+			bool add);
+public:
+	typedef std::shared_ptr<graph_delta> ptr;
+
+	/**
+	 * \brief Create an empty delta for a graph.
+	 * \param header The header of the base graph image.
+	 * \return The delta. It's NULL if the graph has edge data.
+	 */
+	static ptr create(const graph_header &header);
+
+	/**
+	 * \brief Load a delta segment from a file and apply it to the delta.
+	 * The segments have to be loaded in the order that they were written.
+	 * \param file The segment file.
+	 * \return false if the segment doesn't belong to the graph.
+	 */
+	bool load_segment(const std::string &file);
+
+	/**
+	 * \brief Write the delta to a compacted segment file.
+	 * A segment contains the net effect of all updates in the delta,
+	 * sorted by vertex IDs.
+	 * \param file The segment file.
+	 * \return false if the segment can't be written.
+	 */
+	bool dump_segment(const std::string &file) const;
+
+	/**
+	 * \brief Insert an edge to the graph.
+	 */
+	void add_edge(vertex_id_t from, vertex_id_t to);
+
+	/**
+	 * \brief Delete an edge from the graph.
+	 */
+	void delete_edge(vertex_id_t from, vertex_id_t to);
+
+	/**
+	 * \brief Whether a vertex has any updates in the delta.
+	 */
+	bool has_delta(vertex_id_t id) const {
+		return has_delta_map.get(id);
+	}
+
+	/**
+	 * \brief Get the number of updated edges kept in the delta.
+	 */
+	size_t get_num_updates() const {
+		return num_updates.load();
+	}
+
+	/**
+	 * \brief Get the vertices that have updates in the delta.
+	 * \param ids The vertex IDs, sorted in ascending order.
+	 */
+	void get_updated_vertices(std::vector<vertex_id_t> &ids) const;
+
+	/**
+	 * \brief Merge the edges of a vertex in the base image with the delta.
+	 * \param id The vertex ID.
+	 * \param type The direction of the edges. It has to be IN_EDGE or
+	 *             OUT_EDGE for directed graphs and is ignored for
+	 *             undirected graphs.
+	 * \param base The sorted neighbors of the vertex in the base image.
+	 * \param merged The sorted neighbors after the delta is applied.
+	 */
+	void merge_edges(vertex_id_t id, edge_type type,
+			const std::vector<vertex_id_t> &base,
+			std::vector<vertex_id_t> &merged) const;
+
+	const graph_header &get_graph_header() const {
+		return header;
+	}
+};
+
+/*
+ * A byte array backed by contiguous memory. The data is placed as if it
+ * started in the beginning of a page.
+ */
+class mem_byte_array: public safs::page_byte_array
+{
+	const char *data;
+	size_t size;
+public:
+	mem_byte_array() {
+		data = NULL;
+		size = 0;
+	}
+
+	void set_data(const char *data, size_t size) {
+		this->data = data;
+		this->size = size;
+	}
+
+	virtual void lock() {
+	}
+
+	virtual void unlock() {
+	}
+
+	virtual off_t get_offset() const {
+		return 0;
+	}
+
+	virtual size_t get_size() const {
+		return size;
+	}
+
+	virtual safs::page_byte_array *clone() {
+		return NULL;
+	}
+
+	virtual off_t get_offset_in_first_page() const {
+		return 0;
+	}
+
+	virtual const char *get_page(int idx) const {
+		return data + idx * safs::PAGE_SIZE;
+	}
+};
+
+/**
+ * \brief A page vertex whose adjacency list is the one in the base image
+ * merged with the delta of the vertex.
+ * It keeps the parts of a directed vertex requested by the vertex, i.e.,
+ * it only has in-edges if the base vertex only has in-edges.
+ */
+class merged_page_vertex
+{
+	std::vector<char> in_buf;
+	std::vector<char> out_buf;
+	mem_byte_array in_arr;
+	mem_byte_array out_arr;
+	std::unique_ptr<page_vertex> merged;
+
+	void merge_part(const graph_delta &delta, const page_vertex &base,
+			edge_type type, std::vector<char> &buf, mem_byte_array &arr);
+public:
+	merged_page_vertex(const graph_delta &delta, const page_vertex &base);
+
+	const page_vertex &get_vertex() const {
+		return *merged;
+	}
+};
+
+}
+
+#endif
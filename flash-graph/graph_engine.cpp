@@ -27,11 +27,14 @@
 #include "graph_engine.h"
 #include "messaging.h"
 #include "worker_thread.h"
+#include "message_processor.h"
 #include "vertex_compute.h"
 #include "vertex_request.h"
 #include "vertex_index_reader.h"
 #include "in_mem_storage.h"
+#include "checkpoint.h"
 #include "FGlib.h"
+#include "native_file.h"
 
 using namespace safs;
 
@@ -385,12 +388,12 @@ bool vpart_index_compute::run(vertex_id_t start_vid, index_iterator &it)
 		if (graph.is_directed()) {
 			vsize_t num_edges = graph.cal_num_edges(it.get_curr_size())
 				+ graph.cal_num_edges(it.get_curr_out_size());
-			if (num_edges >= (vsize_t) graph_conf.get_min_vpart_degree())
+			if (num_edges >= graph.get_min_vpart_degree())
 				large_degree_ids->push_back(vid);
 		}
 		else {
 			vsize_t num_edges = graph.cal_num_edges(it.get_curr_size());
-			if (num_edges >= (vsize_t) graph_conf.get_min_vpart_degree())
+			if (num_edges >= graph.get_min_vpart_degree())
 				large_degree_ids->push_back(vid);
 		}
 
@@ -539,16 +542,57 @@ void init_vpart_thread::run()
 
 }
 
-void graph_engine::init(graph_index::ptr index)
+graph_partitioner::ptr graph_engine::create_partitioner(const FG_graph &graph)
+{
+	min_vpart_degree = graph_conf.get_min_vpart_degree();
+	if (!graph_conf.use_edge_balanced_part())
+		return graph_partitioner::ptr();
+
+	int num_threads = graph_conf.get_num_threads();
+	int num_vparts = graph_conf.get_num_vparts();
+	// The partition boundaries are stored next to the index file, so we
+	// only need to compute them once for a graph. We only do so when
+	// the index is in the local filesystem; if it's in SAFS, there is
+	// no local directory for the partition file and we recompute it.
+	std::string part_file;
+	if (!graph.get_index_file().empty()
+			&& file_exist(graph.get_index_file()))
+		part_file = graph.get_index_file() + ".part";
+	edge_balanced_graph_partitioner::ptr partitioner;
+	if (!part_file.empty())
+		partitioner = edge_balanced_graph_partitioner::load(part_file,
+				header.get_num_vertices(), num_threads, num_vparts,
+				min_vpart_degree);
+	if (partitioner == NULL) {
+		partitioner = edge_balanced_graph_partitioner::create(*vindex,
+				header.get_num_vertices(), num_threads, num_vparts,
+				min_vpart_degree);
+		if (!part_file.empty() && partitioner->dump(part_file, num_vparts,
+					min_vpart_degree))
+			BOOST_LOG_TRIVIAL(info) << boost::format(
+					"store the partitions in %1%") % part_file;
+	}
+	// Hub vertices are split across threads with vertical partitioning.
+	if (num_vparts > 1)
+		min_vpart_degree = std::min(min_vpart_degree,
+				partitioner->get_hub_degree());
+	return partitioner;
+}
+
+void graph_engine::init(graph_index::ptr index,
+		graph_partitioner::ptr partitioner)
 {
 	int num_threads = graph_conf.get_num_threads();
 	this->num_nodes = params.get_num_nodes();
 
 	// Construct the vertex states.
-	index->init(num_threads, num_nodes);
+	index->init(num_threads, num_nodes, partitioner);
 
 	max_processing_vertices = graph_conf.get_max_processing_vertices();
 	is_complete = false;
+	async_mode = false;
+	num_idle_threads = 0;
+	async_epoch = 0;
 	this->vertices = index;
 
 	pthread_mutex_init(&lock, NULL);
@@ -568,6 +612,9 @@ void graph_engine::init(graph_index::ptr index)
 
 	if (!graph_conf.get_trace_file().empty())
 		logger = trace_logger::ptr(new trace_logger(graph_conf.get_trace_file()));
+	if (!graph_conf.get_profile_file().empty())
+		profiler = engine_profiler::create(graph_conf.get_profile_file(),
+				num_threads);
 
 #if 0
 	if (graph_conf.preload())
@@ -586,6 +633,33 @@ void graph_engine::init(graph_index::ptr index)
 			delete threads[i];
 		}
 	}
+
+	init_checkpoint();
+}
+
+void graph_engine::init_checkpoint()
+{
+	const std::string &name = graph_conf.get_checkpoint();
+	if (name.empty())
+		return;
+
+	if (!is_safs_init() || !params.is_writable())
+		BOOST_LOG_TRIVIAL(warning)
+			<< "checkpoints are written to SAFS, which isn't writable";
+	else if (graph_conf.get_num_vparts() > 1)
+		BOOST_LOG_TRIVIAL(warning)
+			<< "can't checkpoint vertically partitioned vertices";
+	else if (vertices->get_vertex_size() == 0)
+		BOOST_LOG_TRIVIAL(warning)
+			<< "the vertex state can't be copied to a checkpoint";
+	else {
+		checkpoint = graph_checkpoint::create(name, get_num_threads(),
+				vertices->get_vertex_size(), get_num_vertices());
+		ckpt_times.resize(get_num_threads());
+		ckpt_bytes = 0;
+		return;
+	}
+	BOOST_LOG_TRIVIAL(warning) << "checkpointing is disabled";
 }
 
 graph_engine::graph_engine(FG_graph &graph, graph_index::ptr index)
@@ -596,7 +670,8 @@ graph_engine::graph_engine(FG_graph &graph, graph_index::ptr index)
 	// Init graph data.
 	graph_factory = graph.get_graph_io_factory(GLOBAL_CACHE_ACCESS);
 	// Construct the in-memory compressed vertex index.
-	vindex = in_mem_query_vertex_index::create(graph.get_index_data(), true);
+	vindex = in_mem_query_vertex_index::create(graph.get_index_data(), true,
+			graph_conf.use_ef_index());
 
 	header = graph.get_graph_header();
 	header.verify();
@@ -607,7 +682,12 @@ graph_engine::graph_engine(FG_graph &graph, graph_index::ptr index)
 		out_part_off = idx->get_out_part_loc();
 	}
 
-	init(index);
+	delta = graph.get_delta();
+	if (delta)
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"The graph has %1% updated edges") % delta->get_num_updates();
+
+	init(index, create_partitioner(graph));
 
 	gettimeofday(&init_end, NULL);
 	BOOST_LOG_TRIVIAL(info)
@@ -618,6 +698,8 @@ graph_engine::graph_engine(FG_graph &graph, graph_index::ptr index)
 graph_engine::~graph_engine()
 {
 	graph_factory->print_statistics();
+	if (profiler)
+		profiler->write_trace();
 	for (unsigned i = 0; i < worker_threads.size(); i++)
 		delete worker_threads[i];
 	graph_factory = file_io_factory::shared_ptr();
@@ -630,6 +712,12 @@ static inline int get_node_id(int thread_idx, int num_nodes)
 
 void graph_engine::init_threads(vertex_program_creater::ptr creater)
 {
+	// The graph engine may run multiple times.
+	is_complete = false;
+	num_idle_threads = 0;
+	async_epoch = 0;
+	if (profiler)
+		profiler->start_run();
 	std::vector<std::shared_ptr<slab_allocator> > msg_allocs(num_nodes);
 	std::vector<std::shared_ptr<slab_allocator> > flush_msg_allocs(num_nodes);
 	// It turns out that it's important to respect the NUMA effect here.
@@ -720,6 +808,97 @@ void graph_engine::start_all(vertex_initializer::ptr init,
 	iter_start = start_time;
 }
 
+bool graph_engine::resume(vertex_program_creater::ptr creater)
+{
+	if (checkpoint == NULL || checkpoint->get_last_level() < 0)
+		return false;
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	int num_threads = get_num_threads();
+	std::vector<std::vector<vertex_id_t> > start_vertices(num_threads);
+#pragma omp parallel for
+	for (int i = 0; i < num_threads; i++) {
+		std::pair<char *, size_t> data = vertices->get_part_data(i);
+		std::vector<vertex_id_t> local_ids;
+		checkpoint->read_part(i, data.first, data.second, local_ids);
+		start_vertices[i].resize(local_ids.size());
+		for (size_t j = 0; j < local_ids.size(); j++)
+			get_partitioner()->loc2map(i, local_ids[j], start_vertices[i][j]);
+	}
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"It takes %1% seconds to restore the checkpoint of level %2%")
+		% time_diff(start, end) % checkpoint->get_last_level();
+
+	level = checkpoint->get_last_level();
+	gettimeofday(&start_time, NULL);
+	init_threads(std::move(creater));
+	for (int i = 0; i < num_threads; i++) {
+		worker_threads[i]->start_vertices(start_vertices[i],
+				vertex_initializer::ptr());
+		worker_threads[i]->start();
+	}
+	iter_start = start_time;
+	return true;
+}
+
+bool graph_engine::save_checkpoint(const std::vector<char> &driver_state)
+{
+	this->driver_state = driver_state;
+	if (checkpoint == NULL)
+		return false;
+	// The graph engine can't be running.
+	for (size_t i = 0; i < worker_threads.size(); i++)
+		assert(worker_threads[i] == NULL);
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	int num_threads = get_num_threads();
+	std::vector<vertex_id_t> no_active;
+	ckpt_bytes = 0;
+#pragma omp parallel for
+	for (int i = 0; i < num_threads; i++) {
+		std::pair<char *, size_t> data = vertices->get_part_data(i);
+		ckpt_bytes += checkpoint->write_part(0, i, data.first, data.second,
+				no_active);
+	}
+	checkpoint->commit(0, driver_state);
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"checkpoint between runs: %1% bytes in %2% seconds")
+		% ckpt_bytes.load() % time_diff(start, end);
+	ckpt_bytes = 0;
+	return true;
+}
+
+bool graph_engine::get_checkpoint_driver_state(std::vector<char> &state) const
+{
+	if (checkpoint == NULL || checkpoint->get_last_level() < 0)
+		return false;
+	state = checkpoint->get_driver_state();
+	return true;
+}
+
+bool graph_engine::need_checkpoint() const
+{
+	// A checkpoint is taken before the graph engine enters the next level.
+	return checkpoint && !async_mode
+		&& (level.get() + 1) % graph_conf.get_checkpoint_interval() == 0;
+}
+
+void graph_engine::checkpoint_part(int part_id,
+		const std::vector<vertex_id_t> &local_ids)
+{
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	std::pair<char *, size_t> data = vertices->get_part_data(part_id);
+	ckpt_bytes += checkpoint->write_part(level.get() + 1, part_id,
+			data.first, data.second, local_ids);
+	gettimeofday(&end, NULL);
+	ckpt_times[part_id] = time_diff(start, end);
+}
+
 bool graph_engine::progress_first_level()
 {
 	static atomic_number<long> tot_num_activates;
@@ -754,20 +933,42 @@ bool graph_engine::progress_next_level()
 {
 	static atomic_number<long> tot_num_activates;
 	static atomic_integer num_threads;
+	worker_thread *curr = (worker_thread *) thread::get_curr_thread();
+	thread_profiler *prof = curr->get_profiler();
 	// We have to make sure all threads have reach here, so we can switch
 	// queues to progress to the next level.
 	// If the queue of the next level is empty, the program can terminate.
-	int rc = pthread_barrier_wait(&barrier1);
+	int rc;
+	{
+		prof_timer timer(prof, PROF_IDLE);
+		rc = pthread_barrier_wait(&barrier1);
+	}
 	if(rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD)
 	{
 		BOOST_LOG_TRIVIAL(fatal) << "Could not wait on barrier";
 		exit(-1);
 	}
-	worker_thread *curr = (worker_thread *) thread::get_curr_thread();
 	int num_activates = curr->enter_next_level();
 	tot_num_activates.inc(num_activates);
 	// If all threads have reached here.
 	if (num_threads.inc(1) == get_num_threads()) {
+		// All threads have written their partitions of the checkpoint.
+		// There is no need to commit the checkpoint if the algorithm
+		// has completed.
+		if (need_checkpoint()) {
+			if (tot_num_activates.get() > 0) {
+				checkpoint->commit(level.get() + 1, driver_state);
+				struct timeval curr;
+				gettimeofday(&curr, NULL);
+				float ckpt_time = *std::max_element(ckpt_times.begin(),
+						ckpt_times.end());
+				BOOST_LOG_TRIVIAL(info) << boost::format(
+						"checkpoint of level %1%: %2% bytes, the slowest thread takes %3% seconds (%4%%% of the level)")
+					% (level.get() + 1) % ckpt_bytes.load() % ckpt_time
+					% (ckpt_time * 100 / time_diff(iter_start, curr));
+			}
+			ckpt_bytes = 0;
+		}
 		level.inc(1);
 		struct timeval curr;
 		gettimeofday(&curr, NULL);
@@ -787,7 +988,10 @@ bool graph_engine::progress_next_level()
 
 	// We need to synchronize again. We have to make sure all threads see
 	// the completion signal.
-	rc = pthread_barrier_wait(&barrier2);
+	{
+		prof_timer timer(prof, PROF_IDLE);
+		rc = pthread_barrier_wait(&barrier2);
+	}
 	if(rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD)
 	{
 		BOOST_LOG_TRIVIAL(fatal) << "Could not wait on barrier";
@@ -796,6 +1000,70 @@ bool graph_engine::progress_next_level()
 	return is_complete;
 }
 
+namespace
+{
+
+// The level of the current worker thread in the asynchronous mode.
+// It's -1 in the threads that aren't worker threads.
+__thread int async_thread_level = -1;
+
+}
+
+int graph_engine::get_async_level() const
+{
+	if (async_thread_level >= 0)
+		return async_thread_level;
+	else
+		return level.get();
+}
+
+void graph_engine::set_async_level(int new_level)
+{
+	async_thread_level = new_level;
+	// Outside the worker threads, the level of the graph engine is
+	// the max level that a worker thread has reached.
+	pthread_mutex_lock(&lock);
+	if (new_level > level.get())
+		level = new_level;
+	pthread_mutex_unlock(&lock);
+}
+
+void graph_engine::enter_idle()
+{
+	num_idle_threads.fetch_add(1);
+}
+
+void graph_engine::leave_idle()
+{
+	// The epoch has to change before the thread processes any messages,
+	// so a thread that checks quiescence can notice it.
+	async_epoch.fetch_add(1);
+	num_idle_threads.fetch_sub(1);
+}
+
+/*
+ * A thread becomes idle only after it has flushed all of its messages
+ * and it leaves the idle state only when it finds messages in its queue.
+ * If all threads stay idle while we check the message queues of all
+ * threads, there is nothing left to run.
+ */
+bool graph_engine::check_quiescence()
+{
+	if (is_complete)
+		return true;
+	size_t epoch = async_epoch.load();
+	if (num_idle_threads.load() < get_num_threads())
+		return false;
+	for (size_t i = 0; i < worker_threads.size(); i++)
+		if (!worker_threads[i]->get_msg_processor().get_msg_queue().is_empty())
+			return false;
+	if (async_epoch.load() != epoch
+			|| num_idle_threads.load() < get_num_threads())
+		return false;
+	is_complete = true;
+	return true;
+}
+
 void graph_engine::wait4complete()
 {
 	for (unsigned i = 0; i < worker_threads.size(); i++) {
@@ -808,6 +1076,19 @@ void graph_engine::wait4complete()
 	BOOST_LOG_TRIVIAL(info)
 		<< boost::format("The graph engine takes %1% seconds to complete")
 		% time_diff(start_time, curr);
+	if (combiner) {
+		size_t num_sent = 0;
+		size_t num_combined = 0;
+		BOOST_FOREACH(vertex_program::ptr prog, vprograms) {
+			num_sent += prog->get_num_combiner_msgs();
+			num_combined += prog->get_num_combined_msgs();
+		}
+		BOOST_LOG_TRIVIAL(info)
+			<< boost::format("%1% messages are sent and %2% of them are combined")
+			% num_sent % num_combined;
+	}
+	if (profiler)
+		profiler->print_summary();
 }
 
 void graph_engine::set_vertex_scheduler(vertex_scheduler::ptr scheduler)
@@ -815,6 +1096,56 @@ void graph_engine::set_vertex_scheduler(vertex_scheduler::ptr scheduler)
 	this->scheduler = scheduler;
 }
 
+namespace
+{
+
+struct prio_vertex
+{
+	double priority;
+	compute_vertex_pointer v;
+
+	bool operator<(const prio_vertex &v) const {
+		return priority < v.priority;
+	}
+};
+
+}
+
+void priority_vertex_scheduler::schedule(vertex_program &prog,
+		std::vector<compute_vertex_pointer> &vertices)
+{
+	std::vector<prio_vertex> prio_vertices(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) {
+		prio_vertices[i].v = vertices[i];
+		// The vertically partitioned vertices don't have the user's vertex
+		// state, so they always run first.
+		if (vertices[i].is_part())
+			prio_vertices[i].priority = -INFINITY;
+		else
+			prio_vertices[i].priority = get_priority(prog, *vertices[i]);
+	}
+	std::stable_sort(prio_vertices.begin(), prio_vertices.end());
+	for (size_t i = 0; i < vertices.size(); i++)
+		vertices[i] = prio_vertices[i].v;
+}
+
+size_t priority_vertex_scheduler::get_num_runnable(vertex_program &prog,
+		const std::vector<compute_vertex_pointer> &vertices)
+{
+	// The vertices are sorted on their priorities, so the vertices in
+	// the lowest bucket are at the beginning.
+	size_t i = 0;
+	while (i < vertices.size() && vertices[i].is_part())
+		i++;
+	if (i == vertices.size())
+		return i;
+	long bucket = get_bucket(get_priority(prog, *vertices[i]));
+	for (i++; i < vertices.size(); i++)
+		if (get_bucket(get_priority(prog, *vertices[i])) != bucket)
+			break;
+	return i;
+}
+
 #if 0
 void graph_engine::preload_graph()
 {
@@ -21,16 +21,19 @@
  */
 
 #include <atomic>
+#include <cmath>
 
 #include "vertex.h"
 #include "vertex_index.h"
 #include "trace_logger.h"
+#include "engine_profiler.h"
 #include "messaging.h"
 #include "partitioner.h"
 #include "graph_index.h"
 #include "graph_config.h"
 #include "vertex_request.h"
 #include "vertex_program.h"
+#include "graph_delta.h"
 
 namespace safs
 {
@@ -248,6 +251,56 @@ public:
      */
 	virtual void schedule(vertex_program &prog,
 			std::vector<compute_vertex_pointer> &vertices) = 0;
+
+	/**
+	 * \brief In the asynchronous mode, a worker thread only runs the first
+	 *        part of the scheduled vertices and defers the remaining ones
+	 *        until they are scheduled again with the vertices activated
+	 *        later. This enables priority-based scheduling.
+	 *
+	 *  \param prog the vertex program of the worker thread.
+	 *  \param vertices The vertices in the order defined by `schedule'.
+	 *  \return The number of vertices at the beginning of `vertices' that
+	 *          run now.
+	 */
+	virtual size_t get_num_runnable(vertex_program &prog,
+			const std::vector<compute_vertex_pointer> &vertices) {
+		return vertices.size();
+	}
+};
+
+/**
+ * \brief This scheduler runs vertices in the order of a user-defined
+ *        priority (a smaller value runs first). In the asynchronous mode,
+ *        vertices are grouped into buckets of width `delta' on their
+ *        priority, and a worker thread only runs the vertices in its lowest
+ *        bucket, as delta-stepping does.
+ */
+class priority_vertex_scheduler: public vertex_scheduler
+{
+	double delta;
+
+	long get_bucket(double priority) const {
+		return (long) std::floor(priority / delta);
+	}
+public:
+	priority_vertex_scheduler(double delta) {
+		assert(delta > 0);
+		this->delta = delta;
+	}
+
+	/**
+	 * \brief Get the priority of an activated vertex.
+	 *  \param prog the vertex program of the worker thread.
+	 *  \param v The activated vertex.
+	 */
+	virtual double get_priority(vertex_program &prog,
+			const compute_vertex &v) = 0;
+
+	void schedule(vertex_program &prog,
+			std::vector<compute_vertex_pointer> &vertices);
+	size_t get_num_runnable(vertex_program &prog,
+			const std::vector<compute_vertex_pointer> &vertices);
 };
 
 /**
@@ -323,6 +376,7 @@ public:
 class worker_thread;
 class in_mem_graph;
 class FG_graph;
+class graph_checkpoint;
 
 /**
  * \brief This is the class that coordinates how & where algorithms are run.
@@ -341,6 +395,9 @@ class graph_engine
 	in_mem_query_vertex_index::ptr vindex;
 	std::shared_ptr<in_mem_graph> graph_data;
 	vertex_scheduler::ptr scheduler;
+	vertex_msg_combiner::ptr combiner;
+	// The edge updates merged with the adjacency lists read from the graph.
+	graph_delta::ptr delta;
 
 	// The number of activated vertices that haven't been processed
 	// in the current level.
@@ -348,6 +405,14 @@ class graph_engine
 	atomic_integer level;
 	volatile bool is_complete;
 
+	// In the asynchronous mode, worker threads progress to the next level
+	// independently and the graph engine completes when all worker threads
+	// are idle and there are no messages in flight.
+	bool async_mode;
+	std::atomic<int> num_idle_threads;
+	// It increases every time a worker thread leaves the idle state.
+	std::atomic<size_t> async_epoch;
+
 	// These are used for switching queues.
 	pthread_mutex_t lock;
 	pthread_barrier_t barrier1;
@@ -358,16 +423,32 @@ class graph_engine
 	std::vector<vertex_program::ptr> vprograms;
 
 	trace_logger::ptr logger;
+	// It's NULL if the graph engine isn't profiled.
+	engine_profiler::ptr profiler;
 	std::shared_ptr<safs::file_io_factory> graph_factory;
 	int max_processing_vertices;
 
 	// The time when the current iteration starts.
 	struct timeval start_time, iter_start;
 
+	// The min degree of a vertex to perform vertical partitioning.
+	vsize_t min_vpart_degree;
+
+	// It's NULL if checkpointing is disabled.
+	std::shared_ptr<graph_checkpoint> checkpoint;
+	// The time and the size of writing the current checkpoint.
+	std::vector<float> ckpt_times;
+	std::atomic<size_t> ckpt_bytes;
+	// The state of the driver program stored with checkpoints.
+	std::vector<char> driver_state;
+
+	void init_checkpoint();
+
 	void init_threads(vertex_program_creater::ptr creater);
+	graph_partitioner::ptr create_partitioner(const FG_graph &graph);
 protected:
 	graph_engine(FG_graph &graph, graph_index::ptr index);
-	void init(graph_index::ptr index);
+	void init(graph_index::ptr index, graph_partitioner::ptr partitioner);
 public:
 	typedef std::shared_ptr<graph_engine> ptr; /** Smart pointer for object access.*/
 
@@ -470,6 +551,56 @@ public:
      * \param scheduler The user-defined vertex scheduler.
      */
 	void set_vertex_scheduler(vertex_scheduler::ptr scheduler);
+
+	/**
+	 * \brief Run vertex programs asynchronously. Each worker thread runs
+	 * the vertices activated in its partition as soon as it has processed
+	 * the previous ones instead of waiting for all other threads at the end
+	 * of an iteration, and the graph engine terminates when all threads are
+	 * idle and no messages are in flight. This only works for algorithms
+	 * that converge regardless of the order in which vertices run.
+	 * `get_curr_level' returns the level of the current worker thread and
+	 * vertices are notified at the end of each level of their own thread.
+	 * It has to be set before the graph engine starts.
+	 * \param async Whether to run asynchronously.
+	 */
+	void set_async_mode(bool async) {
+		this->async_mode = async;
+	}
+
+	/**
+	 * \brief Whether the graph engine runs vertex programs asynchronously.
+	 */
+	bool is_async_mode() const {
+		return async_mode;
+	}
+
+	/**
+	 * \brief Merge the point-to-point messages sent to the same vertex
+	 * in the sender side before they are delivered. It has to be set
+	 * before the graph engine starts.
+	 * \param combiner The user-defined message combiner.
+	 */
+	void set_msg_combiner(vertex_msg_combiner::ptr combiner) {
+		this->combiner = combiner;
+	}
+
+	/**
+	 * \brief Get the message combiner used by the graph engine.
+	 * \return The message combiner. It's NULL if messages aren't combined.
+	 */
+	vertex_msg_combiner::ptr get_msg_combiner() const {
+		return combiner;
+	}
+
+	/**
+	 * \brief Get the edge updates merged with the adjacency lists
+	 * read from the graph image.
+	 * \return The edge updates. It's NULL if the graph doesn't have any.
+	 */
+	const graph_delta *get_graph_delta() const {
+		return delta.get();
+	}
     
     /**
      * \brief Start the graph engine and begin computation on a subset of vertices.
@@ -506,6 +637,46 @@ public:
 	void start_all(vertex_initializer::ptr init = vertex_initializer::ptr(),
 			vertex_program_creater::ptr creater = vertex_program_creater::ptr());
     
+	/**
+	 * \brief Resume the graph algorithm from the last checkpoint. The vertex
+	 * state is restored and the vertices active in the checkpoint run in
+	 * the level where the checkpoint was taken. The state in the vertex
+	 * programs isn't part of a checkpoint.
+	 *
+	 * The vertex state is saved and restored as raw bytes, so a vertex
+	 * type that holds pointers, e.g., to memory allocated by the vertex,
+	 * can't be resumed in another process.
+	 * \param creater A creator that creates user-defined vertex program.
+	 * \return false if there isn't a checkpoint to resume from.
+	 */
+	bool resume(vertex_program_creater::ptr creater = vertex_program_creater::ptr());
+
+	/**
+	 * \brief Checkpoint the vertex state between two runs of the graph
+	 * engine. It's used by a graph algorithm that runs the graph engine
+	 * many times. When it's resumed, no vertices are active, and
+	 * the algorithm continues with its next run.
+	 * \param driver_state The state that the algorithm needs to continue,
+	 * e.g., the stage of the algorithm. It's also stored with
+	 * the checkpoints taken in the following runs.
+	 * \return false if checkpointing is disabled.
+	 */
+	bool save_checkpoint(const std::vector<char> &driver_state);
+
+	/**
+	 * \brief Set the driver state stored with the checkpoints taken in
+	 * the following runs.
+	 */
+	void set_driver_state(const std::vector<char> &state) {
+		driver_state = state;
+	}
+
+	/**
+	 * \brief Get the driver state stored with the last checkpoint.
+	 * \return false if there isn't a checkpoint to resume from.
+	 */
+	bool get_checkpoint_driver_state(std::vector<char> &state) const;
+
     /**
      * \brief Synchronization barrier that waits for the graph algorithm to
 	 *        complete.
@@ -555,6 +726,8 @@ public:
      * \return The current iteration number.
 	 */
 	int get_curr_level() const {
+		if (async_mode)
+			return get_async_level();
 		return level.get();
 	}
 
@@ -574,12 +747,42 @@ public:
 	 */
 	bool progress_next_level();
 	bool progress_first_level();
+
+	/**
+	 * \internal
+	 * These are used by worker threads to checkpoint their partitions
+	 * at the end of a level.
+	 */
+	bool need_checkpoint() const;
+	void checkpoint_part(int part_id, const std::vector<vertex_id_t> &local_ids);
+
+	/**
+	 * \internal
+	 * These are used by worker threads in the asynchronous mode.
+	 */
+	int get_async_level() const;
+	void set_async_level(int level);
+	void enter_idle();
+	void leave_idle();
+	int get_num_idle_threads() const {
+		return num_idle_threads.load();
+	}
+	/*
+	 * It returns true if all worker threads are idle and no messages
+	 * are in flight.
+	 */
+	bool check_quiescence();
     
     /** \internal*/
 	trace_logger::ptr get_logger() const {
 		return logger;
 	}
 
+	/** \internal*/
+	engine_profiler::ptr get_profiler() const {
+		return profiler;
+	}
+
 	/**
      * \internal
 	 * Get the file id where the graph data is stored.
@@ -595,6 +798,11 @@ public:
 	int get_num_threads() const {
 		return worker_threads.size();
 	}
+
+    /**\internal */
+	int get_num_nodes() const {
+		return num_nodes;
+	}
     
     /**\internal */
 	worker_thread *get_thread(int idx) const {
@@ -643,6 +851,16 @@ public:
 		return out_part_off;
 	}
 
+	/**
+	 * \internal
+	 * The min degree of a vertex to perform vertical partitioning.
+	 * It may be smaller than the one in the configuration if hub vertices
+	 * are split by the edge-balanced partitioner.
+	 */
+	vsize_t get_min_vpart_degree() const {
+		return min_vpart_degree;
+	}
+
 	vsize_t cal_num_edges(vsize_t vertex_size) const {
 		return ext_mem_undirected_vertex::vsize2num_edges(vertex_size,
 				header.get_edge_data_size());
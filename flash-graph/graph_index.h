@@ -21,6 +21,7 @@
  */
 
 #include <algorithm>
+#include <type_traits>
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
 
@@ -86,7 +87,12 @@ public:
 	virtual ~graph_index() {
 	}
 
-	virtual void init(int num_threads, int num_nodes) {
+	/*
+	 * Construct the vertex state of the graph. If a partitioner isn't
+	 * provided, vertices are partitioned with range_graph_partitioner.
+	 */
+	virtual void init(int num_threads, int num_nodes,
+			graph_partitioner::ptr partitioner = graph_partitioner::ptr()) {
 	}
 	virtual void init_vparts(int hpart_id, int num_vparts,
 			std::vector<vertex_id_t> &ids) = 0;
@@ -126,6 +132,18 @@ public:
 	virtual vertex_id_t get_vertex_id(int part_id, compute_vertex_pointer v) const = 0;
 	virtual vertex_id_t get_vertex_id(const compute_vertex &v) const = 0;
 	virtual bool belong2part(const compute_vertex &v, int part_id) const = 0;
+
+	/*
+	 * The interface of accessing the raw vertex state for checkpoints.
+	 * The size of a vertex is 0 if the vertex state can't be copied as
+	 * raw bytes.
+	 */
+	virtual size_t get_vertex_size() const {
+		return 0;
+	}
+	virtual std::pair<char *, size_t> get_part_data(int part_id) {
+		return std::pair<char *, size_t>(NULL, 0);
+	}
 };
 
 template<class vertex_type, class part_vertex_type>
@@ -318,7 +336,7 @@ class NUMA_graph_index: public graph_index
 	graph_header header;
 	vertex_id_t max_vertex_id;
 	vertex_id_t min_vertex_id;
-	std::unique_ptr<range_graph_partitioner> partitioner;
+	graph_partitioner::ptr partitioner;
 	// A graph index per thread
 	std::vector<std::unique_ptr<graph_local_partition<vertex_type, part_vertex_type> > > index_arr;
 
@@ -344,9 +362,15 @@ public:
 		return graph_index::ptr(index);
 	}
 
-	void init(int num_threads, int num_nodes) {
-		partitioner = std::unique_ptr<range_graph_partitioner>(
-				new range_graph_partitioner(num_threads));
+	void init(int num_threads, int num_nodes,
+			graph_partitioner::ptr partitioner = graph_partitioner::ptr()) {
+		if (partitioner) {
+			assert(partitioner->get_num_partitions() == num_threads);
+			this->partitioner = partitioner;
+		}
+		else
+			this->partitioner = graph_partitioner::ptr(
+					new range_graph_partitioner(num_threads));
 
 		// Construct the indices.
 		for (int i = 0; i < num_threads; i++) {
@@ -354,7 +378,7 @@ public:
 						// The partitions are assigned to worker threads.
 						// The memory used to store the partitions should
 						// be on the same NUMA as the worker threads.
-						*partitioner, i, i % num_nodes,
+						*this->partitioner, i, i % num_nodes,
 						header.get_num_vertices()));
 		}
 
@@ -490,6 +514,21 @@ public:
 		// TODO there might be a more light-weight implementation.
 		return get_vertex_id(part_id, v) != INVALID_VERTEX_ID;
 	}
+
+	virtual size_t get_vertex_size() const {
+		if (std::is_trivially_copyable<vertex_type>::value)
+			return sizeof(vertex_type);
+		else
+			return 0;
+	}
+
+	virtual std::pair<char *, size_t> get_part_data(int part_id) {
+		// Copying the raw bytes of other vertex types corrupts them.
+		if (!std::is_trivially_copyable<vertex_type>::value)
+			return std::pair<char *, size_t>(NULL, 0);
+		return std::pair<char *, size_t>((char *) index_arr[part_id]->vertex_arr,
+				sizeof(vertex_type) * index_arr[part_id]->get_num_vertices());
+	}
 };
 
 #if 0
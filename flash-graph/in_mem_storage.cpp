@@ -19,6 +19,9 @@
 
 #include <stdlib.h>
 #include <malloc.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
 
 #include <boost/format.hpp>
 
@@ -58,11 +61,9 @@ in_mem_graph::ptr in_mem_graph::create(const std::string &graph_name,
 	return create(graph_name, buf, size);
 }
 
-in_mem_graph::ptr in_mem_graph::load_graph(const std::string &file_name)
+in_mem_graph::ptr in_mem_graph::create_graph(safs::NUMA_buffer::ptr numa_buf,
+		const std::string &file_name)
 {
-	NUMA_mapper mapper(params.get_num_nodes(), GRAPH_CHUNK_SIZE_LOG);
-	safs::NUMA_buffer::ptr numa_buf = safs::NUMA_buffer::load(file_name, mapper);
-	assert(numa_buf);
 	in_mem_graph::ptr graph = in_mem_graph::ptr(new in_mem_graph());
 	graph->graph_size = numa_buf->get_length();
 	graph->graph_data = numa_buf;
@@ -78,6 +79,36 @@ in_mem_graph::ptr in_mem_graph::load_graph(const std::string &file_name)
 	return graph;
 }
 
+in_mem_graph::ptr in_mem_graph::load_graph(const std::string &file_name)
+{
+	NUMA_mapper mapper(params.get_num_nodes(), GRAPH_CHUNK_SIZE_LOG);
+	safs::NUMA_buffer::ptr numa_buf = safs::NUMA_buffer::load(file_name, mapper);
+	assert(numa_buf);
+	return create_graph(numa_buf, file_name);
+}
+
+in_mem_graph::ptr in_mem_graph::load_shared_graph(const std::string &file_name,
+		const std::string &shm_file)
+{
+	NUMA_mapper mapper(params.get_num_nodes(), GRAPH_CHUNK_SIZE_LOG);
+	safs::NUMA_buffer::ptr numa_buf = safs::NUMA_buffer::load_shared(file_name,
+			shm_file, mapper);
+	return create_graph(numa_buf, file_name);
+}
+
+in_mem_graph::ptr in_mem_graph::attach_shared_graph(const std::string &shm_file)
+{
+	safs::NUMA_buffer::ptr numa_buf = safs::NUMA_buffer::attach_shared(shm_file);
+	return create_graph(numa_buf, shm_file);
+}
+
+void in_mem_graph::remove_shared_graph(const std::string &shm_file)
+{
+	if (unlink(shm_file.c_str()) < 0)
+		BOOST_LOG_TRIVIAL(error) << boost::format("can't remove %1%: %2%")
+			% shm_file % strerror(errno);
+}
+
 in_mem_graph::ptr in_mem_graph::load_safs_graph(const std::string &file_name)
 {
 	NUMA_mapper mapper(params.get_num_nodes(), GRAPH_CHUNK_SIZE_LOG);
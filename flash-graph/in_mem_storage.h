@@ -44,6 +44,9 @@ class in_mem_graph
 		graph_size = 0;
 		graph_file_id = -1;
 	}
+
+	static std::shared_ptr<in_mem_graph> create_graph(
+			safs::NUMA_buffer::ptr buf, const std::string &graph_file);
 public:
 	typedef std::shared_ptr<in_mem_graph> ptr;
 
@@ -66,6 +69,16 @@ public:
 
 	static ptr load_graph(const std::string &graph_file);
 	static ptr load_safs_graph(const std::string &graph_file);
+	/*
+	 * Load the graph to shared memory in `shm_file', which is in a memory
+	 * filesystem such as /dev/shm or a hugetlbfs mount point. If another
+	 * process has loaded the graph there, we attach to it read-only instead.
+	 * The graph stays in memory until `remove_shared_graph' is called.
+	 */
+	static ptr load_shared_graph(const std::string &graph_file,
+			const std::string &shm_file);
+	static ptr attach_shared_graph(const std::string &shm_file);
+	static void remove_shared_graph(const std::string &shm_file);
 
 	void dump(const std::string &file) const;
 
@@ -0,0 +1,456 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "graph_engine.h"
+#include "graph_config.h"
+#include "FG_vector.h"
+#include "FGlib.h"
+
+using namespace fg;
+
+/*
+ * This estimates triangles and local scan with wedge sampling.
+ *
+ * A wedge of vertex v is a pair of neighbors of v. If the two neighbors
+ * are connected, the wedge is closed and forms a triangle with v. A vertex
+ * samples `num_wedges' wedges uniformly, reads the adjacency list of
+ * the endpoint with the smaller degree of each wedge and checks whether
+ * it's connected to the other endpoint. The number of edges among
+ * the neighbors of v is estimated by the fraction of closed wedges times
+ * the number of wedges of v. If v has no more wedges than `num_wedges',
+ * all of its wedges are checked and the result is exact.
+ *
+ * Only the adjacency lists of the sampled vertices and of the endpoints of
+ * their sampled wedges are read.
+ */
+
+namespace
+{
+
+int num_wedges;
+bool directed;
+uint64_t sample_seed;
+
+/*
+ * A pseudo-random number generator that is cheap to create, so every vertex
+ * can have its own generator, and the samples don't depend on the order of
+ * processing vertices.
+ */
+class splitmix64
+{
+	uint64_t state;
+public:
+	splitmix64(uint64_t seed) {
+		state = seed;
+	}
+
+	uint64_t next() {
+		uint64_t z = (state += 0x9E3779B97F4A7C15UL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9UL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBUL;
+		return z ^ (z >> 31);
+	}
+
+	// A random number in [0, 1).
+	double next_double() {
+		return (next() >> 11) * (1.0 / (1UL << 53));
+	}
+};
+
+/*
+ * Keep each vertex with probability `rate'.
+ */
+class bernoulli_filter: public vertex_filter
+{
+	double rate;
+public:
+	bernoulli_filter(double rate) {
+		this->rate = rate;
+	}
+
+	bool keep(vertex_program &prog, compute_vertex &v) {
+		vertex_id_t id = prog.get_vertex_id(v);
+		return splitmix64(sample_seed ^ (id * 0x2545F4914F6CDD1DUL)).next_double()
+			< rate;
+	}
+};
+
+struct wedge_data
+{
+	// The edges of the vertex itself.
+	size_t num_own_edges;
+	// The number of wedges of the vertex.
+	double num_pairs;
+	// All wedges are checked.
+	bool exact;
+	// The wedges to check. The first vertex of a wedge is the endpoint whose
+	// adjacency list is read, the second one is checked in the list.
+	std::vector<std::pair<vertex_id_t, vertex_id_t> > wedges;
+	// The endpoints whose adjacency lists are requested.
+	std::vector<vertex_id_t> reqs;
+	size_t num_joined;
+	// The sum and the sum of squares of the number of edges in the wedges.
+	double sum;
+	double sum_sq;
+
+	wedge_data() {
+		num_own_edges = 0;
+		num_pairs = 0;
+		exact = false;
+		num_joined = 0;
+		sum = 0;
+		sum_sq = 0;
+	}
+};
+
+class wedge_vertex: public compute_vertex
+{
+	wedge_data *data;
+	// The estimated number of edges among the neighbors.
+	float est;
+	// The variance of the estimate from wedge sampling.
+	float var;
+	vsize_t num_own_edges;
+
+	void finalize();
+public:
+	wedge_vertex(vertex_id_t id): compute_vertex(id) {
+		data = NULL;
+		est = 0;
+		var = 0;
+		num_own_edges = 0;
+	}
+
+	double get_est() const {
+		return est;
+	}
+
+	double get_var() const {
+		return var;
+	}
+
+	double get_est_scan() const {
+		return num_own_edges + est;
+	}
+
+	void run(vertex_program &prog) {
+		vertex_id_t id = prog.get_vertex_id(*this);
+		request_vertices(&id, 1);
+	}
+
+	void run(vertex_program &prog, const page_vertex &vertex) {
+		if (vertex.get_id() == prog.get_vertex_id(*this))
+			run_on_itself(prog, vertex);
+		else
+			run_on_neighbor(prog, vertex);
+	}
+
+	void run_on_itself(vertex_program &prog, const page_vertex &vertex);
+	void run_on_neighbor(vertex_program &prog, const page_vertex &vertex);
+
+	void run_on_message(vertex_program &prog, const vertex_message &msg) {
+	}
+};
+
+/*
+ * Get the unique neighbors of a vertex, excluding itself.
+ */
+void get_neighbors(const page_vertex &vertex, std::vector<vertex_id_t> &neighs)
+{
+	std::vector<vertex_id_t> out(vertex.get_num_edges(edge_type::OUT_EDGE));
+	vertex.read_edges(edge_type::OUT_EDGE, out.data(), out.size());
+	if (directed) {
+		std::vector<vertex_id_t> in(vertex.get_num_edges(edge_type::IN_EDGE));
+		vertex.read_edges(edge_type::IN_EDGE, in.data(), in.size());
+		neighs.resize(in.size() + out.size());
+		std::merge(in.begin(), in.end(), out.begin(), out.end(),
+				neighs.begin());
+	}
+	else
+		neighs.swap(out);
+	neighs.erase(std::unique(neighs.begin(), neighs.end()), neighs.end());
+	neighs.erase(std::remove(neighs.begin(), neighs.end(), vertex.get_id()),
+			neighs.end());
+}
+
+void wedge_vertex::run_on_itself(vertex_program &prog, const page_vertex &vertex)
+{
+	vertex_id_t id = vertex.get_id();
+	num_own_edges = vertex.get_num_edges(directed
+			? edge_type::BOTH_EDGES : edge_type::OUT_EDGE);
+	std::vector<vertex_id_t> neighs;
+	get_neighbors(vertex, neighs);
+	size_t degree = neighs.size();
+	if (degree < 2)
+		return;
+
+	data = new wedge_data();
+	data->num_pairs = ((double) degree) * (degree - 1) / 2;
+	data->exact = data->num_pairs <= num_wedges;
+	if (data->exact) {
+		data->wedges.reserve(data->num_pairs);
+		for (size_t i = 0; i < degree; i++)
+			for (size_t j = i + 1; j < degree; j++)
+				data->wedges.push_back(std::pair<vertex_id_t, vertex_id_t>(
+							neighs[i], neighs[j]));
+	}
+	else {
+		splitmix64 gen(sample_seed + id);
+		data->wedges.reserve(num_wedges);
+		for (int i = 0; i < num_wedges; i++) {
+			size_t idx1 = gen.next() % degree;
+			size_t idx2 = gen.next() % (degree - 1);
+			if (idx2 >= idx1)
+				idx2++;
+			data->wedges.push_back(std::pair<vertex_id_t, vertex_id_t>(
+						neighs[idx1], neighs[idx2]));
+		}
+	}
+	// We read the adjacency list of the endpoint with the smaller degree.
+	for (size_t i = 0; i < data->wedges.size(); i++) {
+		std::pair<vertex_id_t, vertex_id_t> &w = data->wedges[i];
+		vsize_t degree1 = prog.get_num_edges(w.first);
+		vsize_t degree2 = prog.get_num_edges(w.second);
+		if (degree2 < degree1 || (degree2 == degree1 && w.second < w.first))
+			std::swap(w.first, w.second);
+	}
+	std::sort(data->wedges.begin(), data->wedges.end());
+	for (size_t i = 0; i < data->wedges.size(); i++)
+		if (data->reqs.empty() || data->reqs.back() != data->wedges[i].first)
+			data->reqs.push_back(data->wedges[i].first);
+	request_vertices(data->reqs.data(), data->reqs.size());
+}
+
+void wedge_vertex::run_on_neighbor(vertex_program &prog, const page_vertex &vertex)
+{
+	assert(data);
+	static thread_local std::vector<vertex_id_t> out;
+	static thread_local std::vector<vertex_id_t> in;
+	out.resize(vertex.get_num_edges(edge_type::OUT_EDGE));
+	vertex.read_edges(edge_type::OUT_EDGE, out.data(), out.size());
+	if (directed) {
+		in.resize(vertex.get_num_edges(edge_type::IN_EDGE));
+		vertex.read_edges(edge_type::IN_EDGE, in.data(), in.size());
+	}
+
+	std::pair<vertex_id_t, vertex_id_t> key(vertex.get_id(), 0);
+	std::vector<std::pair<vertex_id_t, vertex_id_t> >::const_iterator it
+		= std::lower_bound(data->wedges.begin(), data->wedges.end(), key);
+	for (; it != data->wedges.end() && it->first == vertex.get_id(); it++) {
+		// The number of edges between the two endpoints.
+		int num = std::binary_search(out.begin(), out.end(), it->second);
+		if (directed)
+			num += std::binary_search(in.begin(), in.end(), it->second);
+		data->sum += num;
+		data->sum_sq += num * num;
+	}
+	data->num_joined++;
+	if (data->num_joined == data->reqs.size())
+		finalize();
+}
+
+void wedge_vertex::finalize()
+{
+	if (data->exact) {
+		est = data->sum;
+		var = 0;
+	}
+	else {
+		double k = data->wedges.size();
+		double mean = data->sum / k;
+		double sample_var = std::max(0.0, (data->sum_sq - k * mean * mean)
+				/ (k - 1));
+		est = data->num_pairs * mean;
+		var = data->num_pairs * data->num_pairs * sample_var / k;
+	}
+	delete data;
+	data = NULL;
+}
+
+/*
+ * This sums the estimates of the sampled vertices and the variance of
+ * the Horvitz-Thompson estimator of the total.
+ */
+class sum_query: public vertex_query
+{
+	double rate;
+	double sum;
+	double var;
+public:
+	sum_query(double rate) {
+		this->rate = rate;
+		sum = 0;
+		var = 0;
+	}
+
+	virtual void run(graph_engine &graph, compute_vertex &v1) {
+		wedge_vertex &v = (wedge_vertex &) v1;
+		double est = v.get_est();
+		sum += est / rate;
+		// The variance from vertex sampling and from wedge sampling.
+		var += (1 - rate) / (rate * rate) * est * est
+			+ v.get_var() / (rate * rate);
+	}
+
+	virtual void merge(graph_engine &graph, vertex_query::ptr q) {
+		sum_query *other = (sum_query *) q.get();
+		sum += other->sum;
+		var += other->var;
+	}
+
+	virtual ptr clone() {
+		return vertex_query::ptr(new sum_query(rate));
+	}
+
+	double get_sum() const {
+		return sum;
+	}
+
+	double get_var() const {
+		return var;
+	}
+};
+
+}
+
+namespace fg
+{
+
+approx_value approx_undirected_triangles(FG_graph::ptr fg, double sample_rate,
+		int num_wedges, uint64_t seed)
+{
+	directed = fg->get_graph_header().is_directed_graph();
+	if (directed) {
+		BOOST_LOG_TRIVIAL(error)
+			<< "This algorithm counts triangles in an undirected graph";
+		return approx_value();
+	}
+	if (sample_rate <= 0 || sample_rate > 1 || num_wedges < 2) {
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"Invalid sample rate (%1%) or number of wedges (%2%)")
+			% sample_rate % num_wedges;
+		return approx_value();
+	}
+	::num_wedges = num_wedges;
+	sample_seed = seed;
+
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"approximate triangle counting starts on %1% of vertices with %2% wedges per vertex")
+		% sample_rate % num_wedges;
+	graph_index::ptr index = NUMA_graph_index<wedge_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	if (sample_rate < 1)
+		graph->start(std::shared_ptr<vertex_filter>(
+					new bernoulli_filter(sample_rate)));
+	else
+		graph->start_all();
+	graph->wait4complete();
+	gettimeofday(&end, NULL);
+
+	std::shared_ptr<sum_query> query(new sum_query(sample_rate));
+	graph->query_on_all(query);
+	// Each triangle is counted by its three vertices.
+	approx_value ret(query->get_sum() / 3,
+			1.96 * sqrt(query->get_var()) / 3);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"It takes %1% seconds to estimate %2% +/- %3% triangles")
+		% time_diff(start, end) % ret.value % ret.error;
+	return ret;
+}
+
+FG_vector<std::pair<vertex_id_t, approx_value> >::ptr approx_topK_scan(
+		FG_graph::ptr fg, size_t topK, size_t num_candidates, int num_wedges,
+		uint64_t seed)
+{
+	typedef std::pair<vertex_id_t, approx_value> approx_scan;
+	if (num_wedges < 2) {
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"Invalid number of wedges (%1%)") % num_wedges;
+		return FG_vector<approx_scan>::ptr();
+	}
+	directed = fg->get_graph_header().is_directed_graph();
+	::num_wedges = num_wedges;
+	sample_seed = seed;
+
+	graph_index::ptr index = NUMA_graph_index<wedge_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	num_candidates = std::min(std::max(num_candidates, topK),
+			graph->get_num_vertices());
+	topK = std::min(topK, num_candidates);
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	// The local scan of a vertex is bounded by its degree, so we only
+	// estimate the local scan of the vertices with the largest degree.
+	// The degree is kept in memory, so this doesn't read adjacency lists.
+	std::vector<std::pair<vsize_t, vertex_id_t> > degrees(
+			graph->get_num_vertices());
+#pragma omp parallel for
+	for (size_t i = 0; i < degrees.size(); i++)
+		degrees[i] = std::pair<vsize_t, vertex_id_t>(graph->get_num_edges(i),
+				i);
+	std::nth_element(degrees.begin(), degrees.begin() + num_candidates,
+			degrees.end(), std::greater<std::pair<vsize_t, vertex_id_t> >());
+	std::vector<vertex_id_t> candidates(num_candidates);
+	for (size_t i = 0; i < num_candidates; i++)
+		candidates[i] = degrees[i].second;
+	degrees.clear();
+
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"approximate scan statistics starts on %1% candidates with %2% wedges per vertex")
+		% num_candidates % num_wedges;
+	graph->start(candidates.data(), candidates.size());
+	graph->wait4complete();
+	gettimeofday(&end, NULL);
+
+	std::vector<approx_scan> scans(num_candidates);
+	for (size_t i = 0; i < num_candidates; i++) {
+		wedge_vertex &v = (wedge_vertex &) graph->get_vertex(candidates[i]);
+		scans[i] = approx_scan(candidates[i], approx_value(v.get_est_scan(),
+					1.96 * sqrt(v.get_var())));
+	}
+	class greater_scan {
+	public:
+		bool operator()(const approx_scan &s1, const approx_scan &s2) const {
+			return s1.second.value > s2.second.value;
+		}
+	};
+	std::partial_sort(scans.begin(), scans.begin() + topK, scans.end(),
+			greater_scan());
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("It takes %1% seconds for approximate top %2%")
+		% time_diff(start, end) % topK;
+
+	FG_vector<approx_scan>::ptr vec = FG_vector<approx_scan>::create(topK);
+	for (size_t i = 0; i < topK; i++)
+		vec->set(i, scans[i]);
+	return vec;
+}
+
+}
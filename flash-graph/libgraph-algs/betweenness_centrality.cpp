@@ -21,6 +21,7 @@
 #endif
 
 #include <vector>
+#include <unordered_map>
 
 #include "thread.h"
 #include "io_interface.h"
@@ -33,14 +34,24 @@
 #include "FGlib.h"
 #include "FG_vector.h"
 #include "save_result.h"
+#include "ms_bfs.h"
 
 using namespace fg;
 
+/*
+ * This computes betweenness centrality with Brandes' algorithm. It runs
+ * the BFS from a batch of source vertices at the same time with MS-BFS,
+ * so a vertex reads its edges once in a level for all BFS in the batch.
+ * The back propagation of the batch is also done together in the reverse
+ * order of the levels.
+ */
+
 namespace {
+// The max distance of the BFS in the current batch.
 short bfs_max_dist;
+// The number of BFS in the current batch.
+int num_sources;
 
-/* `update` phase is where BC is updated */ 
-vertex_id_t g_source_vertex;
 enum btwn_phase_t
 {
 	bfs,
@@ -50,110 +61,251 @@ enum btwn_phase_t
 
 btwn_phase_t g_alg_phase = bfs;
 
-class betweenness_vertex: public compute_directed_vertex
+/*
+ * The state of a vertex in a BFS.
+ */
+struct source_state
 {
-	float btwn_cent; // per-vertex btwn_cent
+	// The number of shortest paths from the source.
+	float sigma;
+	// The dependency of the source on the vertex.
 	float delta;
-	int sigma;
+	// The distance from the source.
 	short dist;
-	bool bfs_visited;
+};
+
+/*
+ * The per-BFS state of a vertex is only allocated when the vertex is
+ * reached by a BFS, but a batch of S BFS can reach all V vertices, so it
+ * takes O(V * S) memory in the worst case. The state is allocated in large
+ * chunks from a pool of the thread that owns the vertex and all of it is
+ * released at once when a batch completes, instead of allocating a small
+ * array on the heap for every vertex.
+ */
+class source_state_pool
+{
+	static const size_t CHUNK_SIZE = 64 * 1024;
+
+	std::vector<source_state *> chunks;
+	// The number of states used in the last chunk.
+	size_t num_used;
+public:
+	source_state_pool() {
+		num_used = CHUNK_SIZE;
+	}
 
+	~source_state_pool() {
+		clear();
+	}
+
+	source_state *alloc(int num) {
+		assert((size_t) num <= CHUNK_SIZE);
+		if (num_used + num > CHUNK_SIZE) {
+			chunks.push_back(new source_state[CHUNK_SIZE]);
+			num_used = 0;
+		}
+		source_state *ret = chunks.back() + num_used;
+		num_used += num;
+		return ret;
+	}
+
+	void clear() {
+		for (size_t i = 0; i < chunks.size(); i++)
+			delete [] chunks[i];
+		chunks.clear();
+		num_used = CHUNK_SIZE;
+	}
+};
+
+// A pool for each partition. Only the thread of a partition allocates
+// from its pool.
+std::vector<std::unique_ptr<source_state_pool> > pools;
+
+/*
+ * A message that carries a value for each BFS in a bitmap. Only the values
+ * of the BFS whose bits are set are stored, packed in the order of
+ * the BFS IDs, so the message size depends on the number of BFS in it.
+ * A message is constructed in a buffer of `get_max_size()' bytes and
+ * the values are added in ascending order of the BFS IDs.
+ */
+template<int NUM_WORDS>
+class source_value_message: public vertex_message
+{
+	template<class Func>
+	class value_iterator
+	{
+		const float *vals;
+		Func &func;
 	public:
-	betweenness_vertex(vertex_id_t id): compute_directed_vertex(id) {
-		btwn_cent = 0;
-		delta = 0; 
-		sigma = 0 ;
-		dist = -1; 
-		bfs_visited = false;
+		value_iterator(const float *vals, Func &_func): func(_func) {
+			this->vals = vals;
+		}
+
+		void operator()(int bfs_id) {
+			func(bfs_id, *vals);
+			vals++;
+		}
+	};
+
+	source_bitmap<NUM_WORDS> bfs_ids;
+	float vals[0];
+public:
+	static int get_max_size() {
+		return sizeof(source_value_message<NUM_WORDS>)
+			+ source_bitmap<NUM_WORDS>::NUM_BITS * sizeof(float);
 	}
 
-	void init(int sigma, short dist) {
-		this->sigma = sigma;
-		this->dist = dist;	
-		this->delta = 0;
-		this->bfs_visited = false;
+	source_value_message(bool activate): vertex_message(
+			sizeof(source_value_message<NUM_WORDS>), activate) {
 	}
 
-	// Used for save_query join
-	float get_result() const {
-		return btwn_cent;
+	void add(int bfs_id, float val) {
+		assert(!bfs_ids.test(bfs_id));
+		int num_vals = (get_serialized_size()
+				- sizeof(source_value_message<NUM_WORDS>)) / sizeof(float);
+		vals[num_vals] = val;
+		bfs_ids.set(bfs_id);
+		size += sizeof(float);
 	}
 
-	short get_dist() const {
-		return dist;
+	const source_bitmap<NUM_WORDS> &get_bfs_ids() const {
+		return bfs_ids;
 	}
 
-	void set_dist(short dist) {
-		this->dist = dist;
+	/*
+	 * Invoke the function on each BFS in the message and its value.
+	 */
+	template<class Func>
+	void for_each(Func &func) const {
+		value_iterator<Func> it(vals, func);
+		bfs_ids.for_each(it);
 	}
+};
 
-	void set_sigma(int sigma) {
-		this->sigma = sigma;
+/*
+ * For each BFS that visits the sender in the current level, the BFS message
+ * contains the sigma of the sender.
+ */
+template<int NUM_WORDS>
+class bfs_message: public source_value_message<NUM_WORDS>
+{
+public:
+	bfs_message(): source_value_message<NUM_WORDS>(true) {
 	}
+};
 
-	bool is_bfs_visited() const {
-		return bfs_visited;
-	} 
-	void set_visited(bool visited) {
-		this->bfs_visited = visited;
+/*
+ * Back propagate message. For each BFS where the sender is in the current
+ * level, it contains (1 + delta) / sigma of the sender.
+ */
+template<int NUM_WORDS>
+class bp_message: public source_value_message<NUM_WORDS>
+{
+public:
+	bp_message(): source_value_message<NUM_WORDS>(false) {
+	}
+};
+
+template<int NUM_WORDS>
+class betweenness_vertex: public compute_directed_vertex
+{
+	float btwn_cent; // per-vertex btwn_cent
+	ms_bfs_state<NUM_WORDS> state;
+	// The state of the vertex in each BFS of the batch. It's only allocated
+	// when the vertex is reached by a BFS.
+	source_state *sources;
+
+	void alloc_sources(int part_id) {
+		if (sources)
+			return;
+		sources = pools[part_id]->alloc(num_sources);
+		for (int i = 0; i < num_sources; i++) {
+			sources[i].sigma = 0;
+			sources[i].delta = 0;
+			sources[i].dist = -1;
+		}
+	}
+
+	// The memory is released with the pools at the end of a batch.
+	void free_sources() {
+		sources = NULL;
+	}
+
+	void run_bfs(vertex_program &prog, const page_vertex &vertex);
+	void run_back_prop(vertex_program &prog, const page_vertex &vertex);
+public:
+	betweenness_vertex(vertex_id_t id): compute_directed_vertex(id) {
+		btwn_cent = 0;
+		sources = NULL;
+	}
+
+	void reset() {
+		state.reset();
+		free_sources();
+	}
+
+	void init_source(int bfs_id, int part_id) {
+		alloc_sources(part_id);
+		state.init_source(bfs_id);
+		sources[bfs_id].sigma = 1;
+		sources[bfs_id].dist = 0;
+	}
+
+	// Used for save_query join
+	float get_result() const {
+		return btwn_cent;
 	}
 
 	void run(vertex_program &prog);
-	void run(vertex_program &prog, const page_vertex &vertex);
+	void run(vertex_program &prog, const page_vertex &vertex) {
+		if (g_alg_phase == btwn_phase_t::bfs)
+			run_bfs(prog, vertex);
+		else
+			run_back_prop(prog, vertex);
+	}
 	void run_on_message(vertex_program &, const vertex_message &msg1);
+	void notify_iteration_end(vertex_program &prog);
 };
 
 typedef std::shared_ptr<std::vector<vertex_id_t> > vertex_set_ptr;
 // Store activated vertex IDs per iteration in the bfs phase
 typedef std::map<int, std::vector<vertex_set_ptr> > vertex_map_t;
 
-class bfs_vertex_program: public vertex_program_impl<betweenness_vertex>
+template<int NUM_WORDS>
+class bfs_vertex_program: public vertex_program_impl<betweenness_vertex<NUM_WORDS> >
 {
-	std::vector<vertex_set_ptr> bfs_visited_vertices; // Vertex set visited from this thread
-	short max_dist; // Keep track of max dist so we can activate greatest when bp-ing
+	// The vertices reached by the BFS in each level in this thread.
+	// A vertex can be reached by different BFS in multiple levels.
+	std::vector<vertex_set_ptr> bfs_visited_vertices;
 	public:
-	bfs_vertex_program() {
-		max_dist = 0;
-	}
-
-	typedef std::shared_ptr<bfs_vertex_program> ptr;
+	typedef std::shared_ptr<bfs_vertex_program<NUM_WORDS> > ptr;
 
 	static ptr cast2(vertex_program::ptr prog) {
-		return std::static_pointer_cast<bfs_vertex_program, vertex_program>(prog);
-	}
-
-	void add_visited_bfs(vertex_id_t vid) {
-		max_dist = get_graph().get_curr_level();
-		// BOOST_LOG_TRIVIAL(info) << "The current per thread max_dist is " << max_dist << "\n";
-		assert(max_dist == ((short)bfs_visited_vertices.size()) - 1);
-		bfs_visited_vertices.back()->push_back(vid);
+		return std::static_pointer_cast<bfs_vertex_program<NUM_WORDS>,
+			   vertex_program>(prog);
 	}
 
-	virtual void run_on_engine_start() {
-		bfs_visited_vertices.push_back(vertex_set_ptr(
-					new std::vector<vertex_id_t>()));
-	}
-
-	virtual void run_on_iteration_end() {
-		bfs_visited_vertices.push_back(vertex_set_ptr(
-					new std::vector<vertex_id_t>()));
+	void add_visited_bfs(vertex_id_t vid, short dist) {
+		while ((short) bfs_visited_vertices.size() <= dist)
+			bfs_visited_vertices.push_back(vertex_set_ptr(
+						new std::vector<vertex_id_t>()));
+		bfs_visited_vertices[dist]->push_back(vid);
 	}
 
 	void collect_vertices(vertex_map_t &vertices) {
-		vertex_map_t::const_iterator it = vertices.find(get_partition_id());
-		if (it != vertices.end())
-			BOOST_LOG_TRIVIAL(info) << "part" << it->first << "already exists";
+		vertex_map_t::const_iterator it = vertices.find(this->get_partition_id());
 		assert(it == vertices.end());
-		vertices.insert(vertex_map_t::value_type(get_partition_id(),
+		vertices.insert(vertex_map_t::value_type(this->get_partition_id(),
 					bfs_visited_vertices));
 	}
 
 	short get_max_dist() const {
-		return max_dist;
+		return bfs_visited_vertices.size() - 1;
 	}
 };
 
-class bp_vertex_program: public vertex_program_impl<betweenness_vertex>
+template<int NUM_WORDS>
+class bp_vertex_program: public vertex_program_impl<betweenness_vertex<NUM_WORDS> >
 {
 	std::shared_ptr<vertex_map_t> all_vertices;
 	std::vector<vertex_set_ptr> bfs_visited_vertices;
@@ -163,38 +315,39 @@ class bp_vertex_program: public vertex_program_impl<betweenness_vertex>
 	}
 
 	virtual void run_on_engine_start() {
-		vertex_map_t::const_iterator it = all_vertices->find(get_partition_id());
-		assert(it != all_vertices->end());
-		bfs_visited_vertices = it->second;
-
-		// Drop the empty set added at the end of the last iteration in bfs.
-		assert(bfs_visited_vertices.back()->empty());
-		bfs_visited_vertices.pop_back();
-		// Drop the last set of visited vertices because we have already activated them.
-		while ((short)bfs_visited_vertices.size() > bfs_max_dist) {
-			bfs_visited_vertices.pop_back();
-		}
-
-		assert((short)bfs_visited_vertices.size() == bfs_max_dist);
+		vertex_map_t::const_iterator it = all_vertices->find(
+				this->get_partition_id());
+		if (it != all_vertices->end())
+			bfs_visited_vertices = it->second;
+		// The vertices in the last level have been activated when the engine
+		// starts. The vertices in level 0 are the sources, which don't need
+		// to propagate dependencies. This thread may not have vertices in
+		// some levels, so we pad the empty levels.
+		bfs_visited_vertices.resize(bfs_max_dist);
+		if (!bfs_visited_vertices.empty())
+			bfs_visited_vertices.erase(bfs_visited_vertices.begin());
 	}
 
 	virtual void run_on_iteration_end() {
 		if (!bfs_visited_vertices.empty()) {
 			vertex_set_ptr vertices = bfs_visited_vertices.back();
-			activate_vertices(vertices->data(), vertices->size());
+			if (vertices)
+				this->activate_vertices(vertices->data(), vertices->size());
 			bfs_visited_vertices.pop_back();
 		}
 	}
 };
 
+template<int NUM_WORDS>
 class bfs_vertex_program_creater: public vertex_program_creater
 {
 	public:
 		vertex_program::ptr create() const {
-			return vertex_program::ptr(new bfs_vertex_program());
+			return vertex_program::ptr(new bfs_vertex_program<NUM_WORDS>());
 		}
 };
 
+template<int NUM_WORDS>
 class bp_vertex_program_creater: public vertex_program_creater
 {
 	std::shared_ptr<vertex_map_t> all_vertices;
@@ -208,87 +361,109 @@ class bp_vertex_program_creater: public vertex_program_creater
 	}
 
 	vertex_program::ptr create() const {
-		return vertex_program::ptr(new bp_vertex_program(all_vertices));
+		return vertex_program::ptr(new bp_vertex_program<NUM_WORDS>(
+					all_vertices));
 	}
 };
 
-class bfs_message: public vertex_message
+template<int NUM_WORDS>
+class bfs_msg_builder
 {
-	vertex_id_t sender_id;
-	short parent_dist;
-	int parent_sigma;
-
-	public:
-	bfs_message(vertex_id_t id, short sender_dist, int sigma): 
-		vertex_message(sizeof(bfs_message), true) {
-			sender_id = id;
-			parent_dist = sender_dist;
-			parent_sigma = sigma;
-		}
+	bfs_message<NUM_WORDS> &msg;
+	const source_state *sources;
+public:
+	bfs_msg_builder(bfs_message<NUM_WORDS> &_msg,
+			const source_state *sources): msg(_msg) {
+		this->sources = sources;
+	}
 
-	const vertex_id_t get_sender_id() const {
-		return sender_id;
+	void operator()(int bfs_id) {
+		msg.add(bfs_id, sources[bfs_id].sigma);
 	}
+};
 
-	const short get_parent_dist() const {
-		return parent_dist;
-	} 
+/*
+ * Accumulate the sigma of the BFS that reach the vertex for the first time.
+ */
+template<int NUM_WORDS>
+class sigma_accumulator
+{
+	const source_bitmap<NUM_WORDS> &new_ids;
+	source_state *sources;
+public:
+	sigma_accumulator(const source_bitmap<NUM_WORDS> &_new_ids,
+			source_state *sources): new_ids(_new_ids) {
+		this->sources = sources;
+	}
 
-	const int get_parent_sigma() const {
-		return parent_sigma;
+	void operator()(int bfs_id, float sigma) {
+		if (new_ids.test(bfs_id))
+			sources[bfs_id].sigma += sigma;
 	}
 };
 
-/** Back propagate message */
-class bp_message: public vertex_message
+class dist_setter
 {
-	float delta;
-	int sigma;
+	source_state *sources;
 	short dist;
+public:
+	dist_setter(source_state *sources, short dist) {
+		this->sources = sources;
+		this->dist = dist;
+	}
 
-	public:
-	bp_message(short dist, float delta, int sigma): 
-		vertex_message(sizeof(bp_message), false) {
-			this->delta = delta;
-			this->sigma = sigma;
-			this->dist = dist;
-		}
-
-	const float get_sender_delta() const {
-		return delta;
-	} 
+	void operator()(int bfs_id) {
+		sources[bfs_id].dist = dist;
+	}
+};
 
-	const int get_sender_sigma() const {
-		return sigma;
+class delta_accumulator
+{
+	source_state *sources;
+	short parent_dist;
+public:
+	delta_accumulator(source_state *sources, short parent_dist) {
+		this->sources = sources;
+		this->parent_dist = parent_dist;
 	}
 
-	const short get_sender_dist() const {
-		return dist;
+	void operator()(int bfs_id, float coeff) {
+		// Ignore this message if you're not a parent on the path
+		source_state &s = sources[bfs_id];
+		if (s.dist == parent_dist)
+			s.delta += s.sigma * coeff;
 	}
 };
 
-void betweenness_vertex::run(vertex_program &prog) { 
+template<int NUM_WORDS>
+void betweenness_vertex<NUM_WORDS>::run(vertex_program &prog)
+{
 	switch (g_alg_phase) {
-		case btwn_phase_t::bfs:  
+		case btwn_phase_t::bfs:
 			{
-				if (is_bfs_visited()) 
-					return; 
-				directed_vertex_request req(prog.get_vertex_id(*this), edge_type::OUT_EDGE);
+				if (!state.get_frontier().any())
+					return;
+				directed_vertex_request req(prog.get_vertex_id(*this),
+						edge_type::OUT_EDGE);
 				request_partial_vertices(&req, 1);
-				((bfs_vertex_program&)prog).
-					add_visited_bfs(prog.get_vertex_id(*this));
 				break;
 			}
-		case btwn_phase_t::back_prop: 
+		case btwn_phase_t::back_prop:
 			{
-				directed_vertex_request req(prog.get_vertex_id(*this), edge_type::IN_EDGE);
+				directed_vertex_request req(prog.get_vertex_id(*this),
+						edge_type::IN_EDGE);
 				request_partial_vertices(&req, 1);
 				break;
 			}
 		case btwn_phase_t::bc_summation:
 			{
-				if (prog.get_vertex_id(*this) != g_source_vertex)
-					btwn_cent += delta;	
+				if (sources == NULL)
+					return;
+				// The source itself isn't counted.
+				for (int i = 0; i < num_sources; i++)
+					if (sources[i].dist > 0)
+						btwn_cent += sources[i].delta;
+				free_sources();
 				break;
 			}
 		default:
@@ -296,60 +471,78 @@ void betweenness_vertex::run(vertex_program &prog) {
 	}
 }
 
-void betweenness_vertex::run(vertex_program &prog, const page_vertex &vertex)
+template<int NUM_WORDS>
+void betweenness_vertex<NUM_WORDS>::run_bfs(vertex_program &prog,
+		const page_vertex &vertex)
 {
-	switch (g_alg_phase) {
-		case btwn_phase_t::bfs :
-			{
-				bfs_visited = true;
-				int num_dests = vertex.get_num_edges(OUT_EDGE);
-				if (num_dests == 0) return;
-
-				edge_seq_iterator it = vertex.get_neigh_seq_it(OUT_EDGE, 0, num_dests);
-				bfs_message msg(vertex.get_id(), this->dist, this->sigma);
-				prog.multicast_msg(it, msg);
-				break;
-			}
-		case btwn_phase_t::back_prop :
-			{
-				/* NOTE: Sending to all in_neighs instead of only P's ... */
-				int num_dests = vertex.get_num_edges(IN_EDGE); 
-				edge_seq_iterator it = vertex.get_neigh_seq_it(IN_EDGE, 0, num_dests);
-				bp_message msg(this->dist, this->delta, this->sigma);
-				prog.multicast_msg(it, msg);
-				break;
-			}
-		default:
-			assert(0);
+	int num_dests = vertex.get_num_edges(OUT_EDGE);
+	if (num_dests == 0) {
+		state.clear_frontier();
+		return;
 	}
+
+	uint64_t buf[(bfs_message<NUM_WORDS>::get_max_size() + 7) / 8];
+	bfs_message<NUM_WORDS> *msg = new (buf) bfs_message<NUM_WORDS>();
+	bfs_msg_builder<NUM_WORDS> builder(*msg, sources);
+	state.get_frontier().for_each(builder);
+	state.clear_frontier();
+
+	edge_seq_iterator it = vertex.get_neigh_seq_it(OUT_EDGE, 0, num_dests);
+	prog.multicast_msg(it, *msg);
+}
+
+template<int NUM_WORDS>
+void betweenness_vertex<NUM_WORDS>::run_back_prop(vertex_program &prog,
+		const page_vertex &vertex)
+{
+	/* NOTE: Sending to all in_neighs instead of only P's ... */
+	int num_dests = vertex.get_num_edges(IN_EDGE);
+	if (num_dests == 0)
+		return;
+
+	short dist = bfs_max_dist - prog.get_graph().get_curr_level();
+	uint64_t buf[(bp_message<NUM_WORDS>::get_max_size() + 7) / 8];
+	bp_message<NUM_WORDS> *msg = new (buf) bp_message<NUM_WORDS>();
+	for (int i = 0; i < num_sources; i++)
+		if (sources[i].dist == dist)
+			msg->add(i, (1 + sources[i].delta) / sources[i].sigma);
+	if (!msg->get_bfs_ids().any())
+		return;
+	edge_seq_iterator it = vertex.get_neigh_seq_it(IN_EDGE, 0, num_dests);
+	prog.multicast_msg(it, *msg);
 }
 
-void betweenness_vertex::run_on_message(vertex_program &prog, const vertex_message &msg1) {
+template<int NUM_WORDS>
+void betweenness_vertex<NUM_WORDS>::run_on_message(vertex_program &prog,
+		const vertex_message &msg1)
+{
 	switch (g_alg_phase) {
 		case btwn_phase_t::bfs:
 			{
-				const bfs_message &msg = (const bfs_message &) msg1;
-				if (this->dist < 0) { 
-					this->dist = msg.get_parent_dist() + 1;
-				}
-				if (this->dist == msg.get_parent_dist() + 1) {
-					this->sigma = this->sigma + msg.get_parent_sigma();
-				}
+				const bfs_message<NUM_WORDS> &msg
+					= (const bfs_message<NUM_WORDS> &) msg1;
+				// The BFS that reach the vertex for the first time.
+				// The vertex may get messages from multiple parents in
+				// the same level.
+				source_bitmap<NUM_WORDS> new_ids = state.visit(
+						msg.get_bfs_ids());
+				if (!new_ids.any())
+					return;
+				alloc_sources(prog.get_partition_id());
+				sigma_accumulator<NUM_WORDS> acc(new_ids, sources);
+				msg.for_each(acc);
+				prog.request_notify_iter_end(*this);
 				break;
 			}
 		case btwn_phase_t::back_prop:
 			{
-				const bp_message &msg = (const bp_message &) msg1;
-				// Ignore this message if you're not a parent on the path
-				if (this->dist != msg.get_sender_dist() - 1) {
+				if (sources == NULL)
 					return;
-				}
-
-				// Now we know it's only parents
-				if (msg.get_sender_sigma() != 0) { // If msg.get_sender_sigma() == 0 do nothing
-					delta = delta + (((float)sigma/msg.get_sender_sigma()) 
-							* (1 + msg.get_sender_delta()));
-				} 
+				const bp_message<NUM_WORDS> &msg
+					= (const bp_message<NUM_WORDS> &) msg1;
+				short dist = bfs_max_dist - prog.get_graph().get_curr_level();
+				delta_accumulator acc(sources, dist - 1);
+				msg.for_each(acc);
 				break;
 			}
 		default:
@@ -357,43 +550,152 @@ void betweenness_vertex::run_on_message(vertex_program &prog, const vertex_messa
 	}
 }
 
+template<int NUM_WORDS>
+void betweenness_vertex<NUM_WORDS>::notify_iteration_end(vertex_program &prog)
+{
+	if (state.advance()) {
+		short dist = prog.get_graph().get_curr_level() + 1;
+		dist_setter setter(sources, dist);
+		state.get_frontier().for_each(setter);
+		((bfs_vertex_program<NUM_WORDS> &) prog).add_visited_bfs(
+				prog.get_vertex_id(*this), dist);
+	}
+}
+
+template<int NUM_WORDS>
+class btwn_reset: public vertex_initializer
+{
+public:
+	virtual void init(compute_vertex &v) {
+		betweenness_vertex<NUM_WORDS> &bv = (betweenness_vertex<NUM_WORDS> &) v;
+		bv.reset();
+	}
+};
+
+template<int NUM_WORDS>
 class btwn_initializer: public vertex_initializer
 {
-	compute_vertex* source_vertex;
+	// A source vertex may appear multiple times in a batch.
+	std::unordered_multimap<vertex_id_t, int> sources;
+	graph_engine &graph;
 	public:
-	btwn_initializer(compute_vertex *v) {
-		source_vertex = v;
+	btwn_initializer(const std::vector<vertex_id_t> &ids,
+			graph_engine &_graph): graph(_graph) {
+		for (size_t i = 0; i < ids.size(); i++)
+			sources.insert(std::pair<vertex_id_t, int>(ids[i], i));
 	}
 
 	virtual void init(compute_vertex &v) {
-		betweenness_vertex &bv = (betweenness_vertex &) v;
-		&v == source_vertex ? bv.init(1,0) : bv.init(0,-1); // sigma, dist
+		betweenness_vertex<NUM_WORDS> &bv = (betweenness_vertex<NUM_WORDS> &) v;
+		vertex_id_t id = graph.get_graph_index().get_vertex_id(v);
+		auto range = sources.equal_range(id);
+		assert(range.first != range.second);
+		int part_id = graph.get_partitioner()->map(id);
+		for (auto it = range.first; it != range.second; it++)
+			bv.init_source(it->second, part_id);
 	}
 };
 
-/** For back prop phase where we activate vertices 
-  with only dist = max_dist. Also resets the bfs bit
-  to unvisited.
-  */
-class activate_by_dist_filter: public vertex_filter {
-	short dist;
+template<int NUM_WORDS>
+void compute_btwn_batch(graph_engine::ptr graph,
+		const std::vector<vertex_id_t> &batch)
+{
+	num_sources = batch.size();
+	bfs_max_dist = 0;
+	// BFS phase. Inintialize start vert(ex)(ices)
+	g_alg_phase = btwn_phase_t::bfs;
+	BOOST_LOG_TRIVIAL(info) << boost::format("Starting BFS for %1% vertices")
+		% batch.size();
+	graph->init_all_vertices(vertex_initializer::ptr(
+				new btwn_reset<NUM_WORDS>()));
+	// The sources are activated in the engine, so they are visited in
+	// level 0.
+	std::vector<vertex_id_t> start_vertices = batch;
+	std::sort(start_vertices.begin(), start_vertices.end());
+	start_vertices.resize(std::unique(start_vertices.begin(),
+				start_vertices.end()) - start_vertices.begin());
+	graph->start(start_vertices.data(), start_vertices.size(),
+			vertex_initializer::ptr(new btwn_initializer<NUM_WORDS>(batch,
+					*graph)),
+			vertex_program_creater::ptr(
+				new bfs_vertex_program_creater<NUM_WORDS>()));
+	graph->wait4complete();
+
+	std::vector<vertex_program::ptr> programs;
+	graph->get_vertex_programs(programs);
+	bp_vertex_program_creater<NUM_WORDS> *bp_prog_creater_ptr
+		= new bp_vertex_program_creater<NUM_WORDS>();
+	vertex_program_creater::ptr bp_prog_creater
+		= vertex_program_creater::ptr(bp_prog_creater_ptr);
+
+	BOOST_FOREACH(vertex_program::ptr prog, programs) {
+		typename bfs_vertex_program<NUM_WORDS>::ptr bfs_prog
+			= bfs_vertex_program<NUM_WORDS>::cast2(prog);
+		bfs_prog->collect_vertices(bp_prog_creater_ptr->get_vertex_map());
+		bfs_max_dist = std::max(bfs_max_dist, bfs_prog->get_max_dist());
+	}
+
+	BOOST_LOG_TRIVIAL(info) << "Max dist for bfs is: " << bfs_max_dist << "...";
+	if (bfs_max_dist > 0) {
+		// Back propagation phase. It starts from the vertices in
+		// the last level.
+		std::vector<vertex_id_t> last_level;
+		BOOST_FOREACH(vertex_map_t::value_type &v,
+				bp_prog_creater_ptr->get_vertex_map()) {
+			if ((short) v.second.size() > bfs_max_dist)
+				last_level.insert(last_level.end(),
+						v.second[bfs_max_dist]->begin(),
+						v.second[bfs_max_dist]->end());
+		}
+		BOOST_LOG_TRIVIAL(info) << "Starting back_prop phase";
+		g_alg_phase = btwn_phase_t::back_prop;
+		graph->start(last_level.data(), last_level.size(),
+				vertex_initializer::ptr(), std::move(bp_prog_creater));
+		graph->wait4complete();
+	}
 
-	public:
-	activate_by_dist_filter (short dist) {
-		this->dist = dist;
-	} 
-	bool keep(vertex_program &prog, compute_vertex &v) {
-		betweenness_vertex &bv = (betweenness_vertex &) v;
-		bool is_max_v = bv.get_dist() == dist;
+	// It also frees the per-BFS state of the vertices.
+	BOOST_LOG_TRIVIAL(info) << "BC summation step";
+	g_alg_phase = bc_summation;
+	graph->start_all();
+	graph->wait4complete();
+	for (size_t i = 0; i < pools.size(); i++)
+		pools[i]->clear();
+}
 
-		return is_max_v;
+template<int NUM_WORDS>
+FG_vector<float>::ptr compute_btwn(graph_engine::ptr graph,
+		const std::vector<vertex_id_t> &ids, size_t batch_size)
+{
+	pools.clear();
+	for (int i = 0; i < graph->get_num_threads(); i++)
+		pools.emplace_back(new source_state_pool());
+	std::vector<vertex_id_t> batch;
+	for (size_t i = 0; i < ids.size(); i++) {
+		if (graph->get_num_edges(ids[i]))
+			batch.push_back(ids[i]);
+		if (batch.size() == batch_size
+				|| (i == ids.size() - 1 && !batch.empty())) {
+			compute_btwn_batch<NUM_WORDS>(graph, batch);
+			batch.clear();
+		}
 	}
-};
+
+	pools.clear();
+
+	FG_vector<float>::ptr ret = FG_vector<float>::create(
+			graph->get_num_vertices());
+	graph->query_on_all(vertex_query::ptr(
+				new save_query<float, betweenness_vertex<NUM_WORDS> >(ret)));
+	return ret;
+}
+
 }
 
 namespace fg 
 {
-FG_vector<float>::ptr compute_betweenness_centrality(FG_graph::ptr fg, const std::vector<vertex_id_t>& ids)
+FG_vector<float>::ptr compute_betweenness_centrality(FG_graph::ptr fg,
+		const std::vector<vertex_id_t>& ids, size_t num_para_bfs)
 {
 	bool directed = fg->get_graph_header().is_directed_graph();
 	if (!directed) {
@@ -401,12 +703,31 @@ FG_vector<float>::ptr compute_betweenness_centrality(FG_graph::ptr fg, const std
 			<< "This algorithm currently works on a directed graph";
 		return FG_vector<float>::ptr();
 	}
-
-	graph_index::ptr index = NUMA_graph_index<betweenness_vertex>::create(
-			fg->get_graph_header());
+	if (num_para_bfs == 0 || num_para_bfs > (size_t) MAX_MS_BFS_SOURCES) {
+		BOOST_LOG_TRIVIAL(error)
+			<< boost::format("We can run 1 - %1% BFS in parallel")
+			% MAX_MS_BFS_SOURCES;
+		return FG_vector<float>::ptr();
+	}
+	int num_words = get_ms_bfs_num_words(num_para_bfs);
+
+	graph_index::ptr index;
+	if (num_words == 1)
+		index = NUMA_graph_index<betweenness_vertex<1> >::create(
+				fg->get_graph_header());
+	else if (num_words == 2)
+		index = NUMA_graph_index<betweenness_vertex<2> >::create(
+				fg->get_graph_header());
+	else if (num_words == 4)
+		index = NUMA_graph_index<betweenness_vertex<4> >::create(
+				fg->get_graph_header());
+	else
+		index = NUMA_graph_index<betweenness_vertex<8> >::create(
+				fg->get_graph_header());
 	graph_engine::ptr graph = fg->create_engine(index);
 
 	BOOST_LOG_TRIVIAL(info) << "Starting Betweenness Centrality ...";
+	BOOST_LOG_TRIVIAL(info) << boost::format("#para BFS: %1%") % num_para_bfs;
 	BOOST_LOG_TRIVIAL(info) << "prof_file: " << graph_conf.get_prof_file().c_str();
 #ifdef PROFILER
 	if (!graph_conf.get_prof_file().empty())
@@ -416,64 +737,17 @@ FG_vector<float>::ptr compute_betweenness_centrality(FG_graph::ptr fg, const std
 	struct timeval start, end;
 	gettimeofday(&start, NULL);
 
-	BOOST_FOREACH (vertex_id_t id , ids) {
-		if (!graph->get_num_edges(id))
-		   continue;	
-
-		g_source_vertex = id;
-		bfs_max_dist = 0; // Must reset bfs dist for each vertex
-		// BFS phase. Inintialize start vert(ex)(ices)
-		g_alg_phase = btwn_phase_t::bfs;
-		BOOST_LOG_TRIVIAL(info) << "Starting BFS for vertex: " << g_source_vertex;
-		graph->init_all_vertices(vertex_initializer::ptr(
-					new btwn_initializer(&(graph->get_vertex(g_source_vertex)))));
-		graph->start(&g_source_vertex, 1, vertex_initializer::ptr(),
-				vertex_program_creater::ptr(new bfs_vertex_program_creater()));
-		graph->wait4complete();
-
-		std::vector<vertex_program::ptr> programs;
-		graph->get_vertex_programs(programs);
-		bp_vertex_program_creater *bp_prog_creater_ptr = new bp_vertex_program_creater();
-		vertex_program_creater::ptr bp_prog_creater
-			= vertex_program_creater::ptr(bp_prog_creater_ptr);
-
-		BOOST_FOREACH(vertex_program::ptr prog, programs) {
-			bfs_vertex_program::cast2(prog)->collect_vertices(
-					bp_prog_creater_ptr->get_vertex_map());
-			bfs_max_dist = std::max(bfs_max_dist,
-					bfs_vertex_program::cast2(prog)->get_max_dist());
-		}
-
-		BOOST_LOG_TRIVIAL(info) << "Max dist for bfs is: " << bfs_max_dist << "...";
-
-		if (bfs_max_dist > 0) {
-			// Back propagation phase
-			BOOST_LOG_TRIVIAL(info) << "Starting back_prop phase for vertex: " 
-					<< g_source_vertex << "...";
-			g_alg_phase = btwn_phase_t::back_prop;
-
-			std::shared_ptr<vertex_filter> filter =
-				std::shared_ptr<vertex_filter>(new activate_by_dist_filter(bfs_max_dist));
-
-			graph->start(filter, std::move(bp_prog_creater));
-			graph->wait4complete();
-			BOOST_LOG_TRIVIAL(info) << "BC summation step";
-			g_alg_phase = bc_summation;
-			graph->start_all();
-			graph->wait4complete();
-		}
-	}
+	FG_vector<float>::ptr ret;
+	if (num_words == 1)
+		ret = compute_btwn<1>(graph, ids, num_para_bfs);
+	else if (num_words == 2)
+		ret = compute_btwn<2>(graph, ids, num_para_bfs);
+	else if (num_words == 4)
+		ret = compute_btwn<4>(graph, ids, num_para_bfs);
+	else
+		ret = compute_btwn<8>(graph, ids, num_para_bfs);
 
 	gettimeofday(&end, NULL);
-	FG_vector<float>::ptr ret = FG_vector<float>::create(
-			graph->get_num_vertices());
-	graph->query_on_all(vertex_query::ptr(
-				new save_query<float, betweenness_vertex>(ret)));
-
-#if 0
-	BOOST_LOG_TRIVIAL(info) << "Printing betweenness vector:";
-	ret->print(); 
-#endif
 
 #ifdef PROFILER
 	if (!graph_conf.get_prof_file().empty())
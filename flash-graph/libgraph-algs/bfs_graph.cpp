@@ -23,10 +23,13 @@
 #endif
 
 #include <vector>
+#include <atomic>
 
 #include "graph_engine.h"
 #include "graph_config.h"
 #include "FGlib.h"
+#include "multi_query.h"
+#include "edge_map.h"
 
 using namespace safs;
 using namespace fg;
@@ -174,6 +177,157 @@ public:
 
 }
 
+namespace
+{
+
+/*
+ * BFS that runs with other queries in the multi-query engine.
+ */
+class bfs_query: public graph_query
+{
+	std::vector<vertex_id_t> start_vertices;
+	edge_type type;
+	size_t num_visited;
+public:
+	bfs_query(vertex_id_t start_vertex, edge_type type) {
+		start_vertices.push_back(start_vertex);
+		this->type = type;
+		num_visited = 0;
+	}
+
+	const std::vector<vertex_id_t> &get_start_vertices() const {
+		return start_vertices;
+	}
+
+	edge_type get_edge_type() const {
+		return type;
+	}
+
+	void run(query_context &ctx, const page_vertex &vertex,
+			const query_vertex_state &state) {
+		if (type == BOTH_EDGES && ctx.get_vertex_program().get_graph().is_directed()) {
+			edge_seq_iterator it = vertex.get_neigh_seq_it(IN_EDGE);
+			ctx.send(it, 0);
+			it = vertex.get_neigh_seq_it(OUT_EDGE);
+			ctx.send(it, 0);
+		}
+		else {
+			edge_seq_iterator it = vertex.get_neigh_seq_it(type);
+			ctx.send(it, 0);
+		}
+	}
+
+	bool run_on_message(query_vertex_state &state, bool new_state,
+			double val) {
+		// A vertex is visited when the BFS reaches it for the first time.
+		return new_state;
+	}
+
+	void complete(
+			const std::vector<std::pair<vertex_id_t, query_vertex_state> > &states) {
+		num_visited = states.size();
+	}
+
+	size_t get_num_visited() const {
+		return num_visited;
+	}
+};
+
+}
+
+/*
+ * Run BFS from each of the start vertices at the same time.
+ * It returns the number of vertices visited by each BFS.
+ */
+std::vector<size_t> multi_bfs(FG_graph::ptr fg,
+		const std::vector<vertex_id_t> &start_vertices, edge_type traverse_e)
+{
+	// An undirected graph only has one edge list.
+	if (!fg->get_graph_header().is_directed_graph())
+		traverse_e = edge_type::BOTH_EDGES;
+	multi_query_engine::ptr engine = multi_query_engine::create(fg);
+	std::vector<graph_query::ptr> queries;
+	for (size_t i = 0; i < start_vertices.size(); i++)
+		queries.push_back(graph_query::ptr(new bfs_query(start_vertices[i],
+						traverse_e)));
+	engine->run(queries);
+
+	std::vector<size_t> num_visited(queries.size());
+	for (size_t i = 0; i < queries.size(); i++)
+		num_visited[i] = ((bfs_query &) *queries[i]).get_num_visited();
+	return num_visited;
+}
+
+namespace
+{
+
+/*
+ * The edge function of BFS in edge_map. A vertex is visited when it gets
+ * its parent.
+ */
+class bfs_func
+{
+	std::atomic<vertex_id_t> *parents;
+public:
+	bfs_func(std::atomic<vertex_id_t> *parents) {
+		this->parents = parents;
+	}
+
+	bool update(vertex_id_t src, vertex_id_t dst) {
+		parents[dst].store(src, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool update_atomic(vertex_id_t src, vertex_id_t dst) {
+		vertex_id_t expected = INVALID_VERTEX_ID;
+		return parents[dst].compare_exchange_strong(expected, src);
+	}
+
+	bool cond(vertex_id_t dst) const {
+		return parents[dst].load(std::memory_order_relaxed)
+			== INVALID_VERTEX_ID;
+	}
+};
+
+}
+
+/*
+ * BFS with edge_map. It switches to the pull mode when the frontier
+ * is large.
+ */
+size_t bfs_edge_map(FG_graph::ptr fg, vertex_id_t start_vertex,
+		edge_type traverse_e)
+{
+	graph_index::ptr index = NUMA_graph_index<edge_map_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	size_t num_vertices = graph->get_num_vertices();
+	std::unique_ptr<std::atomic<vertex_id_t>[]> parents(
+			new std::atomic<vertex_id_t>[num_vertices]);
+#pragma omp parallel for
+	for (size_t i = 0; i < num_vertices; i++)
+		parents[i].store(INVALID_VERTEX_ID, std::memory_order_relaxed);
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	parents[start_vertex] = start_vertex;
+	vertex_frontier frontier(num_vertices);
+	frontier.add(start_vertex);
+	size_t num_visited = 0;
+	size_t num_levels = 0;
+	while (!frontier.empty()) {
+		num_visited += frontier.size();
+		frontier = edge_map(*graph, frontier, traverse_e,
+				bfs_func(parents.get()));
+		num_levels++;
+	}
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"BFS with edge_map takes %1% seconds and %2% levels")
+		% time_diff(start, end) % num_levels;
+	return num_visited;
+}
+
 size_t bfs(FG_graph::ptr fg, vertex_id_t start_vertex, edge_type traverse_e)
 {
 	bool directed = fg->get_graph_header().is_directed_graph();
@@ -0,0 +1,324 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include "graph_engine.h"
+#include "graph_config.h"
+#include "FGlib.h"
+#include "ms_bfs.h"
+
+using namespace fg;
+
+/*
+ * This computes the closeness centrality of a set of vertices. It runs
+ * BFS from a batch of the vertices at the same time with MS-BFS and sums
+ * the distances from each source in the vertex programs.
+ */
+
+namespace {
+
+edge_type traverse_edge = edge_type::OUT_EDGE;
+// The number of BFS in the current batch.
+int num_sources;
+
+template<int NUM_WORDS>
+class closeness_message: public vertex_message
+{
+	source_bitmap<NUM_WORDS> bfs_ids;
+public:
+	closeness_message(const source_bitmap<NUM_WORDS> &bfs_ids): vertex_message(
+			sizeof(closeness_message<NUM_WORDS>), true) {
+		this->bfs_ids = bfs_ids;
+	}
+
+	const source_bitmap<NUM_WORDS> &get_bfs_ids() const {
+		return bfs_ids;
+	}
+};
+
+template<int NUM_WORDS>
+class closeness_vertex: public compute_directed_vertex
+{
+	ms_bfs_state<NUM_WORDS> state;
+public:
+	closeness_vertex(vertex_id_t id): compute_directed_vertex(id) {
+	}
+
+	void reset() {
+		state.reset();
+	}
+
+	void init_source(int bfs_id) {
+		state.init_source(bfs_id);
+	}
+
+	void run(vertex_program &prog) {
+		if (state.get_frontier().any()) {
+			directed_vertex_request req(prog.get_vertex_id(*this), traverse_edge);
+			request_partial_vertices(&req, 1);
+		}
+	}
+
+	void run(vertex_program &prog, const page_vertex &vertex);
+
+	void run_on_message(vertex_program &prog, const vertex_message &msg) {
+		const closeness_message<NUM_WORDS> &cmsg
+			= (const closeness_message<NUM_WORDS> &) msg;
+		if (state.visit(cmsg.get_bfs_ids()).any())
+			prog.request_notify_iter_end(*this);
+	}
+
+	void notify_iteration_end(vertex_program &prog);
+};
+
+/*
+ * It sums the distances from each source to the vertices in this thread.
+ */
+template<int NUM_WORDS>
+class closeness_vertex_program: public vertex_program_impl<closeness_vertex<NUM_WORDS> >
+{
+	std::vector<size_t> sum_dists;
+	std::vector<size_t> num_reached;
+public:
+	typedef std::shared_ptr<closeness_vertex_program<NUM_WORDS> > ptr;
+
+	static ptr cast2(vertex_program::ptr prog) {
+		return std::static_pointer_cast<closeness_vertex_program<NUM_WORDS>,
+			   vertex_program>(prog);
+	}
+
+	closeness_vertex_program(): sum_dists(num_sources), num_reached(
+			num_sources) {
+	}
+
+	void add_dist(int bfs_id, size_t dist) {
+		sum_dists[bfs_id] += dist;
+		num_reached[bfs_id]++;
+	}
+
+	size_t get_sum_dist(int bfs_id) const {
+		return sum_dists[bfs_id];
+	}
+
+	size_t get_num_reached(int bfs_id) const {
+		return num_reached[bfs_id];
+	}
+};
+
+template<int NUM_WORDS>
+class closeness_vertex_program_creater: public vertex_program_creater
+{
+public:
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new closeness_vertex_program<NUM_WORDS>());
+	}
+};
+
+template<int NUM_WORDS>
+void closeness_vertex<NUM_WORDS>::run(vertex_program &prog,
+		const page_vertex &vertex)
+{
+	closeness_message<NUM_WORDS> msg(state.get_frontier());
+	state.clear_frontier();
+	if (traverse_edge == BOTH_EDGES) {
+		edge_seq_iterator it = vertex.get_neigh_seq_it(IN_EDGE);
+		prog.multicast_msg(it, msg);
+		it = vertex.get_neigh_seq_it(OUT_EDGE);
+		prog.multicast_msg(it, msg);
+	}
+	else {
+		edge_seq_iterator it = vertex.get_neigh_seq_it(traverse_edge);
+		prog.multicast_msg(it, msg);
+	}
+}
+
+template<int NUM_WORDS>
+class dist_adder
+{
+	closeness_vertex_program<NUM_WORDS> &prog;
+	size_t dist;
+public:
+	dist_adder(closeness_vertex_program<NUM_WORDS> &_prog,
+			size_t dist): prog(_prog) {
+		this->dist = dist;
+	}
+
+	void operator()(int bfs_id) {
+		prog.add_dist(bfs_id, dist);
+	}
+};
+
+template<int NUM_WORDS>
+void closeness_vertex<NUM_WORDS>::notify_iteration_end(vertex_program &prog)
+{
+	if (state.advance()) {
+		dist_adder<NUM_WORDS> adder((closeness_vertex_program<NUM_WORDS> &) prog,
+				prog.get_graph().get_curr_level() + 1);
+		state.get_frontier().for_each(adder);
+	}
+}
+
+template<int NUM_WORDS>
+class closeness_reset: public vertex_initializer
+{
+public:
+	void init(compute_vertex &v) {
+		closeness_vertex<NUM_WORDS> &cv = (closeness_vertex<NUM_WORDS> &) v;
+		cv.reset();
+	}
+};
+
+template<int NUM_WORDS>
+class closeness_initializer: public vertex_initializer
+{
+	// A source vertex may appear multiple times in a batch.
+	std::unordered_multimap<vertex_id_t, int> sources;
+	graph_engine &graph;
+public:
+	closeness_initializer(const vertex_id_t ids[], int num,
+			graph_engine &_graph): graph(_graph) {
+		for (int i = 0; i < num; i++)
+			sources.insert(std::pair<vertex_id_t, int>(ids[i], i));
+	}
+
+	void init(compute_vertex &v) {
+		closeness_vertex<NUM_WORDS> &cv = (closeness_vertex<NUM_WORDS> &) v;
+		auto range = sources.equal_range(graph.get_graph_index().get_vertex_id(v));
+		assert(range.first != range.second);
+		for (auto it = range.first; it != range.second; it++)
+			cv.init_source(it->second);
+	}
+};
+
+template<int NUM_WORDS>
+void compute_closeness_batch(graph_engine::ptr graph, const vertex_id_t ids[],
+		int num, float closeness[])
+{
+	num_sources = num;
+	graph->init_all_vertices(vertex_initializer::ptr(
+				new closeness_reset<NUM_WORDS>()));
+	std::vector<vertex_id_t> start_vertices(ids, ids + num);
+	std::sort(start_vertices.begin(), start_vertices.end());
+	start_vertices.resize(std::unique(start_vertices.begin(),
+				start_vertices.end()) - start_vertices.begin());
+	graph->start(start_vertices.data(), start_vertices.size(),
+			vertex_initializer::ptr(new closeness_initializer<NUM_WORDS>(ids,
+					num, *graph)),
+			vertex_program_creater::ptr(
+				new closeness_vertex_program_creater<NUM_WORDS>()));
+	graph->wait4complete();
+
+	std::vector<vertex_program::ptr> programs;
+	graph->get_vertex_programs(programs);
+	for (int i = 0; i < num; i++) {
+		size_t sum_dist = 0;
+		size_t num_reached = 0;
+		BOOST_FOREACH(vertex_program::ptr prog, programs) {
+			typename closeness_vertex_program<NUM_WORDS>::ptr cprog
+				= closeness_vertex_program<NUM_WORDS>::cast2(prog);
+			sum_dist += cprog->get_sum_dist(i);
+			num_reached += cprog->get_num_reached(i);
+		}
+		// The closeness is normalized by the number of vertices that can
+		// be reached by the source.
+		closeness[i] = sum_dist > 0 ? ((float) num_reached) / sum_dist : 0;
+	}
+}
+
+template<int NUM_WORDS>
+void compute_closeness(graph_engine::ptr graph,
+		const std::vector<vertex_id_t> &ids, size_t batch_size,
+		std::vector<float> &closeness)
+{
+	closeness.resize(ids.size());
+	for (size_t i = 0; i < ids.size(); i += batch_size) {
+		size_t num = std::min(batch_size, ids.size() - i);
+		compute_closeness_batch<NUM_WORDS>(graph, ids.data() + i, num,
+				closeness.data() + i);
+	}
+}
+
+}
+
+namespace fg
+{
+
+FG_vector<float>::ptr compute_closeness_centrality(FG_graph::ptr fg,
+		const std::vector<vertex_id_t> &ids, edge_type traverse_e,
+		size_t num_para_bfs)
+{
+	if (!fg->get_graph_header().is_directed_graph()) {
+		BOOST_LOG_TRIVIAL(error)
+			<< "This algorithm currently works on a directed graph";
+		return FG_vector<float>::ptr();
+	}
+	if (num_para_bfs == 0 || num_para_bfs > (size_t) MAX_MS_BFS_SOURCES) {
+		BOOST_LOG_TRIVIAL(error)
+			<< boost::format("We can run 1 - %1% BFS in parallel")
+			% MAX_MS_BFS_SOURCES;
+		return FG_vector<float>::ptr();
+	}
+	traverse_edge = traverse_e;
+	int num_words = get_ms_bfs_num_words(num_para_bfs);
+
+	graph_index::ptr index;
+	if (num_words == 1)
+		index = NUMA_graph_index<closeness_vertex<1> >::create(
+				fg->get_graph_header());
+	else if (num_words == 2)
+		index = NUMA_graph_index<closeness_vertex<2> >::create(
+				fg->get_graph_header());
+	else if (num_words == 4)
+		index = NUMA_graph_index<closeness_vertex<4> >::create(
+				fg->get_graph_header());
+	else
+		index = NUMA_graph_index<closeness_vertex<8> >::create(
+				fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+
+	BOOST_LOG_TRIVIAL(info) << "closeness centrality starts";
+	BOOST_LOG_TRIVIAL(info) << boost::format("#vertices: %1%, #para BFS: %2%")
+		% ids.size() % num_para_bfs;
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+
+	std::vector<float> closeness;
+	if (num_words == 1)
+		compute_closeness<1>(graph, ids, num_para_bfs, closeness);
+	else if (num_words == 2)
+		compute_closeness<2>(graph, ids, num_para_bfs, closeness);
+	else if (num_words == 4)
+		compute_closeness<4>(graph, ids, num_para_bfs, closeness);
+	else
+		compute_closeness<8>(graph, ids, num_para_bfs, closeness);
+
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format("It takes %1% seconds")
+		% time_diff(start, end);
+
+	FG_vector<float>::ptr ret = FG_vector<float>::create(closeness.size());
+	for (size_t i = 0; i < closeness.size(); i++)
+		ret->set(i, closeness[i]);
+	return ret;
+}
+
+}
@@ -27,6 +27,7 @@
 #include "graph_engine.h"
 #include "graph_config.h"
 #include "FGlib.h"
+#include "ms_bfs.h"
 
 using namespace fg;
 
@@ -35,63 +36,34 @@ namespace {
 size_t num_bfs = 1;
 edge_type traverse_edge = edge_type::OUT_EDGE;
 
-template<class T>
-class embedded_bitmap
-{
-	T map;
-public:
-	embedded_bitmap() {
-		map = 0;
-	}
-
-	void set(int idx) {
-		assert((size_t) idx < sizeof(T) * 8);
-		map |= ((T) 1) << idx;
-	}
-
-	void clear() {
-		map = 0;
-	}
-
-	bool merge(const embedded_bitmap<T> &map) {
-		bool old = this->map;
-		this->map |= map.map;
-		return old != map.map;
-	}
-
-	bool operator!=(const embedded_bitmap<T> &map) {
-		return this->map != map.map;
-	}
-
-	T get_value() const {
-		return map;
-	}
-};
-
+template<int NUM_WORDS>
 class diameter_message: public vertex_message
 {
-	embedded_bitmap<uint64_t> bfs_ids;
+	source_bitmap<NUM_WORDS> bfs_ids;
 public:
-	diameter_message(embedded_bitmap<uint64_t> bfs_ids): vertex_message(
-			sizeof(diameter_message), true) {
+	diameter_message(const source_bitmap<NUM_WORDS> &bfs_ids): vertex_message(
+			sizeof(diameter_message<NUM_WORDS>), true) {
 		this->bfs_ids = bfs_ids;
 	}
 
-	embedded_bitmap<uint64_t> get_bfs_ids() const {
+	const source_bitmap<NUM_WORDS> &get_bfs_ids() const {
 		return bfs_ids;
 	}
 };
 
+/*
+ * This diameter estimation runs multiple BFS in each sweep with MS-BFS.
+ * A vertex reads its edges once in a level for all BFS that reached it
+ * in the previous level.
+ */
+template<int NUM_WORDS>
 class diameter_vertex: public compute_directed_vertex
 {
-	embedded_bitmap<uint64_t> bfs_ids;
-	embedded_bitmap<uint64_t> new_bfs_ids;
+	ms_bfs_state<NUM_WORDS> state;
 	// The largest distance from a start vertex among the BFS.
 	short max_dist;
-	bool updated;
 public:
 	diameter_vertex(vertex_id_t id): compute_directed_vertex(id) {
-		updated = false;
 		max_dist = 0;
 	}
 
@@ -101,22 +73,17 @@ public:
 
 	void init(int bfs_id) {
 		max_dist = 0;
-		bfs_ids.clear();
-		bfs_ids.set(bfs_id);
-		new_bfs_ids = bfs_ids;
-		updated = true;
+		state.reset();
+		state.init_source(bfs_id);
 	}
 
 	void reset() {
 		max_dist = 0;
-		updated = false;
-		bfs_ids.clear();
-		new_bfs_ids.clear();
+		state.reset();
 	}
 
 	void run(vertex_program &prog) {
-		if (updated) {
-			updated = false;
+		if (state.get_frontier().any()) {
 			directed_vertex_request req(prog.get_vertex_id(*this), traverse_edge);
 			request_partial_vertices(&req, 1);
 		}
@@ -125,8 +92,9 @@ public:
 	void run(vertex_program &prog, const page_vertex &vertex);
 
 	void run_on_message(vertex_program &vprog, const vertex_message &msg) {
-		const diameter_message &dmsg = (const diameter_message &) msg;
-		if (new_bfs_ids.merge(dmsg.get_bfs_ids()))
+		const diameter_message<NUM_WORDS> &dmsg
+			= (const diameter_message<NUM_WORDS> &) msg;
+		if (state.visit(dmsg.get_bfs_ids()).any())
 			vprog.request_notify_iter_end(*this);
 	}
 
@@ -181,15 +149,18 @@ public:
 	}
 };
 
-void diameter_vertex::run(vertex_program &prog, const page_vertex &vertex)
+template<int NUM_WORDS>
+void diameter_vertex<NUM_WORDS>::run(vertex_program &prog,
+		const page_vertex &vertex)
 {
 	int num_dests = vertex.get_num_edges(traverse_edge);
+	// We need to add the neighbors of the vertex to the queue of
+	// the next level for all BFS in the frontier.
+	diameter_message<NUM_WORDS> msg(state.get_frontier());
+	state.clear_frontier();
 	if (num_dests == 0)
 		return;
 
-	// We need to add the neighbors of the vertex to the queue of
-	// the next level.
-	diameter_message msg(bfs_ids);
 	if (traverse_edge == BOTH_EDGES) {
 		edge_seq_iterator it = vertex.get_neigh_seq_it(IN_EDGE);
 		prog.multicast_msg(it, msg);
@@ -202,16 +173,15 @@ void diameter_vertex::run(vertex_program &prog, const page_vertex &vertex)
 	}
 }
 
-void diameter_vertex::notify_iteration_end(vertex_program &vprog)
+template<int NUM_WORDS>
+void diameter_vertex<NUM_WORDS>::notify_iteration_end(vertex_program &vprog)
 {
-	if (bfs_ids != new_bfs_ids) {
-		updated = true;
+	if (state.advance()) {
 		int iter_no = vprog.get_graph().get_curr_level() + 1;
 		max_dist = max(iter_no, max_dist);
-		((diameter_vertex_program<diameter_vertex> &) vprog).set_max_dist(
+		((diameter_vertex_program<diameter_vertex<NUM_WORDS> > &) vprog).set_max_dist(
 			vprog.get_vertex_id(*this), iter_no);
 	}
-	bfs_ids = new_bfs_ids;
 }
 
 class dist_compare
@@ -360,12 +330,29 @@ size_t estimate_diameter(FG_graph::ptr fg, int num_para_bfs, bool directed)
 	else
 		traverse_edge = edge_type::OUT_EDGE;
 
+	if (num_para_bfs > MAX_MS_BFS_SOURCES) {
+		BOOST_LOG_TRIVIAL(warning)
+			<< boost::format("we can run at most %1% BFS in parallel")
+			% MAX_MS_BFS_SOURCES;
+		num_bfs = MAX_MS_BFS_SOURCES;
+	}
+	int num_words = get_ms_bfs_num_words(num_bfs);
+
 	graph_index::ptr index;
 	if (num_bfs == 1)
 		index = NUMA_graph_index<simple_diameter_vertex>::create(
 				fg->get_graph_header());
+	else if (num_words == 1)
+		index = NUMA_graph_index<diameter_vertex<1> >::create(
+				fg->get_graph_header());
+	else if (num_words == 2)
+		index = NUMA_graph_index<diameter_vertex<2> >::create(
+				fg->get_graph_header());
+	else if (num_words == 4)
+		index = NUMA_graph_index<diameter_vertex<4> >::create(
+				fg->get_graph_header());
 	else
-		index = NUMA_graph_index<diameter_vertex>::create(
+		index = NUMA_graph_index<diameter_vertex<8> >::create(
 				fg->get_graph_header());
 	graph_engine::ptr graph = fg->create_engine(index);
 
@@ -397,11 +384,20 @@ size_t estimate_diameter(FG_graph::ptr fg, int num_para_bfs, bool directed)
 		}
 
 		std::vector<vertex_dist_t> max_dist_vertices;
-		if (start_vertices.size() == 1)
+		if (num_bfs == 1)
 			max_dist_vertices = estimate_diameter_1sweep<simple_diameter_vertex>(
 					graph, start_vertices);
+		else if (num_words == 1)
+			max_dist_vertices = estimate_diameter_1sweep<diameter_vertex<1> >(
+					graph, start_vertices);
+		else if (num_words == 2)
+			max_dist_vertices = estimate_diameter_1sweep<diameter_vertex<2> >(
+					graph, start_vertices);
+		else if (num_words == 4)
+			max_dist_vertices = estimate_diameter_1sweep<diameter_vertex<4> >(
+					graph, start_vertices);
 		else
-			max_dist_vertices = estimate_diameter_1sweep<diameter_vertex>(
+			max_dist_vertices = estimate_diameter_1sweep<diameter_vertex<8> >(
 					graph, start_vertices);
 
 		if (max_dist_vertices.empty()) {
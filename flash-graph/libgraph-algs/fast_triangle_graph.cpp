@@ -140,92 +140,10 @@ runtime_data_t *construct_runtime(vertex_program &prog, const page_vertex &verte
 size_t count_triangles(runtime_data_t *data, const page_vertex &v,
 		vertex_id_t this_id)
 {
-	size_t num_local_triangles = 0;
-
 	if (v.get_num_edges(neigh_edge_type) == 0)
 		return 0;
 
-	/*
-	 * We search for triangles with two different ways:
-	 * binary search if two adjacency lists have very different sizes,
-	 * scan otherwise.
-	 *
-	 * when binary search for multiple neighbors, we can reduce binary search
-	 * overhead by using the new end in the search range. We can further reduce
-	 * overhead by searching in a reverse order (start from the largest neighbor).
-	 * Since vertices of smaller ID has more neighbors, it's more likely
-	 * that a neighbor is in the beginning of the adjacency list, and
-	 * the search range will be narrowed faster.
-	 */
-
-	if (data->edge_set.size() > 0
-			&& data->edges.size() > HASH_SEARCH_RATIO * v.get_num_edges(
-				neigh_edge_type)) {
-		edge_iterator other_it = v.get_neigh_begin(neigh_edge_type);
-		edge_iterator other_end = v.get_neigh_end(neigh_edge_type);
-		for (; other_it != other_end; ++other_it) {
-			vertex_id_t neigh_neighbor = *other_it;
-			runtime_data_t::edge_set_t::const_iterator it
-				= data->edge_set.find(neigh_neighbor);
-			if (it != data->edge_set.end()) {
-				if (neigh_neighbor != v.get_id()
-						&& neigh_neighbor != this_id) {
-					num_local_triangles++;
-					int idx = (*it).get_idx();
-					data->triangles[idx]++;
-				}
-			}
-		}
-	}
-	// If the neighbor vertex has way more edges than this vertex.
-	else if (v.get_num_edges(neigh_edge_type) / data->edges.size(
-				) > BIN_SEARCH_RATIO) {
-		edge_iterator other_it = v.get_neigh_begin(neigh_edge_type);
-		edge_iterator other_end = v.get_neigh_end(neigh_edge_type);
-		for (int i = data->edges.size() - 1; i >= 0; i--) {
-			vertex_id_t this_neighbor = data->edges.at(i);
-			// We need to skip loops.
-			if (this_neighbor != v.get_id()
-					&& this_neighbor != this_id) {
-				edge_iterator first = std::lower_bound(other_it, other_end,
-						this_neighbor);
-				if (first != other_end && this_neighbor == *first) {
-					num_local_triangles++;
-					data->triangles[i]++;
-				}
-				other_end = first;
-			}
-		}
-	}
-	else {
-		std::vector<vertex_id_t>::const_iterator this_it = data->edges.begin();
-		std::vector<int>::iterator count_it = data->triangles.begin();
-		std::vector<vertex_id_t>::const_iterator this_end = data->edges.end();
-		edge_seq_iterator other_it = v.get_neigh_seq_it(neigh_edge_type, 0,
-					v.get_num_edges(neigh_edge_type));
-		while (this_it != this_end && other_it.has_next()) {
-			vertex_id_t this_neighbor = *this_it;
-			vertex_id_t neigh_neighbor = other_it.curr();
-			if (this_neighbor == neigh_neighbor) {
-				// skip loop
-				if (neigh_neighbor != v.get_id()
-						&& neigh_neighbor != this_id) {
-					num_local_triangles++;
-					(*count_it)++;
-				}
-				++this_it;
-				other_it.next();
-				++count_it;
-			}
-			else if (this_neighbor < neigh_neighbor) {
-				++this_it;
-				++count_it;
-			}
-			else
-				other_it.next();
-		}
-	}
-	return num_local_triangles;
+	return data->count_triangles(v, neigh_edge_type, this_id);
 }
 
 void directed_triangle_vertex::run_on_itself(vertex_program &prog,
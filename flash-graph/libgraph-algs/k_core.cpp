@@ -25,34 +25,37 @@
 #include <vector>
 #include <algorithm>
 
+#include <boost/foreach.hpp>
+
 #include "graph_engine.h"
 #include "graph_config.h"
+#include "vertex_buckets.h"
 #include "FGlib.h"
 #include "save_result.h"
 
 using namespace fg;
 
-vsize_t CURRENT_K; // Min degree necessary to be part of the k-core graph
-vsize_t PREVIOUS_K; 
-bool all_greater_than_core = true;
+/*
+ * The k-core decomposition peels vertices with the bucket structure.
+ * In each round, the vertices in the lowest non-empty bucket of degrees
+ * are deleted and their core is the bucket. They read their edge lists
+ * and notify their neighbors, so each edge list is read once in the whole
+ * decomposition.
+ */
+namespace {
 
-enum kcore_stage_t
-{
-	INIT_DEGREE,
-	KCORE,
-};
-kcore_stage_t stage;
+vsize_t CURRENT_K; // The bucket being peeled.
 
 class kcore_vertex: public compute_vertex
 {
 	bool deleted;
 	vsize_t core;
-	vsize_t degree; 
+	vsize_t degree;
 
 	public:
 	kcore_vertex(vertex_id_t id): compute_vertex(id) {
 		this->deleted = false;
-		this->core = -1;
+		this->core = 0;
 		this->degree = 0;
 	}
 
@@ -60,19 +63,15 @@ class kcore_vertex: public compute_vertex
 		return deleted;
 	}
 
-	void _delete() {
-		this->deleted = true;
-	}
-
-	void set_core(vsize_t core) {
-		this->core = core;
+	void init_degree(vsize_t degree) {
+		this->degree = degree;
 	}
 
 	const vsize_t get_core() const {
 		return this->core;
 	}
 
-	vsize_t get_degree() {
+	vsize_t get_degree() const {
 		return degree;
 	}
 
@@ -84,68 +83,86 @@ class kcore_vertex: public compute_vertex
 
 	void run(vertex_program &prog, const page_vertex &vertex);
 
-	void run_on_message(vertex_program &prog, const vertex_message &msg); 
+	void run_on_message(vertex_program &prog, const vertex_message &msg);
 
-	void run_on_vertex_header(vertex_program &prog, const vertex_header &header) {
-		degree = header.get_num_edges();
-		this->core = degree == 0 ? 0 :
-			degree == 1 ? 1 : -1; // Everyone between kmin < core > kmax will get this core
-		this->deleted = degree == 0 ? true : false; // If your degree you're already deleted
-	}
+	void notify_iteration_end(vertex_program &prog);
 };
 
-// If I am to be deleted, multicast this message to all my neighbors
-// and activate them
+/*
+ * The number of edges that a vertex loses. The messages to the same vertex
+ * are combined, so a vertex only updates its bucket once in a round.
+ */
 class deleted_message: public vertex_message
 {
+	vsize_t num;
 	public:
-		deleted_message(): vertex_message(sizeof(deleted_message), true) {
+		deleted_message(): vertex_message(sizeof(deleted_message), false) {
+			num = 1;
+		}
+
+		vsize_t get_num() const {
+			return num;
+		}
+
+		void add(vsize_t num) {
+			this->num += num;
 		}
 };
 
-void multicast_delete_msg(vertex_program &prog, 
-		const page_vertex &vertex, edge_type E)
+class deleted_msg_combiner: public vertex_msg_combiner
 {
-	int num_dests = vertex.get_num_edges(E);
-	edge_seq_iterator it = vertex.get_neigh_seq_it(E, 0, num_dests);
+public:
+	void combine(vertex_message &combined, const vertex_message &msg) const {
+		((deleted_message &) combined).add(
+				((const deleted_message &) msg).get_num());
+	}
+};
 
-	// Doesn't matter who sent it, just --degree on reception 
-	deleted_message msg;
-	prog.multicast_msg(it, msg);
-}
+class kcore_vertex_program: public vertex_program_impl<kcore_vertex>
+{
+	// The vertices whose degrees have decreased in the round.
+	std::vector<vertex_id_t> updated;
+public:
+	typedef std::shared_ptr<kcore_vertex_program> ptr;
 
-void kcore_vertex::run(vertex_program &prog) {
-	vertex_id_t id = prog.get_vertex_id(*this);
-	if (stage == INIT_DEGREE) {
-		request_vertex_headers(&id, 1);
-		return;
+	static ptr cast2(vertex_program::ptr prog) {
+		return std::static_pointer_cast<kcore_vertex_program, vertex_program>(
+				prog);
 	}
 
-	if ( degree > CURRENT_K ) { 
-		return; 
+	void add_updated(vertex_id_t id) {
+		updated.push_back(id);
 	}
 
-	if (!is_deleted()) {
-		request_vertices(&id, 1); // put my edgelist in page cache
-
-		if (all_greater_than_core) {
-			all_greater_than_core = false;
-		}
+	std::vector<vertex_id_t> &get_updated() {
+		return updated;
 	}
-}
+};
 
-void kcore_vertex::run(vertex_program &prog, const page_vertex &vertex) {
-	if (is_deleted()) {
-		return; // Nothing to be done here
+class kcore_vertex_program_creater: public vertex_program_creater
+{
+public:
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new kcore_vertex_program());
 	}
+};
 
-	if ( get_degree() < CURRENT_K ) {
-		set_core(CURRENT_K - 1); // This is true because you must make it past CURRENT_K-1 to be here
-		_delete();
+void kcore_vertex::run(vertex_program &prog) {
+	// The vertex is in the bucket being peeled, so its core is the bucket.
+	core = CURRENT_K;
+	deleted = true;
+	vertex_id_t id = prog.get_vertex_id(*this);
+	if (prog.get_graph().get_num_edges(id) > 0)
+		request_vertices(&id, 1);
+}
 
-		// Send two multicast messages - [IN_EDGE, OUT_EDGE] 
-		multicast_delete_msg(prog, vertex, IN_EDGE);
-		multicast_delete_msg(prog, vertex, OUT_EDGE);
+void kcore_vertex::run(vertex_program &prog, const page_vertex &vertex) {
+	deleted_message msg;
+	edge_seq_iterator it = vertex.get_neigh_seq_it(OUT_EDGE);
+	prog.multicast_msg(it, msg);
+	if (vertex.is_directed()) {
+		edge_seq_iterator in_it = vertex.get_neigh_seq_it(IN_EDGE);
+		prog.multicast_msg(in_it, msg);
 	}
 }
 
@@ -153,135 +170,50 @@ void kcore_vertex::run_on_message(vertex_program &prog, const vertex_message &ms
 	if (is_deleted()) {
 		return; // nothing to be done here
 	}
-	// else
-	degree--;
+	degree -= std::min(degree, ((const deleted_message &) msg).get_num());
+	prog.request_notify_iter_end(*this);
 }
 
-class count_vertex_query: public vertex_query
-{
-	size_t num;
-	public:
-	count_vertex_query() {
-		num = 0;
-	}
-
-	virtual void run(graph_engine &graph, compute_vertex &v) {
-		kcore_vertex &kcore_v = (kcore_vertex &) v;
-		if (!kcore_v.is_deleted())
-			num++;
-	}
-
-	virtual void merge(graph_engine &graph, vertex_query::ptr q) {
-		count_vertex_query *cvq = (count_vertex_query *) q.get();
-		num += cvq->num;
-	}
-
-	virtual ptr clone() {
-		return vertex_query::ptr(new count_vertex_query());
-	}
-
-	size_t get_num() const {
-		return num;
-	}
-};
+void kcore_vertex::notify_iteration_end(vertex_program &prog) {
+	((kcore_vertex_program &) prog).add_updated(prog.get_vertex_id(*this));
+}
 
-// Max degree corresponds to the highest core
-class max_degree_query: public vertex_query
+/*
+ * The state of the decomposition stored with checkpoints. The buckets
+ * are rebuilt from the degrees of the vertices when it's resumed.
+ */
+struct kcore_driver_state
 {
-	vsize_t max_degree;
-	public:
-	max_degree_query() {
-		max_degree = 0;
-	}
-
-	virtual void run(graph_engine &graph, compute_vertex &v) {
-		kcore_vertex& kv = (kcore_vertex&) v;
-		if ((kv.get_degree()) > max_degree) {
-			max_degree = kv.get_degree();
-		}
-	}
-
-	virtual void merge(graph_engine &graph, vertex_query::ptr q) {
-		max_degree_query *mdq = (max_degree_query *) q.get();
-		if (max_degree < mdq->max_degree) {
-			max_degree = mdq->max_degree;
-		}
-	}
+	uint64_t curr_k;
+	// The number of rounds when the checkpoint's run completes.
+	uint64_t num_rounds;
 
-	virtual ptr clone() {
-		return vertex_query::ptr(new max_degree_query());
+	kcore_driver_state(size_t curr_k, size_t num_rounds) {
+		this->curr_k = curr_k;
+		this->num_rounds = num_rounds;
 	}
 
-	vsize_t get_max_degree() const {
-		return max_degree;
+	std::vector<char> serialize() const {
+		return std::vector<char>((const char *) this,
+				(const char *) (this + 1));
 	}
 };
 
-// Figure out the lowest REMAINING degree in the graph
-class min_degree_query: public vertex_query
+class degree_initializer: public vertex_initializer
 {
-	vsize_t min_degree;
-	public:
-	min_degree_query() {
-		min_degree = std::numeric_limits<vsize_t>::max();
-	}
-
-	virtual void run(graph_engine &graph, compute_vertex &v) {
-		kcore_vertex kcore_v = (kcore_vertex&) v;
-		if (!kcore_v.is_deleted()) {
-			if (kcore_v.get_degree() < min_degree) {
-				min_degree = kcore_v.get_degree();
-			}
-		}
-	}
-
-	virtual void merge(graph_engine &graph, vertex_query::ptr q) {
-		min_degree_query *mdq = (min_degree_query *) q.get();
-		if (min_degree > mdq->min_degree) {
-			min_degree = mdq->min_degree;
-		}
+	graph_engine &graph;
+public:
+	degree_initializer(graph_engine &_graph): graph(_graph) {
 	}
 
-	virtual ptr clone() {
-		return vertex_query::ptr(new min_degree_query());
-	}
-
-	vsize_t get_min_degree() const {
-		return min_degree;
+	void init(compute_vertex &v) {
+		vertex_id_t id = graph.get_graph_index().get_vertex_id(v);
+		((kcore_vertex &) v).init_degree(graph.get_num_edges(id));
 	}
 };
 
-// Helpers
-void print_func(vertex_id_t i) {
-	std::cout << " " << i;
-}
-void print_active(std::vector<vertex_id_t> v) {
-	std::cout << "[";
-	for_each (v.begin(), v.end(), print_func);
-	std::cout <<  " ]\n";
-}
-// End Helpers
-
-void set_kmax(graph_engine::ptr graph, size_t& kmax)
-{
-	BOOST_LOG_TRIVIAL(info) << "Computing kmax as max_degree ...";
-	vertex_query::ptr mdq(new max_degree_query());
-	graph->query_on_all(mdq); 
-	kmax = ((max_degree_query *) mdq.get())->get_max_degree();
 }
 
-class activate_k_filter: public vertex_filter {
-	vsize_t min;
-	public:
-	activate_k_filter (vsize_t min) {
-		this->min = min;
-	}
-	bool keep(vertex_program &prog, compute_vertex &v) {
-		kcore_vertex &kcore_v = (kcore_vertex &) v;
-		return kcore_v.get_degree() < min;
-	}
-};
-
 namespace fg
 {
 
@@ -301,69 +233,90 @@ FG_vector<size_t>::ptr compute_kcore(FG_graph::ptr fg,
 	struct timeval start, end;
 	gettimeofday(&start, NULL);
 
-	CURRENT_K = k;
-	BOOST_LOG_TRIVIAL(info) << "Running the init degree stage ...";
-	stage = INIT_DEGREE;
-	graph->start_all(); 
-	graph->wait4complete();
-	stage = KCORE;
-
-	if (kmax == 0 && k != 0) {
-		set_kmax(graph, kmax);
-	}
-	BOOST_LOG_TRIVIAL(info) << "Setting kmax as " << kmax;
-
-
-	for (; CURRENT_K <= kmax; CURRENT_K++) {
-
-		std::shared_ptr<vertex_filter> filter
-			= std::shared_ptr<vertex_filter>(new activate_k_filter(CURRENT_K));
-
-		graph->start(filter, vertex_program_creater::ptr()); 
+	// The degrees are in the in-memory vertex index, so we don't need
+	// to read the vertex headers.
+	graph->init_all_vertices(vertex_initializer::ptr(
+				new degree_initializer(*graph)));
+	graph->set_msg_combiner(vertex_msg_combiner::ptr(
+				new deleted_msg_combiner()));
+
+	// Resume the decomposition from the last checkpoint. If the checkpoint
+	// was taken in the middle of a round, the round completes first.
+	size_t num_rounds = 0;
+	std::vector<char> ckpt_state;
+	if (graph->get_checkpoint_driver_state(ckpt_state)) {
+		if (ckpt_state.size() == sizeof(kcore_driver_state)) {
+			const kcore_driver_state *state
+				= (const kcore_driver_state *) ckpt_state.data();
+			CURRENT_K = state->curr_k;
+			num_rounds = state->num_rounds;
+			graph->resume(vertex_program_creater::ptr(
+						new kcore_vertex_program_creater()));
+			graph->wait4complete();
+			BOOST_LOG_TRIVIAL(info) << boost::format(
+					"K-core resumes after %1% rounds at core %2%")
+				% num_rounds % CURRENT_K;
+		}
+		else
+			BOOST_LOG_TRIVIAL(warning)
+				<< "The checkpoint isn't from k-core, start from scratch";
+	}
+
+	graph_engine &engine = *graph;
+	vertex_buckets buckets(graph->get_num_vertices(),
+			[&engine](vertex_id_t id) -> size_t {
+				kcore_vertex &v = (kcore_vertex &) engine.get_vertex(id);
+				if (v.is_deleted())
+					return vertex_buckets::NULL_BUCKET;
+				return v.get_degree();
+			});
+
+	size_t bucket;
+	std::vector<vertex_id_t> ids;
+	std::vector<vertex_program::ptr> progs;
+	while ((bucket = buckets.next_bucket(ids)) != vertex_buckets::NULL_BUCKET) {
+		if (kmax > 0 && bucket > kmax) {
+			BOOST_LOG_TRIVIAL(info) << "Terminating computation at kmax";
+			break;
+		}
+		CURRENT_K = bucket;
+		graph->set_driver_state(kcore_driver_state(CURRENT_K,
+					num_rounds + 1).serialize());
+		graph->start(ids.data(), ids.size(), vertex_initializer::ptr(),
+				vertex_program_creater::ptr(new kcore_vertex_program_creater()));
 		graph->wait4complete();
-
-		if (all_greater_than_core) { // There's a chance we can hop forward
-			vertex_query::ptr mdq(new min_degree_query());
-			graph->query_on_all(mdq);
-			vsize_t min_degree_remaining = ((min_degree_query *) mdq.get())->get_min_degree();
-
-			if (min_degree_remaining == std::numeric_limits<vsize_t>::max()) {
-				BOOST_LOG_TRIVIAL(info) << "No more active vertices left!";
-				break;
-			}
-
-			BOOST_LOG_TRIVIAL(info)
-				<< "The graphs minimum degree remaining is " << min_degree_remaining;
-			// Effectively jumps us to the CURRENT_K + 1th core
-			CURRENT_K = min_degree_remaining; // NOTE: Careful - messing with the loop variable :/
-
-			if (CURRENT_K > kmax) {
-				BOOST_LOG_TRIVIAL(info) << "Terminating computation at kmax";
-				break;
-			}
+		num_rounds++;
+
+		progs.clear();
+		graph->get_vertex_programs(progs);
+		BOOST_FOREACH(vertex_program::ptr prog, progs) {
+			std::vector<vertex_id_t> &updated
+				= kcore_vertex_program::cast2(prog)->get_updated();
+			buckets.update(updated.data(), updated.size());
+			updated.clear();
 		}
-		all_greater_than_core = true;
-
-#if 1
-		vertex_query::ptr cvq(new count_vertex_query());
-		graph->query_on_all(cvq);
-		size_t in_k_core = ((count_vertex_query *) cvq.get())->get_num();
-		BOOST_LOG_TRIVIAL(info)
-			<< boost::format("%1%-core shows %2% vertices > %3% degree")
-			% CURRENT_K % in_k_core % CURRENT_K;
-#endif
-		PREVIOUS_K = CURRENT_K;
+		// A round usually takes one level, so we checkpoint between rounds.
+		if (num_rounds % graph_conf.get_checkpoint_interval() == 0)
+			graph->save_checkpoint(kcore_driver_state(CURRENT_K,
+						num_rounds).serialize());
 	}
 
 	gettimeofday(&end, NULL);
 	BOOST_LOG_TRIVIAL(info)
-		<< boost::format("K-core took %1% sec to complete") % time_diff(start, end);
+		<< boost::format("K-core took %1% sec to complete, %2% rounds, the max core is %3%")
+		% time_diff(start, end) % num_rounds % CURRENT_K;
 
 	FG_vector<size_t>::ptr ret = FG_vector<size_t>::create(
 			graph->get_num_vertices());
 
 	graph->query_on_all(vertex_query::ptr(
 				new save_query<size_t, kcore_vertex>(ret)));
+	// Only the cores between `k' and `kmax' are reported.
+	size_t *data = ret->get_data();
+#pragma omp parallel for
+	for (size_t i = 0; i < ret->get_size(); i++)
+		if (data[i] < k || (kmax > 0 && data[i] > kmax))
+			data[i] = 0;
 
 	return ret;
 }
@@ -61,23 +61,17 @@ public:
 	size_t count_edges(const page_vertex *v);
 
 	off_t find_idx(vertex_id_t id) const {
-		edge_set_t::const_iterator it = neighbor_set->find(id);
-		if (it == neighbor_set->end())
-			return -1;
-		else {
-			size_t idx = (*it).get_idx();
-			assert(idx < id_list.size());
-			return idx;
-		}
+		off_t idx = neighbor_set.find_idx(id);
+		assert(idx < (off_t) id_list.size());
+		return idx;
 	}
 
 	attributed_neighbor find(vertex_id_t id) const {
-		edge_set_t::const_iterator it = neighbor_set->find(id);
-		if (it == neighbor_set->end())
+		off_t idx = neighbor_set.find_idx(id);
+		if (idx < 0)
 			return attributed_neighbor();
 		else {
-			size_t idx = (*it).get_idx();
-			assert(idx < id_list.size());
+			assert(idx < (off_t) id_list.size());
 			return at(idx);
 		}
 	}
@@ -20,430 +20,733 @@
 #include <gperftools/profiler.h>
 #endif
 
-#include <limits>
+#include <omp.h>
+
 #include <vector>
-#include <map>
-#include <algorithm>
 #include <atomic>
+#include <algorithm>
 
-#include "thread.h"
-#include "io_interface.h"
-#include "container.h"
-#include "concurrency.h"
+#include <boost/foreach.hpp>
 
-#include "vertex_index.h"
 #include "graph_engine.h"
 #include "graph_config.h"
 #include "FGlib.h"
 #include "FG_vector.h"
-#include "save_result.h"
 
 using namespace fg;
 
-// NOTE: This routine is only meant for undirected graphs!!!
+/*
+ * This is the multi-level Louvain method. The first level runs on
+ * the graph in SAFS with the graph engine. The communities found in
+ * the level are collapsed into the vertices of a coarse graph, which
+ * is built by streaming the edge lists from SSDs once more and only keeps
+ * the aggregated edges between communities in memory. The following levels
+ * run on the coarse graphs in memory with OpenMP.
+ *
+ * A directed graph is treated as an undirected graph, i.e., an edge
+ * connects both of its end vertices.
+ */
 namespace {
-	// INIT lets us accumulate
-	enum stage_t
-	{
-		INIT,
-		RUN,
-		REBUILD,
-	};
 
-	template <typename T>
-		class atomicwrapper
-		{
-			private:
-				std::atomic<T> _a;
+typedef uint64_t weight_t;
 
-			public:
-				atomicwrapper() :_a() {}
+const uint32_t INVALID_POS = std::numeric_limits<uint32_t>::max();
 
-				atomicwrapper(const std::atomic<T> &a) :_a(a.load()) {}
+/*
+ * The scratch space of a thread to accumulate the weights of the edges
+ * from a vertex to the communities of its neighbors.
+ * Instead of a hash table, it has a dense array indexed by community IDs,
+ * which stores the location of a community in the list of the communities
+ * touched by the vertex. Only the touched entries are reset afterwards,
+ * so it costs O(#neighbors) per vertex, and the gains of all candidate
+ * communities are computed in a tight loop over contiguous arrays.
+ */
+class community_scratch
+{
+	std::vector<uint32_t> locs;
+	std::vector<vertex_id_t> comms;
+	std::vector<weight_t> weights;
+	std::vector<double> gains;
+public:
+	community_scratch(size_t num_comms): locs(num_comms, INVALID_POS) {
+	}
 
-				atomicwrapper(const atomicwrapper &other) :_a(other._a.load()) {}
+	void add(vertex_id_t comm, weight_t weight) {
+		uint32_t &loc = locs[comm];
+		if (loc == INVALID_POS) {
+			loc = comms.size();
+			comms.push_back(comm);
+			weights.push_back(0);
+		}
+		weights[loc] += weight;
+	}
 
-				atomicwrapper &operator=(const atomicwrapper &other) {
-					_a.store(other._a.load());
-					return *this;
-				}
+	size_t get_num_comms() const {
+		return comms.size();
+	}
 
-				T get() {
-					return _a;
-				}
+	size_t get_loc(vertex_id_t comm) const {
+		assert(locs[comm] != INVALID_POS);
+		return locs[comm];
+	}
 
-				void assign(T val) {
-					_a = val;
-				}
+	const vertex_id_t *get_comms() const {
+		return comms.data();
+	}
 
-				void minus_eq(T val) {
-					_a -= val;
-				}
+	const weight_t *get_weights() const {
+		return weights.data();
+	}
 
-				void plus_eq(T val) {
-					_a += val;
-				}
-		};
+	double *get_gains() {
+		gains.resize(comms.size());
+		return gains.data();
+	}
 
-	template <typename T>
-		static void print_atomicwrapper_v(std::vector<atomicwrapper<T>>& v ) {
+	void clear() {
+		BOOST_FOREACH(vertex_id_t comm, comms)
+			locs[comm] = INVALID_POS;
+		comms.clear();
+		weights.clear();
+	}
+};
 
-			std::cout << "[ ";
-			for (typename std::vector<atomicwrapper<T>>::iterator it = v.begin(); it != v.end(); ++it)  {
-				std::cout << it->get() << " ";
-			}
-			std::cout << "]\n";
+/*
+ * The communities of the vertices in a level. All threads move vertices
+ * between communities concurrently, so the community of a vertex and
+ * the total degree and the size of a community are atomic.
+ */
+class community_state
+{
+	std::vector<std::atomic<vertex_id_t> > comms;
+	std::vector<std::atomic<weight_t> > tots;
+	std::vector<std::atomic<vsize_t> > sizes;
+	std::vector<weight_t> degrees;
+	// Twice the total weight of the edges.
+	double m2;
+public:
+	community_state(size_t num_vertices): comms(num_vertices), tots(
+			num_vertices), sizes(num_vertices), degrees(num_vertices) {
+		// Each vertex starts in its own community.
+#pragma omp parallel for
+		for (size_t i = 0; i < num_vertices; i++) {
+			comms[i].store(i, std::memory_order_relaxed);
+			tots[i].store(0, std::memory_order_relaxed);
+			sizes[i].store(1, std::memory_order_relaxed);
 		}
+		m2 = 0;
+	}
 
-	// Global map from cluster_id : cluster(volume, weight)
-	std::vector<atomicwrapper<uint32_t>> g_weight_vec;
-	std::vector<atomicwrapper<uint32_t>> g_volume_vec;
-
-	typedef safs::page_byte_array::seq_const_iterator<edge_count> data_seq_iterator;
-	typedef vertex_id_t cluster_id_t;
+	size_t get_num_vertices() const {
+		return comms.size();
+	}
 
+	void set_degree(vertex_id_t id, weight_t degree) {
+		degrees[id] = degree;
+		tots[id].store(degree, std::memory_order_relaxed);
+	}
 
-	uint64_t g_edge_weight = 0;
-	bool g_changed = false;
-	stage_t louvain_stage = INIT; // Init the stage
+	void set_tot_weight(double m2) {
+		this->m2 = m2;
+	}
 
-	// If anything changes cluster we cannot converge
-	static void set_changed(bool changed) {
-		if (!changed) // Only once per iter so no prob with this
-			g_changed = changed;
-		if (changed && (!g_changed))
-			g_changed = changed;
+	vertex_id_t get_comm(vertex_id_t id) const {
+		return comms[id].load(std::memory_order_relaxed);
 	}
 
-	// Easy printer for cluster
-	template<typename T>
-		static void print_vector(typename std::vector<T>& v) {
-			std::cout << "[ ";
-			for (typename std::vector<T>::iterator it = v.begin(); it != v.end(); ++it) {
-				std::cout << *it << " ";
-			}
-			std::cout << "]\n";
-		}
+	bool try_move(vertex_id_t id, community_scratch &scratch);
+	size_t renumber(std::vector<vertex_id_t> &new_ids) const;
+};
 
-	class louvain_vertex: public compute_vertex
-	{
-		cluster_id_t cluster_id; // current cluster
-		cluster_id_t next_cluster_id; // current cluster
-		float max_modularity; // max modularity to any cluster
-		uint32_t weight;
-		uint32_t volume;
-		bool update_globals;
-
-		public:
-		louvain_vertex(vertex_id_t id): compute_vertex(id) {
-			cluster_id = id;
-			next_cluster_id = id;
-			max_modularity = 0;
-			weight = 0;
-			volume = 0;
-			update_globals = false;
-		}
+/*
+ * Move a vertex to the neighboring community with the largest modularity
+ * gain. The scratch space has the weights of the edges from the vertex to
+ * the communities of its neighbors, excluding the vertex itself.
+ * The scratch space is cleared afterwards.
+ */
+bool community_state::try_move(vertex_id_t id, community_scratch &scratch)
+{
+	vertex_id_t cur = get_comm(id);
+	weight_t degree = degrees[id];
+	// Staying in the current community is always a candidate.
+	scratch.add(cur, 0);
+	size_t num = scratch.get_num_comms();
+	const vertex_id_t *neigh_comms = scratch.get_comms();
+	const weight_t *neigh_weights = scratch.get_weights();
+	double *gains = scratch.get_gains();
+	// Moving the vertex to community c changes the modularity by
+	// (w_c - degree * tot_c / m2) * 2 / m2 after it's removed from its
+	// own community, where w_c is the weight of the edges to c.
+	for (size_t i = 0; i < num; i++)
+		gains[i] = tots[neigh_comms[i]].load(std::memory_order_relaxed);
+	double scale = degree / m2;
+	for (size_t i = 0; i < num; i++)
+		gains[i] = neigh_weights[i] - scale * gains[i];
+	size_t cur_loc = scratch.get_loc(cur);
+	// The vertex itself isn't counted in its own community.
+	gains[cur_loc] += scale * degree;
+	size_t best_loc = cur_loc;
+	for (size_t i = 0; i < num; i++)
+		if (gains[i] > gains[best_loc])
+			best_loc = i;
+	vertex_id_t target = neigh_comms[best_loc];
+	scratch.clear();
+	if (target == cur)
+		return false;
+
+	// Two vertices that are alone in their communities may join each
+	// other's community at the same time, and they would swap forever.
+	// A singleton only joins another singleton with a smaller ID.
+	if (target > cur && sizes[cur].load(std::memory_order_relaxed) == 1
+			&& sizes[target].load(std::memory_order_relaxed) == 1)
+		return false;
+	tots[cur].fetch_sub(degree, std::memory_order_relaxed);
+	tots[target].fetch_add(degree, std::memory_order_relaxed);
+	sizes[cur].fetch_sub(1, std::memory_order_relaxed);
+	sizes[target].fetch_add(1, std::memory_order_relaxed);
+	comms[id].store(target, std::memory_order_relaxed);
+	return true;
+}
 
-		void run(vertex_program &prog) {
-			if (update_globals) {
-				if (cluster_id != next_cluster_id)
-					switch_clusters();
-				else
-					BOOST_LOG_TRIVIAL(info) << "ignoring ...";
-				update_globals = false;
-			} else {
-				vertex_id_t id = prog.get_vertex_id(*this);
-				request_vertices(&id, 1);
-			}
-		}
+/*
+ * Give the non-empty communities consecutive IDs.
+ * It returns the number of non-empty communities.
+ */
+size_t community_state::renumber(std::vector<vertex_id_t> &new_ids) const
+{
+	new_ids.resize(comms.size());
+	size_t num_comms = 0;
+	for (size_t i = 0; i < comms.size(); i++) {
+		if (sizes[i].load(std::memory_order_relaxed) > 0)
+			new_ids[i] = num_comms++;
+		else
+			new_ids[i] = INVALID_VERTEX_ID;
+	}
+	return num_comms;
+}
 
-		void run(vertex_program &prog, const page_vertex &vertex);
-		void run_on_message(vertex_program &prog, const vertex_message &msg1);
+struct coarse_edge
+{
+	vertex_id_t src;
+	vertex_id_t dst;
+	weight_t weight;
+
+	coarse_edge(vertex_id_t src, vertex_id_t dst, weight_t weight) {
+		this->src = src;
+		this->dst = dst;
+		this->weight = weight;
+	}
+};
 
-		void compute_modularity(cluster_id_t neigh_cluster_id, vertex_id_t my_id, vertex_program& prog);
-		void compute_per_vertex_vol_weight(data_seq_iterator& weight_it, edge_seq_iterator& id_it, 
-				vertex_program &prog);
-		void compute_per_cluster_vol_weight(vertex_program &prog);
+/*
+ * A coarse graph in memory in the CSR format. Each vertex is a community
+ * of the previous level. A vertex has an edge to itself whose weight is
+ * the total weight of the edges inside the community (counted from both
+ * ends), so the degree of a vertex is the total degree of the community.
+ */
+class csr_graph
+{
+	std::vector<size_t> offs;
+	std::vector<vertex_id_t> neighs;
+	std::vector<weight_t> weights;
+public:
+	typedef std::shared_ptr<csr_graph> ptr;
 
-		// Used for save_query join
-		const cluster_id_t get_result() const {
-			return cluster_id;
-		}
+	static ptr create(std::vector<std::vector<coarse_edge> *> &parts,
+			size_t num_vertices);
 
-		// Remove vertex from old cluster 
-		void switch_clusters () {
-			BOOST_LOG_TRIVIAL(info) << " Switching! Moving from c" << cluster_id << " to c" << next_cluster_id;
-			g_weight_vec[cluster_id].minus_eq(weight);
-			g_volume_vec[cluster_id].minus_eq(volume);
+	size_t get_num_vertices() const {
+		return offs.size() - 1;
+	}
 
-			cluster_id = next_cluster_id;
-			g_weight_vec[cluster_id].plus_eq(weight);
-			g_volume_vec[cluster_id].plus_eq(volume);
-		}
+	size_t get_num_edges() const {
+		return neighs.size();
+	}
+
+	size_t get_begin(vertex_id_t id) const {
+		return offs[id];
+	}
 
-		//void notify_iteration_end(vertex_program &vprog);
+	size_t get_end(vertex_id_t id) const {
+		return offs[id + 1];
+	}
 
-	};
+	vertex_id_t get_neighbor(size_t idx) const {
+		return neighs[idx];
+	}
 
-	/* We need this to get the total edge_weight of the graph */
-	class init_vertex_program: public vertex_program_impl<louvain_vertex>
-	{
-		// Thread local
-		edge_count th_local_edge_count; // For the global edge count
+	weight_t get_weight(size_t idx) const {
+		return weights[idx];
+	}
 
-		public:
-		init_vertex_program() {
-			th_local_edge_count = 0;
-		}
+	weight_t get_degree(vertex_id_t id) const {
+		weight_t degree = 0;
+		for (size_t i = offs[id]; i < offs[id + 1]; i++)
+			degree += weights[i];
+		return degree;
+	}
 
-		typedef std::shared_ptr<init_vertex_program> ptr;
+	double get_modularity(double m2) const;
+};
 
-		static ptr cast2(vertex_program::ptr prog) {
-			return std::static_pointer_cast<init_vertex_program, vertex_program>(prog);
+/*
+ * Build a coarse graph from the edges between communities. There may be
+ * multiple edges between two communities, and their weights are summed.
+ * The edges in `parts' are freed.
+ */
+csr_graph::ptr csr_graph::create(std::vector<std::vector<coarse_edge> *> &parts,
+		size_t num_vertices)
+{
+	// Place the edges by their source vertices.
+	std::vector<std::atomic<size_t> > locs(num_vertices);
+#pragma omp parallel for
+	for (size_t i = 0; i < num_vertices; i++)
+		locs[i].store(0, std::memory_order_relaxed);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (size_t i = 0; i < parts.size(); i++)
+		BOOST_FOREACH(const coarse_edge &e, *parts[i])
+			locs[e.src].fetch_add(1, std::memory_order_relaxed);
+	std::vector<size_t> tmp_offs(num_vertices + 1);
+	tmp_offs[0] = 0;
+	for (size_t i = 0; i < num_vertices; i++) {
+		tmp_offs[i + 1] = tmp_offs[i] + locs[i].load(std::memory_order_relaxed);
+		locs[i].store(tmp_offs[i], std::memory_order_relaxed);
+	}
+	std::vector<vertex_id_t> tmp_neighs(tmp_offs[num_vertices]);
+	std::vector<weight_t> tmp_weights(tmp_offs[num_vertices]);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (size_t i = 0; i < parts.size(); i++) {
+		BOOST_FOREACH(const coarse_edge &e, *parts[i]) {
+			size_t loc = locs[e.src].fetch_add(1, std::memory_order_relaxed);
+			tmp_neighs[loc] = e.dst;
+			tmp_weights[loc] = e.weight;
 		}
+		std::vector<coarse_edge>().swap(*parts[i]);
+	}
 
-		void pp_ec(edge_count weight) {
-			this->th_local_edge_count += weight;
+	// Merge the edges to the same neighbor in place.
+	std::vector<size_t> lens(num_vertices);
+#pragma omp parallel
+	{
+		community_scratch scratch(num_vertices);
+#pragma omp for schedule(dynamic, 1024)
+		for (size_t i = 0; i < num_vertices; i++) {
+			for (size_t j = tmp_offs[i]; j < tmp_offs[i + 1]; j++)
+				scratch.add(tmp_neighs[j], tmp_weights[j]);
+			size_t num = scratch.get_num_comms();
+			memcpy(&tmp_neighs[tmp_offs[i]], scratch.get_comms(),
+					sizeof(vertex_id_t) * num);
+			memcpy(&tmp_weights[tmp_offs[i]], scratch.get_weights(),
+					sizeof(weight_t) * num);
+			lens[i] = num;
+			scratch.clear();
 		}
+	}
 
-		const uint32_t get_local_ec() const {
-			return th_local_edge_count.get_count();
+	ptr g(new csr_graph());
+	g->offs.resize(num_vertices + 1);
+	g->offs[0] = 0;
+	for (size_t i = 0; i < num_vertices; i++)
+		g->offs[i + 1] = g->offs[i] + lens[i];
+	g->neighs.resize(g->offs[num_vertices]);
+	g->weights.resize(g->offs[num_vertices]);
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (size_t i = 0; i < num_vertices; i++) {
+		memcpy(&g->neighs[g->offs[i]], &tmp_neighs[tmp_offs[i]],
+				sizeof(vertex_id_t) * lens[i]);
+		memcpy(&g->weights[g->offs[i]], &tmp_weights[tmp_offs[i]],
+				sizeof(weight_t) * lens[i]);
+	}
+	return g;
+}
+
+/*
+ * The modularity of the communities represented by the vertices.
+ */
+double csr_graph::get_modularity(double m2) const
+{
+	double modularity = 0;
+#pragma omp parallel for reduction(+:modularity)
+	for (size_t i = 0; i < get_num_vertices(); i++) {
+		weight_t in_weight = 0;
+		weight_t degree = 0;
+		for (size_t j = offs[i]; j < offs[i + 1]; j++) {
+			if (neighs[j] == i)
+				in_weight = weights[j];
+			degree += weights[j];
 		}
-	};
+		modularity += in_weight / m2 - (degree / m2) * (degree / m2);
+	}
+	return modularity;
+}
 
-	/* We need this to do the INIT phase and pass vertex_program_impl to the start method */
-	class init_vertex_program_creater: public vertex_program_creater
-	{
-		public:
-			vertex_program::ptr create() const {
-				return vertex_program::ptr(new init_vertex_program());
+/*
+ * Move the vertices of a coarse graph until no vertex moves or
+ * the number of iterations reaches the limit.
+ * It returns the number of moves.
+ */
+size_t move_vertices(const csr_graph &g, community_state &state, int max_iters)
+{
+	size_t tot_moves = 0;
+	for (int iter = 0; iter < max_iters; iter++) {
+		size_t num_moves = 0;
+#pragma omp parallel reduction(+:num_moves)
+		{
+			community_scratch scratch(g.get_num_vertices());
+#pragma omp for schedule(dynamic, 1024)
+			for (size_t i = 0; i < g.get_num_vertices(); i++) {
+				for (size_t j = g.get_begin(i); j < g.get_end(i); j++) {
+					vertex_id_t neigh = g.get_neighbor(j);
+					if (neigh != i)
+						scratch.add(state.get_comm(neigh), g.get_weight(j));
+				}
+				if (state.try_move(i, scratch))
+					num_moves++;
 			}
-	};
+		}
+		tot_moves += num_moves;
+		if (num_moves == 0)
+			break;
+	}
+	return tot_moves;
+}
 
-	class cluster_message: public vertex_message
+/*
+ * Collapse the communities of a coarse graph into a new coarse graph.
+ */
+csr_graph::ptr coarsen(const csr_graph &g, const community_state &state,
+		const std::vector<vertex_id_t> &new_ids, size_t num_comms)
+{
+	int num_threads = omp_get_max_threads();
+	std::vector<std::vector<coarse_edge> > edges(num_threads);
+#pragma omp parallel num_threads(num_threads)
 	{
-		cluster_id_t sender_cluster_id;
+		community_scratch scratch(num_comms);
+		std::vector<coarse_edge> &local_edges = edges[omp_get_thread_num()];
+#pragma omp for schedule(dynamic, 1024)
+		for (size_t i = 0; i < g.get_num_vertices(); i++) {
+			for (size_t j = g.get_begin(i); j < g.get_end(i); j++)
+				scratch.add(new_ids[state.get_comm(g.get_neighbor(j))],
+						g.get_weight(j));
+			vertex_id_t src = new_ids[state.get_comm(i)];
+			for (size_t k = 0; k < scratch.get_num_comms(); k++)
+				local_edges.push_back(coarse_edge(src, scratch.get_comms()[k],
+							scratch.get_weights()[k]));
+			scratch.clear();
+		}
+	}
+	std::vector<std::vector<coarse_edge> *> parts;
+	for (int i = 0; i < num_threads; i++)
+		parts.push_back(&edges[i]);
+	return csr_graph::create(parts, num_comms);
+}
 
-		public:
-		cluster_message(cluster_id_t cluster_id):
-			vertex_message(sizeof(cluster_message), true)	{
-				this->sender_cluster_id = cluster_id;
+/*
+ * The first level runs in the graph engine in three stages:
+ * computing the degrees of vertices, moving vertices between communities
+ * and collapsing the communities.
+ */
+enum louvain_stage_t
+{
+	DEGREE,
+	MOVE,
+	COARSEN,
+};
+
+louvain_stage_t louvain_stage;
+// Whether the edges have the number of duplicated edges as weights.
+bool weighted;
+int max_iters;
+community_state *state;
+// The IDs of the communities in the coarse graph.
+const std::vector<vertex_id_t> *coarse_ids;
+
+/*
+ * Apply a function to all edges of a vertex with their weights.
+ */
+template<class Func>
+void for_each_edge(const page_vertex &vertex, Func func)
+{
+	typedef safs::page_byte_array::seq_const_iterator<edge_count> data_seq_iterator;
+	if (vertex.is_directed()) {
+		const page_directed_vertex &dvertex
+			= (const page_directed_vertex &) vertex;
+		edge_type types[2] = {edge_type::IN_EDGE, edge_type::OUT_EDGE};
+		for (int i = 0; i < 2; i++) {
+			edge_seq_iterator it = dvertex.get_neigh_seq_it(types[i]);
+			if (weighted) {
+				data_seq_iterator data_it
+					= dvertex.get_data_seq_it<edge_count>(types[i]);
+				while (it.has_next())
+					func(it.next(), data_it.next().get_count());
+			}
+			else {
+				while (it.has_next())
+					func(it.next(), 1);
 			}
-
-		const cluster_id_t get_sender_cluster_id() const {
-			return sender_cluster_id;
 		}
-	};
-
-	void louvain_vertex::run(vertex_program &prog, const page_vertex &vertex) {
-		switch (louvain_stage) {
-			case INIT: /* INIT just accums the global edge_count */
-				{
-					// Out edges
-					data_seq_iterator weight_it = 
-						((const page_directed_vertex&)vertex).get_data_seq_it<edge_count>(OUT_EDGE);
-					edge_seq_iterator id_it = vertex.get_neigh_seq_it(OUT_EDGE);
-					compute_per_vertex_vol_weight(weight_it, id_it, prog);
-
-					// In edges
-					weight_it = ((const page_directed_vertex&)vertex).
-						get_data_seq_it<edge_count>(IN_EDGE);
-					id_it = vertex.get_neigh_seq_it(IN_EDGE);
-					compute_per_vertex_vol_weight(weight_it, id_it, prog);
-				}
-				break;
-			case RUN:
-				{
-					// Broadcast cluster_id to all my neighbors then rely on run_on_message
-					// Out edges
-					edge_seq_iterator id_it = vertex.get_neigh_seq_it(OUT_EDGE);
-					cluster_message out_msg(this->cluster_id);
-					prog.multicast_msg(id_it, out_msg);
-
-					// In edges
-					id_it = vertex.get_neigh_seq_it(IN_EDGE);
-					cluster_message in_msg(this->cluster_id);
-					prog.multicast_msg(id_it, in_msg);
-				}
-				break;
-			default:
-				assert(0);
+	}
+	else {
+		const page_undirected_vertex &uvertex
+			= (const page_undirected_vertex &) vertex;
+		edge_seq_iterator it = uvertex.get_neigh_seq_it(edge_type::OUT_EDGE);
+		if (weighted) {
+			data_seq_iterator data_it = uvertex.get_data_seq_it<edge_count>();
+			while (it.has_next())
+				func(it.next(), data_it.next().get_count());
+		}
+		else {
+			while (it.has_next())
+				func(it.next(), 1);
 		}
 	}
+}
 
-	void louvain_vertex::run_on_message(vertex_program &prog, const vertex_message &msg1) {
+class louvain_vertex: public compute_vertex
+{
+public:
+	louvain_vertex(vertex_id_t id): compute_vertex(id) {
+	}
 
-		if (!update_globals) 
-			update_globals = true;
+	void run(vertex_program &prog) {
+		vertex_id_t id = prog.get_vertex_id(*this);
+		request_vertices(&id, 1);
+	}
 
-		const cluster_message& msg = (const cluster_message& ) msg1;
-		if (msg.get_sender_cluster_id() == next_cluster_id) { 
-			return; // Ignore since my cluster will not change
-		} else {
-			// This may update the next_cluster_id and max_modularity values
-			compute_modularity(msg.get_sender_cluster_id(), prog.get_vertex_id(*this), prog);
+	void run(vertex_program &prog, const page_vertex &vertex);
 
-		}
+	void run_on_message(vertex_program &, const vertex_message &) {
 	}
+};
 
-	// Tradeoff by iterating through neighbors, instead of the min computation which is every cluster.
-	void louvain_vertex::compute_modularity(cluster_id_t neigh_cluster_id, vertex_id_t my_id, vertex_program& prog) {
+class louvain_vertex_program: public vertex_program_impl<louvain_vertex>
+{
+	community_scratch scratch;
+	std::vector<coarse_edge> edges;
+	weight_t tot_weight;
+	size_t num_moves;
+public:
+	typedef std::shared_ptr<louvain_vertex_program> ptr;
+
+	static ptr cast2(vertex_program::ptr prog) {
+		return std::static_pointer_cast<louvain_vertex_program,
+			   vertex_program>(prog);
+	}
 
-		// TODO: Remove divisions & hope for no overflow
-		float delta_mod = ((int)(g_weight_vec[neigh_cluster_id].get() - 
-					(g_weight_vec[this->next_cluster_id].get() - this->weight)) / (float) g_edge_weight) +
-			(((int)((g_volume_vec[this->next_cluster_id].get() - this->volume) - g_volume_vec[neigh_cluster_id].get()) 
-			  * (int)this->volume) / (float)(2*(g_edge_weight*g_edge_weight)));
+	louvain_vertex_program(size_t num_comms): scratch(num_comms) {
+		tot_weight = 0;
+		num_moves = 0;
+	}
 
-		if (delta_mod > this->max_modularity) {
-#if 1
-			/** DEBUG **/
-			BOOST_LOG_TRIVIAL(info) << "v" << my_id << " tentative move from c" <<  cluster_id << " to c"
-				<< neigh_cluster_id << ", delta_mod="<< delta_mod << " > max_mod=" << max_modularity << "\n";
-			/** GUBED **/
-#endif
-			max_modularity = delta_mod;
-			this->next_cluster_id = neigh_cluster_id;
-			//BOOST_LOG_TRIVIAL(info) << "Activating v" << my_id << " for the switch iteration";
-			set_changed(true); // Global notification of cluster change
+	community_scratch &get_scratch() {
+		return scratch;
+	}
 
-			//prog.request_notify_iter_end(*this);
-			//prog.activate_vertices(&my_id,1); // Activate myself so I can change my clusters metadata
-		}
+	std::vector<coarse_edge> &get_edges() {
+		return edges;
 	}
 
-#if 0
-	void louvain_vertex::notify_iteration_end(vertex_program &prog) {
-		assert (next_cluster_id != cluster_id);
-		vertex_id_t my_id = prog.get_vertex_id(*this);
-		prog.activate_vertices(&my_id,1); // Activate myself so I can change my clusters metadata in NEXT iteration
+	void add_weight(weight_t weight) {
+		tot_weight += weight;
 	}
 
-#endif
+	weight_t get_tot_weight() const {
+		return tot_weight;
+	}
 
-	// Only need to do this once per vertex ever
-	void louvain_vertex::compute_per_vertex_vol_weight(data_seq_iterator& weight_it, edge_seq_iterator& id_it, 
-			vertex_program &prog) {
-		edge_count local_edge_weight = 0;
-		uint32_t self_edge_weight = 0;
+	void inc_moves() {
+		num_moves++;
+	}
 
-		while (weight_it.has_next()) {
-			edge_count e = weight_it.next();
-			vertex_id_t nid = id_it.next();
+	size_t get_num_moves() const {
+		return num_moves;
+	}
+};
 
-			local_edge_weight += e.get_count();
-			if (nid == prog.get_vertex_id(*this)) {
-				self_edge_weight += e.get_count();
-			}
-		}
+class louvain_vertex_program_creater: public vertex_program_creater
+{
+	size_t num_comms;
+public:
+	louvain_vertex_program_creater(size_t num_comms) {
+		this->num_comms = num_comms;
+	}
 
-		((init_vertex_program&)prog).
-			pp_ec(local_edge_weight);
-		this->volume += local_edge_weight.get_count() + (2*self_edge_weight);
-		this->weight += local_edge_weight.get_count() + self_edge_weight;
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new louvain_vertex_program(num_comms));
+	}
+};
 
-		// Aggregate for the cluster INIT
-		g_weight_vec[cluster_id].plus_eq(local_edge_weight.get_count() + self_edge_weight);
-		g_volume_vec[cluster_id].plus_eq(local_edge_weight.get_count() + (2*self_edge_weight));
+void louvain_vertex::run(vertex_program &prog, const page_vertex &vertex)
+{
+	louvain_vertex_program &lprog = (louvain_vertex_program &) prog;
+	vertex_id_t id = vertex.get_id();
+	community_scratch &scratch = lprog.get_scratch();
+	switch (louvain_stage) {
+		case DEGREE: {
+			weight_t degree = 0;
+			for_each_edge(vertex, [&](vertex_id_t neigh, weight_t weight) {
+					degree += weight;
+			});
+			state->set_degree(id, degree);
+			lprog.add_weight(degree);
+			break;
+		}
+		case MOVE: {
+			for_each_edge(vertex, [&](vertex_id_t neigh, weight_t weight) {
+					if (neigh != id)
+						scratch.add(state->get_comm(neigh), weight);
+			});
+			if (!state->try_move(id, scratch))
+				break;
+			lprog.inc_moves();
+			// The neighbors may want to join the new community of the vertex.
+			if (prog.get_graph().get_curr_level() + 1 >= max_iters)
+				break;
+			edge_seq_iterator it = vertex.get_neigh_seq_it(edge_type::OUT_EDGE);
+			prog.activate_vertices(it);
+			if (vertex.is_directed()) {
+				edge_seq_iterator in_it = vertex.get_neigh_seq_it(
+						edge_type::IN_EDGE);
+				prog.activate_vertices(in_it);
+			}
+			break;
+		}
+		case COARSEN: {
+			const std::vector<vertex_id_t> &new_ids = *coarse_ids;
+			for_each_edge(vertex, [&](vertex_id_t neigh, weight_t weight) {
+					scratch.add(new_ids[state->get_comm(neigh)], weight);
+			});
+			vertex_id_t src = new_ids[state->get_comm(id)];
+			for (size_t i = 0; i < scratch.get_num_comms(); i++)
+				lprog.get_edges().push_back(coarse_edge(src,
+							scratch.get_comms()[i], scratch.get_weights()[i]));
+			scratch.clear();
+			break;
+		}
 	}
 }
 
-namespace fg 
+}
+
+namespace fg
 {
-	void compute_louvain(FG_graph::ptr fg, const uint32_t levels)
-	{
-		graph_index::ptr index = NUMA_graph_index<louvain_vertex>::create(
-				fg->get_graph_header());
-		graph_engine::ptr graph = fg->create_engine(index);
 
-		BOOST_LOG_TRIVIAL(info) << "Starting Louvain with " << levels << " levels";
-		BOOST_LOG_TRIVIAL(info) << "prof_file: " << graph_conf.get_prof_file().c_str();
+FG_vector<vertex_id_t>::ptr compute_louvain(FG_graph::ptr fg, uint32_t levels,
+		int max_iters)
+{
+	const graph_header &header = fg->get_graph_header();
+	weighted = header.get_edge_data_size() == sizeof(edge_count);
+	if (header.has_edge_data() && !weighted)
+		BOOST_LOG_TRIVIAL(warning)
+			<< "louvain only uses edge_count as edge weights, ignore edge data";
+	::max_iters = max_iters;
+
+	graph_index::ptr index = NUMA_graph_index<louvain_vertex>::create(header);
+	graph_engine::ptr graph = fg->create_engine(index);
+	size_t num_vertices = graph->get_num_vertices();
+	BOOST_LOG_TRIVIAL(info) << "louvain starts";
 #ifdef PROFILER
-		if (!graph_conf.get_prof_file().empty())
-			ProfilerStart(graph_conf.get_prof_file().c_str());
+	if (!graph_conf.get_prof_file().empty())
+		ProfilerStart(graph_conf.get_prof_file().c_str());
 #endif
 
-		struct timeval start, end;
-		gettimeofday(&start, NULL);
-		// Resize weight and volume vectors
-		BOOST_LOG_TRIVIAL(info) << "Resizing vectors to " << graph->get_num_vertices() << "\n";
-		g_weight_vec.resize(graph->get_num_vertices(), atomicwrapper<uint32_t>(0));
-		g_volume_vec.resize(graph->get_num_vertices(), atomicwrapper<uint32_t>(0));
-
-		/*~~~~~~~~~~~~~~~~~~~~~~~~~~ Compute Vol & Weight ~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-		graph->start_all(vertex_initializer::ptr(), 
-				vertex_program_creater::ptr(new init_vertex_program_creater()));
+	struct timeval start, end, level_start;
+	gettimeofday(&start, NULL);
+	level_start = start;
+	std::unique_ptr<community_state> level0_state(
+			new community_state(num_vertices));
+	state = level0_state.get();
+	std::vector<vertex_program::ptr> progs;
+
+	louvain_stage = DEGREE;
+	graph->start_all(vertex_initializer::ptr(), vertex_program_creater::ptr(
+				new louvain_vertex_program_creater(0)));
+	graph->wait4complete();
+	graph->get_vertex_programs(progs);
+	weight_t m2 = 0;
+	BOOST_FOREACH(vertex_program::ptr prog, progs)
+		m2 += louvain_vertex_program::cast2(prog)->get_tot_weight();
+	state->set_tot_weight(m2);
+
+	louvain_stage = MOVE;
+	graph->start_all(vertex_initializer::ptr(), vertex_program_creater::ptr(
+				new louvain_vertex_program_creater(num_vertices)));
+	graph->wait4complete();
+	progs.clear();
+	graph->get_vertex_programs(progs);
+	size_t num_moves = 0;
+	BOOST_FOREACH(vertex_program::ptr prog, progs)
+		num_moves += louvain_vertex_program::cast2(prog)->get_num_moves();
+
+	std::vector<vertex_id_t> new_ids;
+	size_t num_comms = state->renumber(new_ids);
+	FG_vector<vertex_id_t>::ptr comms = FG_vector<vertex_id_t>::create(
+			num_vertices);
+	vertex_id_t *comm_data = comms->get_data();
+#pragma omp parallel for
+	for (size_t i = 0; i < num_vertices; i++)
+		comm_data[i] = new_ids[state->get_comm(i)];
+
+	csr_graph::ptr g;
+	if (levels > 1 && num_comms < num_vertices && m2 > 0) {
+		louvain_stage = COARSEN;
+		coarse_ids = &new_ids;
+		graph->start_all(vertex_initializer::ptr(), vertex_program_creater::ptr(
+					new louvain_vertex_program_creater(num_comms)));
 		graph->wait4complete();
-
-		// Aggregate the global edge-weight
-		std::vector<vertex_program::ptr> ec_progs;
-		graph->get_vertex_programs(ec_progs);
-		BOOST_FOREACH(vertex_program::ptr vprog, ec_progs) {
-			init_vertex_program::ptr lvp = init_vertex_program::cast2(vprog);
-			g_edge_weight += lvp->get_local_ec(); 
-		}
-		BOOST_LOG_TRIVIAL(info) << "The graph's total edge weight is " << g_edge_weight << "\n";
-
-		int iter = 0;
-		do {
-			set_changed(false);
-			/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Compute modularity ~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-			louvain_stage = RUN;
-			BOOST_LOG_TRIVIAL(info) << "\n\n\x1B[31m****************** LEVEL ITERATION: " << iter++ 
-				<< " ********************************\x1B[0m\n\n";
-
-			graph->start_all();
-			graph->wait4complete();
-
-#if 1
-			/** DEBUG **/
-			FG_vector<cluster_id_t>::ptr ret = FG_vector<cluster_id_t>::create(
-					graph->get_num_vertices());
-			graph->query_on_all(vertex_query::ptr(new save_query<cluster_id_t, louvain_vertex>(ret)));
-			BOOST_LOG_TRIVIAL(info) << "Printing vertex clusters:";
-			ret->print(); 
-			/** GUBED **/
-#endif
-#if 1
-			/** DEBUG **/
-			BOOST_LOG_TRIVIAL(info) << "\x1B[31m===========================================\x1B[0m\n";
-			BOOST_LOG_TRIVIAL(info) << "Global volume vector:";
-			print_atomicwrapper_v(g_volume_vec);
-
-			BOOST_LOG_TRIVIAL(info) << "Global weight vector:";
-			print_atomicwrapper_v(g_weight_vec);
-			BOOST_LOG_TRIVIAL(info) << "\x1B[31m===========================================\x1B[0m\n";
-			/** GUBED **/
-			if (g_changed) BOOST_LOG_TRIVIAL(info) << "Loop continues!";
-			else BOOST_LOG_TRIVIAL(info) << "Loop ending!";
-
-			//if (iter > 2) { fprintf(stderr, "Premature kill"); exit(-1); } 
-			/** GUBED **/
-#endif
-		} while (g_changed);
-
-#if 1
-		/** DEBUG **/
-		FG_vector<cluster_id_t>::ptr ret = FG_vector<cluster_id_t>::create(
-				graph->get_num_vertices());
-		graph->query_on_all(vertex_query::ptr(new save_query<cluster_id_t, louvain_vertex>(ret)));
-		BOOST_LOG_TRIVIAL(info) << "\nVertex clusters @ end of Level1:";
-		ret->print(); 
-		/** GUBED **/
-#endif
-
-		louvain_stage = REBUILD; // TODO: Do something here
-		BOOST_LOG_TRIVIAL(info) << "\n Reached rebuild graph stage\n"; 
+		progs.clear();
+		graph->get_vertex_programs(progs);
+		std::vector<std::vector<coarse_edge> *> parts;
+		BOOST_FOREACH(vertex_program::ptr prog, progs)
+			parts.push_back(&louvain_vertex_program::cast2(prog)->get_edges());
+		g = csr_graph::create(parts, num_comms);
+	}
+	progs.clear();
+	state = NULL;
+	coarse_ids = NULL;
+	level0_state.reset();
+	graph.reset();
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"level 0: %1% moves, %2% communities, takes %3% seconds")
+		% num_moves % num_comms % time_diff(level_start, end);
+	if (g)
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"level 0: the coarse graph has %1% edges, modularity: %2%")
+			% g->get_num_edges() % g->get_modularity(m2);
+
+	for (uint32_t level = 1; g && level < levels; level++) {
+		level_start = end;
+		community_state level_state(g->get_num_vertices());
+#pragma omp parallel for
+		for (size_t i = 0; i < g->get_num_vertices(); i++)
+			level_state.set_degree(i, g->get_degree(i));
+		level_state.set_tot_weight(m2);
+		num_moves = move_vertices(*g, level_state, max_iters);
+		num_comms = level_state.renumber(new_ids);
+		if (num_comms == g->get_num_vertices())
+			break;
+
+#pragma omp parallel for
+		for (size_t i = 0; i < num_vertices; i++)
+			comm_data[i] = new_ids[level_state.get_comm(comm_data[i])];
+		g = coarsen(*g, level_state, new_ids, num_comms);
 		gettimeofday(&end, NULL);
+		BOOST_LOG_TRIVIAL(info) << boost::format(
+				"level %1%: %2% moves, %3% communities, modularity: %4%, takes %5% seconds")
+			% level % num_moves % num_comms % g->get_modularity(m2)
+			% time_diff(level_start, end);
+	}
 
 #ifdef PROFILER
-		if (!graph_conf.get_prof_file().empty())
-			ProfilerStop();
+	if (!graph_conf.get_prof_file().empty())
+		ProfilerStop();
 #endif
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"louvain takes %1% seconds and finds %2% communities")
+		% time_diff(start, end) % num_comms;
+	return comms;
+}
 
-		BOOST_LOG_TRIVIAL(info) << boost::format("It takes %1% seconds")
-			% time_diff(start, end);
-
-		return;
-	}
 }
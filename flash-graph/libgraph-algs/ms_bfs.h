@@ -0,0 +1,211 @@
+#ifndef __MS_BFS_H__
+#define __MS_BFS_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <assert.h>
+
+/*
+ * This file contains the data structures for multi-source BFS (MS-BFS),
+ * which runs many BFS at the same time. Each vertex keeps a bit for each
+ * BFS in a bitmap, so a vertex reads its adjacency list once in a level
+ * for all BFS that reach the vertex in the level, and sends one message
+ * to each neighbor with the bitmap of these BFS.
+ */
+
+/*
+ * The max number of BFS in a batch of MS-BFS.
+ */
+const int MAX_MS_BFS_SOURCES = 512;
+
+/*
+ * A bitmap with a bit for each BFS in a batch.
+ */
+template<int NUM_WORDS>
+class source_bitmap
+{
+	uint64_t words[NUM_WORDS];
+public:
+	static const int NUM_BITS = NUM_WORDS * 64;
+
+	source_bitmap() {
+		clear();
+	}
+
+	void set(int idx) {
+		assert(idx < NUM_BITS);
+		words[idx / 64] |= 1UL << (idx % 64);
+	}
+
+	bool test(int idx) const {
+		assert(idx < NUM_BITS);
+		return words[idx / 64] & (1UL << (idx % 64));
+	}
+
+	void clear() {
+		for (int i = 0; i < NUM_WORDS; i++)
+			words[i] = 0;
+	}
+
+	bool any() const {
+		for (int i = 0; i < NUM_WORDS; i++)
+			if (words[i])
+				return true;
+		return false;
+	}
+
+	/*
+	 * Merge the bits of another bitmap.
+	 * It returns true if this bitmap gets new bits.
+	 */
+	bool merge(const source_bitmap<NUM_WORDS> &map) {
+		uint64_t changed = 0;
+		for (int i = 0; i < NUM_WORDS; i++) {
+			changed |= map.words[i] & ~words[i];
+			words[i] |= map.words[i];
+		}
+		return changed != 0;
+	}
+
+	/*
+	 * Get the bits in this bitmap that don't exist in another bitmap.
+	 */
+	source_bitmap<NUM_WORDS> subtract(const source_bitmap<NUM_WORDS> &map) const {
+		source_bitmap<NUM_WORDS> ret;
+		for (int i = 0; i < NUM_WORDS; i++)
+			ret.words[i] = words[i] & ~map.words[i];
+		return ret;
+	}
+
+	bool operator!=(const source_bitmap<NUM_WORDS> &map) const {
+		for (int i = 0; i < NUM_WORDS; i++)
+			if (words[i] != map.words[i])
+				return true;
+		return false;
+	}
+
+	/*
+	 * Invoke the function on the index of each bit that is set.
+	 */
+	template<class Func>
+	void for_each(Func &func) const {
+		for (int i = 0; i < NUM_WORDS; i++) {
+			uint64_t word = words[i];
+			while (word) {
+				int idx = __builtin_ctzl(word);
+				word &= word - 1;
+				func(i * 64 + idx);
+			}
+		}
+	}
+};
+
+/*
+ * The BFS state of a vertex in MS-BFS.
+ */
+template<int NUM_WORDS>
+class ms_bfs_state
+{
+	// The BFS that have reached the vertex.
+	source_bitmap<NUM_WORDS> seen;
+	// The BFS that reached the vertex in the last level.
+	source_bitmap<NUM_WORDS> frontier;
+	// The BFS that reach the vertex in the current level.
+	source_bitmap<NUM_WORDS> next;
+public:
+	typedef source_bitmap<NUM_WORDS> bitmap_t;
+
+	void reset() {
+		seen.clear();
+		frontier.clear();
+		next.clear();
+	}
+
+	/*
+	 * The vertex is the source of a BFS.
+	 */
+	void init_source(int bfs_id) {
+		seen.set(bfs_id);
+		frontier.set(bfs_id);
+	}
+
+	/*
+	 * The BFS that have reached the vertex.
+	 */
+	const bitmap_t &get_seen() const {
+		return seen;
+	}
+
+	/*
+	 * The BFS that reached the vertex in the last level. The vertex needs
+	 * to visit its neighbors for these BFS in the current level.
+	 */
+	const bitmap_t &get_frontier() const {
+		return frontier;
+	}
+
+	/*
+	 * The BFS from a neighbor reach the vertex in the current level.
+	 * It returns the BFS that haven't reached the vertex before.
+	 */
+	bitmap_t visit(const bitmap_t &bfs_ids) {
+		bitmap_t new_ids = bfs_ids.subtract(seen);
+		next.merge(new_ids);
+		return new_ids;
+	}
+
+	/*
+	 * Move to the next level at the end of a level.
+	 * It returns true if new BFS reached the vertex in the level.
+	 */
+	bool advance() {
+		frontier = next;
+		seen.merge(next);
+		next.clear();
+		return frontier.any();
+	}
+
+	/*
+	 * The vertex has visited its neighbors for the BFS in the frontier.
+	 */
+	void clear_frontier() {
+		frontier.clear();
+	}
+};
+
+/*
+ * Get the number of 64-bit words for a batch of BFS.
+ * It has to be one of the sizes that the MS-BFS code is compiled with.
+ */
+static inline int get_ms_bfs_num_words(int num_bfs)
+{
+	assert(num_bfs <= MAX_MS_BFS_SOURCES);
+	if (num_bfs <= 64)
+		return 1;
+	else if (num_bfs <= 128)
+		return 2;
+	else if (num_bfs <= 256)
+		return 4;
+	else
+		return 8;
+}
+
+#endif
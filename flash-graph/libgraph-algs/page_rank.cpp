@@ -22,9 +22,12 @@
 
 #include <limits>
 #include <cmath>
+#include <atomic>
 
 #include "graph_engine.h"
 #include "graph_config.h"
+#include "vertex_state.h"
+#include "edge_map.h"
 #include "FGlib.h"
 
 using namespace fg;
@@ -46,27 +49,21 @@ enum pr_stage_t
 	RUN,
 };
 pr_stage_t pr_stage;
+// In incremental mode, the vertices activated in the first iteration always
+// notify their out-neighbors because their edges have changed.
+bool incremental = false;
+
+/*
+ * The current PageRank and the out-degree of a vertex are read by all of
+ * its out-neighbors, so they're stored in columns instead of pgrank_vertex.
+ */
+vertex_column<float>::ptr curr_prs;
+vertex_column<vsize_t>::ptr out_degrees;
 
 class pgrank_vertex: public compute_directed_vertex
 {
-  float curr_itr_pr; // Current iteration's page rank
-  vsize_t num_out_edges;
-
 public:
   pgrank_vertex(vertex_id_t id): compute_directed_vertex(id) {
-    this->curr_itr_pr = 1 - DAMPING_FACTOR; // Must be this
-  }
-
-  vsize_t get_num_out_edges() const {
-	  return num_out_edges;
-  }
-
-  float get_curr_itr_pr() const{
-    return curr_itr_pr;
-  }
-
-  float get_result() const {
-	  return get_curr_itr_pr();
   }
 
   void run(vertex_program &prog);
@@ -80,7 +77,7 @@ public:
 	void run_on_vertex_header(vertex_program &prog, const vertex_header &header) {
 		assert(prog.get_vertex_id(*this) == header.get_id());
 		directed_vertex_header &dheader = (directed_vertex_header &) header;
-		this->num_out_edges = dheader.get_num_out_edges();
+		out_degrees->get(prog, *this) = dheader.get_num_out_edges();
 	}
 };
 
@@ -98,17 +95,69 @@ void pgrank_vertex::run(vertex_program &prog)
 	}
 };
 
+/*
+ * The vertex program counts the number of times that vertices run on
+ * their edge lists.
+ */
+class pgrank_vertex_program: public vertex_program_impl<pgrank_vertex>
+{
+	size_t num_runs;
+public:
+	typedef std::shared_ptr<pgrank_vertex_program> ptr;
+
+	static ptr cast2(vertex_program::ptr prog) {
+		return std::static_pointer_cast<pgrank_vertex_program,
+			   vertex_program>(prog);
+	}
+
+	pgrank_vertex_program() {
+		num_runs = 0;
+	}
+
+	void inc_runs() {
+		num_runs++;
+	}
+
+	size_t get_num_runs() const {
+		return num_runs;
+	}
+};
+
+class pgrank_vertex_program_creater: public vertex_program_creater
+{
+public:
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new pgrank_vertex_program());
+	}
+};
+
 void pgrank_vertex::run(vertex_program &prog, const page_vertex &vertex) {
+  ((pgrank_vertex_program &) prog).inc_runs();
+  // The edge list may include edge updates that aren't in the vertex header.
+  out_degrees->get(prog, *this) = vertex.get_num_edges(OUT_EDGE);
+  float &curr_itr_pr = curr_prs->get(prog, *this);
+
   // Gather
+  // We locate the in-neighbors once and read their PageRank and
+  // out-degree from the columns.
+  static thread_local std::vector<vertex_loc_t> locs;
+  static thread_local std::vector<float> in_prs;
+  static thread_local std::vector<vsize_t> in_degrees;
+  size_t num_in_edges = vertex.get_num_edges(IN_EDGE);
+  if (locs.size() < num_in_edges) {
+    locs.resize(num_in_edges);
+    in_prs.resize(num_in_edges);
+    in_degrees.resize(num_in_edges);
+  }
+  edge_seq_iterator in_it = vertex.get_neigh_seq_it(IN_EDGE, 0, num_in_edges);
+  num_in_edges = prog.get_graph().get_partitioner()->map2loc(in_it,
+      locs.data(), num_in_edges);
+  // Notice I want this iteration's pagerank
+  curr_prs->gather(locs.data(), num_in_edges, in_prs.data());
+  out_degrees->gather(locs.data(), num_in_edges, in_degrees.data());
   float accum = 0;
-  edge_iterator end_it = vertex.get_neigh_end(IN_EDGE);
-  
-  for (edge_iterator it = vertex.get_neigh_begin(IN_EDGE); it != end_it; ++it) {
-    vertex_id_t id = *it;
-    pgrank_vertex& v = (pgrank_vertex&) prog.get_graph().get_vertex(id);
-    // Notice I want this iteration's pagerank
-    accum += (v.get_curr_itr_pr()/v.get_num_out_edges()); 
-  }   
+  for (size_t i = 0; i < num_in_edges; i++)
+    accum += in_prs[i] / in_degrees[i];
 
   // Apply
   float last_change = 0;
@@ -119,7 +168,8 @@ void pgrank_vertex::run(vertex_program &prog, const page_vertex &vertex) {
   }   
   
   // Scatter (activate your out-neighbors ... if you have any :) 
-  if ( std::fabs( last_change ) > TOLERANCE ) {
+  if ( std::fabs( last_change ) > TOLERANCE
+		  || (incremental && prog.get_graph().get_curr_level() == 0)) {
 	int num_dests = vertex.get_num_edges(OUT_EDGE);
     if (num_dests > 0) {
 		edge_seq_iterator it = vertex.get_neigh_seq_it(OUT_EDGE, 0, num_dests);
@@ -140,6 +190,22 @@ public:
 	float get_delta() const {
 		return delta;
 	}
+
+	void add_delta(float delta) {
+		this->delta += delta;
+	}
+};
+
+/*
+ * A vertex only needs the sum of the deltas sent to it.
+ */
+class pr_msg_combiner: public vertex_msg_combiner
+{
+public:
+	void combine(vertex_message &combined, const vertex_message &msg) const {
+		((pr_message &) combined).add_delta(
+				((const pr_message &) msg).get_delta());
+	}
 };
 
 class pgrank_vertex2: public compute_directed_vertex
@@ -190,10 +256,74 @@ void pgrank_vertex2::run(vertex_program &prog, const page_vertex &vertex)
 	}
 }
 
+/*
+ * The edge function of PageRank in edge_map. A vertex sums up
+ * the contributions from its in-neighbors whose PageRank has changed.
+ */
+class pr_edge_func
+{
+	const float *contribs;
+	std::atomic<float> *sums;
+public:
+	pr_edge_func(const float *contribs, std::atomic<float> *sums) {
+		this->contribs = contribs;
+		this->sums = sums;
+	}
+
+	bool update(vertex_id_t src, vertex_id_t dst) {
+		sums[dst].store(sums[dst].load(std::memory_order_relaxed)
+				+ contribs[src], std::memory_order_relaxed);
+		return true;
+	}
+
+	/*
+	 * A vertex is in the output frontier only once when it gets its first
+	 * contribution.
+	 */
+	bool update_atomic(vertex_id_t src, vertex_id_t dst) {
+		float old = sums[dst].load(std::memory_order_relaxed);
+		while (!sums[dst].compare_exchange_weak(old, old + contribs[src]))
+			;
+		return old == 0;
+	}
+
+	bool cond(vertex_id_t dst) const {
+		return true;
+	}
+};
+
 }
 
 #include "save_result.h"
 
+namespace {
+
+/*
+ * This initializes the PageRank of vertices with the previous result.
+ * The out-degree of vertices comes from the in-memory vertex index, so we
+ * don't need to read vertex headers. The index doesn't include the edge
+ * updates, so a vertex with updates gets its out-degree from its edge
+ * list when it runs.
+ */
+class pgrank_initializer: public vertex_initializer
+{
+	graph_engine &graph;
+	FG_vector<float>::ptr prev;
+public:
+	pgrank_initializer(graph_engine &_graph,
+			FG_vector<float>::ptr prev): graph(_graph) {
+		this->prev = prev;
+	}
+
+	void init(compute_vertex &v) {
+		vertex_id_t id = graph.get_graph_index().get_vertex_id(v);
+		curr_prs->get(id) = prev->get(id);
+		out_degrees->get(id) = graph.get_num_edges(id, OUT_EDGE);
+	}
+};
+
+}
+
 namespace fg
 {
 
@@ -217,6 +347,8 @@ FG_vector<float>::ptr compute_pagerank(FG_graph::ptr fg, int num_iters,
 	graph_index::ptr index = NUMA_graph_index<pgrank_vertex>::create(
 			fg->get_graph_header());
 	graph_engine::ptr graph = fg->create_engine(index);
+	curr_prs = vertex_column<float>::create(graph, 1 - DAMPING_FACTOR);
+	out_degrees = vertex_column<vsize_t>::create(graph, 0);
 	max_num_iters = num_iters;
 	BOOST_LOG_TRIVIAL(info)
 		<< boost::format("Pagerank (at maximal %1% iterations) starting")
@@ -230,17 +362,19 @@ FG_vector<float>::ptr compute_pagerank(FG_graph::ptr fg, int num_iters,
 	struct timeval start, end;
 	gettimeofday(&start, NULL);
 	pr_stage = pr_stage_t::INIT;
-	graph->start_all(); 
+	graph->start_all(vertex_initializer::ptr(), vertex_program_creater::ptr(
+				new pgrank_vertex_program_creater()));
 	graph->wait4complete();
 	pr_stage = pr_stage_t::RUN;
-	graph->start_all(); 
+	incremental = false;
+	graph->start_all(vertex_initializer::ptr(), vertex_program_creater::ptr(
+				new pgrank_vertex_program_creater()));
 	graph->wait4complete();
 	gettimeofday(&end, NULL);
 
-	FG_vector<float>::ptr ret = FG_vector<float>::create(
-			graph->get_num_vertices());
-	graph->query_on_all(vertex_query::ptr(
-				new save_query<float, pgrank_vertex>(ret)));
+	FG_vector<float>::ptr ret = curr_prs->conv2FG_vector();
+	curr_prs.reset();
+	out_degrees.reset();
 
 #ifdef PROFILER
 	if (!graph_conf.get_prof_file().empty())
@@ -254,7 +388,7 @@ FG_vector<float>::ptr compute_pagerank(FG_graph::ptr fg, int num_iters,
 }
 
 FG_vector<float>::ptr compute_pagerank2(FG_graph::ptr fg, int num_iters,
-		float damping_factor)
+		float damping_factor, bool async)
 {
 	bool directed = fg->get_graph_header().is_directed_graph();
 	if (!directed) {
@@ -273,10 +407,12 @@ FG_vector<float>::ptr compute_pagerank2(FG_graph::ptr fg, int num_iters,
 	graph_index::ptr index = NUMA_graph_index<pgrank_vertex2>::create(
 			fg->get_graph_header());
 	graph_engine::ptr graph = fg->create_engine(index);
+	graph->set_msg_combiner(vertex_msg_combiner::ptr(new pr_msg_combiner()));
+	graph->set_async_mode(async);
 	max_num_iters = num_iters;
 	BOOST_LOG_TRIVIAL(info)
-		<< boost::format("Pagerank (at maximal %1% iterations) starting")
-		% max_num_iters;
+		<< boost::format("Pagerank (at maximal %1% iterations) starting%2%")
+		% max_num_iters % (async ? " asynchronously" : "");
 	BOOST_LOG_TRIVIAL(info) << "prof_file: " << graph_conf.get_prof_file();
 #ifdef PROFILER
 	if (!graph_conf.get_prof_file().empty())
@@ -300,8 +436,171 @@ FG_vector<float>::ptr compute_pagerank2(FG_graph::ptr fg, int num_iters,
 #endif
 
 	BOOST_LOG_TRIVIAL(info)
-		<< boost::format("It takes %1% seconds in total")
+		<< boost::format("It takes %1% seconds in total and %2% levels")
+		% time_diff(start, end) % graph->get_curr_level();
+	return ret;
+}
+
+FG_vector<float>::ptr compute_pagerank_edge_map(FG_graph::ptr fg, int num_iters,
+		float damping_factor)
+{
+	bool directed = fg->get_graph_header().is_directed_graph();
+	if (!directed) {
+		BOOST_LOG_TRIVIAL(error)
+			<< "This algorithm works on a directed graph";
+		return FG_vector<float>::ptr();
+	}
+
+	DAMPING_FACTOR = damping_factor;
+	if (DAMPING_FACTOR < 0 || DAMPING_FACTOR > 1) {
+		BOOST_LOG_TRIVIAL(fatal)
+			<< "Damping factor must be between 0 and 1 inclusive";
+		exit(-1);
+	}
+
+	graph_index::ptr index = NUMA_graph_index<edge_map_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"Pagerank with edge_map (at maximal %1% iterations) starting")
+		% num_iters;
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	// The same as compute_pagerank2, a vertex pushes the change of its
+	// PageRank to its out-neighbors and it's in the frontier when
+	// the change is larger than the tolerance.
+	size_t num_vertices = graph->get_num_vertices();
+	FG_vector<float>::ptr ret = FG_vector<float>::create(num_vertices);
+	float *prs = ret->get_data();
+	std::vector<float> sent_prs(num_vertices);
+	std::vector<float> deltas(num_vertices);
+	std::vector<float> contribs(num_vertices);
+	std::vector<vsize_t> degrees(num_vertices);
+	std::unique_ptr<std::atomic<float>[]> sums(
+			new std::atomic<float>[num_vertices]);
+#pragma omp parallel for
+	for (size_t i = 0; i < num_vertices; i++) {
+		prs[i] = 1 - DAMPING_FACTOR;
+		sent_prs[i] = prs[i];
+		deltas[i] = prs[i];
+		degrees[i] = graph->get_num_edges(i, OUT_EDGE);
+		sums[i].store(0, std::memory_order_relaxed);
+	}
+
+	vertex_frontier frontier(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++)
+		frontier.add(i);
+	frontier.optimize();
+	int level;
+	std::vector<vertex_id_t> ids;
+	for (level = 0; level < num_iters && !frontier.empty(); level++) {
+		ids.clear();
+		frontier.get_vertices(ids);
+#pragma omp parallel for
+		for (size_t i = 0; i < ids.size(); i++) {
+			vertex_id_t id = ids[i];
+			contribs[id] = degrees[id] > 0
+				? deltas[id] / degrees[id] * DAMPING_FACTOR : 0;
+		}
+
+		vertex_frontier updated = edge_map(*graph, frontier, OUT_EDGE,
+				pr_edge_func(contribs.data(), sums.get()));
+
+		ids.clear();
+		updated.get_vertices(ids);
+		std::vector<bool> changed(ids.size());
+#pragma omp parallel for
+		for (size_t i = 0; i < ids.size(); i++) {
+			vertex_id_t id = ids[i];
+			prs[id] += sums[id].load(std::memory_order_relaxed);
+			sums[id].store(0, std::memory_order_relaxed);
+			float delta = prs[id] - sent_prs[id];
+			if (std::fabs(delta) > TOLERANCE) {
+				deltas[id] = delta;
+				sent_prs[id] = prs[id];
+				changed[i] = true;
+			}
+		}
+		frontier.clear();
+		for (size_t i = 0; i < ids.size(); i++)
+			if (changed[i])
+				frontier.add(ids[i]);
+	}
+	gettimeofday(&end, NULL);
+
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("It takes %1% seconds in total and %2% levels")
+		% time_diff(start, end) % level;
+	return ret;
+}
+
+FG_vector<float>::ptr compute_pagerank_incremental(FG_graph::ptr fg,
+		FG_vector<float>::ptr prev, const std::vector<vertex_id_t> &changed,
+		int num_iters, float damping_factor, incremental_stats *stats)
+{
+	bool directed = fg->get_graph_header().is_directed_graph();
+	if (!directed) {
+		BOOST_LOG_TRIVIAL(error)
+			<< "This algorithm works on a directed graph";
+		return FG_vector<float>::ptr();
+	}
+
+	DAMPING_FACTOR = damping_factor;
+	if (DAMPING_FACTOR < 0 || DAMPING_FACTOR > 1) {
+		BOOST_LOG_TRIVIAL(fatal)
+			<< "Damping factor must be between 0 and 1 inclusive";
+		exit(-1);
+	}
+
+	graph_index::ptr index = NUMA_graph_index<pgrank_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	if (prev->get_size() != graph->get_num_vertices()) {
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"The previous result has %1% vertices, but the graph has %2%")
+			% prev->get_size() % graph->get_num_vertices();
+		return FG_vector<float>::ptr();
+	}
+	curr_prs = vertex_column<float>::create(graph, 1 - DAMPING_FACTOR);
+	out_degrees = vertex_column<vsize_t>::create(graph, 0);
+	max_num_iters = num_iters;
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"Incremental pagerank (at maximal %1% iterations) starts from %2% changed vertices")
+		% max_num_iters % changed.size();
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	// Only the vertices touched by the updates run in the first level.
+	graph->init_all_vertices(vertex_initializer::ptr(
+				new pgrank_initializer(*graph, prev)));
+
+	pr_stage = pr_stage_t::RUN;
+	incremental = true;
+	graph->start(changed.data(), changed.size(), vertex_initializer::ptr(),
+			vertex_program_creater::ptr(new pgrank_vertex_program_creater()));
+	graph->wait4complete();
+	incremental = false;
+	gettimeofday(&end, NULL);
+
+	size_t num_runs = 0;
+	std::vector<vertex_program::ptr> vprogs;
+	graph->get_vertex_programs(vprogs);
+	BOOST_FOREACH(vertex_program::ptr vprog, vprogs)
+		num_runs += pgrank_vertex_program::cast2(vprog)->get_num_runs();
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"Incremental pagerank processes %1% vertices in %2% levels (%3% vertices in the graph) in %4% seconds")
+		% num_runs % graph->get_curr_level() % graph->get_num_vertices()
 		% time_diff(start, end);
+	if (stats) {
+		stats->num_vertex_runs = num_runs;
+		stats->num_levels = graph->get_curr_level();
+		stats->num_vertices = graph->get_num_vertices();
+	}
+
+	FG_vector<float>::ptr ret = curr_prs->conv2FG_vector();
+	curr_prs.reset();
+	out_degrees.reset();
 	return ret;
 }
 
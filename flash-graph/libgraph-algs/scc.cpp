@@ -55,7 +55,7 @@ class trim2_message: public vertex_message
 	vertex_id_t comp_id;
 public:
 	trim2_message(vertex_id_t comp_id): vertex_message(
-			sizeof(trim1_message), false) {
+			sizeof(trim2_message), false) {
 		this->comp_id = comp_id;
 	}
 
@@ -149,6 +149,12 @@ enum scc_stage_t {
 	OUT_WCC,
 } scc_stage;
 
+/*
+ * In the coloring mode, a vertex reached by the forward BFS from the root
+ * of its color belongs to the SCC of the root.
+ */
+bool coloring;
+
 template<class T>
 class bit_flags
 {
@@ -291,9 +297,12 @@ public:
 
 struct trim1_state
 {
-	// for trimming
+	// for trimming. The number of edges to the vertices that haven't been
+	// trimmed.
 	vsize_t num_in_edges;
 	vsize_t num_out_edges;
+	// The vertex has been trimmed, but it hasn't notified its neighbors.
+	bool pending;
 };
 
 struct wcc_state
@@ -354,9 +363,24 @@ public:
 		return state.fwbw.get_color();
 	}
 
+	vsize_t get_remain_edges(edge_type type) const {
+		if (type == IN_EDGE)
+			return state.trim1.num_in_edges;
+		else
+			return state.trim1.num_out_edges;
+	}
+
+	/*
+	 * A trimmed vertex still needs to run in TRIM1 to notify its neighbors.
+	 */
+	bool is_trim_pending() const {
+		return scc_stage == scc_stage_t::TRIM1 && state.trim1.pending;
+	}
+
 	void init_trim1() {
 		state.trim1.num_out_edges = get_num_out_edges();
 		state.trim1.num_in_edges = get_num_in_edges();
+		state.trim1.pending = false;
 	}
 
 	void init_wcc() {
@@ -374,6 +398,14 @@ public:
 		state.fwbw.set_pivot(get_id());
 	}
 
+	/*
+	 * The root of a color only runs the forward BFS.
+	 */
+	void init_color_root() {
+		state.fwbw.set_fw();
+		state.fwbw.set_pivot(get_id());
+	}
+
 	void post_wcc_init() {
 		assert(!state.fwbw.has_fw_visited());
 		assert(!state.fwbw.has_bw_visited());
@@ -381,7 +413,7 @@ public:
 	}
 
 	void run(vertex_program &prog) {
-		if (is_assigned())
+		if (is_assigned() && !is_trim_pending())
 			return;
 
 		switch(scc_stage) {
@@ -425,7 +457,7 @@ public:
 	void run_stage_wcc(vertex_program &prog);
 
 	void run(vertex_program &prog, const page_vertex &vertex) {
-		if (is_assigned())
+		if (is_assigned() && !is_trim_pending())
 			return;
 
 		switch(scc_stage) {
@@ -455,6 +487,7 @@ public:
 
 	void run_stage_trim1(vertex_program &prog, const page_vertex &vertex);
 	void run_stage_trim2(vertex_program &prog, const page_vertex &vertex);
+	void trim2(vertex_program &prog, const page_vertex &vertex, edge_type type);
 	void run_stage_trim3(vertex_program &prog, const page_vertex &vertex);
 	void run_stage_FWBW(vertex_program &prog, const page_vertex &vertex);
 	void run_stage_part(vertex_program &prog, const page_vertex &vertex);
@@ -572,6 +605,8 @@ public:
 class trim_vertex_program: public vertex_program_impl<scc_vertex>
 {
 	size_t num_trims;
+	// The vertices trimmed in TRIM2. They notify their neighbors in TRIM1.
+	std::vector<vertex_id_t> trimmed;
 public:
 	typedef std::shared_ptr<trim_vertex_program> ptr;
 
@@ -590,6 +625,14 @@ public:
 	size_t get_num_trimmed() const {
 		return num_trims;
 	}
+
+	void add_trimmed(vertex_id_t id) {
+		trimmed.push_back(id);
+	}
+
+	const std::vector<vertex_id_t> &get_trimmed() const {
+		return trimmed;
+	}
 };
 
 class trim_vertex_program_creater: public vertex_program_creater
@@ -602,34 +645,41 @@ public:
 
 void scc_vertex::run_stage_trim1(vertex_program &prog)
 {
-	if (state.trim1.num_in_edges == 0 || state.trim1.num_out_edges == 0) {
-		vertex_id_t id = get_id();
-		request_vertices(&id, 1);
-
+	if (!is_assigned() && (state.trim1.num_in_edges == 0
+				|| state.trim1.num_out_edges == 0)) {
 		// This vertex has to be a SCC itself.
-		comp_id = id;
+		comp_id = get_id();
+		state.trim1.pending = true;
 		((trim_vertex_program &) prog).trim_vertex(1);
 	}
+
+	if (state.trim1.pending) {
+		vertex_id_t id = get_id();
+		if (get_degree() > 0)
+			request_vertices(&id, 1);
+		else
+			state.trim1.pending = false;
+	}
 }
 
 void scc_vertex::run_stage_trim1(vertex_program &prog, const page_vertex &vertex)
 {
-	// The vertices on the other side of the edges should reduce their degree
-	// by 1. They have the opposite direction of the edges.
-	edge_type type = edge_type::NONE;
-	if (vertex.get_num_edges(edge_type::IN_EDGE) > 0) {
-		assert(vertex.get_num_edges(edge_type::OUT_EDGE) == 0);
-		type = edge_type::OUT_EDGE;
-	}
-	else if (vertex.get_num_edges(edge_type::OUT_EDGE) > 0) {
-		assert(vertex.get_num_edges(edge_type::IN_EDGE) == 0);
-		type = edge_type::IN_EDGE;
-	}
-	if (type != edge_type::NONE) {
-		trim1_message msg(type);
-		int num_edges = vertex.get_num_edges(BOTH_EDGES);
-		edge_seq_iterator it = vertex.get_neigh_seq_it(BOTH_EDGES, 0,
-				num_edges);
+	// The in-neighbors lose an out-edge and the out-neighbors lose
+	// an in-edge. The neighbors are activated, so the ones that run out of
+	// edges are trimmed in the next level.
+	state.trim1.pending = false;
+	int num_in_edges = vertex.get_num_edges(edge_type::IN_EDGE);
+	if (num_in_edges > 0) {
+		trim1_message msg(edge_type::OUT_EDGE);
+		edge_seq_iterator it = vertex.get_neigh_seq_it(edge_type::IN_EDGE, 0,
+				num_in_edges);
+		prog.multicast_msg(it, msg);
+	}
+	int num_out_edges = vertex.get_num_edges(edge_type::OUT_EDGE);
+	if (num_out_edges > 0) {
+		trim1_message msg(edge_type::IN_EDGE);
+		edge_seq_iterator it = vertex.get_neigh_seq_it(edge_type::OUT_EDGE, 0,
+				num_out_edges);
 		prog.multicast_msg(it, msg);
 	}
 }
@@ -655,11 +705,7 @@ void scc_vertex::run_on_message_stage_trim1(vertex_program &prog,
 void scc_vertex::run_stage_trim2(vertex_program &prog)
 {
 	vertex_id_t id = get_id();
-	if (get_num_in_edges() == 1) {
-		// TODO requesting partial vertices causes errors.
-		request_vertices(&id, 1);
-	}
-	else if (get_num_out_edges() == 1) {
+	if (state.trim1.num_in_edges == 1 || state.trim1.num_out_edges == 1) {
 		// TODO requesting partial vertices causes errors.
 		request_vertices(&id, 1);
 	}
@@ -675,54 +721,57 @@ static inline bool contain_edge(const page_vertex &vertex, edge_type type,
 void scc_vertex::run_stage_trim2(vertex_program &prog, const page_vertex &vertex)
 {
 	assert(vertex.get_id() == get_id());
-	// Ideally, we should use the remaining in-edges or out-edges,
-	// but we don't know which edges have been removed, so we just
-	// use the original number of edges.
-	if (get_num_in_edges() == 1) {
-		edge_iterator it = vertex.get_neigh_begin(edge_type::IN_EDGE);
-		vertex_id_t neighbor = *it;
-		// If the only in-edge is to itself, it's a SCC itself.
-		if (neighbor == get_id()) {
-			comp_id = get_id();
-			((trim_vertex_program &) prog).trim_vertex(1);
-		}
-		else {
-			scc_vertex &neigh_v = (scc_vertex &) prog.get_graph().get_vertex(neighbor);
-			// If the vertex's out-edge list contains the neighbor,
-			// it means the neighbor's only in-edge connect to this vertex.
-			if (get_id() < neighbor
-					&& neigh_v.get_num_in_edges() == 1
-					&& contain_edge(vertex, edge_type::OUT_EDGE, neighbor)) {
-				comp_id = get_id();
-				trim2_message msg(get_id());
-				prog.send_msg(neighbor, msg);
-				((trim_vertex_program &) prog).trim_vertex(2);
-			}
+	if (state.trim1.num_in_edges == 1)
+		trim2(prog, vertex, edge_type::IN_EDGE);
+	if (!is_assigned() && state.trim1.num_out_edges == 1)
+		trim2(prog, vertex, edge_type::OUT_EDGE);
+}
+
+/*
+ * The vertex has only one remaining edge of the specified type.
+ * If the edge is to itself, the vertex is a SCC itself. If the neighbor
+ * also has only one remaining edge of the type and the edge connects to
+ * this vertex, no other vertices can reach the two vertices (or be reached
+ * by them), so they form a SCC of size 2.
+ */
+void scc_vertex::trim2(vertex_program &prog, const page_vertex &vertex,
+		edge_type type)
+{
+	trim_vertex_program &trim_prog = (trim_vertex_program &) prog;
+	vertex_id_t neighbor = INVALID_VERTEX_ID;
+	edge_iterator end_it = vertex.get_neigh_end(type);
+	for (edge_iterator it = vertex.get_neigh_begin(type); it != end_it; ++it) {
+		vertex_id_t id = *it;
+		if (!((scc_vertex &) prog.get_graph().get_vertex(id)).is_assigned()) {
+			neighbor = id;
+			break;
 		}
 	}
-	else if (get_num_out_edges() == 1) {
-		edge_iterator it = vertex.get_neigh_begin(edge_type::OUT_EDGE);
-		vertex_id_t neighbor = *it;
-		// If the only in-edge is to itself, it's a SCC itself.
-		if (neighbor == get_id()) {
-			comp_id = get_id();
-			((trim_vertex_program &) prog).trim_vertex(1);
-		}
-		else {
-			scc_vertex &neigh_v = (scc_vertex &) prog.get_graph().get_vertex(neighbor);
-			// The same as above.
-			if (get_id() < neighbor
-					&& neigh_v.get_num_out_edges() == 1
-					&& contain_edge(vertex, edge_type::IN_EDGE, neighbor)) {
-				comp_id = get_id();
-				trim2_message msg(get_id());
-				prog.send_msg(neighbor, msg);
-				((trim_vertex_program &) prog).trim_vertex(2);
-			}
-		}
+	if (neighbor == INVALID_VERTEX_ID)
+		return;
+
+	if (neighbor == get_id()) {
+		comp_id = get_id();
+		state.trim1.pending = true;
+		trim_prog.add_trimmed(get_id());
+		trim_prog.trim_vertex(1);
+		return;
+	}
+
+	edge_type rev_type = type == edge_type::IN_EDGE
+		? edge_type::OUT_EDGE : edge_type::IN_EDGE;
+	scc_vertex &neigh_v = (scc_vertex &) prog.get_graph().get_vertex(neighbor);
+	// Only the vertex with the smaller Id assigns the pair.
+	if (get_id() < neighbor && neigh_v.get_remain_edges(type) == 1
+			&& contain_edge(vertex, rev_type, neighbor)) {
+		comp_id = get_id();
+		state.trim1.pending = true;
+		trim2_message msg(get_id());
+		prog.send_msg(neighbor, msg);
+		trim_prog.add_trimmed(get_id());
+		trim_prog.add_trimmed(neighbor);
+		trim_prog.trim_vertex(2);
 	}
-	else
-		assert(0);
 }
 
 void scc_vertex::run_on_message_stage_trim2(vertex_program &prog,
@@ -730,6 +779,7 @@ void scc_vertex::run_on_message_stage_trim2(vertex_program &prog,
 {
 	const trim2_message &msg = (const trim2_message &) msg1;
 	comp_id = msg.get_comp_id();
+	state.trim1.pending = true;
 }
 
 void scc_vertex::run_stage_trim3(vertex_program &prog)
@@ -858,7 +908,7 @@ void scc_vertex::run_on_message_stage_FWBW(vertex_program &prog,
 
 void scc_vertex::run_stage_part(vertex_program &prog)
 {
-	if (state.fwbw.is_fw() && state.fwbw.is_bw()) {
+	if (state.fwbw.is_fw() && (coloring || state.fwbw.is_bw())) {
 		comp_id = state.fwbw.get_pivot();
 		((part_vertex_program &) prog).assign_vertex(comp_id);
 	}
@@ -999,6 +1049,62 @@ public:
 	}
 };
 
+/*
+ * Only the vertices with one remaining in-edge or out-edge run in TRIM2.
+ */
+class trim2_filter: public vertex_filter
+{
+public:
+	bool keep(vertex_program &prog, compute_vertex &v) {
+		scc_vertex &sv = (scc_vertex &) v;
+		return !sv.is_assigned() && (sv.get_remain_edges(IN_EDGE) == 1
+				|| sv.get_remain_edges(OUT_EDGE) == 1);
+	}
+};
+
+class color_root_initializer: public vertex_initializer
+{
+public:
+	void init(compute_vertex &v) {
+		scc_vertex &sv = (scc_vertex &) v;
+		assert(!sv.is_assigned());
+		sv.init_color_root();
+	}
+};
+
+/*
+ * After IN_WCC, the color of a vertex is the smallest vertex that it can
+ * reach in its partition. The vertex whose color is itself is the root
+ * of the color, and the vertices of the color reached by the root are in
+ * the SCC of the root.
+ */
+class color_root_query: public vertex_query
+{
+	std::vector<vertex_id_t> roots;
+public:
+	virtual void run(graph_engine &graph, compute_vertex &v) {
+		scc_vertex &scc_v = (scc_vertex &) v;
+		if (scc_v.is_assigned())
+			return;
+		scc_v.post_wcc_init();
+		if (scc_v.get_color() == scc_v.get_id())
+			roots.push_back(scc_v.get_id());
+	}
+
+	virtual void merge(graph_engine &graph, vertex_query::ptr q) {
+		color_root_query *crq = (color_root_query *) q.get();
+		roots.insert(roots.end(), crq->roots.begin(), crq->roots.end());
+	}
+
+	virtual ptr clone() {
+		return vertex_query::ptr(new color_root_query());
+	}
+
+	const std::vector<vertex_id_t> &get_roots() const {
+		return roots;
+	}
+};
+
 class max_degree_query: public vertex_query
 {
 	vsize_t max_degree;
@@ -1096,6 +1202,78 @@ public:
 	}
 };
 
+/*
+ * Get the number of vertices trimmed in the last run of the graph engine
+ * and the vertices trimmed by TRIM2.
+ */
+size_t collect_trimmed(graph_engine &graph, std::vector<vertex_id_t> &trimmed)
+{
+	std::vector<vertex_program::ptr> trim_vprogs;
+	graph.get_vertex_programs(trim_vprogs);
+	size_t num_trimmed = 0;
+	trimmed.clear();
+	BOOST_FOREACH(vertex_program::ptr vprog, trim_vprogs) {
+		trim_vertex_program::ptr trim_vprog = trim_vertex_program::cast2(vprog);
+		num_trimmed += trim_vprog->get_num_trimmed();
+		trimmed.insert(trimmed.end(), trim_vprog->get_trimmed().begin(),
+				trim_vprog->get_trimmed().end());
+	}
+	return num_trimmed;
+}
+
+/*
+ * Run FWBW from the vertex with the largest degree, which is most likely
+ * in the giant SCC, and partition the graph with the result.
+ * It returns the vertices that aren't assigned to a component.
+ */
+void find_giant_scc(graph_engine &graph, vertex_id_t max_v,
+		std::vector<vertex_id_t> &active_vertices)
+{
+	struct timeval start, end;
+	scc_stage = scc_stage_t::FWBW;
+	gettimeofday(&start, NULL);
+	graph.init_all_vertices(vertex_initializer::ptr(new fwbw_reset()));
+	scc_vertex &v = (scc_vertex &) graph.get_vertex(max_v);
+	v.init_fwbw();
+	graph.start(&max_v, 1);
+	graph.wait4complete();
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("FWBW takes %1% seconds") % time_diff(start, end);
+
+	scc_stage = scc_stage_t::PARTITION;
+	gettimeofday(&start, NULL);
+	graph.start_all(vertex_initializer::ptr(),
+			vertex_program_creater::ptr(new part_vertex_program_creater()));
+	graph.wait4complete();
+
+	std::vector<vertex_program::ptr> part_vprogs;
+	graph.get_vertex_programs(part_vprogs);
+	size_t largest_comp_size = 0;
+	BOOST_FOREACH(vertex_program::ptr vprog, part_vprogs) {
+		part_vertex_program::ptr part_vprog = part_vertex_program::cast2(vprog);
+		largest_comp_size += part_vprog->get_num_assigned();
+		active_vertices.insert(active_vertices.begin(),
+				part_vprog->get_remain_vertices().begin(),
+				part_vprog->get_remain_vertices().end());
+	}
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("partition takes %1% seconds. Assign %2% vertices to components.")
+		% time_diff(start, end) % largest_comp_size;
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("after partition, finding %1% active vertices takes %2% seconds.")
+		% active_vertices.size() % time_diff(start, end);
+}
+
+// TRIM2 and TRIM1 alternate until TRIM2 can't trim more vertices or
+// they have run for this number of rounds.
+const int MAX_TRIM_ROUNDS = 10;
+// The remaining vertices are partitioned by coloring when they are fewer
+// than this fraction of the graph. Most of them are in small SCCs, and
+// coloring finds the SCCs of all colors in one FW BFS.
+const double COLORING_RATIO = 0.01;
+
 class comp_size_compare
 {
 public:
@@ -1112,7 +1290,7 @@ public:
 namespace fg
 {
 
-FG_vector<vertex_id_t>::ptr compute_scc(FG_graph::ptr fg)
+FG_vector<vertex_id_t>::ptr compute_scc(FG_graph::ptr fg, bool giant_only)
 {
 	bool directed = fg->get_graph_header().is_directed_graph();
 	if (!directed) {
@@ -1134,6 +1312,8 @@ FG_vector<vertex_id_t>::ptr compute_scc(FG_graph::ptr fg)
 	std::vector<vertex_id_t> active_vertices;
 	vertex_id_t max_v = 0;
 	size_t num_comp1 = 0;
+	size_t num_comp2 = 0;
+	coloring = false;
 
 	struct timeval start, end, scc_start;
 	scc_stage = scc_stage_t::INIT;
@@ -1145,77 +1325,48 @@ FG_vector<vertex_id_t>::ptr compute_scc(FG_graph::ptr fg)
 	BOOST_LOG_TRIVIAL(info)
 		<< boost::format("init takes %1% seconds.") % time_diff(start, end);
 
+	// Trim the vertices without remaining in-edges or out-edges until
+	// there are no such vertices. Then trim the SCCs of size 2, whose
+	// vertices cause more vertices to be trimmed.
 	scc_stage = scc_stage_t::TRIM1;
 	gettimeofday(&start, NULL);
 	graph->start_all(vertex_initializer::ptr(new trim1_initializer()),
 			vertex_program_creater::ptr(new trim_vertex_program_creater()));
 	graph->wait4complete();
-	std::vector<vertex_program::ptr> trim_vprogs;
-	graph->get_vertex_programs(trim_vprogs);
-	BOOST_FOREACH(vertex_program::ptr vprog, trim_vprogs) {
-		trim_vertex_program::ptr trim_vprog = trim_vertex_program::cast2(vprog);
-		num_comp1 += trim_vprog->get_num_trimmed();
-	}
-	gettimeofday(&end, NULL);
-	BOOST_LOG_TRIVIAL(info)
-		<< boost::format("trim1 takes %1% seconds. It trims %2% vertices")
-		% time_diff(start, end) % num_comp1;
+	std::vector<vertex_id_t> trimmed;
+	num_comp1 += collect_trimmed(*graph, trimmed);
+	int num_trim_rounds;
+	for (num_trim_rounds = 0; num_trim_rounds < MAX_TRIM_ROUNDS;
+			num_trim_rounds++) {
+		scc_stage = scc_stage_t::TRIM2;
+		graph->start(std::shared_ptr<vertex_filter>(new trim2_filter()),
+				vertex_program_creater::ptr(new trim_vertex_program_creater()));
+		graph->wait4complete();
+		num_comp2 += collect_trimmed(*graph, trimmed);
+		if (trimmed.empty())
+			break;
 
-#if 0
-	scc_stage = scc_stage_t::TRIM2;
-	gettimeofday(&start, NULL);
-	graph->start_all(vertex_initializer::ptr(),
-			vertex_program_creater::ptr(new trim_vertex_program_creater()));
-	graph->wait4complete();
-	graph->get_vertex_programs(trim_vprogs);
-	BOOST_FOREACH(vertex_program::ptr vprog, trim_vprogs) {
-		trim_vertex_program::ptr trim_vprog = trim_vertex_program::cast2(vprog);
-		num_comp2 += trim_vprog->get_num_trimmed();
+		// The vertices trimmed by TRIM2 notify their neighbors.
+		scc_stage = scc_stage_t::TRIM1;
+		graph->start(trimmed.data(), trimmed.size(), vertex_initializer::ptr(),
+				vertex_program_creater::ptr(new trim_vertex_program_creater()));
+		graph->wait4complete();
+		num_comp1 += collect_trimmed(*graph, trimmed);
 	}
 	gettimeofday(&end, NULL);
-	printf("trim2 takes %f seconds. It trims %ld vertices\n",
-			time_diff(start, end), num_comp2);
-#endif
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("trimming takes %1% seconds in %2% rounds. trim1 trims %3% vertices and trim2 trims %4% vertices")
+		% time_diff(start, end) % (num_trim_rounds + 1) % num_comp1 % num_comp2;
 
 	vertex_query::ptr mdq(new max_degree_query());
 	graph->query_on_all(mdq);
 	max_v = ((max_degree_query *) mdq.get())->get_max_id();
-	scc_stage = scc_stage_t::FWBW;
-	gettimeofday(&start, NULL);
-	graph->init_all_vertices(vertex_initializer::ptr(new fwbw_reset()));
-	scc_vertex &v = (scc_vertex &) index->get_vertex(max_v);
-	v.init_fwbw();
-	graph->start(&max_v, 1);
-	graph->wait4complete();
-	gettimeofday(&end, NULL);
-	BOOST_LOG_TRIVIAL(info)
-		<< boost::format("FWBW takes %1% seconds") % time_diff(start, end);
-
-	scc_stage = scc_stage_t::PARTITION;
-	gettimeofday(&start, NULL);
-	graph->start_all(vertex_initializer::ptr(),
-			vertex_program_creater::ptr(new part_vertex_program_creater()));
-	graph->wait4complete();
+	if (max_v != INVALID_VERTEX_ID)
+		find_giant_scc(*graph, max_v, active_vertices);
 
-	std::vector<vertex_program::ptr> part_vprogs;
-	graph->get_vertex_programs(part_vprogs);
-	size_t largest_comp_size = 0;
-	BOOST_FOREACH(vertex_program::ptr vprog, part_vprogs) {
-		part_vertex_program::ptr part_vprog = part_vertex_program::cast2(vprog);
-		largest_comp_size += part_vprog->get_num_assigned();
-		active_vertices.insert(active_vertices.begin(),
-				part_vprog->get_remain_vertices().begin(),
-				part_vprog->get_remain_vertices().end());
-	}
-	gettimeofday(&end, NULL);
-	BOOST_LOG_TRIVIAL(info)
-		<< boost::format("partition takes %1% seconds. Assign %2% vertices to components.")
-		% time_diff(start, end) % largest_comp_size;
-	BOOST_LOG_TRIVIAL(info)
-		<< boost::format("after partition, finding %1% active vertices takes %2% seconds.")
-		% active_vertices.size() % time_diff(start, end);
-
-	do {
+	// In the giant-only mode, the remaining vertices aren't assigned to
+	// any component.
+	while (!giant_only && !active_vertices.empty()) {
 		scc_stage = scc_stage_t::TRIM3;
 		trim3_vertices = 0;
 		graph->start(active_vertices.data(), active_vertices.size());
@@ -1229,21 +1380,38 @@ FG_vector<vertex_id_t>::ptr compute_scc(FG_graph::ptr fg)
 				std::shared_ptr<vertex_initializer>(new in_wcc_initializer()));
 		graph->wait4complete();
 
-		scc_stage = scc_stage_t::OUT_WCC;
-		graph->start(active_vertices.data(), active_vertices.size(),
-				std::shared_ptr<vertex_initializer>(new out_wcc_initializer()));
-		graph->wait4complete();
-		vertex_query::ptr mdq1(new post_wcc_query());
-		graph->query_on_all(mdq1);
-
-		std::vector<vertex_id_t> fwbw_starts;
-		((post_wcc_query *) mdq1.get())->get_max_ids(fwbw_starts);
-		BOOST_LOG_TRIVIAL(info)
-			<< boost::format("FWBW starts on %1% vertices") % fwbw_starts.size();
-		scc_stage = scc_stage_t::FWBW;
-		graph->start(fwbw_starts.data(), fwbw_starts.size(),
-				vertex_initializer::ptr(new fwbw_initializer()));
-		graph->wait4complete();
+		coloring = active_vertices.size()
+			< graph->get_num_vertices() * COLORING_RATIO;
+		if (coloring) {
+			vertex_query::ptr crq(new color_root_query());
+			graph->query_on_all(crq);
+			const std::vector<vertex_id_t> &roots
+				= ((color_root_query *) crq.get())->get_roots();
+			BOOST_LOG_TRIVIAL(info)
+				<< boost::format("coloring FW starts on %1% vertices")
+				% roots.size();
+			scc_stage = scc_stage_t::FWBW;
+			graph->start(roots.data(), roots.size(),
+					vertex_initializer::ptr(new color_root_initializer()));
+			graph->wait4complete();
+		}
+		else {
+			scc_stage = scc_stage_t::OUT_WCC;
+			graph->start(active_vertices.data(), active_vertices.size(),
+					std::shared_ptr<vertex_initializer>(new out_wcc_initializer()));
+			graph->wait4complete();
+			vertex_query::ptr mdq1(new post_wcc_query());
+			graph->query_on_all(mdq1);
+
+			std::vector<vertex_id_t> fwbw_starts;
+			((post_wcc_query *) mdq1.get())->get_max_ids(fwbw_starts);
+			BOOST_LOG_TRIVIAL(info)
+				<< boost::format("FWBW starts on %1% vertices") % fwbw_starts.size();
+			scc_stage = scc_stage_t::FWBW;
+			graph->start(fwbw_starts.data(), fwbw_starts.size(),
+					vertex_initializer::ptr(new fwbw_initializer()));
+			graph->wait4complete();
+		}
 
 		scc_stage = scc_stage_t::PARTITION;
 		graph->start(active_vertices.data(), active_vertices.size(),
@@ -1271,7 +1439,8 @@ FG_vector<vertex_id_t>::ptr compute_scc(FG_graph::ptr fg)
 		BOOST_LOG_TRIVIAL(info)
 			<< boost::format("There are %1% vertices left unassigned")
 			% active_vertices.size();
-	} while (!active_vertices.empty());
+	}
+	gettimeofday(&end, NULL);
 	BOOST_LOG_TRIVIAL(info)
 			<< boost::format("scc takes %1% seconds") % time_diff(scc_start, end);
 
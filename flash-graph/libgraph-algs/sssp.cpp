@@ -0,0 +1,499 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef PROFILER
+#include <gperftools/profiler.h>
+#endif
+
+#include <math.h>
+
+#include <vector>
+#include <map>
+#include <limits>
+#include <algorithm>
+
+#include "graph_engine.h"
+#include "graph_config.h"
+#include "FGlib.h"
+#include "save_result.h"
+
+using namespace fg;
+
+/*
+ * This implements delta-stepping single-source shortest paths.
+ * Vertices are put in buckets of width `delta' based on their tentative
+ * distances, and the buckets are processed in order. In a bucket, vertices
+ * relax their light edges (with weights <= delta) repeatedly until no
+ * vertices in the bucket change their distances. Then the vertices settled
+ * in the bucket relax their heavy edges once.
+ *
+ * Only the distances of vertices are kept in memory. The edge lists and
+ * their weights are read from SSDs every time a vertex relaxes its edges.
+ */
+
+namespace {
+
+const double INF_DIST = std::numeric_limits<double>::infinity();
+
+edge_type traverse_edge = edge_type::OUT_EDGE;
+double delta;
+long curr_bucket;
+
+enum sssp_phase_t
+{
+	// Relax the light edges of the vertices in the current bucket.
+	LIGHT,
+	// Relax the heavy edges of the vertices settled in the current bucket.
+	HEAVY,
+	// Relax all edges whenever a vertex changes its distance. The order
+	// in which vertices run is determined by a priority scheduler.
+	ASYNC,
+};
+sssp_phase_t sssp_phase;
+
+long get_bucket(double dist)
+{
+	return (long) floor(dist / delta);
+}
+
+class dist_message: public vertex_message
+{
+	double dist;
+public:
+	dist_message(double dist, bool activate): vertex_message(
+			sizeof(dist_message), activate) {
+		this->dist = dist;
+	}
+
+	double get_dist() const {
+		return dist;
+	}
+
+	void set_dist(double dist) {
+		this->dist = dist;
+	}
+};
+
+/*
+ * A vertex only needs the shortest distance sent to it.
+ */
+class dist_msg_combiner: public vertex_msg_combiner
+{
+public:
+	void combine(vertex_message &combined, const vertex_message &msg) const {
+		dist_message &dmsg = (dist_message &) combined;
+		dmsg.set_dist(std::min(dmsg.get_dist(),
+					((const dist_message &) msg).get_dist()));
+	}
+};
+
+template<class WeightType>
+class sssp_vertex: public compute_directed_vertex
+{
+	double dist;
+	// The distance has changed since the vertex relaxed its edges.
+	bool dirty;
+	// The vertex has relaxed its light edges.
+	bool relaxed;
+	bool has_heavy;
+
+	void request_edges(vertex_program &prog);
+	void relax_edges(vertex_program &prog, const page_vertex &vertex,
+			edge_type type);
+public:
+	sssp_vertex(vertex_id_t id): compute_directed_vertex(id) {
+		dist = INF_DIST;
+		dirty = false;
+		relaxed = false;
+		has_heavy = false;
+	}
+
+	void init_source() {
+		dist = 0;
+		dirty = true;
+	}
+
+	double get_dist() const {
+		return dist;
+	}
+
+	bool is_dirty() const {
+		return dirty;
+	}
+
+	double get_result() const {
+		return dist;
+	}
+
+	void run(vertex_program &prog) {
+		switch (sssp_phase) {
+			case LIGHT:
+				if (dirty && get_bucket(dist) == curr_bucket) {
+					dirty = false;
+					request_edges(prog);
+				}
+				break;
+			case HEAVY:
+				assert(has_heavy);
+				request_edges(prog);
+				break;
+			case ASYNC:
+				if (dirty) {
+					dirty = false;
+					request_edges(prog);
+				}
+				break;
+		}
+	}
+
+	void run(vertex_program &prog, const page_vertex &vertex);
+
+	void run_on_message(vertex_program &prog, const vertex_message &msg);
+};
+
+/*
+ * The vertex program keeps the vertices whose distances fall into
+ * the buckets after the current one, and the vertices settled in
+ * the current bucket that have heavy edges.
+ */
+template<class WeightType>
+class sssp_vertex_program: public vertex_program_impl<sssp_vertex<WeightType> >
+{
+	std::map<long, std::vector<vertex_id_t> > buckets;
+	std::vector<vertex_id_t> settled;
+public:
+	typedef std::shared_ptr<sssp_vertex_program<WeightType> > ptr;
+
+	static ptr cast2(vertex_program::ptr prog) {
+		return std::static_pointer_cast<sssp_vertex_program<WeightType>,
+			   vertex_program>(prog);
+	}
+
+	void add_bucket(long bucket, vertex_id_t id) {
+		buckets[bucket].push_back(id);
+	}
+
+	void add_settled(vertex_id_t id) {
+		settled.push_back(id);
+	}
+
+	std::map<long, std::vector<vertex_id_t> > &get_buckets() {
+		return buckets;
+	}
+
+	std::vector<vertex_id_t> &get_settled() {
+		return settled;
+	}
+};
+
+template<class WeightType>
+class sssp_vertex_program_creater: public vertex_program_creater
+{
+public:
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new sssp_vertex_program<WeightType>());
+	}
+};
+
+template<class WeightType>
+vertex_program_creater::ptr get_creater()
+{
+	return vertex_program_creater::ptr(
+			new sssp_vertex_program_creater<WeightType>());
+}
+
+template<class WeightType>
+void sssp_vertex<WeightType>::request_edges(vertex_program &prog)
+{
+	vertex_id_t id = prog.get_vertex_id(*this);
+	if (prog.get_graph().is_directed() && traverse_edge != BOTH_EDGES) {
+		directed_vertex_request req(id, traverse_edge);
+		request_partial_vertices(&req, 1);
+	}
+	else
+		request_vertices(&id, 1);
+}
+
+template<class WeightType>
+void sssp_vertex<WeightType>::relax_edges(vertex_program &prog,
+		const page_vertex &vertex, edge_type type)
+{
+	edge_seq_iterator it = vertex.get_neigh_seq_it(type);
+	safs::page_byte_array::seq_const_iterator<WeightType> w_it
+		= vertex.is_directed()
+		? ((const page_directed_vertex &) vertex).get_data_seq_it<WeightType>(type)
+		: ((const page_undirected_vertex &) vertex).get_data_seq_it<WeightType>();
+	while (it.has_next()) {
+		vertex_id_t dest = it.next();
+		BOOST_VERIFY(w_it.has_next());
+		WeightType w = w_it.next();
+		assert(w >= 0);
+		bool light = w <= delta;
+		if (sssp_phase == LIGHT && !light) {
+			has_heavy = true;
+			continue;
+		}
+		if (sssp_phase == HEAVY && light)
+			continue;
+		// The vertices that receive distances through heavy edges can't
+		// be in the current bucket, so they don't need to run now.
+		dist_message msg(dist + w, sssp_phase != HEAVY);
+		prog.send_msg(dest, msg);
+	}
+}
+
+template<class WeightType>
+void sssp_vertex<WeightType>::run(vertex_program &prog,
+		const page_vertex &vertex)
+{
+	if (vertex.is_directed() && traverse_edge == BOTH_EDGES) {
+		relax_edges(prog, vertex, IN_EDGE);
+		relax_edges(prog, vertex, OUT_EDGE);
+	}
+	else
+		relax_edges(prog, vertex, traverse_edge);
+
+	// A vertex relaxes its light edges only in the bucket where it settles.
+	// We need to remember it if it has heavy edges to relax at the end of
+	// the bucket.
+	if (sssp_phase == LIGHT && !relaxed) {
+		relaxed = true;
+		if (has_heavy)
+			((sssp_vertex_program<WeightType> &) prog).add_settled(
+					prog.get_vertex_id(*this));
+	}
+}
+
+template<class WeightType>
+void sssp_vertex<WeightType>::run_on_message(vertex_program &prog,
+		const vertex_message &msg1)
+{
+	const dist_message &msg = (const dist_message &) msg1;
+	if (msg.get_dist() >= dist)
+		return;
+
+	long old_bucket = dist == INF_DIST ? -1 : get_bucket(dist);
+	dist = msg.get_dist();
+	dirty = true;
+	if (sssp_phase == ASYNC)
+		return;
+	// The vertices in the current bucket have been activated by
+	// the message. The others will run when we reach their buckets.
+	long bucket = get_bucket(dist);
+	if (bucket > curr_bucket && bucket != old_bucket)
+		((sssp_vertex_program<WeightType> &) prog).add_bucket(bucket,
+				prog.get_vertex_id(*this));
+}
+
+template<class WeightType>
+class sssp_initializer: public vertex_initializer
+{
+public:
+	void init(compute_vertex &v) {
+		((sssp_vertex<WeightType> &) v).init_source();
+	}
+};
+
+/*
+ * In the asynchronous mode, the vertices with shorter distances run first.
+ */
+template<class WeightType>
+class dist_scheduler: public priority_vertex_scheduler
+{
+public:
+	dist_scheduler(double delta): priority_vertex_scheduler(delta) {
+	}
+
+	double get_priority(vertex_program &prog, const compute_vertex &v) {
+		return ((const sssp_vertex<WeightType> &) v).get_dist();
+	}
+};
+
+/*
+ * Collect the buckets and the settled vertices from the vertex programs
+ * of a run of the graph engine.
+ */
+template<class WeightType>
+void collect_buckets(graph_engine::ptr graph,
+		std::map<long, std::vector<vertex_id_t> > &buckets,
+		std::vector<vertex_id_t> &settled)
+{
+	std::vector<vertex_program::ptr> programs;
+	graph->get_vertex_programs(programs);
+	BOOST_FOREACH(vertex_program::ptr prog, programs) {
+		typename sssp_vertex_program<WeightType>::ptr sssp_prog
+			= sssp_vertex_program<WeightType>::cast2(prog);
+		std::map<long, std::vector<vertex_id_t> > &local
+			= sssp_prog->get_buckets();
+		for (auto it = local.begin(); it != local.end(); it++) {
+			std::vector<vertex_id_t> &bucket = buckets[it->first];
+			bucket.insert(bucket.end(), it->second.begin(), it->second.end());
+		}
+		local.clear();
+		std::vector<vertex_id_t> &local_settled = sssp_prog->get_settled();
+		settled.insert(settled.end(), local_settled.begin(),
+				local_settled.end());
+		local_settled.clear();
+	}
+}
+
+template<class WeightType>
+void delta_stepping(graph_engine::ptr graph, vertex_id_t start_vertex)
+{
+	std::map<long, std::vector<vertex_id_t> > buckets;
+	std::vector<vertex_id_t> settled;
+	std::vector<vertex_id_t> ids;
+	size_t num_buckets = 0;
+	size_t num_light_runs = 0;
+
+	curr_bucket = 0;
+	sssp_phase = LIGHT;
+	graph->start(&start_vertex, 1, vertex_initializer::ptr(
+				new sssp_initializer<WeightType>()), get_creater<WeightType>());
+	graph->wait4complete();
+	num_light_runs++;
+	while (true) {
+		num_buckets++;
+		collect_buckets<WeightType>(graph, buckets, settled);
+		if (!settled.empty()) {
+			sssp_phase = HEAVY;
+			graph->start(settled.data(), settled.size(),
+					vertex_initializer::ptr(), get_creater<WeightType>());
+			graph->wait4complete();
+			settled.clear();
+			collect_buckets<WeightType>(graph, buckets, settled);
+			assert(settled.empty());
+		}
+
+		// Find the next non-empty bucket. A vertex may be in a bucket that
+		// it has left because its distance has decreased since then.
+		ids.clear();
+		while (ids.empty() && !buckets.empty()) {
+			auto it = buckets.begin();
+			curr_bucket = it->first;
+			BOOST_FOREACH(vertex_id_t id, it->second) {
+				sssp_vertex<WeightType> &v
+					= (sssp_vertex<WeightType> &) graph->get_vertex(id);
+				if (v.is_dirty() && get_bucket(v.get_dist()) == curr_bucket)
+					ids.push_back(id);
+			}
+			buckets.erase(it);
+		}
+		if (ids.empty())
+			break;
+
+		sssp_phase = LIGHT;
+		graph->start(ids.data(), ids.size(), vertex_initializer::ptr(),
+				get_creater<WeightType>());
+		graph->wait4complete();
+		num_light_runs++;
+	}
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("delta-stepping processes %1% buckets with %2% light runs")
+		% num_buckets % num_light_runs;
+}
+
+template<class WeightType>
+FG_vector<double>::ptr run_sssp(FG_graph::ptr fg, vertex_id_t start_vertex,
+		bool async)
+{
+	if ((size_t) fg->get_graph_header().get_edge_data_size()
+			!= sizeof(WeightType)) {
+		BOOST_LOG_TRIVIAL(error)
+			<< boost::format("The edge weight has %1% bytes, but the graph has %2% bytes of edge data")
+			% sizeof(WeightType) % fg->get_graph_header().get_edge_data_size();
+		return FG_vector<double>::ptr();
+	}
+
+	graph_index::ptr index = NUMA_graph_index<sssp_vertex<WeightType> >::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	if (start_vertex > graph->get_max_vertex_id()) {
+		BOOST_LOG_TRIVIAL(error)
+			<< boost::format("The start vertex %1% doesn't exist") % start_vertex;
+		return FG_vector<double>::ptr();
+	}
+	graph->set_msg_combiner(vertex_msg_combiner::ptr(new dist_msg_combiner()));
+
+	BOOST_LOG_TRIVIAL(info) << boost::format("SSSP starts from v%1%%2%")
+		% start_vertex % (async ? " asynchronously" : "");
+#ifdef PROFILER
+	if (!graph_conf.get_prof_file().empty())
+		ProfilerStart(graph_conf.get_prof_file().c_str());
+#endif
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	if (async) {
+		sssp_phase = ASYNC;
+		graph->set_async_mode(true);
+		graph->set_vertex_scheduler(vertex_scheduler::ptr(
+					new dist_scheduler<WeightType>(delta)));
+		graph->start(&start_vertex, 1, vertex_initializer::ptr(
+					new sssp_initializer<WeightType>()),
+				get_creater<WeightType>());
+		graph->wait4complete();
+	}
+	else
+		delta_stepping<WeightType>(graph, start_vertex);
+	gettimeofday(&end, NULL);
+#ifdef PROFILER
+	if (!graph_conf.get_prof_file().empty())
+		ProfilerStop();
+#endif
+	BOOST_LOG_TRIVIAL(info) << boost::format("SSSP takes %1% seconds")
+		% time_diff(start, end);
+
+	FG_vector<double>::ptr vec = FG_vector<double>::create(graph);
+	graph->query_on_all(vertex_query::ptr(
+				new save_query<double, sssp_vertex<WeightType> >(vec)));
+	return vec;
+}
+
+}
+
+namespace fg
+{
+
+FG_vector<double>::ptr compute_sssp(FG_graph::ptr fg, vertex_id_t start_vertex,
+		edge_type traverse_e, const std::string &weight_type,
+		double delta, bool async)
+{
+	if (delta <= 0) {
+		BOOST_LOG_TRIVIAL(error) << "delta has to be positive";
+		return FG_vector<double>::ptr();
+	}
+	::delta = delta;
+	traverse_edge = traverse_e;
+
+	if (weight_type == "I")
+		return run_sssp<int>(fg, start_vertex, async);
+	else if (weight_type == "L")
+		return run_sssp<long>(fg, start_vertex, async);
+	else if (weight_type == "F")
+		return run_sssp<float>(fg, start_vertex, async);
+	else if (weight_type == "D")
+		return run_sssp<double>(fg, start_vertex, async);
+	else {
+		BOOST_LOG_TRIVIAL(error) << boost::format("unknown weight type: %1%")
+			% weight_type;
+		return FG_vector<double>::ptr();
+	}
+}
+
+}
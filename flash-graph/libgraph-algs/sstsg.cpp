@@ -38,6 +38,31 @@ namespace {
 time_t timestamp;
 time_t time_interval = 1;
 int num_time_intervals = 1;
+// The temporal index of the graph. It may not exist.
+const ts_vertex_index *ts_index;
+
+edge_seq_iterator get_edges(const page_directed_vertex &v, edge_type type,
+		time_t time_start, time_t time_interval)
+{
+	if (ts_index)
+		return get_ts_iterator(v, type, time_start, time_interval, *ts_index);
+	else
+		return get_ts_iterator(v, type, time_start, time_interval);
+}
+
+/*
+ * Test if a vertex has edges in the time interval or in any of
+ * the previous intervals.
+ */
+bool has_edges(vertex_id_t id, int num_intervals)
+{
+	if (ts_index == NULL)
+		return true;
+	time_t start = timestamp - (num_intervals - 1) * time_interval;
+	time_t length = num_intervals * time_interval;
+	return ts_index->has_edges(id, edge_type::IN_EDGE, start, length)
+		|| ts_index->has_edges(id, edge_type::OUT_EDGE, start, length);
+}
 
 class scan_vertex: public compute_vertex
 {
@@ -56,6 +81,7 @@ public:
 		num_joined = 0;
 		local_scans = NULL;
 		neighbors = NULL;
+		result = 0;
 	}
 
 	double get_result() const {
@@ -71,7 +97,9 @@ public:
 
 	void run(vertex_program &prog) {
 		vertex_id_t id = prog.get_vertex_id(*this);
-		request_vertices(&id, 1);
+		// A vertex without edges in the time interval has nothing to scan.
+		if (has_edges(id, 1))
+			request_vertices(&id, 1);
 	}
 
 	void run(vertex_program &prog, const page_vertex &vertex) {
@@ -83,6 +111,7 @@ public:
 
 	void run_on_itself(vertex_program &prog, const page_directed_vertex &vertex);
 	void run_on_neighbor(vertex_program &prog, const page_directed_vertex &vertex);
+	void finalize();
 
 	void run_on_message(vertex_program &prog, const vertex_message &msg) {
 	}
@@ -93,7 +122,7 @@ size_t scan_vertex::count_edges(vertex_program &prog, const page_directed_vertex
 		time_t time_interval, edge_type type)
 {
 	size_t num_local_edges = 0;
-	edge_seq_iterator it = get_ts_iterator(v, type, timestamp, time_interval);
+	edge_seq_iterator it = get_edges(v, type, timestamp, time_interval);
 	// If there are no edges in the time interval.
 	if (it.get_num_tot_entries() == 0)
 		return 0;
@@ -179,7 +208,7 @@ int unique_merge(InputIterator1 it1, InputIterator1 last1,
 size_t get_neighbors(const page_directed_vertex &v, edge_type type, time_t time_start,
 		time_t time_interval, std::vector<vertex_id_t> &neighbors)
 {
-	edge_seq_iterator it = get_ts_iterator(v, type, time_start, time_interval);
+	edge_seq_iterator it = get_edges(v, type, time_start, time_interval);
 	size_t ret = it.get_num_tot_entries();
 	PAGE_FOREACH(vertex_id_t, id, it) {
 		neighbors.push_back(id);
@@ -253,7 +282,7 @@ void scan_vertex::run_on_itself(vertex_program &prog,
 		time_t timestamp2 = timestamp - ts_idx * time_interval;
 
 		// For in-edges.
-		edge_seq_iterator it = get_ts_iterator(vertex, edge_type::IN_EDGE,
+		edge_seq_iterator it = get_edges(vertex, edge_type::IN_EDGE,
 				timestamp2, time_interval);
 		PAGE_FOREACH(vertex_id_t, id, it) {
 			// Ignore loop
@@ -266,7 +295,7 @@ void scan_vertex::run_on_itself(vertex_program &prog,
 		} PAGE_FOREACH_END
 
 		// For out-edges.
-		it = get_ts_iterator(vertex, edge_type::OUT_EDGE, timestamp2,
+		it = get_edges(vertex, edge_type::OUT_EDGE, timestamp2,
 					time_interval);
 		PAGE_FOREACH(vertex_id_t, id, it) {
 			// Ignore loop
@@ -279,7 +308,18 @@ void scan_vertex::run_on_itself(vertex_program &prog,
 		} PAGE_FOREACH_END
 	}
 
-	request_vertices(neighbors->data(), neighbors->size());
+	// The neighbors without edges in any of the time intervals don't
+	// contribute to the local scans, so we don't need to read them.
+	std::vector<vertex_id_t> reqs;
+	BOOST_FOREACH(vertex_id_t id, *neighbors) {
+		if (has_edges(id, num_time_intervals))
+			reqs.push_back(id);
+	}
+	num_joined = neighbors->size() - reqs.size();
+	if (reqs.empty())
+		finalize();
+	else
+		request_vertices(reqs.data(), reqs.size());
 }
 
 void scan_vertex::run_on_neighbor(vertex_program &prog,
@@ -297,36 +337,40 @@ void scan_vertex::run_on_neighbor(vertex_program &prog,
 
 	// If we have seen all required neighbors, we have complete
 	// the computation. We can release the memory now.
-	if (num_joined == (int) neighbors->size()) {
-		double avg = 0;
-		if (num_time_intervals - 1 > 0) {
-			double sum = 0;
-			for (int i = 1; i < num_time_intervals; i++)
-				sum += local_scans->at(i);
-			avg = sum / (num_time_intervals - 1);
-		}
+	if (num_joined == (int) neighbors->size())
+		finalize();
+}
 
-		double deviation;
-		if (num_time_intervals - 1 <= 1)
-			deviation = 1;
-		else {
-			double sum = 0;
-			for (int i = 1; i < num_time_intervals; i++) {
-				sum += (local_scans->at(i)
-						- avg) * (local_scans->at(i) - avg);
-			}
-			sum = sum / (num_time_intervals - 2);
-			deviation = sqrt(sum);
-			if (deviation < 1)
-				deviation = 1;
-		}
-		result = (local_scans->at(0) - avg) / deviation;
+void scan_vertex::finalize()
+{
+	double avg = 0;
+	if (num_time_intervals - 1 > 0) {
+		double sum = 0;
+		for (int i = 1; i < num_time_intervals; i++)
+			sum += local_scans->at(i);
+		avg = sum / (num_time_intervals - 1);
+	}
 
-		delete local_scans;
-		delete neighbors;
-		local_scans = NULL;
-		neighbors = NULL;
+	double deviation;
+	if (num_time_intervals - 1 <= 1)
+		deviation = 1;
+	else {
+		double sum = 0;
+		for (int i = 1; i < num_time_intervals; i++) {
+			sum += (local_scans->at(i)
+					- avg) * (local_scans->at(i) - avg);
+		}
+		sum = sum / (num_time_intervals - 2);
+		deviation = sqrt(sum);
+		if (deviation < 1)
+			deviation = 1;
 	}
+	result = (local_scans->at(0) - avg) / deviation;
+
+	delete local_scans;
+	delete neighbors;
+	local_scans = NULL;
+	neighbors = NULL;
 }
 
 }
@@ -337,15 +381,16 @@ namespace fg
 {
 
 FG_vector<float>::ptr compute_sstsg(FG_graph::ptr fg, time_t start_time,
-		time_t interval, int num_intervals)
+		time_t interval, int num_intervals, ts_vertex_index::ptr index)
 {
 	timestamp = start_time;
 	time_interval = interval;
 	num_time_intervals = num_intervals;
+	ts_index = index.get();
 
-	graph_index::ptr index = NUMA_graph_index<scan_vertex>::create(
+	graph_index::ptr gindex = NUMA_graph_index<scan_vertex>::create(
 			fg->get_graph_header());
-	graph_engine::ptr graph = fg->create_engine(index);
+	graph_engine::ptr graph = fg->create_engine(gindex);
 	assert(graph->get_graph_header().get_graph_type() == graph_type::DIRECTED);
 	assert(graph->get_graph_header().has_edge_data());
 	BOOST_LOG_TRIVIAL(info)
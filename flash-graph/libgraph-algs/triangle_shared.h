@@ -21,7 +21,7 @@
 
 #include "graph_engine.h"
 #include "graph_config.h"
-#include "graphlab/cuckoo_set_pow2.hpp"
+#include "set_intersect.h"
 #include "FG_vector.h"
 #include "FGlib.h"
 
@@ -30,9 +30,7 @@
  * and undirected triangle counting.
  */
 
-const double BIN_SEARCH_RATIO = 100;
-const int HASH_SEARCH_RATIO = 16;
-const int hash_threshold = 1000;
+const int index_threshold = 1000;
 
 static atomic_number<long> num_working_vertices;
 static atomic_number<long> num_completed_vertices;
@@ -52,49 +50,40 @@ public:
 
 struct runtime_data_t
 {
-	class index_entry
+	/*
+	 * Count the triangles on the neighbors of this vertex shared with
+	 * the neighbor vertex `v'.
+	 */
+	class triangle_counter
 	{
-		fg::vertex_id_t id;
-		uint32_t idx;
+		std::vector<int> &triangles;
+		const fg::vertex_id_t *neighs;
+		fg::vertex_id_t neigh_id;
+		fg::vertex_id_t this_id;
+		size_t num_triangles;
 	public:
-		index_entry() {
-			id = -1;
-			idx = -1;
-		}
-
-		index_entry(fg::vertex_id_t id) {
-			this->id = id;
-			this->idx = -1;
-		}
-
-		index_entry(fg::vertex_id_t id, uint32_t idx) {
-			this->id = id;
-			this->idx = idx;
-		}
-
-		fg::vertex_id_t get_id() const {
-			return id;
+		triangle_counter(std::vector<int> &_triangles,
+				const fg::vertex_id_t *neighs, fg::vertex_id_t neigh_id,
+				fg::vertex_id_t this_id): triangles(_triangles) {
+			this->neighs = neighs;
+			this->neigh_id = neigh_id;
+			this->this_id = this_id;
+			num_triangles = 0;
 		}
 
-		uint32_t get_idx() const {
-			return idx;
+		void operator()(size_t this_idx, size_t neigh_idx) {
+			// We need to skip loops.
+			if (neighs[neigh_idx] != neigh_id && neighs[neigh_idx] != this_id) {
+				num_triangles++;
+				triangles[this_idx]++;
+			}
 		}
 
-		bool operator==(const index_entry &e) const {
-			return id == e.get_id();
+		size_t get_num_triangles() const {
+			return num_triangles;
 		}
 	};
 
-	class index_hash
-	{
-		boost::hash<fg::vertex_id_t> id_hash;
-	public:
-		size_t operator()(const index_entry &e) const {
-			return id_hash(e.get_id());
-		}
-	};
-	typedef graphlab::cuckoo_set_pow2<index_entry, 3, size_t,
-			index_hash> edge_set_t;
 	// It contains part of the edge list.
 	// We only use the neighbors whose ID is smaller than this vertex.
 	std::vector<fg::vertex_id_t> edges;
@@ -107,22 +96,39 @@ struct runtime_data_t
 	size_t num_required;
 	size_t num_triangles;
 
-	edge_set_t edge_set;
+	fg::sorted_id_set edge_set;
 public:
-	runtime_data_t(size_t num_edges, size_t num_triangles): edge_set(
-				index_entry(), 0, 2 * num_edges) {
+	runtime_data_t(size_t num_edges, size_t num_triangles) {
 		num_joined = 0;
 		this->num_required = 0;
 		this->num_triangles = num_triangles;
 	}
 
 	void finalize_init() {
-		// We only build a hash table on large vertices
-		if (edges.size() > (size_t) hash_threshold)
-			for (size_t i = 0; i < edges.size(); i++)
-				edge_set.insert(index_entry(edges[i], i));
+		// We only build a bitmap index on large vertices, which are
+		// intersected with many neighbor lists.
+		edge_set.init(edges.data(), edges.size(),
+				edges.size() > (size_t) index_threshold);
 		triangles.resize(edges.size());
 	}
+
+	/*
+	 * Count the triangles formed by this vertex, the neighbor `v' and
+	 * the common neighbors of the two vertices. We only use the neighbors
+	 * of `v' whose IDs are smaller than `max_id'.
+	 */
+	size_t count_triangles(const fg::page_vertex &v, fg::edge_type type,
+			fg::vertex_id_t this_id,
+			fg::vertex_id_t max_id = fg::INVALID_VERTEX_ID) {
+		size_t num_neighs;
+		const fg::vertex_id_t *neighs = fg::read_neighbors(v, type, num_neighs);
+		if (max_id != fg::INVALID_VERTEX_ID)
+			num_neighs = std::lower_bound(neighs, neighs + num_neighs,
+					max_id) - neighs;
+		triangle_counter counter(triangles, neighs, v.get_id(), this_id);
+		fg::intersect(edge_set, neighs, num_neighs, counter);
+		return counter.get_num_triangles();
+	}
 };
 
 enum multi_func_flags
@@ -20,8 +20,13 @@
 #include <gperftools/profiler.h>
 #endif
 
+#include <omp.h>
+
 #include <vector>
+#include <atomic>
+#include <random>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "graph_engine.h"
 #include "graph_config.h"
@@ -33,6 +38,13 @@ using namespace fg;
 
 namespace {
 
+/*
+ * In incremental mode, most vertices already have their final component IDs
+ * and don't send them to neighbors. When such a vertex receives a larger
+ * component ID, it has to send its own component ID back.
+ */
+bool incremental = false;
+
 class component_message: public vertex_message
 {
 	int id;
@@ -69,6 +81,15 @@ public:
 		return component_id;
 	}
 
+	/*
+	 * Initialize the vertex with a previously computed component ID.
+	 */
+	void init_component(vertex_id_t component_id, bool empty, bool updated) {
+		this->component_id = component_id;
+		this->empty = empty;
+		this->updated = updated;
+	}
+
 	void run(vertex_program &prog) {
 		if (updated) {
 			vertex_id_t id = prog.get_vertex_id(*this);
@@ -85,6 +106,8 @@ public:
 			updated = true;
 			component_id = msg.get_id();
 		}
+		else if (incremental && msg.get_id() > component_id)
+			updated = true;
 	}
 
 	vertex_id_t get_result() const {
@@ -99,6 +122,8 @@ template<class vertex_type>
 class wcc_vertex_program: public vertex_program_impl<vertex_type>
 {
 	std::vector<vertex_id_t> buf;
+	// The number of times that vertices run on their edge lists.
+	size_t num_runs;
 public:
 	typedef std::shared_ptr<wcc_vertex_program<vertex_type> > ptr;
 
@@ -107,9 +132,21 @@ public:
 			   vertex_program>(prog);
 	}
 
+	wcc_vertex_program() {
+		num_runs = 0;
+	}
+
 	std::vector<vertex_id_t> &get_buf() {
 		return buf;
 	}
+
+	void inc_runs() {
+		num_runs++;
+	}
+
+	size_t get_num_runs() const {
+		return num_runs;
+	}
 };
 
 template<class vertex_type>
@@ -169,6 +206,7 @@ void wcc_vertex::run(vertex_program &prog, const page_vertex &vertex)
 	empty = (vertex.get_num_edges(BOTH_EDGES) == 0);
 	wcc_vertex_program<wcc_vertex> &wcc_vprog
 		= (wcc_vertex_program<wcc_vertex> &) prog;
+	wcc_vprog.inc_runs();
 	std::vector<vertex_id_t> &buf = wcc_vprog.get_buf();
 	edge_seq_iterator in_it = dvertex.get_neigh_seq_it(IN_EDGE);
 	edge_seq_iterator out_it = dvertex.get_neigh_seq_it(OUT_EDGE);
@@ -396,10 +434,206 @@ void ts_wcc_vertex::run(vertex_program &prog, const page_vertex &vertex)
 	prog.multicast_msg(out_it, msg);
 }
 
+/*
+ * The disjoint sets of vertices used by Afforest. The root of a tree has
+ * the smallest vertex ID in the tree. Worker threads link trees
+ * concurrently by hooking the root with the larger ID to the other root
+ * with CAS.
+ */
+class concurrent_union_find
+{
+	std::vector<std::atomic<vertex_id_t> > parents;
+
+	vertex_id_t get_parent(vertex_id_t id) const {
+		return parents[id].load(std::memory_order_relaxed);
+	}
+public:
+	concurrent_union_find(size_t num_vertices): parents(num_vertices) {
+#pragma omp parallel for
+		for (size_t i = 0; i < num_vertices; i++)
+			parents[i].store(i, std::memory_order_relaxed);
+	}
+
+	void link(vertex_id_t u, vertex_id_t v);
+	void compress();
+	vertex_id_t sample_largest(size_t num_samples) const;
+
+	/*
+	 * This is only valid after the trees are compressed.
+	 */
+	vertex_id_t get_root(vertex_id_t id) const {
+		return get_parent(id);
+	}
+};
+
+void concurrent_union_find::link(vertex_id_t u, vertex_id_t v)
+{
+	vertex_id_t p1 = get_parent(u);
+	vertex_id_t p2 = get_parent(v);
+	while (p1 != p2) {
+		vertex_id_t high = std::max(p1, p2);
+		vertex_id_t low = std::min(p1, p2);
+		vertex_id_t p_high = get_parent(high);
+		// The two trees have been linked.
+		if (p_high == low)
+			break;
+		if (p_high == high && parents[high].compare_exchange_strong(p_high,
+					low))
+			break;
+		// `high' isn't a root any more. Go up the trees and try again.
+		p1 = get_parent(get_parent(high));
+		p2 = get_parent(low);
+	}
+}
+
+/*
+ * Pointer jumping, so every vertex points to the root of its tree.
+ * It shouldn't run with `link' concurrently.
+ */
+void concurrent_union_find::compress()
+{
+#pragma omp parallel for schedule(dynamic, 16384)
+	for (size_t i = 0; i < parents.size(); i++) {
+		while (get_parent(i) != get_parent(get_parent(i)))
+			parents[i].store(get_parent(get_parent(i)),
+					std::memory_order_relaxed);
+	}
+}
+
+/*
+ * Find the largest tree from the roots of randomly sampled vertices.
+ */
+vertex_id_t concurrent_union_find::sample_largest(size_t num_samples) const
+{
+	std::unordered_map<vertex_id_t, size_t> counts;
+	std::mt19937 gen(0);
+	std::uniform_int_distribution<size_t> dist(0, parents.size() - 1);
+	for (size_t i = 0; i < num_samples; i++)
+		counts[get_parent(dist(gen))]++;
+	std::pair<vertex_id_t, size_t> largest(INVALID_VERTEX_ID, 0);
+	for (std::unordered_map<vertex_id_t, size_t>::const_iterator it
+			= counts.begin(); it != counts.end(); it++)
+		if (it->second > largest.second)
+			largest = *it;
+	return largest.first;
+}
+
+/*
+ * Afforest has two stages. In the first stage, every vertex links
+ * the first few neighbors in its out-edge list. Most vertices end up in
+ * the largest component after that. In the second stage, only the vertices
+ * outside the largest component read their edge lists again and link all of
+ * the remaining neighbors. An edge between a vertex in the largest component
+ * and a vertex outside it is linked by the latter, so the vertices in
+ * the largest component can be skipped.
+ */
+enum afforest_stage_t
+{
+	SAMPLE,
+	FINISH,
+};
+
+afforest_stage_t afforest_stage;
+// The number of neighbors linked by a vertex in the first stage.
+size_t num_afforest_samples;
+concurrent_union_find *afforest_sets;
+
+class afforest_vertex: public compute_directed_vertex
+{
+public:
+	afforest_vertex(vertex_id_t id): compute_directed_vertex(id) {
+	}
+
+	void run(vertex_program &prog) {
+		vertex_id_t id = prog.get_vertex_id(*this);
+		graph_engine &graph = prog.get_graph();
+		// The first stage only needs out-edges in a directed graph.
+		if (afforest_stage == SAMPLE && graph.is_directed()) {
+			if (graph.get_num_edges(id, edge_type::OUT_EDGE) > 0) {
+				directed_vertex_request req(id, edge_type::OUT_EDGE);
+				request_partial_vertices(&req, 1);
+			}
+		}
+		else if (graph.get_num_edges(id, edge_type::BOTH_EDGES) > 0)
+			request_vertices(&id, 1);
+	}
+
+	void run(vertex_program &prog, const page_vertex &vertex);
+
+	void run_on_message(vertex_program &, const vertex_message &) {
+	}
+};
+
+void afforest_vertex::run(vertex_program &prog, const page_vertex &vertex)
+{
+	vertex_id_t id = vertex.get_id();
+	size_t num_out = vertex.get_num_edges(edge_type::OUT_EDGE);
+	size_t num_sampled = std::min(num_out, num_afforest_samples);
+	if (afforest_stage == SAMPLE) {
+		edge_seq_iterator it = vertex.get_neigh_seq_it(edge_type::OUT_EDGE,
+				0, num_sampled);
+		while (it.has_next())
+			afforest_sets->link(id, it.next());
+		return;
+	}
+
+	edge_seq_iterator it = vertex.get_neigh_seq_it(edge_type::OUT_EDGE,
+			num_sampled, num_out);
+	while (it.has_next())
+		afforest_sets->link(id, it.next());
+	if (vertex.is_directed()) {
+		edge_seq_iterator in_it = vertex.get_neigh_seq_it(edge_type::IN_EDGE);
+		while (in_it.has_next())
+			afforest_sets->link(id, in_it.next());
+	}
+}
+
 }
 
 #include "save_result.h"
 
+namespace {
+
+/*
+ * This initializes vertices with the previous component IDs. The vertices
+ * in the components that need to be recomputed start from scratch.
+ */
+class wcc_initializer: public vertex_initializer
+{
+	graph_engine &graph;
+	FG_vector<vertex_id_t>::ptr prev;
+	const std::unordered_set<vertex_id_t> &reset_comps;
+public:
+	wcc_initializer(graph_engine &_graph, FG_vector<vertex_id_t>::ptr prev,
+			const std::unordered_set<vertex_id_t> &_reset_comps): graph(
+				_graph), reset_comps(_reset_comps) {
+		this->prev = prev;
+	}
+
+	void init(compute_vertex &v) {
+		vertex_id_t id = graph.get_graph_index().get_vertex_id(v);
+		vertex_id_t comp_id = prev->get(id);
+		wcc_vertex &wv = (wcc_vertex &) v;
+		if (comp_id == INVALID_VERTEX_ID)
+			wv.init_component(id, true, false);
+		else if (reset_comps.find(comp_id) != reset_comps.end())
+			wv.init_component(id, false, true);
+		else
+			wv.init_component(comp_id, false, false);
+	}
+};
+
+class wcc_activator: public vertex_initializer
+{
+public:
+	void init(compute_vertex &v) {
+		wcc_vertex &wv = (wcc_vertex &) v;
+		wv.init_component(wv.get_component_id(), false, true);
+	}
+};
+
+}
+
 namespace fg
 {
 
@@ -446,7 +680,7 @@ FG_vector<vertex_id_t>::ptr compute_cc(FG_graph::ptr fg)
 	return vec;
 }
 
-FG_vector<vertex_id_t>::ptr compute_wcc(FG_graph::ptr fg)
+FG_vector<vertex_id_t>::ptr compute_wcc(FG_graph::ptr fg, bool async)
 {
 	bool directed = fg->get_graph_header().is_directed_graph();
 	if (!directed) {
@@ -458,7 +692,10 @@ FG_vector<vertex_id_t>::ptr compute_wcc(FG_graph::ptr fg)
 	graph_index::ptr index = NUMA_graph_index<wcc_vertex>::create(
 			fg->get_graph_header());
 	graph_engine::ptr graph = fg->create_engine(index);
-	BOOST_LOG_TRIVIAL(info) << "weakly connected components starts";
+	graph->set_async_mode(async);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"weakly connected components starts%1%")
+		% (async ? " asynchronously" : "");
 #ifdef PROFILER
 	if (!graph_conf.get_prof_file().empty())
 		ProfilerStart(graph_conf.get_prof_file().c_str());
@@ -475,8 +712,8 @@ FG_vector<vertex_id_t>::ptr compute_wcc(FG_graph::ptr fg)
 	graph->wait4complete();
 	gettimeofday(&end, NULL);
 	BOOST_LOG_TRIVIAL(info)
-		<< boost::format("WCC takes %1% seconds in total")
-		% time_diff(start, end);
+		<< boost::format("WCC takes %1% seconds in total and %2% levels")
+		% time_diff(start, end) % graph->get_curr_level();
 
 #ifdef PROFILER
 	if (!graph_conf.get_prof_file().empty())
@@ -577,4 +814,150 @@ FG_vector<vertex_id_t>::ptr compute_ts_wcc(FG_graph::ptr fg,
 	return vec;
 }
 
+FG_vector<vertex_id_t>::ptr compute_wcc_incremental(FG_graph::ptr fg,
+		FG_vector<vertex_id_t>::ptr prev,
+		const std::vector<vertex_id_t> &changed, bool has_deletions,
+		incremental_stats *stats)
+{
+	bool directed = fg->get_graph_header().is_directed_graph();
+	if (!directed) {
+		BOOST_LOG_TRIVIAL(error)
+			<< "This algorithm works on a directed graph";
+		return FG_vector<vertex_id_t>::ptr();
+	}
+
+	graph_index::ptr index = NUMA_graph_index<wcc_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	if (prev->get_size() != graph->get_num_vertices()) {
+		BOOST_LOG_TRIVIAL(error) << boost::format(
+				"The previous result has %1% vertices, but the graph has %2%")
+			% prev->get_size() % graph->get_num_vertices();
+		return FG_vector<vertex_id_t>::ptr();
+	}
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"incremental weakly connected components starts from %1% changed vertices")
+		% changed.size();
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	// Deleting edges may split a component, so the components with
+	// the changed vertices are computed from scratch. Inserting edges
+	// can only merge components, which is handled by propagating
+	// the component IDs from the changed vertices.
+	std::unordered_set<vertex_id_t> reset_comps;
+	std::vector<vertex_id_t> active_vertices(changed.begin(), changed.end());
+	if (has_deletions) {
+		for (size_t i = 0; i < changed.size(); i++)
+			if (prev->get(changed[i]) != INVALID_VERTEX_ID)
+				reset_comps.insert(prev->get(changed[i]));
+		for (size_t id = 0; id < prev->get_size(); id++)
+			if (reset_comps.find(prev->get(id)) != reset_comps.end())
+				active_vertices.push_back(id);
+	}
+	graph->init_all_vertices(vertex_initializer::ptr(
+				new wcc_initializer(*graph, prev, reset_comps)));
+	std::sort(active_vertices.begin(), active_vertices.end());
+	active_vertices.erase(std::unique(active_vertices.begin(),
+				active_vertices.end()), active_vertices.end());
+
+	incremental = true;
+	graph->start(active_vertices.data(), active_vertices.size(),
+			vertex_initializer::ptr(new wcc_activator()),
+			vertex_program_creater::ptr(
+				new wcc_vertex_program_creater<wcc_vertex>()));
+	graph->wait4complete();
+	incremental = false;
+	gettimeofday(&end, NULL);
+
+	size_t num_runs = 0;
+	std::vector<vertex_program::ptr> vprogs;
+	graph->get_vertex_programs(vprogs);
+	BOOST_FOREACH(vertex_program::ptr vprog, vprogs)
+		num_runs += wcc_vertex_program<wcc_vertex>::cast2(
+				vprog)->get_num_runs();
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"Incremental WCC processes %1% vertices in %2% levels (%3% vertices in the graph) in %4% seconds")
+		% num_runs % graph->get_curr_level() % graph->get_num_vertices()
+		% time_diff(start, end);
+	if (stats) {
+		stats->num_vertex_runs = num_runs;
+		stats->num_levels = graph->get_curr_level();
+		stats->num_vertices = graph->get_num_vertices();
+	}
+
+	FG_vector<vertex_id_t>::ptr vec = FG_vector<vertex_id_t>::create(graph);
+	graph->query_on_all(vertex_query::ptr(
+				new save_query<vertex_id_t, wcc_vertex>(vec)));
+	return vec;
+}
+
+FG_vector<vertex_id_t>::ptr compute_wcc_afforest(FG_graph::ptr fg,
+		size_t num_samples)
+{
+	graph_index::ptr index = NUMA_graph_index<afforest_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	size_t num_vertices = graph->get_num_vertices();
+	BOOST_LOG_TRIVIAL(info) << "Afforest connected components starts";
+#ifdef PROFILER
+	if (!graph_conf.get_prof_file().empty())
+		ProfilerStart(graph_conf.get_prof_file().c_str());
+#endif
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	concurrent_union_find sets(num_vertices);
+	afforest_sets = &sets;
+	num_afforest_samples = num_samples;
+	afforest_stage = SAMPLE;
+	graph->start_all();
+	graph->wait4complete();
+	sets.compress();
+	vertex_id_t largest = sets.sample_largest(1024);
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"Afforest links %1% neighbors per vertex in %2% seconds")
+		% num_samples % time_diff(start, end);
+
+	std::vector<std::vector<vertex_id_t> > local_active(
+			omp_get_max_threads());
+#pragma omp parallel for
+	for (size_t i = 0; i < num_vertices; i++) {
+		if (sets.get_root(i) != largest
+				&& graph->get_num_edges(i, edge_type::BOTH_EDGES) > 0)
+			local_active[omp_get_thread_num()].push_back(i);
+	}
+	std::vector<vertex_id_t> active_vertices;
+	for (size_t i = 0; i < local_active.size(); i++)
+		active_vertices.insert(active_vertices.end(), local_active[i].begin(),
+				local_active[i].end());
+	std::sort(active_vertices.begin(), active_vertices.end());
+	afforest_stage = FINISH;
+	graph->start(active_vertices.data(), (int) active_vertices.size());
+	graph->wait4complete();
+	sets.compress();
+	afforest_sets = NULL;
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"Afforest reads %1% vertices outside the largest component again, and takes %2% seconds in total")
+		% active_vertices.size() % time_diff(start, end);
+
+#ifdef PROFILER
+	if (!graph_conf.get_prof_file().empty())
+		ProfilerStop();
+#endif
+
+	FG_vector<vertex_id_t>::ptr vec = FG_vector<vertex_id_t>::create(graph);
+	vertex_id_t *data = vec->get_data();
+#pragma omp parallel for
+	for (size_t i = 0; i < num_vertices; i++) {
+		if (graph->get_num_edges(i, edge_type::BOTH_EDGES) > 0)
+			data[i] = sets.get_root(i);
+		else
+			data[i] = INVALID_VERTEX_ID;
+	}
+	return vec;
+}
+
 }
@@ -124,7 +124,7 @@ void message_processor::process_multicast_msg(multicast_message &mmsg,
 	}
 }
 
-void message_processor::process_msg(message &msg, bool check_steal)
+size_t message_processor::process_msg(message &msg, bool check_steal)
 {
 	worker_thread *t = (worker_thread *) thread::get_curr_thread();
 	// Messages are always processed in the main vertex.
@@ -132,9 +132,11 @@ void message_processor::process_msg(message &msg, bool check_steal)
 
 	const int VMSG_BUF_SIZE = 128;
 	vertex_message *v_msgs[VMSG_BUF_SIZE];
+	size_t num_processed = 0;
 	while (!msg.is_empty()) {
 		int num = msg.get_next(v_msgs, VMSG_BUF_SIZE);
 		assert(num > 0);
+		num_processed += num;
 		// If we aren't in the mode of load balancing and these aren't
 		// multicast messages, we can use the fast path.
 		// We only need to check the first message. All messages are
@@ -171,10 +173,12 @@ void message_processor::process_msg(message &msg, bool check_steal)
 				owner.activate_vertex(id);
 		}
 	}
+	return num_processed;
 }
 
-void message_processor::process_msgs()
+size_t message_processor::process_msgs()
 {
+	size_t num_processed = 0;
 	if (steal_state && steal_state->get_num_returned() > 0 && !stolenv_msgs.is_empty()) {
 		// TODO we might have to make sure that a lot of messages can be
 		// processed. Otherwise, we are wasting time.
@@ -186,7 +190,7 @@ void message_processor::process_msgs()
 		int num_fetched = stolenv_msgs.fetch(msgs.data(),
 				stolenv_msgs.get_num_entries());
 		for (int i = 0; i < num_fetched; i++)
-			process_msg(msgs[i], true);
+			num_processed += process_msg(msgs[i], true);
 	}
 
 	const int MSG_BUF_SIZE = 16;
@@ -199,10 +203,11 @@ void message_processor::process_msgs()
 	while (!msg_q.is_empty()) {
 		int num_fetched = msg_q.fetch(msgs, MSG_BUF_SIZE);
 		for (int i = 0; i < num_fetched; i++)
-			process_msg(msgs[i], check_steal);
+			num_processed += process_msg(msgs[i], check_steal);
 	}
 	if (steal_state)
 		steal_state->unguard_msg_processing();
+	return num_processed;
 }
 
 void message_processor::steal_vertices(compute_vertex_pointer vertices[], int num)
@@ -62,14 +62,18 @@ class message_processor
 	void buf_msg(vertex_message &msg);
 	void buf_mmsg(local_vid_t id, multicast_message &mmsg);
 
-	void process_msg(message &msg, bool check_steal);
+	size_t process_msg(message &msg, bool check_steal);
 	void process_multicast_msg(multicast_message &mmsg, bool check_steal);
 
 public:
 	message_processor(graph_engine &_graph, worker_thread &_owner,
 			std::shared_ptr<slab_allocator> msg_alloc);
 
-	void process_msgs();
+	/*
+	 * Process the messages in the queue. It returns the number of
+	 * vertex messages that have been processed.
+	 */
+	size_t process_msgs();
 
 	void steal_vertices(compute_vertex_pointer vertices[], int num);
 	void return_vertices(vertex_id_t ids[], int num);
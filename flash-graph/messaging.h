@@ -20,6 +20,8 @@
  * limitations under the License.
  */
 
+#include <vector>
+
 #include "slab_allocator.h"
 
 #include "vertex.h"
@@ -345,6 +347,10 @@ public:
 		this->flush = flush;
 	}
 
+	void set_activate(bool activate) {
+		this->activate = activate;
+	}
+
 	local_vid_t get_dest() const {
 		return local_vid_t(u.dest);
 	}
@@ -561,6 +567,230 @@ public:
 	}
 };
 
+/**
+ * \brief A message combiner merges the messages sent to the same vertex
+ * before they are delivered, so that the destination vertex receives
+ * a single message.
+ *
+ * The graph engine doesn't define the order in which messages are merged,
+ * so the merge operation has to be associative and commutative (e.g., sum,
+ * min or max of the message payload). All messages sent by the vertex
+ * program have to be of the same type if a combiner is used.
+ */
+class vertex_msg_combiner
+{
+public:
+	typedef std::shared_ptr<vertex_msg_combiner> ptr;
+
+	virtual ~vertex_msg_combiner() {
+	}
+
+	/**
+	 * \brief Merge a message to the message that has been buffered for
+	 * the same destination vertex.
+	 * \param combined The buffered message, which stores the merged result.
+	 * \param msg The message to be merged.
+	 */
+	virtual void combine(vertex_message &combined,
+			const vertex_message &msg) const = 0;
+};
+
+/*
+ * This sender merges the messages to the same destination vertex in
+ * a local buffer with a user-defined combiner. The merged messages are
+ * passed to a simple_msg_sender when the sender is flushed or when
+ * the local buffer has too many destinations.
+ *
+ * There is a sender for each (thread, partition) pair, so the buffered
+ * destinations are located with a small open-addressing table that is
+ * allocated on the first message and grows with the number of
+ * destinations. The table never needs more slots than the partition has
+ * vertices; when it covers the whole partition, a local vertex ID is
+ * its own slot and lookups never probe.
+ */
+class combine_msg_sender
+{
+	// The max number of destinations buffered in the sender.
+	static const size_t MAX_NUM_DESTS = 64 * 1024;
+	static const size_t INIT_NUM_SLOTS = 1024;
+
+	struct msg_slot
+	{
+		// The local ID of the destination vertex.
+		vertex_id_t id;
+		// The location of the merged message in the buffer.
+		uint32_t off;
+	};
+
+	vertex_msg_combiner::ptr combiner;
+	simple_msg_sender &sender;
+	// The buffered messages.
+	std::vector<char> msg_buf;
+	// The number of slots is a power of 2. Empty slots have an invalid ID.
+	std::vector<msg_slot> slots;
+	size_t num_dests;
+	// The max number of slots, determined by the partition size.
+	size_t max_num_slots;
+	// The number of vertices in the destination partition.
+	size_t part_size;
+	// The number of messages passed to the sender.
+	size_t num_sent;
+	// The number of messages merged to another message.
+	size_t num_combined;
+
+	combine_msg_sender(vertex_msg_combiner::ptr combiner,
+			simple_msg_sender &_sender, size_t part_size): sender(_sender) {
+		this->combiner = combiner;
+		this->part_size = part_size;
+		// We keep the load factor of the table below 1/2, unless the table
+		// covers the entire partition.
+		max_num_slots = 1;
+		while (max_num_slots < std::min(part_size, MAX_NUM_DESTS * 2))
+			max_num_slots *= 2;
+		num_dests = 0;
+		num_sent = 0;
+		num_combined = 0;
+	}
+
+	size_t get_slot_idx(vertex_id_t id) const {
+		size_t mask = slots.size() - 1;
+		if (slots.size() >= part_size)
+			return id;
+		// Fibonacci hashing spreads consecutive IDs over the table.
+		return (id * 11400714819323198485UL) >> 32 & mask;
+	}
+
+	msg_slot &lookup(vertex_id_t id) {
+		size_t mask = slots.size() - 1;
+		size_t idx = get_slot_idx(id);
+		while (slots[idx].id != INVALID_VERTEX_ID && slots[idx].id != id)
+			idx = (idx + 1) & mask;
+		return slots[idx];
+	}
+
+	void resize_slots(size_t num_slots) {
+		std::vector<msg_slot> old_slots;
+		old_slots.swap(slots);
+		msg_slot empty_slot;
+		empty_slot.id = INVALID_VERTEX_ID;
+		empty_slot.off = 0;
+		slots.resize(num_slots, empty_slot);
+		for (size_t i = 0; i < old_slots.size(); i++)
+			if (old_slots[i].id != INVALID_VERTEX_ID)
+				lookup(old_slots[i].id) = old_slots[i];
+	}
+
+	/*
+	 * Remove a destination from the table. In a hashed table, we shift
+	 * the following entries in the probe sequence backward, so lookups of
+	 * other destinations still work. A table that covers the partition
+	 * never probes, and it may have no empty slot at all.
+	 */
+	void erase(msg_slot &slot) {
+		if (slots.size() >= part_size) {
+			slot.id = INVALID_VERTEX_ID;
+			return;
+		}
+		size_t mask = slots.size() - 1;
+		size_t idx = &slot - slots.data();
+		for (size_t next = (idx + 1) & mask; slots[next].id != INVALID_VERTEX_ID;
+				next = (next + 1) & mask) {
+			size_t home = get_slot_idx(slots[next].id);
+			if (((next - home) & mask) >= ((next - idx) & mask)) {
+				slots[idx] = slots[next];
+				idx = next;
+			}
+		}
+		slots[idx].id = INVALID_VERTEX_ID;
+	}
+
+	bool is_full() const {
+		if (slots.size() >= part_size)
+			return false;
+		return num_dests * 2 >= slots.size();
+	}
+public:
+	/*
+	 * `part_size' is the number of vertices in the partition that
+	 * the messages are sent to.
+	 */
+	static combine_msg_sender *create(vertex_msg_combiner::ptr combiner,
+			simple_msg_sender &sender, size_t part_size) {
+		return new combine_msg_sender(combiner, sender, part_size);
+	}
+
+	static void destroy(combine_msg_sender *s) {
+		delete s;
+	}
+
+	/*
+	 * The destination of the message must have been set.
+	 */
+	void send(const vertex_message &msg) {
+		num_sent++;
+		vertex_id_t dest = msg.get_dest().id;
+		if (slots.empty())
+			resize_slots(std::min(INIT_NUM_SLOTS, max_num_slots));
+
+		msg_slot *slot = &lookup(dest);
+		if (slot->id == dest) {
+			vertex_message *combined = (vertex_message *) &msg_buf[slot->off];
+			assert(combined->get_serialized_size()
+					== msg.get_serialized_size());
+			combiner->combine(*combined, msg);
+			if (msg.is_activate())
+				combined->set_activate(true);
+			num_combined++;
+			return;
+		}
+
+		if (is_full()) {
+			if (slots.size() < max_num_slots)
+				resize_slots(slots.size() * 2);
+			else
+				flush_combined();
+			slot = &lookup(dest);
+		}
+		size_t off = msg_buf.size();
+		assert(off + msg.get_serialized_size()
+				<= std::numeric_limits<uint32_t>::max());
+		msg_buf.resize(off + msg.get_serialized_size());
+		msg.serialize(&msg_buf[off], msg.get_serialized_size());
+		slot->id = dest;
+		slot->off = off;
+		num_dests++;
+	}
+
+	/*
+	 * Pass all merged messages to the simple_msg_sender.
+	 */
+	void flush_combined() {
+		// We only remove the slots of the buffered messages, so the cost of
+		// a flush doesn't depend on the size of the table.
+		for (size_t off = 0; off < msg_buf.size(); ) {
+			vertex_message *msg = (vertex_message *) &msg_buf[off];
+			off += msg->get_serialized_size();
+			erase(lookup(msg->get_dest().id));
+			sender.send_cached(*msg);
+		}
+		msg_buf.clear();
+		num_dests = 0;
+	}
+
+	int flush() {
+		flush_combined();
+		return sender.flush();
+	}
+
+	size_t get_num_sent() const {
+		return num_sent;
+	}
+
+	size_t get_num_combined() const {
+		return num_combined;
+	}
+};
+
 }
 
 #endif
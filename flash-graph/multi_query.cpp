@@ -0,0 +1,370 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
+#include "multi_query.h"
+#include "FGlib.h"
+
+namespace fg
+{
+
+namespace
+{
+
+/*
+ * A vertex may run a query while other threads deliver messages of
+ * the queries to it. The state of a vertex is protected by one of
+ * the spin locks here.
+ */
+class vertex_locks
+{
+	static const int NUM_LOCKS = 4096;
+	pthread_spinlock_t locks[NUM_LOCKS];
+public:
+	vertex_locks() {
+		for (int i = 0; i < NUM_LOCKS; i++)
+			pthread_spin_init(&locks[i], PTHREAD_PROCESS_PRIVATE);
+	}
+
+	void lock(vertex_id_t id) {
+		pthread_spin_lock(&locks[id % NUM_LOCKS]);
+	}
+
+	void unlock(vertex_id_t id) {
+		pthread_spin_unlock(&locks[id % NUM_LOCKS]);
+	}
+} locks;
+
+class query_msg: public vertex_message
+{
+	query_id_t query_id;
+	// The level when the message is sent.
+	int level;
+	double val;
+public:
+	query_msg(query_id_t query_id, int level, double val): vertex_message(
+			sizeof(query_msg), true) {
+		this->query_id = query_id;
+		this->level = level;
+		this->val = val;
+	}
+
+	query_id_t get_query_id() const {
+		return query_id;
+	}
+
+	int get_level() const {
+		return level;
+	}
+
+	double get_val() const {
+		return val;
+	}
+};
+
+/*
+ * The states of queries on a vertex. It's only allocated when a query
+ * reaches the vertex.
+ */
+struct query_vertex_data
+{
+	// Sorted by query ID.
+	std::vector<query_vertex_state> states;
+	// The queries activated on the vertex and the levels when they're
+	// activated. A query runs on the vertex in the level after it's
+	// activated.
+	std::vector<std::pair<query_id_t, int> > activated;
+	// The queries that run on the vertex in the current level.
+	std::vector<query_id_t> running;
+
+	query_vertex_state *get_state(query_id_t id, int level, bool &new_state) {
+		std::vector<query_vertex_state>::iterator it = std::lower_bound(
+				states.begin(), states.end(), query_vertex_state(id, 0),
+				state_less());
+		new_state = it == states.end() || it->query_id != id;
+		if (new_state)
+			it = states.insert(it, query_vertex_state(id, level));
+		return &*it;
+	}
+
+	query_vertex_state *get_state(query_id_t id) {
+		std::vector<query_vertex_state>::iterator it = std::lower_bound(
+				states.begin(), states.end(), query_vertex_state(id, 0),
+				state_less());
+		assert(it != states.end() && it->query_id == id);
+		return &*it;
+	}
+
+	struct state_less {
+		bool operator()(const query_vertex_state &s1,
+				const query_vertex_state &s2) const {
+			return s1.query_id < s2.query_id;
+		}
+	};
+};
+
+class multi_query_vertex: public compute_directed_vertex
+{
+	query_vertex_data *data;
+public:
+	multi_query_vertex(vertex_id_t id): compute_directed_vertex(id) {
+		data = NULL;
+	}
+
+	query_vertex_data *get_data() {
+		return data;
+	}
+
+	query_vertex_data *get_data_create() {
+		if (data == NULL)
+			data = new query_vertex_data();
+		return data;
+	}
+
+	void destroy_data() {
+		delete data;
+		data = NULL;
+	}
+
+	void run(vertex_program &prog);
+
+	void run(vertex_program &prog, const page_vertex &vertex);
+
+	void run_on_message(vertex_program &prog, const vertex_message &msg);
+};
+
+class multi_query_vertex_program: public vertex_program_impl<multi_query_vertex>
+{
+	const std::vector<graph_query::ptr> &queries;
+	// The vertices reached by queries in the messages processed by
+	// this vertex program.
+	std::vector<vertex_id_t> reached;
+public:
+	multi_query_vertex_program(
+			const std::vector<graph_query::ptr> &_queries): queries(_queries) {
+	}
+
+	graph_query &get_query(query_id_t id) {
+		return *queries[id];
+	}
+
+	void add_reached(vertex_id_t id) {
+		reached.push_back(id);
+	}
+
+	const std::vector<vertex_id_t> &get_reached() const {
+		return reached;
+	}
+};
+
+class multi_query_vertex_program_creater: public vertex_program_creater
+{
+	const std::vector<graph_query::ptr> &queries;
+public:
+	multi_query_vertex_program_creater(
+			const std::vector<graph_query::ptr> &_queries): queries(_queries) {
+	}
+
+	vertex_program::ptr create() const {
+		return vertex_program::ptr(new multi_query_vertex_program(queries));
+	}
+};
+
+void multi_query_vertex::run(vertex_program &prog)
+{
+	multi_query_vertex_program &mq_prog = (multi_query_vertex_program &) prog;
+	vertex_id_t id = prog.get_vertex_id(*this);
+	int level = prog.get_graph().get_curr_level();
+	edge_type type = edge_type::NONE;
+
+	locks.lock(id);
+	if (data == NULL) {
+		locks.unlock(id);
+		return;
+	}
+	// The queries activated in the current level run in the next level.
+	size_t num_kept = 0;
+	for (size_t i = 0; i < data->activated.size(); i++) {
+		if (data->activated[i].second < level)
+			data->running.push_back(data->activated[i].first);
+		else
+			data->activated[num_kept++] = data->activated[i];
+	}
+	data->activated.resize(num_kept);
+	std::sort(data->running.begin(), data->running.end());
+	data->running.erase(std::unique(data->running.begin(),
+				data->running.end()), data->running.end());
+	BOOST_FOREACH(query_id_t query_id, data->running) {
+		edge_type query_type = mq_prog.get_query(query_id).get_edge_type();
+		if (type == edge_type::NONE)
+			type = query_type;
+		else if (type != query_type)
+			type = edge_type::BOTH_EDGES;
+	}
+	locks.unlock(id);
+
+	if (type == edge_type::NONE)
+		return;
+	// Queries running on the vertex share the same edge list.
+	if (prog.get_graph().is_directed()) {
+		directed_vertex_request req(id, type);
+		request_partial_vertices(&req, 1);
+	}
+	else
+		request_vertices(&id, 1);
+}
+
+void multi_query_vertex::run(vertex_program &prog, const page_vertex &vertex)
+{
+	multi_query_vertex_program &mq_prog = (multi_query_vertex_program &) prog;
+	vertex_id_t id = prog.get_vertex_id(*this);
+	assert(vertex.get_id() == id);
+
+	// Only the thread that runs the vertex accesses the running queries.
+	std::vector<query_id_t> running;
+	running.swap(data->running);
+	// Messages may add states to the vertex at the same time, so we copy
+	// the states under the lock. The queries run and send messages
+	// without holding the lock.
+	std::vector<query_vertex_state> states;
+	states.reserve(running.size());
+	locks.lock(id);
+	BOOST_FOREACH(query_id_t query_id, running)
+		states.push_back(*data->get_state(query_id));
+	locks.unlock(id);
+	BOOST_FOREACH(const query_vertex_state &state, states) {
+		query_context ctx(prog, state.query_id);
+		mq_prog.get_query(state.query_id).run(ctx, vertex, state);
+	}
+}
+
+void multi_query_vertex::run_on_message(vertex_program &prog,
+		const vertex_message &msg1)
+{
+	multi_query_vertex_program &mq_prog = (multi_query_vertex_program &) prog;
+	const query_msg &msg = (const query_msg &) msg1;
+	vertex_id_t id = prog.get_vertex_id(*this);
+
+	locks.lock(id);
+	bool new_data = data == NULL;
+	get_data_create();
+	bool new_state;
+	query_vertex_state *state = data->get_state(msg.get_query_id(),
+			prog.get_graph().get_curr_level(), new_state);
+	if (mq_prog.get_query(msg.get_query_id()).run_on_message(*state,
+				new_state, msg.get_val()))
+		data->activated.push_back(std::pair<query_id_t, int>(
+					msg.get_query_id(), msg.get_level()));
+	locks.unlock(id);
+	if (new_data)
+		mq_prog.add_reached(id);
+}
+
+}
+
+int query_context::get_curr_level() const
+{
+	return prog.get_graph().get_curr_level();
+}
+
+void query_context::send(edge_seq_iterator &it, double val)
+{
+	query_msg msg(query_id, get_curr_level(), val);
+	prog.multicast_msg(it, msg);
+}
+
+void query_context::send(vertex_id_t id, double val)
+{
+	query_msg msg(query_id, get_curr_level(), val);
+	prog.send_msg(id, msg);
+}
+
+multi_query_engine::multi_query_engine(FG_graph::ptr fg)
+{
+	graph_index::ptr index = NUMA_graph_index<multi_query_vertex>::create(
+			fg->get_graph_header());
+	graph = fg->create_engine(index);
+}
+
+void multi_query_engine::run(const std::vector<graph_query::ptr> &queries)
+{
+	if (queries.empty())
+		return;
+
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+
+	// The engine isn't running, so we can initialize the start vertices
+	// of the queries directly.
+	std::vector<vertex_id_t> reached;
+	for (size_t i = 0; i < queries.size(); i++) {
+		BOOST_FOREACH(vertex_id_t id, queries[i]->get_start_vertices()) {
+			multi_query_vertex &v = (multi_query_vertex &) graph->get_vertex(id);
+			if (v.get_data() == NULL)
+				reached.push_back(id);
+			query_vertex_data *data = v.get_data_create();
+			bool new_state;
+			query_vertex_state *state = data->get_state(i, 0, new_state);
+			if (new_state)
+				queries[i]->init(id, *state);
+			data->activated.push_back(std::pair<query_id_t, int>(i, -1));
+		}
+	}
+	std::vector<vertex_id_t> start_vertices(reached);
+	graph->start(start_vertices.data(), start_vertices.size(),
+			vertex_initializer::ptr(), vertex_program_creater::ptr(
+				new multi_query_vertex_program_creater(queries)));
+	graph->wait4complete();
+
+	std::vector<vertex_program::ptr> vprogs;
+	graph->get_vertex_programs(vprogs);
+	BOOST_FOREACH(vertex_program::ptr vprog, vprogs) {
+		const std::vector<vertex_id_t> &prog_reached
+			= ((multi_query_vertex_program &) *vprog).get_reached();
+		reached.insert(reached.end(), prog_reached.begin(), prog_reached.end());
+	}
+
+	// Collect the states of the queries and reset the vertices for
+	// the next batch.
+	std::vector<std::vector<std::pair<vertex_id_t, query_vertex_state> > > states(
+			queries.size());
+	BOOST_FOREACH(vertex_id_t id, reached) {
+		multi_query_vertex &v = (multi_query_vertex &) graph->get_vertex(id);
+		query_vertex_data *data = v.get_data();
+		assert(data);
+		BOOST_FOREACH(const query_vertex_state &state, data->states)
+			states[state.query_id].push_back(
+					std::pair<vertex_id_t, query_vertex_state>(id, state));
+		v.destroy_data();
+	}
+	for (size_t i = 0; i < queries.size(); i++)
+		queries[i]->complete(states[i]);
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"%1% queries reach %2% vertices in %3% levels in %4% seconds")
+		% queries.size() % reached.size() % graph->get_curr_level()
+		% time_diff(start, end);
+}
+
+}
@@ -0,0 +1,185 @@
+#ifndef __MULTI_QUERY_H__
+#define __MULTI_QUERY_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "graph_engine.h"
+
+namespace fg
+{
+
+class FG_graph;
+
+typedef uint32_t query_id_t;
+
+/**
+ * \brief The state of a query on a vertex. A query gets the state when
+ * it reaches the vertex, and the meaning of the values is defined by
+ * the query.
+ */
+struct query_vertex_state
+{
+	query_id_t query_id;
+	/** The level when the query reaches the vertex. */
+	int level;
+	double vals[2];
+
+	query_vertex_state(query_id_t query_id, int level) {
+		this->query_id = query_id;
+		this->level = level;
+		vals[0] = 0;
+		vals[1] = 0;
+	}
+};
+
+/**
+ * \brief The interface for a query on a vertex. It's only valid while
+ * the query runs on the vertex.
+ */
+class query_context
+{
+	vertex_program &prog;
+	query_id_t query_id;
+public:
+	query_context(vertex_program &_prog, query_id_t query_id): prog(_prog) {
+		this->query_id = query_id;
+	}
+
+	vertex_program &get_vertex_program() {
+		return prog;
+	}
+
+	/**
+	 * \brief Get the current level of the queries.
+	 */
+	int get_curr_level() const;
+
+	/**
+	 * \brief Send a value to the vertices in the edge list.
+	 */
+	void send(edge_seq_iterator &it, double val);
+
+	/**
+	 * \brief Send a value to a vertex.
+	 */
+	void send(vertex_id_t id, double val);
+};
+
+/**
+ * \brief A query that runs with other queries in the multi-query engine.
+ *
+ * A query starts from some vertices and propagates to other vertices
+ * level by level with messages. Unlike a vertex program, a query keeps
+ * a state only on the vertices it reaches, so many small queries can run
+ * at the same time. The callbacks of a query are invoked by multiple
+ * worker threads; they only access the state of the vertex passed to them.
+ * The state of a query on a vertex is only modified by `init', before
+ * the queries start, and by `run_on_message', under a lock of the vertex.
+ */
+class graph_query
+{
+public:
+	typedef std::shared_ptr<graph_query> ptr;
+
+	virtual ~graph_query() {
+	}
+
+	/**
+	 * \brief The vertices where the query starts.
+	 */
+	virtual const std::vector<vertex_id_t> &get_start_vertices() const = 0;
+
+	/**
+	 * \brief The edges the query reads on a vertex.
+	 */
+	virtual edge_type get_edge_type() const = 0;
+
+	/**
+	 * \brief Initialize the state on a start vertex.
+	 */
+	virtual void init(vertex_id_t id, query_vertex_state &state) {
+	}
+
+	/**
+	 * \brief Run the query on an active vertex with its edge list.
+	 * \param state A copy of the state of the query on the vertex. It's
+	 * taken before the query runs, and messages delivered to the vertex
+	 * in the meantime aren't reflected in it.
+	 */
+	virtual void run(query_context &ctx, const page_vertex &vertex,
+			const query_vertex_state &state) = 0;
+
+	/**
+	 * \brief Receive a value sent to a vertex.
+	 * \param state The state of the query on the vertex.
+	 * \param new_state Whether the query reaches the vertex for the first time.
+	 * \param val The value sent to the vertex.
+	 * \return true if the query should run on the vertex in the next level.
+	 */
+	virtual bool run_on_message(query_vertex_state &state, bool new_state,
+			double val) = 0;
+
+	/**
+	 * \brief Get the states of the query on all vertices it has reached
+	 * when all queries complete.
+	 */
+	virtual void complete(
+			const std::vector<std::pair<vertex_id_t, query_vertex_state> > &states) = 0;
+};
+
+/**
+ * \brief This runs multiple independent queries in one graph engine.
+ *
+ * All queries in a batch share the worker threads and the page cache.
+ * A vertex reached by several queries in a level reads its edge list once
+ * for all of them, and the messages are tagged with the query IDs.
+ * The engine is created once and can run many batches.
+ */
+class multi_query_engine
+{
+	graph_engine::ptr graph;
+
+	multi_query_engine(std::shared_ptr<FG_graph> fg);
+public:
+	typedef std::shared_ptr<multi_query_engine> ptr;
+
+	static ptr create(std::shared_ptr<FG_graph> fg) {
+		return ptr(new multi_query_engine(fg));
+	}
+
+	graph_engine::ptr get_graph_engine() const {
+		return graph;
+	}
+
+	/**
+	 * \brief Run a batch of queries. It returns when all queries complete,
+	 * after `graph_query::complete' is invoked on every query.
+	 */
+	void run(const std::vector<graph_query::ptr> &queries);
+};
+
+}
+
+#endif
@@ -17,8 +17,15 @@
  * limitations under the License.
  */
 
+#include <stdio.h>
+
+#include <boost/format.hpp>
+
+#include "log.h"
+
 #include "partitioner.h"
 #include "graph_config.h"
+#include "vertex_index.h"
 
 namespace fg
 {
@@ -154,4 +161,191 @@ size_t range_graph_partitioner::map2loc(edge_seq_iterator &it,
 	return ret;
 }
 
+/*
+ * The header of the file that stores the partition boundaries of
+ * edge_balanced_graph_partitioner.
+ */
+struct part_file_header
+{
+	static const uint64_t MAGIC_NUMBER = 0x4547504152543032UL;
+
+	uint64_t magic;
+	uint64_t num_vertices;
+	uint64_t hub_degree;
+	// The configuration used to compute the partitions.
+	uint64_t min_vpart_degree;
+	int32_t num_parts;
+	int32_t num_vparts;
+};
+
+edge_balanced_graph_partitioner::ptr edge_balanced_graph_partitioner::create(
+		const in_mem_query_vertex_index &index, size_t num_vertices,
+		int num_parts, int num_vparts, vsize_t min_vpart_degree)
+{
+	assert(num_parts > 0);
+	size_t tot_num_edges = 0;
+#pragma omp parallel for reduction(+:tot_num_edges)
+	for (size_t id = 0; id < num_vertices; id++)
+		tot_num_edges += index.get_num_edges(id, edge_type::BOTH_EDGES);
+
+	ptr partitioner = ptr(new edge_balanced_graph_partitioner());
+	if (num_vparts > 1) {
+		// A vertex is a hub if its degree is a large fraction of the edge
+		// budget of a partition.
+		size_t hub_degree = std::max(1UL,
+				tot_num_edges / num_parts / num_vparts);
+		partitioner->hub_degree = std::min((size_t) min_vpart_degree,
+				hub_degree);
+	}
+
+	// The cost of processing a vertex. Each vertex costs at least 1 even if
+	// it doesn't have edges.
+	size_t tot_cost = 0;
+	std::vector<vertex_id_t> &starts = partitioner->part_starts;
+	starts.push_back(0);
+	for (int pass = 0; pass < 2; pass++) {
+		size_t cum_cost = 0;
+		for (size_t id = 0; id < num_vertices; id++) {
+			vsize_t num_edges = index.get_num_edges(id, edge_type::BOTH_EDGES);
+			if (num_edges >= partitioner->hub_degree)
+				num_edges = num_edges / num_vparts;
+			cum_cost += num_edges + 1;
+			// In the second pass, we cut the partition as soon as it gets
+			// its share of the total cost.
+			if (pass == 1 && (int) starts.size() < num_parts
+					&& cum_cost >= tot_cost * starts.size() / num_parts)
+				starts.push_back(id + 1);
+		}
+		tot_cost = cum_cost;
+	}
+	while ((int) starts.size() <= num_parts)
+		starts.push_back(num_vertices);
+	starts.back() = num_vertices;
+
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"edge-balanced partitioning: %1% edges in %2% partitions, hub degree: %3%")
+		% tot_num_edges % num_parts % partitioner->hub_degree;
+	return partitioner;
+}
+
+edge_balanced_graph_partitioner::ptr edge_balanced_graph_partitioner::create(
+		const std::vector<vertex_id_t> &part_starts)
+{
+	assert(part_starts.size() > 1);
+	assert(part_starts.front() == 0);
+	assert(std::is_sorted(part_starts.begin(), part_starts.end()));
+	ptr partitioner = ptr(new edge_balanced_graph_partitioner());
+	partitioner->part_starts = part_starts;
+	return partitioner;
+}
+
+edge_balanced_graph_partitioner::ptr edge_balanced_graph_partitioner::load(
+		const std::string &file, size_t num_vertices, int num_parts,
+		int num_vparts, vsize_t min_vpart_degree)
+{
+	FILE *f = fopen(file.c_str(), "r");
+	if (f == NULL)
+		return ptr();
+
+	part_file_header header;
+	ptr partitioner;
+	if (fread(&header, sizeof(header), 1, f) != 1
+			|| header.magic != part_file_header::MAGIC_NUMBER
+			|| header.num_vertices != num_vertices) {
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"%1% doesn't contain the partitions of the graph") % file;
+	}
+	else if (header.num_parts != num_parts
+			|| header.num_vparts != num_vparts
+			|| header.min_vpart_degree != min_vpart_degree) {
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"%1% was created with %2% partitions, %3% vertical parts and min vpart degree %4%; recompute the partitions")
+			% file % header.num_parts % header.num_vparts
+			% header.min_vpart_degree;
+	}
+	else {
+		partitioner = ptr(new edge_balanced_graph_partitioner());
+		partitioner->hub_degree = header.hub_degree;
+		partitioner->part_starts.resize(num_parts + 1);
+		if (fread(partitioner->part_starts.data(),
+					sizeof(vertex_id_t) * (num_parts + 1), 1, f) != 1
+				|| partitioner->part_starts.back() != num_vertices) {
+			BOOST_LOG_TRIVIAL(warning) << boost::format(
+					"%1% is corrupted") % file;
+			partitioner = ptr();
+		}
+	}
+	fclose(f);
+	return partitioner;
+}
+
+bool edge_balanced_graph_partitioner::dump(const std::string &file,
+		int num_vparts, vsize_t min_vpart_degree) const
+{
+	FILE *f = fopen(file.c_str(), "w");
+	if (f == NULL) {
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"can't open %1% to store partitions") % file;
+		return false;
+	}
+
+	part_file_header header;
+	header.magic = part_file_header::MAGIC_NUMBER;
+	header.num_vertices = part_starts.back();
+	header.hub_degree = hub_degree;
+	header.min_vpart_degree = min_vpart_degree;
+	header.num_parts = get_num_partitions();
+	header.num_vparts = num_vparts;
+	bool ret = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fwrite(part_starts.data(),
+				sizeof(vertex_id_t) * part_starts.size(), 1, f) == 1;
+	fclose(f);
+	return ret;
+}
+
+size_t edge_balanced_graph_partitioner::get_all_vertices_in_part(int part_id,
+		size_t tot_num_vertices, std::vector<vertex_id_t> &ids) const
+{
+	assert(tot_num_vertices == part_starts.back());
+	for (vertex_id_t id = part_starts[part_id]; id < part_starts[part_id + 1];
+			id++)
+		ids.push_back(id);
+	return ids.size();
+}
+
+void edge_balanced_graph_partitioner::map2loc(vertex_id_t ids[], int num,
+		std::vector<local_vid_t> locs[], int num_parts) const
+{
+	assert(num_parts <= get_num_partitions());
+	for (int i = 0; i < num; i++) {
+		int part_id = map(ids[i]);
+		locs[part_id].push_back(local_vid_t(ids[i] - part_starts[part_id]));
+	}
+}
+
+void edge_balanced_graph_partitioner::map2loc(edge_seq_iterator &it,
+		std::vector<local_vid_t> locs[], int num_parts) const
+{
+	assert(num_parts <= get_num_partitions());
+	PAGE_FOREACH(vertex_id_t, id, it) {
+		int part_id = map(id);
+		locs[part_id].push_back(local_vid_t(id - part_starts[part_id]));
+	} PAGE_FOREACH_END
+}
+
+size_t edge_balanced_graph_partitioner::map2loc(edge_seq_iterator &it,
+		vertex_loc_t locs[], size_t num) const
+{
+	size_t ret = 0;
+	PAGE_FOREACH(vertex_id_t, id, it) {
+		if ((size_t) page_foreach_idx == num)
+			break;
+		int part_id = map(id);
+		vertex_loc_t loc(part_id, local_vid_t(id - part_starts[part_id]));
+		locs[page_foreach_idx] = loc;
+		ret++;
+	} PAGE_FOREACH_END
+	return ret;
+}
+
 }
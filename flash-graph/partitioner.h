@@ -23,6 +23,11 @@
 #include <math.h>
 
 #include <utility>
+#include <limits>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "vertex.h"
 
@@ -53,9 +58,16 @@ struct local_vid_t
  */
 typedef std::pair<int, struct local_vid_t> vertex_loc_t;
 
+class in_mem_query_vertex_index;
+
 class graph_partitioner
 {
 public:
+	typedef std::shared_ptr<graph_partitioner> ptr;
+
+	virtual ~graph_partitioner() {
+	}
+
 	virtual int get_num_partitions() const = 0;
 	virtual int map(vertex_id_t id) const = 0;
 	virtual void map2loc(vertex_id_t id, int &part_id, off_t &off) const = 0;
@@ -176,6 +188,106 @@ public:
 	}
 };
 
+/**
+ * This partitioner assigns each partition a contiguous range of vertex IDs.
+ * Unlike range_graph_partitioner, the ranges have different sizes: they're
+ * cut on the cumulative degree of vertices so that all partitions have
+ * roughly the same number of edges. As such, the work of a worker thread
+ * follows the number of edges instead of the number of vertices.
+ *
+ * A hub vertex whose degree is a large fraction of the edge budget of
+ * a partition can't be balanced by cutting ranges. If vertical partitioning
+ * is enabled (num_vparts > 1), such a vertex is split into vertical parts and
+ * only a vertical part is charged to the partition that owns the vertex,
+ * because the other parts can be processed by other threads.
+ */
+class edge_balanced_graph_partitioner: public graph_partitioner
+{
+	// The first vertex of each partition. The last element is the number
+	// of vertices in the graph.
+	std::vector<vertex_id_t> part_starts;
+	// The min degree of a vertex to be split with vertical partitioning.
+	vsize_t hub_degree;
+
+	edge_balanced_graph_partitioner() {
+		hub_degree = std::numeric_limits<vsize_t>::max();
+	}
+public:
+	typedef std::shared_ptr<edge_balanced_graph_partitioner> ptr;
+
+	/*
+	 * Cut the vertex ID space on the cumulative degree of vertices.
+	 * The degree of vertices is read from the in-memory vertex index.
+	 * If `num_vparts' is larger than 1, vertices whose degree is at least
+	 * `min_vpart_degree' or larger than the hub degree computed from
+	 * the graph are charged with 1/num_vparts of their edges.
+	 */
+	static ptr create(const in_mem_query_vertex_index &index,
+			size_t num_vertices, int num_parts, int num_vparts,
+			vsize_t min_vpart_degree);
+	/*
+	 * Create a partitioner with the given partition boundaries.
+	 */
+	static ptr create(const std::vector<vertex_id_t> &part_starts);
+	/*
+	 * Load the partition boundaries from a file. If the file doesn't exist
+	 * or it was created for a different graph, a different number of
+	 * partitions or a different `min_vpart_degree', it returns NULL.
+	 */
+	static ptr load(const std::string &file, size_t num_vertices,
+			int num_parts, int num_vparts, vsize_t min_vpart_degree);
+	/*
+	 * Persist the partition boundaries to a file, together with
+	 * the configuration used to compute them.
+	 * It returns false if it fails to write the file.
+	 */
+	bool dump(const std::string &file, int num_vparts,
+			vsize_t min_vpart_degree) const;
+
+	int get_num_partitions() const {
+		return part_starts.size() - 1;
+	}
+
+	vsize_t get_hub_degree() const {
+		return hub_degree;
+	}
+
+	vertex_id_t get_part_start(int part_id) const {
+		return part_starts[part_id];
+	}
+
+	virtual int map(vertex_id_t id) const {
+		// The number of partitions is small, so a binary search on
+		// the partition boundaries is cheap.
+		return std::upper_bound(part_starts.begin() + 1, part_starts.end(),
+				id) - (part_starts.begin() + 1);
+	}
+
+	virtual void map2loc(vertex_id_t id, int &part_id, off_t &off) const {
+		part_id = map(id);
+		off = id - part_starts[part_id];
+	}
+
+	virtual void map2loc(vertex_id_t ids[], int num,
+			std::vector<local_vid_t> locs[], int num_parts) const;
+	virtual void map2loc(edge_seq_iterator &, std::vector<local_vid_t> locs[],
+			int num_parts) const;
+	virtual size_t map2loc(edge_seq_iterator &,
+			vertex_loc_t locs[], size_t num) const;
+
+	virtual void loc2map(int part_id, off_t off, vertex_id_t &id) const {
+		id = part_starts[part_id] + off;
+	}
+
+	virtual size_t get_all_vertices_in_part(int part_id,
+			size_t tot_num_vertices, std::vector<vertex_id_t> &ids) const;
+
+	virtual size_t get_part_size(int part_id, size_t num_vertices) const {
+		assert(num_vertices == part_starts.back());
+		return part_starts[part_id + 1] - part_starts[part_id];
+	}
+};
+
 }
 
 #endif
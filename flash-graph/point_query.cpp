@@ -0,0 +1,357 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
+#include "thread.h"
+#include "io_interface.h"
+
+#include "point_query.h"
+#include "vertex_compute.h"
+#include "vertex_index_reader.h"
+#include "graph_config.h"
+#include "FGlib.h"
+
+using namespace safs;
+
+namespace fg
+{
+
+namespace
+{
+
+/*
+ * This gets the locations of the edge lists of a vertex in the graph file.
+ */
+class vertex_info_compute: public index_compute
+{
+	edge_type type;
+	std::vector<ext_mem_vertex_info> *infos;
+public:
+	vertex_info_compute(index_comp_allocator &alloc): index_compute(alloc) {
+		type = edge_type::NONE;
+		infos = NULL;
+	}
+
+	void init(vertex_id_t id, edge_type type,
+			std::vector<ext_mem_vertex_info> &infos) {
+		index_compute::clear();
+		index_compute::init(id);
+		this->type = type;
+		this->infos = &infos;
+	}
+
+	virtual bool run(vertex_id_t vid, index_iterator &it) {
+		if (type == edge_type::IN_EDGE || type == edge_type::BOTH_EDGES)
+			infos->push_back(ext_mem_vertex_info(vid, it.get_curr_off(),
+						it.get_curr_size()));
+		if (type == edge_type::OUT_EDGE || type == edge_type::BOTH_EDGES)
+			infos->push_back(ext_mem_vertex_info(vid, it.get_curr_out_off(),
+						it.get_curr_out_size()));
+		return true;
+	}
+};
+
+/*
+ * A session looks up one vertex in the in-memory index at a time and
+ * the lookup completes immediately, so a single compute is enough.
+ */
+class single_comp_allocator: public index_comp_allocator
+{
+	vertex_info_compute compute;
+public:
+	single_comp_allocator(): compute(*this) {
+	}
+
+	virtual index_compute *alloc() {
+		return &compute;
+	}
+
+	virtual void free(index_compute *compute) {
+		assert(compute == &this->compute);
+	}
+};
+
+class point_query_callback: public callback
+{
+	point_query_session &session;
+public:
+	point_query_callback(point_query_session &_session): session(_session) {
+	}
+
+	virtual int invoke(io_request *reqs[], int num) {
+		session.add_completed(num);
+		return 0;
+	}
+};
+
+}
+
+point_query_engine::point_query_engine(FG_graph::ptr fg)
+{
+	header = fg->get_graph_header();
+	header.verify();
+	graph_factory = fg->get_graph_io_factory(GLOBAL_CACHE_ACCESS);
+	vindex = in_mem_query_vertex_index::create(fg->get_index_data(), true,
+			graph_conf.use_ef_index());
+	if (fg->get_delta())
+		BOOST_LOG_TRIVIAL(warning)
+			<< "point queries don't see the edge updates of the graph";
+}
+
+vsize_t point_query_engine::get_num_edges(vertex_id_t id, edge_type type) const
+{
+	if (!is_directed())
+		type = edge_type::IN_EDGE;
+	return vindex->get_num_edges(id, type);
+}
+
+point_query_session::ptr point_query_engine::create_session() const
+{
+	return point_query_session::ptr(new point_query_session(*this));
+}
+
+point_query_session::point_query_session(
+		const point_query_engine &_engine): engine(_engine)
+{
+	io = create_io(engine.get_graph_io_factory(), thread::get_curr_thread());
+	io->set_callback(callback::ptr(new point_query_callback(*this)));
+	index_reader = vertex_index_reader::create(engine.get_vertex_index(),
+			engine.is_directed());
+	comp_alloc = std::shared_ptr<index_comp_allocator>(
+			new single_comp_allocator());
+	num_completed = 0;
+}
+
+const std::vector<point_edge_list> &point_query_session::fetch(
+		const vertex_id_t ids[], size_t num, edge_type type)
+{
+	assert(type != edge_type::NONE);
+	if (!engine.is_directed())
+		type = edge_type::IN_EDGE;
+
+	// A vertex may appear multiple times in a request. We read its edge
+	// list once.
+	uniq_ids.assign(ids, ids + num);
+	std::sort(uniq_ids.begin(), uniq_ids.end());
+	uniq_ids.erase(std::unique(uniq_ids.begin(), uniq_ids.end()),
+			uniq_ids.end());
+
+	// Look up the locations of the edge lists.
+	infos.clear();
+	for (size_t i = 0; i < uniq_ids.size(); i++) {
+		vertex_info_compute *compute
+			= (vertex_info_compute *) comp_alloc->alloc();
+		compute->init(uniq_ids[i], type, infos);
+		index_reader->request_index(compute);
+	}
+
+	// Place the edge lists in the arena. We keep the edge lists aligned
+	// so we can access them as ext_mem_undirected_vertex.
+	arena_offs.resize(infos.size());
+	size_t arena_size = 0;
+	for (size_t i = 0; i < infos.size(); i++) {
+		arena_offs[i] = arena_size;
+		arena_size += ROUNDUP(infos[i].get_size(), sizeof(vertex_id_t) * 2);
+	}
+	if (arena.size() < arena_size)
+		arena.resize(arena_size);
+
+	// Read all edge lists at once, so their latencies overlap.
+	num_completed = 0;
+	int max_pending = io->get_max_num_pending_ios();
+	for (size_t i = 0; i < infos.size(); i++) {
+		if (infos[i].get_size() == 0) {
+			num_completed++;
+			continue;
+		}
+		data_loc_t loc(io->get_file_id(), infos[i].get_off());
+		io_request req(arena.data() + arena_offs[i], loc, infos[i].get_size(),
+				READ, io.get());
+		while (io->num_pending_ios() >= max_pending)
+			io->wait4complete(1);
+		io->access(&req, 1);
+	}
+	io->flush_requests();
+	while (num_completed < infos.size()) {
+		assert(io->num_pending_ios() > 0);
+		io->wait4complete(1);
+	}
+
+	uniq_lists.clear();
+	for (size_t i = 0; i < infos.size(); i++) {
+		if (uniq_lists.empty()
+				|| uniq_lists.back().get_id() != infos[i].get_id())
+			uniq_lists.push_back(point_edge_list(infos[i].get_id()));
+		if (infos[i].get_size() > 0)
+			uniq_lists.back().add_part((const ext_mem_undirected_vertex *) (
+						arena.data() + arena_offs[i]));
+	}
+	assert(uniq_lists.size() == uniq_ids.size());
+
+	// Return the edge lists in the order of the requested vertices.
+	lists.clear();
+	for (size_t i = 0; i < num; i++) {
+		size_t idx = std::lower_bound(uniq_ids.begin(), uniq_ids.end(),
+				ids[i]) - uniq_ids.begin();
+		assert(uniq_lists[idx].get_id() == ids[i]);
+		lists.push_back(uniq_lists[idx]);
+	}
+	return lists;
+}
+
+int point_query_session::k_hop(vertex_id_t start, int k, edge_type type,
+		std::vector<vertex_id_t> &vertices, size_t max_vertices)
+{
+	vertices.clear();
+	visited.clear();
+	frontier.clear();
+	vertices.push_back(start);
+	visited.insert(start);
+	frontier.push_back(start);
+
+	int hop = 0;
+	while (hop < k && !frontier.empty() && vertices.size() < max_vertices) {
+		const std::vector<point_edge_list> &lists = fetch(frontier.data(),
+				frontier.size(), type);
+		frontier.clear();
+		hop++;
+		BOOST_FOREACH(const point_edge_list &list, lists) {
+			size_t num_edges = list.get_num_edges();
+			for (size_t i = 0; i < num_edges
+					&& vertices.size() < max_vertices; i++) {
+				vertex_id_t neigh = list.get_neighbor(i);
+				if (visited.insert(neigh).second) {
+					vertices.push_back(neigh);
+					frontier.push_back(neigh);
+				}
+			}
+		}
+	}
+	return hop;
+}
+
+void point_query_session::sample_neighbors(
+		const std::vector<vertex_id_t> &seeds,
+		const std::vector<size_t> &fanouts, edge_type type,
+		std::vector<std::pair<vertex_id_t, vertex_id_t> > &edges)
+{
+	edges.clear();
+	visited.clear();
+	frontier = seeds;
+	visited.insert(seeds.begin(), seeds.end());
+	for (size_t hop = 0; hop < fanouts.size() && !frontier.empty(); hop++) {
+		const std::vector<point_edge_list> &lists = fetch(frontier.data(),
+				frontier.size(), type);
+		frontier.clear();
+		BOOST_FOREACH(const point_edge_list &list, lists) {
+			size_t num_edges = list.get_num_edges();
+			size_t num_samples = std::min(fanouts[hop], num_edges);
+			// Selection sampling: each edge is selected with the probability
+			// of the number of samples needed over the number of edges left.
+			for (size_t i = 0; i < num_edges && num_samples > 0; i++) {
+				if (gen() % (num_edges - i) >= num_samples)
+					continue;
+				num_samples--;
+				vertex_id_t neigh = list.get_neighbor(i);
+				edges.push_back(std::pair<vertex_id_t, vertex_id_t>(
+							list.get_id(), neigh));
+				if (visited.insert(neigh).second)
+					frontier.push_back(neigh);
+			}
+		}
+	}
+}
+
+void point_query_session::add_residual(vertex_id_t id, double val,
+		edge_type type, double epsilon, std::vector<vertex_id_t> &active)
+{
+	double &residual = residuals[id];
+	double threshold = epsilon * std::max<vsize_t>(
+			engine.get_num_edges(id, type), 1);
+	// A vertex is activated once when its residual exceeds the threshold.
+	bool below = residual < threshold;
+	residual += val;
+	if (below && residual >= threshold)
+		active.push_back(id);
+}
+
+namespace
+{
+
+struct score_greater
+{
+	bool operator()(const std::pair<vertex_id_t, double> &v1,
+			const std::pair<vertex_id_t, double> &v2) const {
+		return v1.second > v2.second;
+	}
+};
+
+}
+
+size_t point_query_session::personalized_pagerank(vertex_id_t source,
+		edge_type type, double alpha, double epsilon,
+		std::vector<std::pair<vertex_id_t, double> > &scores)
+{
+	assert(alpha > 0 && alpha < 1);
+	residuals.clear();
+	estimates.clear();
+	frontier.clear();
+	residuals[source] = 1;
+	frontier.push_back(source);
+
+	// All vertices whose residuals exceed their thresholds push in a round,
+	// so the edge lists of a round are read together.
+	size_t num_pushes = 0;
+	std::vector<vertex_id_t> next;
+	while (!frontier.empty()) {
+		std::sort(frontier.begin(), frontier.end());
+		frontier.erase(std::unique(frontier.begin(), frontier.end()),
+				frontier.end());
+		const std::vector<point_edge_list> &lists = fetch(frontier.data(),
+				frontier.size(), type);
+		next.clear();
+		BOOST_FOREACH(const point_edge_list &list, lists) {
+			double &residual = residuals[list.get_id()];
+			double r = residual;
+			residual = 0;
+			estimates[list.get_id()] += alpha * r;
+			num_pushes++;
+			size_t num_edges = list.get_num_edges();
+			// A vertex without edges teleports back to the source.
+			if (num_edges == 0) {
+				add_residual(source, (1 - alpha) * r, type, epsilon, next);
+				continue;
+			}
+			double push = (1 - alpha) * r / num_edges;
+			for (size_t i = 0; i < num_edges; i++)
+				add_residual(list.get_neighbor(i), push, type, epsilon, next);
+		}
+		frontier.swap(next);
+	}
+
+	scores.clear();
+	scores.insert(scores.end(), estimates.begin(), estimates.end());
+	std::sort(scores.begin(), scores.end(), score_greater());
+	return num_pushes;
+}
+
+}
@@ -0,0 +1,258 @@
+#ifndef __POINT_QUERY_H__
+#define __POINT_QUERY_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "vertex.h"
+#include "vertex_index.h"
+
+namespace safs
+{
+class io_interface;
+class file_io_factory;
+}
+
+namespace fg
+{
+
+class FG_graph;
+class vertex_index_reader;
+class index_comp_allocator;
+class point_query_session;
+
+/**
+ * \brief The edge list of a vertex read by a point query. The edge list
+ * of a vertex in a directed graph has both in-edges and out-edges
+ * if both types of edges are requested.
+ * It's only valid before the next request in the session.
+ */
+class point_edge_list
+{
+	vertex_id_t id;
+	const ext_mem_undirected_vertex *parts[2];
+	int num_parts;
+public:
+	point_edge_list(vertex_id_t id) {
+		this->id = id;
+		parts[0] = NULL;
+		parts[1] = NULL;
+		num_parts = 0;
+	}
+
+	void add_part(const ext_mem_undirected_vertex *part) {
+		assert(num_parts < 2);
+		parts[num_parts++] = part;
+	}
+
+	vertex_id_t get_id() const {
+		return id;
+	}
+
+	size_t get_num_edges() const {
+		size_t num_edges = 0;
+		for (int i = 0; i < num_parts; i++)
+			num_edges += parts[i]->get_num_edges();
+		return num_edges;
+	}
+
+	vertex_id_t get_neighbor(size_t idx) const {
+		for (int i = 0; i < num_parts; i++) {
+			if (idx < parts[i]->get_num_edges())
+				return parts[i]->get_neighbor(idx);
+			idx -= parts[i]->get_num_edges();
+		}
+		assert(0);
+		return INVALID_VERTEX_ID;
+	}
+};
+
+/**
+ * \brief This serves point queries on a graph, such as k-hop neighborhoods
+ * and personalized PageRank from a vertex.
+ *
+ * A point query touches a few thousand vertices at most, so it doesn't
+ * go through the graph engine, whose levels are synchronized by all worker
+ * threads and which iterates over all vertices in each level. Instead,
+ * a query runs in the thread that issues it. It looks up the locations of
+ * vertices in the in-memory vertex index and reads their edge lists with
+ * asynchronous I/O requests to SAFS, so the page cache is shared with all
+ * sessions. The engine is thread-safe, and each thread that runs queries
+ * creates its own session.
+ */
+class point_query_engine
+{
+	graph_header header;
+	in_mem_query_vertex_index::ptr vindex;
+	std::shared_ptr<safs::file_io_factory> graph_factory;
+
+	point_query_engine(std::shared_ptr<FG_graph> fg);
+public:
+	typedef std::shared_ptr<point_query_engine> ptr;
+
+	static ptr create(std::shared_ptr<FG_graph> fg) {
+		return ptr(new point_query_engine(fg));
+	}
+
+	const graph_header &get_graph_header() const {
+		return header;
+	}
+
+	bool is_directed() const {
+		return header.is_directed_graph();
+	}
+
+	in_mem_query_vertex_index::ptr get_vertex_index() const {
+		return vindex;
+	}
+
+	std::shared_ptr<safs::file_io_factory> get_graph_io_factory() const {
+		return graph_factory;
+	}
+
+	/**
+	 * \brief Get the number of edges of a vertex. It doesn't need I/O.
+	 */
+	vsize_t get_num_edges(vertex_id_t id, edge_type type) const;
+
+	/**
+	 * \brief Create a session that runs queries in the current thread.
+	 */
+	std::shared_ptr<point_query_session> create_session() const;
+};
+
+/**
+ * \brief A session runs point queries in the thread that creates it.
+ *
+ * A session keeps the I/O instance of the thread and an arena for the edge
+ * lists read by a query. The arena and the other buffers are reused by
+ * the next query, so a query doesn't allocate memory once the buffers are
+ * large enough.
+ */
+class point_query_session
+{
+	const point_query_engine &engine;
+	std::shared_ptr<safs::io_interface> io;
+	std::shared_ptr<vertex_index_reader> index_reader;
+	std::shared_ptr<index_comp_allocator> comp_alloc;
+	// The requested vertices without duplicates and their edge lists.
+	std::vector<vertex_id_t> uniq_ids;
+	std::vector<point_edge_list> uniq_lists;
+	std::vector<ext_mem_vertex_info> infos;
+	std::vector<off_t> arena_offs;
+	std::vector<char> arena;
+	size_t num_completed;
+	std::mt19937_64 gen;
+
+	// The buffers used by queries.
+	std::vector<point_edge_list> lists;
+	std::vector<vertex_id_t> frontier;
+	std::unordered_set<vertex_id_t> visited;
+	std::unordered_map<vertex_id_t, double> residuals;
+	std::unordered_map<vertex_id_t, double> estimates;
+
+	point_query_session(const point_query_engine &_engine);
+
+	void add_residual(vertex_id_t id, double val, edge_type type,
+			double epsilon, std::vector<vertex_id_t> &active);
+public:
+	typedef std::shared_ptr<point_query_session> ptr;
+
+	void set_seed(uint64_t seed) {
+		gen.seed(seed);
+	}
+
+	void add_completed(size_t num) {
+		num_completed += num;
+	}
+
+	/**
+	 * \brief Read the edge lists of vertices.
+	 * \param ids The vertices.
+	 * \param num The number of vertices.
+	 * \param type The type of edges to read. It's ignored in an undirected
+	 * graph.
+	 * \return The edge lists in the same order as the vertices. They stay
+	 * valid until the next request in the session. A vertex that appears
+	 * multiple times is read once and gets an edge list at each position.
+	 */
+	const std::vector<point_edge_list> &fetch(const vertex_id_t ids[],
+			size_t num, edge_type type);
+
+	/**
+	 * \brief Get the vertices within k hops from a vertex.
+	 * \param start The vertex where the search starts.
+	 * \param k The number of hops.
+	 * \param type The type of edges to follow.
+	 * \param vertices The vertices reached by the search, in the order
+	 * they're reached. The start vertex is the first one.
+	 * \param max_vertices The search stops when it reaches so many vertices.
+	 * \return The number of hops that have been expanded.
+	 */
+	int k_hop(vertex_id_t start, int k, edge_type type,
+			std::vector<vertex_id_t> &vertices,
+			size_t max_vertices = std::numeric_limits<size_t>::max());
+
+	/**
+	 * \brief Sample a multi-hop neighborhood from seed vertices.
+	 * In each hop, every vertex in the frontier samples `fanouts[hop]'
+	 * neighbors without replacement, and the sampled neighbors form
+	 * the next frontier.
+	 * \param seeds The vertices where sampling starts.
+	 * \param fanouts The number of neighbors sampled per vertex in each hop.
+	 * \param type The type of edges to sample.
+	 * \param edges The sampled edges.
+	 */
+	void sample_neighbors(const std::vector<vertex_id_t> &seeds,
+			const std::vector<size_t> &fanouts, edge_type type,
+			std::vector<std::pair<vertex_id_t, vertex_id_t> > &edges);
+
+	/**
+	 * \brief Compute personalized PageRank from a vertex with forward push.
+	 * A vertex pushes its residual to its neighbors when the residual is
+	 * at least `epsilon' times its degree, so the error of the estimate of
+	 * a vertex is bounded by `epsilon' times its degree.
+	 * \param source The source vertex.
+	 * \param type The type of edges to push along. It should be OUT_EDGE
+	 * in a directed graph for the usual definition of PageRank.
+	 * \param alpha The probability of teleporting back to the source.
+	 * \param epsilon The residual threshold.
+	 * \param scores The estimates of the vertices, sorted in descending
+	 * order.
+	 * \return The number of pushes.
+	 */
+	size_t personalized_pagerank(vertex_id_t source, edge_type type,
+			double alpha, double epsilon,
+			std::vector<std::pair<vertex_id_t, double> > &scores);
+
+	friend class point_query_engine;
+};
+
+}
+
+#endif
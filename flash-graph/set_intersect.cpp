@@ -0,0 +1,108 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+
+#include "set_intersect.h"
+
+namespace fg
+{
+
+simd_level get_simd_level()
+{
+#ifdef FG_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return SIMD_AVX512;
+	else if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+#endif
+	return SIMD_NONE;
+}
+
+void sorted_id_set::init(const vertex_id_t *ids, size_t num,
+		bool build_index)
+{
+	this->ids = ids;
+	this->num = num;
+	words.clear();
+	ranks.clear();
+	if (num == 0)
+		return;
+
+	min_id = ids[0];
+	max_id = ids[num - 1];
+	assert(min_id <= max_id);
+	size_t range = ((size_t) max_id) - min_id + 1;
+	if (!build_index || range / num > MAX_BITMAP_BITS_PER_ID)
+		return;
+
+	size_t num_words = (range + 63) / 64;
+	words.resize(num_words);
+	ranks.resize(num_words);
+	for (size_t i = 0; i < num; i++) {
+		size_t off = ids[i] - min_id;
+		words[off / 64] |= 1UL << (off % 64);
+	}
+	uint32_t rank = 0;
+	for (size_t i = 0; i < num_words; i++) {
+		ranks[i] = rank;
+		rank += __builtin_popcountl(words[i]);
+	}
+	// The index only works if the IDs are unique. Otherwise, we fall back
+	// to the other kernels.
+	if (rank != num) {
+		words.clear();
+		ranks.clear();
+	}
+}
+
+static pthread_key_t neigh_buf_key;
+static pthread_once_t neigh_buf_once = PTHREAD_ONCE_INIT;
+
+static void destroy_neigh_buf(void *p)
+{
+	std::vector<vertex_id_t> *buf = (std::vector<vertex_id_t> *) p;
+	delete buf;
+}
+
+static void init_neigh_buf_key()
+{
+	pthread_key_create(&neigh_buf_key, destroy_neigh_buf);
+}
+
+const vertex_id_t *read_neighbors(const page_vertex &v, edge_type type,
+		size_t &num)
+{
+	pthread_once(&neigh_buf_once, init_neigh_buf_key);
+	std::vector<vertex_id_t> *buf
+		= (std::vector<vertex_id_t> *) pthread_getspecific(neigh_buf_key);
+	if (buf == NULL) {
+		buf = new std::vector<vertex_id_t>();
+		pthread_setspecific(neigh_buf_key, buf);
+	}
+	num = v.get_num_edges(type);
+	if (buf->size() < num)
+		buf->resize(num);
+	if (num > 0)
+		v.read_edges(type, buf->data(), num);
+	return buf->data();
+}
+
+}
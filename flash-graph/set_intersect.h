@@ -0,0 +1,430 @@
+#ifndef __SET_INTERSECT_H__
+#define __SET_INTERSECT_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <assert.h>
+
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define FG_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#include "FG_basic_types.h"
+#include "vertex.h"
+
+/*
+ * This file implements the intersection of sorted neighbor lists, which
+ * dominates the computation of triangle counting and scan statistics.
+ *
+ * All kernels intersect a sorted array `a' whose elements are unique with
+ * a sorted array `b' that may contain duplicates. They invoke func(i, j)
+ * for every element b[j] that exists in `a', where a[i] == b[j], in
+ * the ascending order of `j', and return the number of matches.
+ *
+ * There are four kernels:
+ * merge: the scalar merge of two sorted arrays.
+ * SIMD: the merge that compares a block of `a' with a block of `b' with
+ *       AVX2 or AVX-512 instructions. The instructions are chosen at
+ *       runtime, so the code doesn't need to be compiled with -mavx2.
+ * gallop: it searches for the elements of the short array in the long
+ *         array with exponential search, for arrays with very different
+ *         sizes.
+ * bitmap: it probes the elements of `b' in a bitmap index of `a'. It's
+ *         used for hub vertices whose neighbor lists are intersected with
+ *         many other lists.
+ *
+ * `intersect' picks a kernel based on the lengths of the arrays.
+ */
+
+namespace fg
+{
+
+/*
+ * If one array is longer than the other by this ratio, we use galloping.
+ */
+const size_t GALLOP_RATIO = 32;
+/*
+ * If the indexed array is longer than the other by this ratio, we probe
+ * the bitmap index.
+ */
+const size_t BITMAP_PROBE_RATIO = 4;
+/*
+ * We only build a bitmap index if each element uses fewer bits than this
+ * in the bitmap.
+ */
+const size_t MAX_BITMAP_BITS_PER_ID = 256;
+
+enum intersect_method
+{
+	INTERSECT_AUTO,
+	INTERSECT_MERGE,
+	INTERSECT_SIMD,
+	INTERSECT_GALLOP,
+	INTERSECT_BITMAP,
+};
+
+enum simd_level
+{
+	SIMD_NONE,
+	SIMD_AVX2,
+	SIMD_AVX512,
+};
+
+/*
+ * The widest SIMD instructions supported by the CPU.
+ */
+simd_level get_simd_level();
+
+/*
+ * The first element in arr[start, num) that isn't smaller than `key'.
+ * It doubles the search range until it passes the key and searches for
+ * the key in the last range with binary search.
+ */
+static inline size_t gallop_lower_bound(const vertex_id_t *arr, size_t start,
+		size_t num, vertex_id_t key)
+{
+	size_t lo = start;
+	size_t hi = start;
+	size_t step = 1;
+	while (hi < num && arr[hi] < key) {
+		lo = hi + 1;
+		hi += step;
+		step <<= 1;
+	}
+	if (hi > num)
+		hi = num;
+	return std::lower_bound(arr + lo, arr + hi, key) - arr;
+}
+
+/*
+ * Merge a[i, num_a) and b[j, num_b). It also merges the rest of the arrays
+ * after the block merge. The elements of `b' that match the elements of `a'
+ * before `i' have been reported, and they are smaller than a[i], so they
+ * won't be reported again.
+ */
+template<class Func>
+size_t intersect_tail(const vertex_id_t *a, size_t i, size_t num_a,
+		const vertex_id_t *b, size_t j, size_t num_b, Func &func)
+{
+	size_t num_matches = 0;
+	while (i < num_a && j < num_b) {
+		if (a[i] < b[j])
+			i++;
+		else if (b[j] < a[i])
+			j++;
+		else {
+			func(i, j);
+			num_matches++;
+			// `b' may have duplicates, so we only move forward in `b'.
+			j++;
+		}
+	}
+	return num_matches;
+}
+
+template<class Func>
+size_t intersect_merge(const vertex_id_t *a, size_t num_a,
+		const vertex_id_t *b, size_t num_b, Func &func)
+{
+	return intersect_tail(a, 0, num_a, b, 0, num_b, func);
+}
+
+template<class Func>
+size_t intersect_gallop(const vertex_id_t *a, size_t num_a,
+		const vertex_id_t *b, size_t num_b, Func &func)
+{
+	size_t num_matches = 0;
+	if (num_a <= num_b) {
+		size_t j = 0;
+		for (size_t i = 0; i < num_a && j < num_b; i++) {
+			j = gallop_lower_bound(b, j, num_b, a[i]);
+			for (; j < num_b && b[j] == a[i]; j++) {
+				func(i, j);
+				num_matches++;
+			}
+		}
+	}
+	else {
+		size_t i = 0;
+		for (size_t j = 0; j < num_b && i < num_a; j++) {
+			i = gallop_lower_bound(a, i, num_a, b[j]);
+			if (i < num_a && a[i] == b[j]) {
+				func(i, j);
+				num_matches++;
+			}
+		}
+	}
+	return num_matches;
+}
+
+#ifdef FG_X86_SIMD
+
+/*
+ * Report the elements of a block in `b' selected by `mask'. We find
+ * the matched elements in the block of `a' with a linear scan because
+ * the block is small.
+ */
+template<class Func>
+static inline size_t report_block_matches(const vertex_id_t *a, size_t i,
+		size_t block_size, const vertex_id_t *b, size_t j, uint32_t mask,
+		Func &func)
+{
+	size_t num_matches = 0;
+	while (mask) {
+		int lane = __builtin_ctz(mask);
+		mask &= mask - 1;
+		size_t k = 0;
+		while (a[i + k] != b[j + lane])
+			k++;
+		assert(k < block_size);
+		func(i + k, j + lane);
+		num_matches++;
+	}
+	return num_matches;
+}
+
+/*
+ * The block merge: we compare every element in a block of `b' with every
+ * element in a block of `a', and move forward in the array whose block
+ * has the smaller max element. When the max elements are the same, we
+ * only move forward in `b' because the next block of `b' may have
+ * duplicates of the max element.
+ */
+template<class Func>
+__attribute__((target("avx2")))
+size_t intersect_avx2(const vertex_id_t *a, size_t num_a,
+		const vertex_id_t *b, size_t num_b, Func &func)
+{
+	const size_t BLOCK = 8;
+	size_t i = 0;
+	size_t j = 0;
+	size_t num_matches = 0;
+	while (i + BLOCK <= num_a && j + BLOCK <= num_b) {
+		__m256i vb = _mm256_loadu_si256((const __m256i *) (b + j));
+		__m256i eq = _mm256_setzero_si256();
+		for (size_t k = 0; k < BLOCK; k++)
+			eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(vb,
+						_mm256_set1_epi32(a[i + k])));
+		uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+		if (mask)
+			num_matches += report_block_matches(a, i, BLOCK, b, j, mask,
+					func);
+		vertex_id_t a_max = a[i + BLOCK - 1];
+		vertex_id_t b_max = b[j + BLOCK - 1];
+		if (a_max < b_max)
+			i += BLOCK;
+		else
+			j += BLOCK;
+	}
+	return num_matches + intersect_tail(a, i, num_a, b, j, num_b, func);
+}
+
+template<class Func>
+__attribute__((target("avx512f")))
+size_t intersect_avx512(const vertex_id_t *a, size_t num_a,
+		const vertex_id_t *b, size_t num_b, Func &func)
+{
+	const size_t BLOCK = 16;
+	size_t i = 0;
+	size_t j = 0;
+	size_t num_matches = 0;
+	while (i + BLOCK <= num_a && j + BLOCK <= num_b) {
+		__m512i vb = _mm512_loadu_si512((const void *) (b + j));
+		__mmask16 mask = 0;
+		for (size_t k = 0; k < BLOCK; k++)
+			mask |= _mm512_cmpeq_epi32_mask(vb, _mm512_set1_epi32(a[i + k]));
+		if (mask)
+			num_matches += report_block_matches(a, i, BLOCK, b, j, mask,
+					func);
+		vertex_id_t a_max = a[i + BLOCK - 1];
+		vertex_id_t b_max = b[j + BLOCK - 1];
+		if (a_max < b_max)
+			i += BLOCK;
+		else
+			j += BLOCK;
+	}
+	return num_matches + intersect_tail(a, i, num_a, b, j, num_b, func);
+}
+
+#endif
+
+template<class Func>
+size_t intersect_simd(const vertex_id_t *a, size_t num_a,
+		const vertex_id_t *b, size_t num_b, Func &func)
+{
+#ifdef FG_X86_SIMD
+	static const simd_level level = get_simd_level();
+	if (level == SIMD_AVX512)
+		return intersect_avx512(a, num_a, b, num_b, func);
+	else if (level == SIMD_AVX2)
+		return intersect_avx2(a, num_a, b, num_b, func);
+#endif
+	return intersect_merge(a, num_a, b, num_b, func);
+}
+
+/*
+ * A sorted array of unique vertex IDs. It optionally has a bitmap index
+ * that covers the range of the IDs in the array, so we can test
+ * the membership of an ID and find its location in the array in constant
+ * time. The index is only built if the IDs are dense enough.
+ *
+ * The array doesn't own the IDs.
+ */
+class sorted_id_set
+{
+	const vertex_id_t *ids;
+	size_t num;
+	vertex_id_t min_id;
+	vertex_id_t max_id;
+	std::vector<uint64_t> words;
+	// The number of bits set in the words before each word.
+	std::vector<uint32_t> ranks;
+public:
+	sorted_id_set() {
+		ids = NULL;
+		num = 0;
+		min_id = 0;
+		max_id = 0;
+	}
+
+	/*
+	 * \param build_index Whether to build the bitmap index.
+	 */
+	void init(const vertex_id_t *ids, size_t num, bool build_index);
+
+	const vertex_id_t *get_ids() const {
+		return ids;
+	}
+
+	size_t size() const {
+		return num;
+	}
+
+	bool has_index() const {
+		return !words.empty();
+	}
+
+	/*
+	 * The location of the ID in the array. It returns -1 if the ID doesn't
+	 * exist. It uses binary search if the set doesn't have the bitmap index.
+	 */
+	off_t find_idx(vertex_id_t id) const {
+		if (num == 0 || id < min_id || id > max_id)
+			return -1;
+		if (!has_index()) {
+			const vertex_id_t *it = std::lower_bound(ids, ids + num, id);
+			return *it == id ? it - ids : -1;
+		}
+		size_t off = id - min_id;
+		uint64_t word = words[off / 64];
+		uint64_t bit = 1UL << (off % 64);
+		if ((word & bit) == 0)
+			return -1;
+		return ranks[off / 64] + __builtin_popcountl(word & (bit - 1));
+	}
+};
+
+template<class Func>
+size_t intersect_bitmap(const sorted_id_set &a, const vertex_id_t *b,
+		size_t num_b, Func &func)
+{
+	assert(a.has_index());
+	size_t num_matches = 0;
+	for (size_t j = 0; j < num_b; j++) {
+		off_t i = a.find_idx(b[j]);
+		if (i >= 0) {
+			func(i, j);
+			num_matches++;
+		}
+	}
+	return num_matches;
+}
+
+/*
+ * Intersect two sorted arrays with the kernel chosen by their lengths.
+ */
+template<class Func>
+size_t intersect(const vertex_id_t *a, size_t num_a, const vertex_id_t *b,
+		size_t num_b, Func &func)
+{
+	if (num_a == 0 || num_b == 0)
+		return 0;
+	if (num_a > GALLOP_RATIO * num_b || num_b > GALLOP_RATIO * num_a)
+		return intersect_gallop(a, num_a, b, num_b, func);
+	else
+		return intersect_simd(a, num_a, b, num_b, func);
+}
+
+/*
+ * Intersect an array with a set that may have a bitmap index. The index
+ * is used if the set is much longer than the array.
+ */
+template<class Func>
+size_t intersect(const sorted_id_set &a, const vertex_id_t *b, size_t num_b,
+		Func &func)
+{
+	if (a.has_index() && a.size() > BITMAP_PROBE_RATIO * num_b)
+		return intersect_bitmap(a, b, num_b, func);
+	else
+		return intersect(a.get_ids(), a.size(), b, num_b, func);
+}
+
+/*
+ * Intersect two arrays with the specified kernel. It's mainly used for
+ * testing and benchmarking the kernels.
+ */
+template<class Func>
+size_t intersect(intersect_method method, const sorted_id_set &a,
+		const vertex_id_t *b, size_t num_b, Func &func)
+{
+	switch (method) {
+		case INTERSECT_MERGE:
+			return intersect_merge(a.get_ids(), a.size(), b, num_b, func);
+		case INTERSECT_SIMD:
+			return intersect_simd(a.get_ids(), a.size(), b, num_b, func);
+		case INTERSECT_GALLOP:
+			return intersect_gallop(a.get_ids(), a.size(), b, num_b, func);
+		case INTERSECT_BITMAP:
+			if (a.has_index())
+				return intersect_bitmap(a, b, num_b, func);
+			else
+				return intersect(a.get_ids(), a.size(), b, num_b, func);
+		default:
+			return intersect(a, b, num_b, func);
+	}
+}
+
+/*
+ * The neighbors of a vertex in a page vertex may not be stored in contiguous
+ * memory. This reads them to a per-thread buffer, so they can be
+ * intersected with the kernels above. The buffer is valid until the next
+ * invocation in the same thread.
+ */
+const vertex_id_t *read_neighbors(const page_vertex &v, edge_type type,
+		size_t &num);
+
+}
+
+#endif
@@ -71,6 +71,36 @@ void run_cycle_triangle(FG_graph::ptr graph, int argc, char *argv[])
 
 void run_triangle(FG_graph::ptr graph, int argc, char *argv[])
 {
+	int opt;
+	int num_opts = 0;
+	double sample_rate = 0;
+	int num_wedges = 64;
+
+	while ((opt = getopt(argc, argv, "r:w:")) != -1) {
+		num_opts++;
+		switch (opt) {
+			case 'r':
+				sample_rate = atof(optarg);
+				num_opts++;
+				break;
+			case 'w':
+				num_wedges = atoi(optarg);
+				num_opts++;
+				break;
+			default:
+				print_usage();
+				abort();
+		}
+	}
+
+	if (sample_rate > 0) {
+		approx_value ret = approx_undirected_triangles(graph, sample_rate,
+				num_wedges);
+		printf("There are about %.0f +/- %.0f triangles\n", ret.value,
+				ret.error);
+		return;
+	}
+
 	FG_vector<size_t>::ptr triangles;
 	triangles = compute_undirected_triangles(graph);
 	if (triangles)
@@ -116,20 +146,42 @@ void run_topK_scan(FG_graph::ptr graph, int argc, char *argv[])
 	int opt;
 	int num_opts = 0;
 	int topK = 1;
+	size_t num_candidates = 0;
+	int num_wedges = 64;
 
-	while ((opt = getopt(argc, argv, "K:")) != -1) {
+	while ((opt = getopt(argc, argv, "K:c:w:")) != -1) {
 		num_opts++;
 		switch (opt) {
 			case 'K':
 				topK = atoi(optarg);
 				num_opts++;
 				break;
+			case 'c':
+				num_candidates = atol(optarg);
+				num_opts++;
+				break;
+			case 'w':
+				num_wedges = atoi(optarg);
+				num_opts++;
+				break;
 			default:
 				print_usage();
 				abort();
 		}
 	}
 
+	if (num_candidates > 0) {
+		FG_vector<std::pair<vertex_id_t, approx_value> >::ptr scan
+			= approx_topK_scan(graph, topK, num_candidates, num_wedges);
+		if (scan) {
+			printf("The top %ld approximate scans:\n", scan->get_size());
+			for (size_t i = 0; i < scan->get_size(); i++)
+				printf("%u\t%.0f +/- %.0f\n", scan->get(i).first,
+						scan->get(i).second.value, scan->get(i).second.error);
+		}
+		return;
+	}
+
 	FG_vector<std::pair<vertex_id_t, size_t> >::ptr scan
 		= compute_topK_scan(graph, topK);
 	if (scan) {
@@ -160,18 +212,61 @@ void run_cc(FG_graph::ptr graph, int argc, char *argv[])
 		print_cc(cc);
 }
 
+/*
+ * Run WCC on the level-synchronous and the asynchronous graph engine
+ * and compare their time to convergence. Both have to reach the same
+ * components.
+ */
+void compare_wcc(FG_graph::ptr graph)
+{
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	FG_vector<vertex_id_t>::ptr sync_ids = compute_wcc(graph, false);
+	gettimeofday(&end, NULL);
+	double sync_time = time_diff(start, end);
+
+	gettimeofday(&start, NULL);
+	FG_vector<vertex_id_t>::ptr async_ids = compute_wcc(graph, true);
+	gettimeofday(&end, NULL);
+	double async_time = time_diff(start, end);
+	if (sync_ids == NULL || async_ids == NULL)
+		return;
+
+	size_t num_diffs = 0;
+	for (size_t i = 0; i < sync_ids->get_size(); i++)
+		if (sync_ids->get(i) != async_ids->get(i))
+			num_diffs++;
+	printf("sync wcc: %f seconds, async wcc: %f seconds, speedup: %f\n",
+			sync_time, async_time, sync_time / async_time);
+	if (num_diffs > 0)
+		printf("%ld vertices are in different components\n", num_diffs);
+	print_cc(async_ids);
+}
+
 void run_wcc(FG_graph::ptr graph, int argc, char *argv[])
 {
 	int opt;
 	int num_opts = 0;
 	bool sync = false;
+	bool async = false;
+	bool afforest = false;
+	bool compare = false;
 	std::string output_file;
-	while ((opt = getopt(argc, argv, "so:")) != -1) {
+	while ((opt = getopt(argc, argv, "safco:")) != -1) {
 		num_opts++;
 		switch (opt) {
 			case 's':
 				sync = true;
 				break;
+			case 'a':
+				async = true;
+				break;
+			case 'f':
+				afforest = true;
+				break;
+			case 'c':
+				compare = true;
+				break;
 			case 'o':
 				output_file = optarg;
 				num_opts++;
@@ -181,11 +276,18 @@ void run_wcc(FG_graph::ptr graph, int argc, char *argv[])
 				abort();
 		}
 	}
+	if (compare) {
+		compare_wcc(graph);
+		return;
+	}
+
 	FG_vector<vertex_id_t>::ptr comp_ids;
-	if (sync)
+	if (afforest)
+		comp_ids = compute_wcc_afforest(graph);
+	else if (sync)
 		comp_ids = compute_sync_wcc(graph);
 	else
-		comp_ids = compute_wcc(graph);
+		comp_ids = compute_wcc(graph, async);
 	if (comp_ids == NULL)
 		return;
 
@@ -204,7 +306,22 @@ void run_wcc(FG_graph::ptr graph, int argc, char *argv[])
 
 void run_scc(FG_graph::ptr graph, int argc, char *argv[])
 {
-	FG_vector<vertex_id_t>::ptr cc = compute_scc(graph);
+	int opt;
+	int num_opts = 0;
+	bool giant_only = false;
+	while ((opt = getopt(argc, argv, "g")) != -1) {
+		num_opts++;
+		switch (opt) {
+			case 'g':
+				giant_only = true;
+				break;
+			default:
+				print_usage();
+				abort();
+		}
+	}
+
+	FG_vector<vertex_id_t>::ptr cc = compute_scc(graph, giant_only);
 	if (cc)
 		print_cc(cc);
 }
@@ -250,8 +367,10 @@ void run_pagerank(FG_graph::ptr graph, int argc, char *argv[], int version)
 
 	int num_iters = 30;
 	float damping_factor = 0.85;
+	bool async = false;
+	bool edge_map = false;
 
-	while ((opt = getopt(argc, argv, "i:D:")) != -1) {
+	while ((opt = getopt(argc, argv, "i:D:am")) != -1) {
 		num_opts++;
 		switch (opt) {
 			case 'i':
@@ -262,6 +381,12 @@ void run_pagerank(FG_graph::ptr graph, int argc, char *argv[], int version)
 				damping_factor = atof(optarg);
 				num_opts++;
 				break;
+			case 'a':
+				async = true;
+				break;
+			case 'm':
+				edge_map = true;
+				break;
 			default:
 				print_usage();
 				abort();
@@ -274,7 +399,10 @@ void run_pagerank(FG_graph::ptr graph, int argc, char *argv[], int version)
 			pr = compute_pagerank(graph, num_iters, damping_factor);
 			break;
 		case 2:
-			pr = compute_pagerank2(graph, num_iters, damping_factor);
+			if (edge_map)
+				pr = compute_pagerank_edge_map(graph, num_iters, damping_factor);
+			else
+				pr = compute_pagerank2(graph, num_iters, damping_factor, async);
 			break;
 		default:
 			abort();
@@ -298,11 +426,12 @@ void run_sstsg(FG_graph::ptr graph, int argc, char *argv[])
 	long time_interval = 1;
 	bool compute_all = false;
 	time_t start_time = -1;
+	std::string ts_index_file;
 
 	int opt;
 	int num_opts = 0;
 
-	while ((opt = getopt(argc, argv, "n:u:o:t:l:a")) != -1) {
+	while ((opt = getopt(argc, argv, "n:u:o:t:l:ai:")) != -1) {
 		num_opts++;
 		switch (opt) {
 			case 'n':
@@ -332,12 +461,25 @@ void run_sstsg(FG_graph::ptr graph, int argc, char *argv[])
 			case 'a':
 				compute_all = true;
 				break;
+			case 'i':
+				ts_index_file = optarg;
+				num_opts++;
+				break;
 			default:
 				print_usage();
 				abort();
 		}
 	}
 
+	// The temporal index is built and saved in the first run.
+	ts_vertex_index::ptr ts_index;
+	if (!ts_index_file.empty() && access(ts_index_file.c_str(), R_OK) == 0)
+		ts_index = ts_vertex_index::load(ts_index_file);
+	else if (!ts_index_file.empty()) {
+		ts_index = build_ts_vertex_index(graph);
+		ts_index->dump(ts_index_file);
+	}
+
 	if (time_unit_str == "hour")
 		time_interval *= HOUR_SECS;
 	else if (time_unit_str == "day")
@@ -367,7 +509,7 @@ void run_sstsg(FG_graph::ptr graph, int argc, char *argv[])
 				= start_time + num_time_intervals * time_interval;
 				interval_start < end_time; interval_start += time_interval) {
 			FG_vector<float>::ptr res = compute_sstsg(graph, interval_start,
-					time_interval, num_time_intervals);
+					time_interval, num_time_intervals, ts_index);
 			std::pair<float, off_t> p = res->max_val_loc();
 			printf("v%ld has max scan %f\n", p.second, p.first);
 		}
@@ -375,7 +517,7 @@ void run_sstsg(FG_graph::ptr graph, int argc, char *argv[])
 	else {
 		printf("start time: %ld, interval: %ld\n", start_time, time_interval);
 		FG_vector<float>::ptr res = compute_sstsg(graph, start_time,
-				time_interval, num_time_intervals);
+				time_interval, num_time_intervals, ts_index);
 
 		std::pair<float, off_t> p = res->max_val_loc();
 		printf("v%ld has max scan %f\n", p.second, p.first);
@@ -489,8 +631,9 @@ void run_betweenness_centrality(FG_graph::ptr graph, int argc, char* argv[])
 	int num_opts = 0;
 	std::string write_out = "";
 	vertex_id_t id = INVALID_VERTEX_ID;
+	size_t num_para_bfs = 64;
 
-	while ((opt = getopt(argc, argv, "w:s:")) != -1) {
+	while ((opt = getopt(argc, argv, "w:s:p:")) != -1) {
 		num_opts++;
 		switch (opt) {
 			case 'w':
@@ -499,6 +642,9 @@ void run_betweenness_centrality(FG_graph::ptr graph, int argc, char* argv[])
 			case 's':
 				id = atol(optarg);
 				break;
+			case 'p':
+				num_para_bfs = atol(optarg);
+				break;
 			default:
 				print_usage();
 				assert(0);
@@ -515,11 +661,129 @@ void run_betweenness_centrality(FG_graph::ptr graph, int argc, char* argv[])
 		ids.push_back(id);
 	}
 
-	FG_vector<float>::ptr btwn_v = compute_betweenness_centrality(graph, ids);
+	FG_vector<float>::ptr btwn_v = compute_betweenness_centrality(graph,
+			ids, num_para_bfs);
 	if (!write_out.empty() && btwn_v)
 		btwn_v->to_file(write_out);
 }
 
+void run_closeness_centrality(FG_graph::ptr graph, int argc, char* argv[])
+{
+	int opt;
+	int num_opts = 0;
+	std::string write_out = "";
+	vertex_id_t id = INVALID_VERTEX_ID;
+	size_t num_para_bfs = 64;
+	edge_type edge = edge_type::OUT_EDGE;
+	std::string edge_type_str;
+
+	while ((opt = getopt(argc, argv, "w:s:p:e:")) != -1) {
+		num_opts++;
+		switch (opt) {
+			case 'w':
+				write_out = optarg;
+				break;
+			case 's':
+				id = atol(optarg);
+				break;
+			case 'p':
+				num_para_bfs = atol(optarg);
+				break;
+			case 'e':
+				edge_type_str = optarg;
+				break;
+			default:
+				print_usage();
+				assert(0);
+		}
+	}
+
+	if (!edge_type_str.empty()) {
+		if (edge_type_str == "IN")
+			edge = edge_type::IN_EDGE;
+		else if (edge_type_str == "OUT")
+			edge = edge_type::OUT_EDGE;
+		else if (edge_type_str == "BOTH")
+			edge = edge_type::BOTH_EDGES;
+		else {
+			fprintf(stderr, "wrong edge type");
+			exit(1);
+		}
+	}
+
+	std::vector<vertex_id_t> ids;
+	if (id == INVALID_VERTEX_ID) {
+		for (vertex_id_t id = 0; id < graph->get_graph_header().get_num_vertices(); id++) {
+			ids.push_back(id);
+		}
+	} else {
+		ids.push_back(id);
+	}
+
+	FG_vector<float>::ptr closeness = compute_closeness_centrality(graph,
+			ids, edge, num_para_bfs);
+	if (!write_out.empty() && closeness)
+		closeness->to_file(write_out);
+}
+
+void run_sssp(FG_graph::ptr graph, int argc, char* argv[])
+{
+	int opt;
+	int num_opts = 0;
+	std::string write_out = "";
+	vertex_id_t id = 0;
+	edge_type edge = edge_type::OUT_EDGE;
+	std::string edge_type_str;
+	std::string weight_type = "F";
+	double delta = 1;
+	bool async = false;
+
+	while ((opt = getopt(argc, argv, "w:s:e:t:d:a")) != -1) {
+		num_opts++;
+		switch (opt) {
+			case 'w':
+				write_out = optarg;
+				break;
+			case 's':
+				id = atol(optarg);
+				break;
+			case 'e':
+				edge_type_str = optarg;
+				break;
+			case 't':
+				weight_type = optarg;
+				break;
+			case 'd':
+				delta = atof(optarg);
+				break;
+			case 'a':
+				async = true;
+				break;
+			default:
+				print_usage();
+				assert(0);
+		}
+	}
+
+	if (!edge_type_str.empty()) {
+		if (edge_type_str == "IN")
+			edge = edge_type::IN_EDGE;
+		else if (edge_type_str == "OUT")
+			edge = edge_type::OUT_EDGE;
+		else if (edge_type_str == "BOTH")
+			edge = edge_type::BOTH_EDGES;
+		else {
+			fprintf(stderr, "wrong edge type");
+			exit(1);
+		}
+	}
+
+	FG_vector<double>::ptr dists = compute_sssp(graph, id, edge, weight_type,
+			delta, async);
+	if (!write_out.empty() && dists)
+		dists->to_file(write_out);
+}
+
 int read_vertices(const std::string &file, std::vector<vertex_id_t> &vertices)
 {
 	FILE *f = fopen(file.c_str(), "r");
@@ -600,9 +864,11 @@ void run_bfs(FG_graph::ptr graph, int argc, char* argv[])
 	int num_opts = 0;
 	edge_type edge = edge_type::OUT_EDGE;
 	vertex_id_t start_vertex = 0;
+	int num_queries = 0;
+	bool edge_map = false;
 
 	std::string edge_type_str;
-	while ((opt = getopt(argc, argv, "e:s:")) != -1) {
+	while ((opt = getopt(argc, argv, "e:s:n:m")) != -1) {
 		num_opts++;
 		switch (opt) {
 			case 'e':
@@ -613,6 +879,13 @@ void run_bfs(FG_graph::ptr graph, int argc, char* argv[])
 				start_vertex = atol(optarg);
 				num_opts++;
 				break;
+			case 'n':
+				num_queries = atoi(optarg);
+				num_opts++;
+				break;
+			case 'm':
+				edge_map = true;
+				break;
 			default:
 				print_usage();
 				abort();
@@ -631,8 +904,32 @@ void run_bfs(FG_graph::ptr graph, int argc, char* argv[])
 		}
 	}
 
+	if (num_queries > 0) {
+		std::vector<size_t> multi_bfs(FG_graph::ptr fg,
+				const std::vector<vertex_id_t> &start_vertices, edge_type);
+		std::vector<vertex_id_t> start_vertices;
+		for (int i = 0; i < num_queries; i++)
+			start_vertices.push_back((start_vertex + i)
+					% graph->get_graph_header().get_num_vertices());
+		struct timeval start, end;
+		gettimeofday(&start, NULL);
+		std::vector<size_t> num_vertices = multi_bfs(graph, start_vertices,
+				edge);
+		gettimeofday(&end, NULL);
+		for (size_t i = 0; i < num_vertices.size(); i++)
+			printf("BFS from v%u traverses %ld vertices on edge type %d\n",
+					start_vertices[i], num_vertices[i], edge);
+		printf("%d BFS take %f seconds\n", num_queries, time_diff(start, end));
+		return;
+	}
+
 	size_t bfs(FG_graph::ptr fg, vertex_id_t start_vertex, edge_type);
-	size_t num_vertices = bfs(graph, start_vertex, edge);
+	size_t bfs_edge_map(FG_graph::ptr fg, vertex_id_t start_vertex, edge_type);
+	size_t num_vertices;
+	if (edge_map)
+		num_vertices = bfs_edge_map(graph, start_vertex, edge);
+	else
+		num_vertices = bfs(graph, start_vertex, edge);
 	printf("BFS from v%u traverses %ld vertices on edge type %d\n",
 			start_vertex, num_vertices, edge);
 }
@@ -666,21 +963,31 @@ void run_louvain(FG_graph::ptr graph, int argc, char* argv[])
 {
 	int opt;
 	int num_opts = 0;
-	uint32_t levels = 1;
+	uint32_t levels = 10;
+	int max_iters = 30;
 
-	while ((opt = getopt(argc, argv, "l:")) != -1) {
+	while ((opt = getopt(argc, argv, "l:i:")) != -1) {
 		num_opts++;
 		switch (opt) {
 			case 'l':
 				levels = atoi(optarg);
 				break;
+			case 'i':
+				max_iters = atoi(optarg);
+				break;
 			default:
 				print_usage();
 				assert(0);
 		}
 	}
 
-	compute_louvain(graph, levels);
+	FG_vector<vertex_id_t>::ptr comms = compute_louvain(graph, levels,
+			max_iters);
+	count_map<vertex_id_t> map;
+	comms->count_unique(map);
+	printf("There are %ld communities\n", map.get_size());
+	std::pair<vertex_id_t, size_t> max_comm = map.get_max_count();
+	printf("The largest community has %ld vertices\n", max_comm.second);
 }
 
 void run_sem_kmeans(FG_graph::ptr graph, int argc, char *argv[])
@@ -732,6 +1039,8 @@ std::string supported_algs[] = {
 	"ts_wcc",
 	"kcore",
 	"betweenness",
+	"closeness",
+	"sssp",
 	"overlap",
 	"bfs",
 	"spmv",
@@ -746,6 +1055,12 @@ void print_usage()
 			"test_algs conf_file graph_file index_file algorithm [alg-options]\n");
 	fprintf(stderr, "scan-statistics:\n");
 	fprintf(stderr, "-K topK: topK vertices in topK scan\n");
+	fprintf(stderr, "-c num: estimate the scan of num vertices with the largest degree\n");
+	fprintf(stderr, "-w num: the number of sampled wedges per vertex in estimation\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "triangle\n");
+	fprintf(stderr, "-r rate: estimate triangles on the vertices sampled with the rate\n");
+	fprintf(stderr, "-w num: the number of sampled wedges per vertex in estimation\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "local scan\n");
 	fprintf(stderr, "-H hops: local scan within the specified number of hops\n");
@@ -758,6 +1073,8 @@ void print_usage()
 	fprintf(stderr, "pagerank\n");
 	fprintf(stderr, "-i num: the maximum number of iterations\n");
 	fprintf(stderr, "-D v: damping factor\n");
+	fprintf(stderr, "-a: run pagerank2 asynchronously\n");
+	fprintf(stderr, "-m: run pagerank2 with edge_map\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "sstsg\n");
 	fprintf(stderr, "-n num: the number of time intervals\n");
@@ -765,6 +1082,7 @@ void print_usage()
 	fprintf(stderr, "-o output: the output file\n");
 	fprintf(stderr, "-t time: the start time\n");
 	fprintf(stderr, "-l time: the length of time interval\n");
+	fprintf(stderr, "-i file: the temporal index file (built if it doesn't exist)\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "ts_wcc\n");
 	fprintf(stderr, "-u unit: time unit (hour, day, month, etc)\n");
@@ -779,12 +1097,33 @@ void print_usage()
 	fprintf(stderr, "betweenness\n");
 	fprintf(stderr, "-w output: the file name for a vector written to file\n");
 	fprintf(stderr, "-s vertex id: the vertex where BC starts. (Default runs all)\n");
+	fprintf(stderr, "-p num_para_bfs: the number of parallel bfs (1-512)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "closeness\n");
+	fprintf(stderr, "-w output: the file name for a vector written to file\n");
+	fprintf(stderr, "-s vertex id: the vertex to compute. (Default runs all)\n");
+	fprintf(stderr, "-p num_para_bfs: the number of parallel bfs (1-512)\n");
+	fprintf(stderr, "-e edge type: the type of edge to traverse (IN, OUT, BOTH)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "sssp\n");
+	fprintf(stderr, "-w output: the file name for a vector written to file\n");
+	fprintf(stderr, "-s vertex id: the vertex where the shortest paths start\n");
+	fprintf(stderr, "-e edge type: the type of edge to traverse (IN, OUT, BOTH)\n");
+	fprintf(stderr, "-t type: the type of edge weights (I, L, F, D)\n");
+	fprintf(stderr, "-d delta: the width of a bucket in delta-stepping\n");
+	fprintf(stderr, "-a: run sssp on the asynchronous graph engine\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "cycle_triangle\n");
 	fprintf(stderr, "-f: run the fast implementation\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "wcc\n");
 	fprintf(stderr, "-s: run wcc synchronously\n");
+	fprintf(stderr, "-a: run wcc on the asynchronous graph engine\n");
+	fprintf(stderr, "-f: run wcc with Afforest\n");
+	fprintf(stderr, "-c: compare the run time of sync and async wcc\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "scc\n");
+	fprintf(stderr, "-g: only compute the giant SCC\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "overlap vertex_file\n");
 	fprintf(stderr, "-o output: the output file\n");
@@ -793,12 +1132,15 @@ void print_usage()
 	fprintf(stderr, "bfs\n");
 	fprintf(stderr, "-e edge type: the type of edge to traverse (IN, OUT, BOTH)\n");
 	fprintf(stderr, "-s vertex id: the vertex where the BFS starts\n");
+	fprintf(stderr, "-n num: run num BFS from consecutive vertices in the multi-query engine\n");
+	fprintf(stderr, "-m: run BFS with edge_map\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "spmv\n");
 	fprintf(stderr, "-t: transpose the sparse matrix.\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "louvain\n");
-	fprintf(stderr, "-l: how many levels in the hierarchy to compute\n");
+	fprintf(stderr, "-l: the max number of levels in the hierarchy to compute\n");
+	fprintf(stderr, "-i: the max number of iterations in a level\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "sem_kmeans\n");
 	fprintf(stderr, "-k: the number of clusters to use\n");
@@ -888,6 +1230,12 @@ int main(int argc, char *argv[])
 	else if (alg == "betweenness") {
 		run_betweenness_centrality(graph, argc, argv);
 	}
+	else if (alg == "closeness") {
+		run_closeness_centrality(graph, argc, argv);
+	}
+	else if (alg == "sssp") {
+		run_sssp(graph, argc, argv);
+	}
 	else if (alg == "overlap") {
 		run_overlap(graph, argc, argv);
 	}
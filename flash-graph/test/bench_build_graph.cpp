@@ -0,0 +1,92 @@
+/**
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * This benchmarks the external-memory graph construction with different
+ * numbers of threads on a random edge list. It reports the throughput
+ * of each stage in edges per second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <string>
+#include <vector>
+
+#include "graph_builder.h"
+
+using namespace fg;
+
+void gen_edge_list(const std::string &file, size_t num_vertices,
+		size_t num_edges)
+{
+	FILE *f = fopen(file.c_str(), "w");
+	assert(f);
+	for (size_t i = 0; i < num_edges; i++)
+		fprintf(f, "%ld\t%ld\n", random() % num_vertices,
+				random() % num_vertices);
+	fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4) {
+		fprintf(stderr,
+				"bench_build_graph num_vertices num_edges mem_size(MB) [tmp_dir]\n");
+		return -1;
+	}
+	size_t num_vertices = atol(argv[1]);
+	size_t num_edges = atol(argv[2]);
+	size_t mem_size = atol(argv[3]) * 1024 * 1024;
+	std::string tmp_dir = argc > 4 ? argv[4] : ".";
+
+	std::string edge_file = tmp_dir + "/bench_build_graph.txt";
+	std::string adj_file = tmp_dir + "/bench_build_graph.adj";
+	std::string index_file = tmp_dir + "/bench_build_graph.index";
+	gen_edge_list(edge_file, num_vertices, num_edges);
+
+	int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+		for (int directed = 1; directed >= 0; directed--) {
+			utils::ext_mem_graph_builder::options opts;
+			opts.directed = directed;
+			opts.dedup = true;
+			opts.num_threads = num_threads;
+			opts.mem_size = mem_size;
+			opts.tmp_dir = tmp_dir;
+			std::vector<std::string> files(1, edge_file);
+			utils::ext_mem_graph_builder::stats stats
+				= utils::ext_mem_graph_builder::build(files, adj_file,
+						index_file, opts);
+			printf("%d threads, %s, %ld runs, %d merge passes:\n", num_threads,
+					directed ? "directed" : "undirected", stats.num_runs,
+					stats.num_merge_passes);
+			printf("\tparse: %.0f edges/s, merge: %.0f edges/s, write: %.0f edges/s, total: %.0f edges/s\n",
+					num_edges / stats.parse_time,
+					stats.num_merge_passes > 0 ? num_edges / stats.merge_time : 0,
+					num_edges / stats.write_time,
+					num_edges / stats.get_tot_time());
+		}
+	}
+	unlink(edge_file.c_str());
+	unlink(adj_file.c_str());
+	unlink(index_file.c_str());
+}
@@ -0,0 +1,167 @@
+/**
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * This benchmarks the intersection kernels of sorted neighbor lists against
+ * the algorithm used by triangle counting before, which uses a hash table
+ * for hub vertices, binary search for skewed lists and the scalar merge
+ * otherwise.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+
+#include "set_intersect.h"
+
+using namespace fg;
+
+const double BIN_SEARCH_RATIO = 100;
+const size_t HASH_SEARCH_RATIO = 16;
+const size_t hash_threshold = 1000;
+
+class match_counter
+{
+	size_t num;
+public:
+	match_counter() {
+		num = 0;
+	}
+
+	void operator()(size_t i, size_t j) {
+		num++;
+	}
+
+	size_t get_num() const {
+		return num;
+	}
+};
+
+/*
+ * The intersection in triangle counting before the intersection kernels.
+ */
+size_t baseline_intersect(const std::vector<vertex_id_t> &a,
+		const std::unordered_set<vertex_id_t> &a_set,
+		const vertex_id_t *b, size_t num_b)
+{
+	size_t num = 0;
+	if (!a_set.empty() && a.size() > HASH_SEARCH_RATIO * num_b) {
+		for (size_t j = 0; j < num_b; j++)
+			if (a_set.find(b[j]) != a_set.end())
+				num++;
+	}
+	else if (num_b / a.size() > BIN_SEARCH_RATIO) {
+		const vertex_id_t *end = b + num_b;
+		for (int i = a.size() - 1; i >= 0; i--) {
+			const vertex_id_t *first = std::lower_bound(b, end, a[i]);
+			if (first != end && *first == a[i])
+				num++;
+			end = first;
+		}
+	}
+	else {
+		size_t i = 0, j = 0;
+		while (i < a.size() && j < num_b) {
+			if (a[i] == b[j]) {
+				num++;
+				i++;
+				j++;
+			}
+			else if (a[i] < b[j])
+				i++;
+			else
+				j++;
+		}
+	}
+	return num;
+}
+
+void gen_sorted(size_t num, size_t range, std::vector<vertex_id_t> &arr)
+{
+	arr.clear();
+	for (size_t i = 0; i < num; i++)
+		arr.push_back(random() % range);
+	std::sort(arr.begin(), arr.end());
+	arr.resize(std::unique(arr.begin(), arr.end()) - arr.begin());
+}
+
+/*
+ * Intersect a list with `num_a' elements with many lists with `num_b'
+ * elements, which is what a vertex does in triangle counting.
+ */
+void run_bench(size_t num_a, size_t num_b, size_t range, size_t num_lists)
+{
+	std::vector<vertex_id_t> a;
+	gen_sorted(num_a, range, a);
+	std::unordered_set<vertex_id_t> a_set;
+	if (a.size() > hash_threshold)
+		a_set.insert(a.begin(), a.end());
+	sorted_id_set set;
+	set.init(a.data(), a.size(), a.size() > hash_threshold);
+
+	std::vector<std::vector<vertex_id_t> > lists(num_lists);
+	for (size_t i = 0; i < num_lists; i++)
+		gen_sorted(num_b, range, lists[i]);
+
+	printf("%ld x %ld in [0, %ld):\n", a.size(), lists[0].size(), range);
+	struct timeval start, end;
+	size_t expected = 0;
+	gettimeofday(&start, NULL);
+	for (size_t i = 0; i < num_lists; i++)
+		expected += baseline_intersect(a, a_set, lists[i].data(),
+				lists[i].size());
+	gettimeofday(&end, NULL);
+	float base_time = time_diff(start, end);
+	printf("\tbaseline: %.3fs\n", base_time);
+
+	const char *names[] = {"auto", "merge", "SIMD", "gallop", "bitmap"};
+	intersect_method methods[] = {INTERSECT_AUTO, INTERSECT_MERGE,
+		INTERSECT_SIMD, INTERSECT_GALLOP, INTERSECT_BITMAP};
+	for (size_t k = 0; k < sizeof(methods) / sizeof(methods[0]); k++) {
+		if (methods[k] == INTERSECT_BITMAP && !set.has_index())
+			continue;
+		match_counter counter;
+		gettimeofday(&start, NULL);
+		for (size_t i = 0; i < num_lists; i++)
+			intersect(methods[k], set, lists[i].data(), lists[i].size(),
+					counter);
+		gettimeofday(&end, NULL);
+		float t = time_diff(start, end);
+		printf("\t%s: %.3fs (%.2fx)%s\n", names[k], t, base_time / t,
+				counter.get_num() == expected ? "" : " WRONG RESULT");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const char *levels[] = {"none", "AVX2", "AVX-512"};
+	printf("SIMD: %s\n", levels[get_simd_level()]);
+	// Lists of similar sizes.
+	run_bench(1000, 1000, 10000, 10000);
+	run_bench(200, 200, 100000, 100000);
+	// A hub vertex with small neighbors.
+	run_bench(100000, 500, 1000000, 10000);
+	run_bench(100000, 50, 10000000, 100000);
+	// A small vertex with hub neighbors.
+	run_bench(50, 20000, 1000000, 10000);
+}
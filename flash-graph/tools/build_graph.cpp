@@ -0,0 +1,106 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "graph_builder.h"
+
+using namespace fg;
+
+void print_usage()
+{
+	fprintf(stderr,
+			"build_graph [options] adj_list_file index_file edge_list_files\n");
+	fprintf(stderr, "-u: undirected graph\n");
+	fprintf(stderr, "-U: remove duplicated edges\n");
+	fprintf(stderr, "-s: remove self edges\n");
+	fprintf(stderr, "-t type: the type of edge attributes (I, L, F, D)\n");
+	fprintf(stderr, "-T num: the number of threads\n");
+	fprintf(stderr, "-m size: the memory size (in MB) for buffering edges\n");
+	fprintf(stderr, "-d dir: the directory for the temporary files\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	int num_opts = 0;
+	utils::ext_mem_graph_builder::options opts;
+	while ((opt = getopt(argc, argv, "uUst:T:m:d:")) != -1) {
+		num_opts++;
+		switch (opt) {
+			case 'u':
+				opts.directed = false;
+				break;
+			case 'U':
+				opts.dedup = true;
+				break;
+			case 's':
+				opts.remove_self_edges = true;
+				break;
+			case 't':
+				opts.attr_type = optarg;
+				num_opts++;
+				break;
+			case 'T':
+				opts.num_threads = atoi(optarg);
+				num_opts++;
+				break;
+			case 'm':
+				opts.mem_size = atol(optarg) * 1024 * 1024;
+				num_opts++;
+				break;
+			case 'd':
+				opts.tmp_dir = optarg;
+				num_opts++;
+				break;
+			default:
+				print_usage();
+				exit(-1);
+		}
+	}
+	argv += 1 + num_opts;
+	argc -= 1 + num_opts;
+
+	if (argc < 3) {
+		print_usage();
+		exit(-1);
+	}
+
+	std::string adj_file = argv[0];
+	std::string index_file = argv[1];
+	std::vector<std::string> files;
+	for (int i = 2; i < argc; i++)
+		files.push_back(argv[i]);
+
+	utils::ext_mem_graph_builder::stats stats
+		= utils::ext_mem_graph_builder::build(files, adj_file, index_file, opts);
+	printf("%s graph has %ld vertices and %ld edges (%ld edges in the input)\n",
+			opts.directed ? "directed" : "undirected", stats.num_vertices,
+			stats.num_edges, stats.num_input_edges);
+	printf("%ld runs, %d merge passes\n", stats.num_runs,
+			stats.num_merge_passes);
+	printf("parse: %.3fs, merge: %.3fs, write: %.3fs\n", stats.parse_time,
+			stats.merge_time, stats.write_time);
+	printf("%.0f edges/s\n", stats.num_input_edges / stats.get_tot_time());
+}
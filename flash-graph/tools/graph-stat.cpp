@@ -165,13 +165,16 @@ int main(int argc, char *argv[])
 		if (on_ts) {
 			if (print_ts_all) {
 				std::pair<time_t, time_t> range = get_time_range(fg);
+				// Most vertices don't have edges in a time interval, so
+				// the temporal index saves reading them in each interval.
+				ts_vertex_index::ptr ts_index = build_ts_vertex_index(fg);
 				for (start_time = range.first; start_time < range.second;
 						start_time += time_interval) {
 					printf("start time: %ld\n", start_time);
 					in_degrees = get_ts_degree(fg, IN_EDGE, start_time,
-							time_interval);
+							time_interval, ts_index);
 					out_degrees = get_ts_degree(fg, OUT_EDGE, start_time,
-							time_interval);
+							time_interval, ts_index);
 					print_directed(in_degrees, out_degrees);
 				}
 			}
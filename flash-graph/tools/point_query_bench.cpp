@@ -0,0 +1,239 @@
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <omp.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "graph_engine.h"
+#include "graph_config.h"
+#include "point_query.h"
+#include "FGlib.h"
+
+using namespace fg;
+
+void print_usage()
+{
+	fprintf(stderr,
+			"point_query_bench [options] conf_file graph_file index_file\n");
+	fprintf(stderr, "-q query: the type of queries (khop, sample, ppr)\n");
+	fprintf(stderr, "-n num: the number of queries run by each thread\n");
+	fprintf(stderr, "-T num: the number of threads that issue queries\n");
+	fprintf(stderr, "-k hops: the number of hops in khop\n");
+	fprintf(stderr, "-m num: the max number of vertices reached by khop\n");
+	fprintf(stderr, "-f fanouts: the fanouts of the hops in sample, e.g., 10,5\n");
+	fprintf(stderr, "-a alpha: the teleport probability in ppr\n");
+	fprintf(stderr, "-e epsilon: the residual threshold in ppr\n");
+	fprintf(stderr, "-E type: the type of edges (in, out, both)\n");
+	fprintf(stderr, "-s seed: the seed of the random number generator\n");
+}
+
+std::vector<size_t> parse_fanouts(const std::string &str)
+{
+	std::vector<size_t> fanouts;
+	size_t start = 0;
+	while (start < str.size()) {
+		size_t end = str.find(',', start);
+		if (end == std::string::npos)
+			end = str.size();
+		fanouts.push_back(atol(str.substr(start, end - start).c_str()));
+		start = end + 1;
+	}
+	return fanouts;
+}
+
+/*
+ * Pick a random vertex with edges as the source of a query.
+ */
+vertex_id_t get_rand_vertex(const point_query_engine &engine, edge_type type,
+		unsigned int &seed)
+{
+	size_t num_vertices = engine.get_graph_header().get_num_vertices();
+	vertex_id_t id = 0;
+	for (int i = 0; i < 100; i++) {
+		id = (((size_t) rand_r(&seed)) * RAND_MAX + rand_r(&seed)) % num_vertices;
+		if (engine.get_num_edges(id, type) > 0)
+			break;
+	}
+	return id;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	int num_opts = 0;
+	std::string query = "khop";
+	size_t num_queries = 1000;
+	int num_threads = 1;
+	int k = 2;
+	size_t max_vertices = std::numeric_limits<size_t>::max();
+	std::string fanout_str = "10,5";
+	double alpha = 0.15;
+	double epsilon = 1e-6;
+	std::string edge_type_str;
+	unsigned int seed = 0;
+	while ((opt = getopt(argc, argv, "q:n:T:k:m:f:a:e:E:s:")) != -1) {
+		num_opts++;
+		switch (opt) {
+			case 'q':
+				query = optarg;
+				num_opts++;
+				break;
+			case 'n':
+				num_queries = atol(optarg);
+				num_opts++;
+				break;
+			case 'T':
+				num_threads = atoi(optarg);
+				num_opts++;
+				break;
+			case 'k':
+				k = atoi(optarg);
+				num_opts++;
+				break;
+			case 'm':
+				max_vertices = atol(optarg);
+				num_opts++;
+				break;
+			case 'f':
+				fanout_str = optarg;
+				num_opts++;
+				break;
+			case 'a':
+				alpha = atof(optarg);
+				num_opts++;
+				break;
+			case 'e':
+				epsilon = atof(optarg);
+				num_opts++;
+				break;
+			case 'E':
+				edge_type_str = optarg;
+				num_opts++;
+				break;
+			case 's':
+				seed = atoi(optarg);
+				num_opts++;
+				break;
+			default:
+				print_usage();
+		}
+	}
+	argv += 1 + num_opts;
+	argc -= 1 + num_opts;
+
+	if (argc < 3) {
+		print_usage();
+		exit(-1);
+	}
+	if (query != "khop" && query != "sample" && query != "ppr") {
+		fprintf(stderr, "wrong query type: %s\n", query.c_str());
+		print_usage();
+		exit(-1);
+	}
+
+	std::string conf_file = argv[0];
+	std::string graph_file = argv[1];
+	std::string index_file = argv[2];
+
+	config_map::ptr configs = config_map::create(conf_file);
+	assert(configs);
+	graph_engine::init_flash_graph(configs);
+
+	FG_graph::ptr fg = FG_graph::create(graph_file, index_file, configs);
+	point_query_engine::ptr engine = point_query_engine::create(fg);
+
+	edge_type type = engine->is_directed() ? edge_type::OUT_EDGE
+		: edge_type::BOTH_EDGES;
+	if (edge_type_str == "in")
+		type = edge_type::IN_EDGE;
+	else if (edge_type_str == "out")
+		type = edge_type::OUT_EDGE;
+	else if (edge_type_str == "both")
+		type = edge_type::BOTH_EDGES;
+	std::vector<size_t> fanouts = parse_fanouts(fanout_str);
+
+	// Latencies in microseconds.
+	std::vector<long> latencies(num_queries * num_threads);
+	std::vector<size_t> num_results(num_threads);
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+#pragma omp parallel num_threads(num_threads)
+	{
+		int thread_id = omp_get_thread_num();
+		unsigned int thread_seed = seed + thread_id;
+		point_query_session::ptr session = engine->create_session();
+		session->set_seed(thread_seed);
+		std::vector<vertex_id_t> vertices;
+		std::vector<std::pair<vertex_id_t, vertex_id_t> > edges;
+		std::vector<std::pair<vertex_id_t, double> > scores;
+		for (size_t i = 0; i < num_queries; i++) {
+			vertex_id_t id = get_rand_vertex(*engine, type, thread_seed);
+			struct timeval query_start, query_end;
+			gettimeofday(&query_start, NULL);
+			if (query == "khop") {
+				session->k_hop(id, k, type, vertices, max_vertices);
+				num_results[thread_id] += vertices.size();
+			}
+			else if (query == "sample") {
+				session->sample_neighbors(std::vector<vertex_id_t>(1, id),
+						fanouts, type, edges);
+				num_results[thread_id] += edges.size();
+			}
+			else {
+				session->personalized_pagerank(id, type, alpha, epsilon,
+						scores);
+				num_results[thread_id] += scores.size();
+			}
+			gettimeofday(&query_end, NULL);
+			latencies[thread_id * num_queries + i] = time_diff_us(query_start,
+					query_end);
+		}
+	}
+	gettimeofday(&end, NULL);
+
+	size_t tot_queries = latencies.size();
+	size_t tot_results = 0;
+	for (int i = 0; i < num_threads; i++)
+		tot_results += num_results[i];
+	if (tot_queries > 0) {
+		std::sort(latencies.begin(), latencies.end());
+		long tot_latency = 0;
+		for (size_t i = 0; i < tot_queries; i++)
+			tot_latency += latencies[i];
+		printf("%ld %s queries in %f seconds, %f queries/s\n", tot_queries,
+				query.c_str(), time_diff(start, end),
+				tot_queries / time_diff(start, end));
+		printf("avg results per query: %f\n", ((double) tot_results) / tot_queries);
+		printf("latency (us): avg: %ld, p50: %ld, p99: %ld, max: %ld\n",
+				tot_latency / tot_queries, latencies[tot_queries / 2],
+				latencies[std::min(tot_queries - 1, tot_queries * 99 / 100)],
+				latencies.back());
+	}
+
+	engine.reset();
+	fg.reset();
+	graph_engine::destroy_flash_graph();
+}
@@ -17,29 +17,197 @@
  * limitations under the License.
  */
 
+#include <stdio.h>
+
+#include <boost/format.hpp>
+
 #include "ts_graph.h"
+#include "safs_exception.h"
+#include "graph_exception.h"
 
 namespace fg
 {
 
+const size_t ts_vertex_index::INTERVAL;
+
+void ts_vertex_index::init_locs()
+{
+	locs.resize(num_edges.size());
+	size_t loc = 0;
+	for (size_t i = 0; i < num_edges.size(); i++) {
+		locs[i] = loc;
+		loc += get_num_samples(num_edges[i]);
+	}
+	timestamps.resize(loc);
+}
+
+ts_vertex_index::ptr ts_vertex_index::create(size_t num_vertices,
+		const vsize_t num_in_edges[], const vsize_t num_out_edges[])
+{
+	ptr index(new ts_vertex_index());
+	index->num_vertices = num_vertices;
+	index->num_edges.resize(num_vertices * 2);
+	for (size_t i = 0; i < num_vertices; i++) {
+		index->num_edges[i * 2] = num_in_edges[i];
+		index->num_edges[i * 2 + 1] = num_out_edges[i];
+	}
+	index->init_locs();
+	return index;
+}
+
+/*
+ * The file has the number of vertices, the sample interval, the number of
+ * edges of all vertices and then the timestamps.
+ */
+ts_vertex_index::ptr ts_vertex_index::load(const std::string &file)
+{
+	FILE *f = fopen(file.c_str(), "r");
+	if (f == NULL)
+		throw safs::io_exception(std::string("can't open ") + file);
+	ptr index(new ts_vertex_index());
+	size_t interval = 0;
+	if (fread(&index->num_vertices, sizeof(size_t), 1, f) != 1
+			|| fread(&interval, sizeof(size_t), 1, f) != 1) {
+		fclose(f);
+		throw wrong_format("the temporal index is smaller than expected");
+	}
+	if (interval != INTERVAL) {
+		fclose(f);
+		throw wrong_format(boost::str(boost::format(
+						"the temporal index has interval %1%, expect %2%")
+					% interval % INTERVAL));
+	}
+	index->num_edges.resize(index->num_vertices * 2);
+	if (!index->num_edges.empty() && fread(index->num_edges.data(),
+				sizeof(vsize_t) * index->num_edges.size(), 1, f) != 1) {
+		fclose(f);
+		throw wrong_format("the temporal index is smaller than expected");
+	}
+	index->init_locs();
+	if (!index->timestamps.empty() && fread(index->timestamps.data(),
+				sizeof(time_t) * index->timestamps.size(), 1, f) != 1) {
+		fclose(f);
+		throw wrong_format("the temporal index is smaller than expected");
+	}
+	fclose(f);
+	return index;
+}
+
+void ts_vertex_index::dump(const std::string &file) const
+{
+	FILE *f = fopen(file.c_str(), "w");
+	if (f == NULL)
+		throw safs::io_exception(std::string("can't open ") + file);
+	size_t interval = INTERVAL;
+	BOOST_VERIFY(fwrite(&num_vertices, sizeof(size_t), 1, f) == 1);
+	BOOST_VERIFY(fwrite(&interval, sizeof(size_t), 1, f) == 1);
+	if (!num_edges.empty())
+		BOOST_VERIFY(fwrite(num_edges.data(),
+					sizeof(vsize_t) * num_edges.size(), 1, f) == 1);
+	if (!timestamps.empty())
+		BOOST_VERIFY(fwrite(timestamps.data(),
+					sizeof(time_t) * timestamps.size(), 1, f) == 1);
+	fclose(f);
+}
+
+ts_vertex_index::edge_range ts_vertex_index::get_edge_range(vertex_id_t id,
+		edge_type type, time_t time_start, time_t time_interval) const
+{
+	size_t idx = id * 2 + get_type_idx(type);
+	vsize_t num = num_edges[idx];
+	if (num == 0)
+		return edge_range(0, 0);
+	// The timestamp of the (i * INTERVAL)-th edge is in samples[i] and
+	// the timestamp of the last edge is in samples[num_samples].
+	const time_t *samples = timestamps.data() + locs[idx];
+	size_t num_samples = get_num_samples(num) - 1;
+	time_t time_end = time_start + time_interval;
+	if (samples[num_samples] < time_start || samples[0] >= time_end)
+		return edge_range(0, 0);
+
+	// All edges before the last sample smaller than `time_start' are
+	// out of the time window.
+	size_t start_idx = std::lower_bound(samples, samples + num_samples,
+			time_start) - samples;
+	size_t start = start_idx == 0 ? 0 : (start_idx - 1) * INTERVAL;
+	// All edges after the first sample not smaller than `time_end' are
+	// out of the time window.
+	size_t end_idx = std::lower_bound(samples, samples + num_samples,
+			time_end) - samples;
+	size_t end = end_idx == num_samples ? num : end_idx * INTERVAL;
+	return edge_range(start, end);
+}
+
+bool ts_vertex_index::get_num_edges(vertex_id_t id, edge_type type,
+		time_t time_start, time_t time_interval, vsize_t &num) const
+{
+	edge_range range = get_edge_range(id, type, time_start, time_interval);
+	if (range.first == range.second) {
+		num = 0;
+		return true;
+	}
+	size_t idx = id * 2 + get_type_idx(type);
+	const time_t *samples = timestamps.data() + locs[idx];
+	size_t num_samples = get_num_samples(num_edges[idx]) - 1;
+	if (samples[0] >= time_start
+			&& samples[num_samples] < time_start + time_interval) {
+		num = num_edges[idx];
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Find the first edge in [first, last) whose timestamp isn't smaller than
+ * `time'. page_byte_array::const_iterator can't move backward, so
+ * std::lower_bound doesn't work on it; we search on the edge indices and
+ * only jump forward from `begin_it' with operator+.
+ */
+static size_t lower_bound_ts(
+		const safs::page_byte_array::const_iterator<ts_edge_data> &begin_it,
+		size_t first, size_t last, time_t time)
+{
+	while (first < last) {
+		size_t mid = first + (last - first) / 2;
+		if ((*(begin_it + mid)).get_timestamp() < time)
+			first = mid + 1;
+		else
+			last = mid;
+	}
+	return first;
+}
+
 edge_seq_iterator get_ts_iterator(const page_directed_vertex &v,
 		edge_type type, time_t time_start, time_t time_interval)
 {
 	safs::page_byte_array::const_iterator<ts_edge_data> begin_it
 		= v.get_data_begin<ts_edge_data>(type);
-	safs::page_byte_array::const_iterator<ts_edge_data> end_it
-		= v.get_data_end<ts_edge_data>(type);
-	safs::page_byte_array::const_iterator<ts_edge_data> ts_it = std::lower_bound(
-			begin_it, end_it, ts_edge_data(time_start));
+	size_t num_edges = v.get_num_edges(type);
+	size_t start = lower_bound_ts(begin_it, 0, num_edges, time_start);
 	// All timestamps are smaller than time_start
-	if (ts_it == end_it)
+	if (start == num_edges)
 		return v.get_neigh_seq_it(type, 0, 0);
-	size_t start = ts_it - begin_it;
 
-	safs::page_byte_array::const_iterator<ts_edge_data> ts_end_it = std::lower_bound(
-			begin_it, end_it, time_start + time_interval);
-	size_t end = ts_end_it - begin_it;
+	size_t end = lower_bound_ts(begin_it, start, num_edges,
+			time_start + time_interval);
+	return v.get_neigh_seq_it(type, start, end);
+}
 
+edge_seq_iterator get_ts_iterator(const page_directed_vertex &v,
+		edge_type type, time_t time_start, time_t time_interval,
+		const ts_vertex_index &index)
+{
+	ts_vertex_index::edge_range range = index.get_edge_range(v.get_id(),
+			type, time_start, time_interval);
+	if (range.first == range.second)
+		return v.get_neigh_seq_it(type, 0, 0);
+
+	safs::page_byte_array::const_iterator<ts_edge_data> begin_it
+		= v.get_data_begin<ts_edge_data>(type);
+	size_t start = lower_bound_ts(begin_it, range.first, range.second,
+			time_start);
+	size_t end = lower_bound_ts(begin_it, start, range.second,
+			time_start + time_interval);
 	return v.get_neigh_seq_it(type, start, end);
 }
 
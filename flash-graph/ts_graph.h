@@ -20,6 +20,9 @@
  * limitations under the License.
  */
 
+#include <memory>
+#include <vector>
+
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include "vertex.h"
@@ -31,8 +34,119 @@ const int HOUR_SECS = 3600;
 const int DAY_SECS = HOUR_SECS * 24;
 const int MONTH_SECS = DAY_SECS * 30;
 
+/*
+ * The temporal index of a time-series graph. The edges of a vertex are
+ * sorted by their timestamps, so for each vertex and each edge type,
+ * we keep the timestamp of every INTERVAL-th edge and of the last edge.
+ * Given a time window, the index bounds the edges in the window to a range
+ * of INTERVAL edges at each end without reading the vertex. In particular,
+ * it tells whether a vertex has any edges in the window at all.
+ */
+class ts_vertex_index
+{
+public:
+	static const size_t INTERVAL = 32;
+private:
+	size_t num_vertices;
+	// The number of in-edges and out-edges of vertex v are in
+	// num_edges[2 * v] and num_edges[2 * v + 1].
+	std::vector<vsize_t> num_edges;
+	// The timestamps of a vertex start at locs[2 * v] for in-edges and at
+	// locs[2 * v + 1] for out-edges in `timestamps'.
+	std::vector<size_t> locs;
+	std::vector<time_t> timestamps;
+
+	static size_t get_num_samples(vsize_t num_edges) {
+		return num_edges == 0 ? 0 : (num_edges + INTERVAL - 1) / INTERVAL + 1;
+	}
+
+	static int get_type_idx(edge_type type) {
+		assert(type == IN_EDGE || type == OUT_EDGE);
+		return type == IN_EDGE ? 0 : 1;
+	}
+
+	void init_locs();
+public:
+	typedef std::shared_ptr<ts_vertex_index> ptr;
+	typedef std::pair<size_t, size_t> edge_range;
+
+	/*
+	 * Create an empty index for the vertices with the specified number
+	 * of in-edges and out-edges. The timestamps of each vertex are
+	 * added with `set_timestamps'.
+	 */
+	static ptr create(size_t num_vertices, const vsize_t num_in_edges[],
+			const vsize_t num_out_edges[]);
+	static ptr load(const std::string &file);
+	void dump(const std::string &file) const;
+
+	/*
+	 * Add the timestamps of the edges of a vertex. `it' iterates over
+	 * the timestamps of all edges of the vertex in the specified type.
+	 * Different threads can add the timestamps of different vertices
+	 * at the same time.
+	 */
+	template<class Iterator>
+	void set_timestamps(vertex_id_t id, edge_type type, Iterator it) {
+		size_t idx = id * 2 + get_type_idx(type);
+		vsize_t num = num_edges[idx];
+		if (num == 0)
+			return;
+		time_t *samples = timestamps.data() + locs[idx];
+		time_t last = 0;
+		for (vsize_t i = 0; i < num; i++, ++it) {
+			last = (*it).get_timestamp();
+			if (i % INTERVAL == 0)
+				*(samples++) = last;
+		}
+		*samples = last;
+	}
+
+	size_t get_num_vertices() const {
+		return num_vertices;
+	}
+
+	vsize_t get_num_edges(vertex_id_t id, edge_type type) const {
+		return num_edges[id * 2 + get_type_idx(type)];
+	}
+
+	/*
+	 * Get the range of edges of a vertex that contains all edges whose
+	 * timestamps are in [time_start, time_start + time_interval).
+	 * The range is empty if the vertex has no edges in the time window.
+	 */
+	edge_range get_edge_range(vertex_id_t id, edge_type type,
+			time_t time_start, time_t time_interval) const;
+
+	bool has_edges(vertex_id_t id, edge_type type, time_t time_start,
+			time_t time_interval) const {
+		edge_range range = get_edge_range(id, type, time_start, time_interval);
+		return range.first < range.second;
+	}
+
+	/*
+	 * Get the number of edges of a vertex in the time window if it can be
+	 * decided by the index alone, i.e., the vertex has no edges or all of
+	 * its edges in the time window.
+	 */
+	bool get_num_edges(vertex_id_t id, edge_type type, time_t time_start,
+			time_t time_interval, vsize_t &num) const;
+
+	size_t get_mem_size() const {
+		return num_edges.capacity() * sizeof(vsize_t)
+			+ locs.capacity() * sizeof(size_t)
+			+ timestamps.capacity() * sizeof(time_t);
+	}
+};
+
 edge_seq_iterator get_ts_iterator(const page_directed_vertex &v,
 		edge_type type, time_t time_start, time_t time_interval);
+/*
+ * This only searches in the range of edges given by the temporal index.
+ */
+edge_seq_iterator get_ts_iterator(const page_directed_vertex &v,
+		edge_type type, time_t time_start, time_t time_interval,
+		const ts_vertex_index &index);
 
 static inline bool is_time_str(const std::string &str)
 {
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "io_interface.h"
+#include "safs_file.h"
+
+#include "graph_engine.h"
+#include "graph_builder.h"
+#include "checkpoint.h"
+#include "FG_vector.h"
+#include "FGlib.h"
+
+using namespace fg;
+
+const size_t num_vertices = 1000;
+const size_t num_comps = 4;
+const int ckpt_interval = 10;
+const int crash_level = 55;
+// The exit code of the process that dies in the middle of a run.
+const int CRASH_EXIT = 2;
+
+std::string conf_file;
+std::string adj_file = "/tmp/test-checkpoint.adj";
+std::string index_file = "/tmp/test-checkpoint.index";
+std::string ckpt_name;
+
+// The level where the current process dies. It's -1 if it runs to the end.
+int die_level = -1;
+
+class label_message: public vertex_message
+{
+	vertex_id_t label;
+public:
+	label_message(vertex_id_t label): vertex_message(
+			sizeof(label_message), true) {
+		this->label = label;
+	}
+
+	vertex_id_t get_label() const {
+		return label;
+	}
+};
+
+/*
+ * Each vertex takes the smallest label in its component. The labels move
+ * one hop in a level, so a long chain takes many levels.
+ */
+class label_vertex: public compute_directed_vertex
+{
+	bool updated;
+	vertex_id_t label;
+public:
+	label_vertex(vertex_id_t id): compute_directed_vertex(id) {
+		label = id;
+		updated = true;
+	}
+
+	vertex_id_t get_label() const {
+		return label;
+	}
+
+	void run(vertex_program &prog) {
+		if (prog.get_graph().get_curr_level() == die_level)
+			_exit(CRASH_EXIT);
+		if (updated) {
+			vertex_id_t id = prog.get_vertex_id(*this);
+			request_vertices(&id, 1);
+			updated = false;
+		}
+	}
+
+	void run(vertex_program &prog, const page_vertex &vertex) {
+		label_message msg(label);
+		edge_seq_iterator in_it = vertex.get_neigh_seq_it(IN_EDGE);
+		prog.multicast_msg(in_it, msg);
+		edge_seq_iterator out_it = vertex.get_neigh_seq_it(OUT_EDGE);
+		prog.multicast_msg(out_it, msg);
+	}
+
+	void run_on_message(vertex_program &, const vertex_message &msg1) {
+		const label_message &msg = (const label_message &) msg1;
+		if (msg.get_label() < label) {
+			label = msg.get_label();
+			updated = true;
+		}
+	}
+};
+
+class label_query: public vertex_query
+{
+	FG_vector<vertex_id_t>::ptr vec;
+public:
+	label_query(FG_vector<vertex_id_t>::ptr vec) {
+		this->vec = vec;
+	}
+
+	virtual void run(graph_engine &graph, compute_vertex &v1) {
+		label_vertex &v = (label_vertex &) v1;
+		vec->set(graph.get_graph_index().get_vertex_id(v), v.get_label());
+	}
+
+	virtual void merge(graph_engine &graph, vertex_query::ptr q) {
+	}
+
+	virtual ptr clone() {
+		return vertex_query::ptr(new label_query(vec));
+	}
+};
+
+/*
+ * The vertices of a component form a chain in descending order of
+ * their IDs, so the smallest label travels through the whole chain.
+ */
+void create_graph()
+{
+	std::vector<std::vector<vertex_id_t> > in_neighs(num_vertices);
+	std::vector<std::vector<vertex_id_t> > out_neighs(num_vertices);
+	for (vertex_id_t id = num_comps; id < num_vertices; id++) {
+		out_neighs[id].push_back(id - num_comps);
+		in_neighs[id - num_comps].push_back(id);
+	}
+	utils::ext_mem_image_writer writer(adj_file, true, "/tmp");
+	for (vertex_id_t id = 0; id < num_vertices; id++)
+		writer.add_vertex(id, in_neighs[id].data(), in_neighs[id].size(),
+				out_neighs[id].data(), out_neighs[id].size());
+	writer.close(num_vertices, index_file);
+}
+
+FG_graph::ptr init_graph(const std::string &opts)
+{
+	config_map::ptr configs = config_map::create(conf_file);
+	configs->add_options(opts);
+	graph_engine::init_flash_graph(configs);
+	return FG_graph::create(adj_file, index_file, configs);
+}
+
+void save_labels(graph_engine::ptr graph, const std::string &file)
+{
+	FG_vector<vertex_id_t>::ptr vec = FG_vector<vertex_id_t>::create(graph);
+	graph->query_on_all(vertex_query::ptr(new label_query(vec)));
+	FILE *f = fopen(file.c_str(), "w");
+	assert(f);
+	size_t ret = fwrite(vec->get_data(), sizeof(vertex_id_t),
+			vec->get_size(), f);
+	assert(ret == vec->get_size());
+	fclose(f);
+}
+
+std::vector<vertex_id_t> read_labels(const std::string &file)
+{
+	std::vector<vertex_id_t> labels(num_vertices);
+	FILE *f = fopen(file.c_str(), "r");
+	assert(f);
+	size_t ret = fread(labels.data(), sizeof(vertex_id_t), labels.size(), f);
+	assert(ret == labels.size());
+	fclose(f);
+	unlink(file.c_str());
+	return labels;
+}
+
+/*
+ * Remove the metadata file and the partition files in both slots.
+ */
+void delete_checkpoint(const std::string &name, int num_parts)
+{
+	for (int slot = 0; slot < 2; slot++)
+		for (int i = 0; i < num_parts; i++) {
+			safs::safs_file f(safs::get_sys_RAID_conf(),
+					boost::str(boost::format("%1%-%2%-%3%") % name % slot % i));
+			if (f.exist())
+				f.delete_file();
+		}
+	safs::safs_file(safs::get_sys_RAID_conf(), name).delete_file();
+}
+
+void run_labels(const std::string &opts, bool resume, const std::string &out)
+{
+	FG_graph::ptr fg = init_graph(opts);
+	graph_index::ptr index = NUMA_graph_index<label_vertex>::create(
+			fg->get_graph_header());
+	graph_engine::ptr graph = fg->create_engine(index);
+	if (resume) {
+		bool ret = graph->resume();
+		assert(ret);
+	}
+	else
+		graph->start_all();
+	graph->wait4complete();
+	save_labels(graph, out);
+
+	if (resume)
+		delete_checkpoint(ckpt_name, graph->get_num_threads());
+	graph = graph_engine::ptr();
+	fg = FG_graph::ptr();
+	graph_engine::destroy_flash_graph();
+}
+
+/*
+ * Each run initializes FlashGraph with its own configuration, so it runs
+ * in a separate process. It returns the exit code of the process.
+ */
+int run_proc(const std::string &opts, int die, bool resume,
+		const std::string &out)
+{
+	pid_t pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		die_level = die;
+		run_labels(opts, resume, out);
+		_exit(0);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+	assert(WIFEXITED(status));
+	return WEXITSTATUS(status);
+}
+
+void test_resume()
+{
+	printf("resume label propagation from a checkpoint\n");
+	std::string ckpt_opts = boost::str(boost::format(
+				"checkpoint=%1% checkpoint_interval=%2%") % ckpt_name
+			% ckpt_interval);
+	std::string full_out = "/tmp/test-checkpoint.full";
+	std::string resume_out = "/tmp/test-checkpoint.resume";
+
+	// The run without interruption.
+	int ret = run_proc("", -1, false, full_out);
+	assert(ret == 0);
+	std::vector<vertex_id_t> full = read_labels(full_out);
+	for (vertex_id_t id = 0; id < num_vertices; id++)
+		assert(full[id] == id % num_comps);
+
+	// The run dies in the middle of a level after a few checkpoints.
+	ret = run_proc(ckpt_opts, crash_level, false, resume_out);
+	assert(ret == CRASH_EXIT);
+	// The run resumed from the last checkpoint.
+	ret = run_proc(ckpt_opts, -1, true, resume_out);
+	assert(ret == 0);
+	std::vector<vertex_id_t> resumed = read_labels(resume_out);
+	for (vertex_id_t id = 0; id < num_vertices; id++)
+		assert(full[id] == resumed[id]);
+}
+
+void test_uncommitted()
+{
+	printf("read the last committed checkpoint\n");
+	pid_t pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		config_map::ptr configs = config_map::create(conf_file);
+		graph_engine::init_flash_graph(configs);
+		std::string name = ckpt_name + "-raw";
+		const size_t part_size = 5000;
+		std::vector<size_t> data(part_size);
+		std::vector<vertex_id_t> active;
+		std::string state_str = "stage 3";
+		std::vector<char> driver_state(state_str.begin(), state_str.end());
+		{
+			graph_checkpoint::ptr ckpt = graph_checkpoint::create(name, 2,
+					sizeof(size_t), part_size * 2);
+			assert(ckpt->get_last_level() == -1);
+			for (int i = 0; i < 2; i++) {
+				for (size_t j = 0; j < part_size; j++)
+					data[j] = i * part_size + j;
+				active.clear();
+				for (size_t j = 0; j < part_size; j += 3 + i)
+					active.push_back(j);
+				ckpt->write_part(4, i, (const char *) data.data(),
+						data.size() * sizeof(size_t), active);
+			}
+			ckpt->commit(4, driver_state);
+			// The process dies while writing the checkpoint of level 6.
+			std::fill(data.begin(), data.end(), 0);
+			active.clear();
+			ckpt->write_part(6, 0, (const char *) data.data(),
+					data.size() * sizeof(size_t), active);
+		}
+
+		graph_checkpoint::ptr ckpt = graph_checkpoint::create(name, 2,
+				sizeof(size_t), part_size * 2);
+		assert(ckpt->get_last_level() == 4);
+		assert(ckpt->get_driver_state() == driver_state);
+		for (int i = 0; i < 2; i++) {
+			ckpt->read_part(i, (char *) data.data(),
+					data.size() * sizeof(size_t), active);
+			for (size_t j = 0; j < part_size; j++)
+				assert(data[j] == i * part_size + j);
+			assert(active.size() == (part_size + 2 + i) / (3 + i));
+			for (size_t j = 0; j < active.size(); j++)
+				assert(active[j] == j * (3 + i));
+		}
+		// A checkpoint of a different graph engine is ignored.
+		assert(graph_checkpoint::create(name, 3, sizeof(size_t),
+					part_size * 2)->get_last_level() == -1);
+
+		delete_checkpoint(name, 2);
+		graph_engine::destroy_flash_graph();
+		_exit(0);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "test-checkpoint conf_file\n");
+		fprintf(stderr, "SAFS in the configuration has to be writable\n");
+		return -1;
+	}
+	conf_file = argv[1];
+	ckpt_name = boost::str(boost::format("test-checkpoint-%1%") % getpid());
+
+	create_graph();
+	test_uncommitted();
+	test_resume();
+	unlink(adj_file.c_str());
+	unlink(index_file.c_str());
+}
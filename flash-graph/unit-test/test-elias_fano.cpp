@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <vector>
+
+#include "elias_fano.h"
+
+using namespace fg;
+
+/*
+ * Generate a non-decreasing sequence whose gaps are mostly smaller than
+ * `max_gap', with some large gaps in between.
+ */
+void gen_sequence(size_t num, uint64_t max_gap, std::vector<uint64_t> &vals)
+{
+	vals.clear();
+	uint64_t val = random() % 10;
+	for (size_t i = 0; i < num; i++) {
+		val += random() % max_gap;
+		if (random() % 100 == 0)
+			val += max_gap * 1000;
+		vals.push_back(val);
+	}
+}
+
+void test_array(size_t num, uint64_t max_gap)
+{
+	printf("test Elias-Fano array with %ld values and gaps < %ld\n",
+			num, max_gap);
+	std::vector<uint64_t> vals;
+	gen_sequence(num, max_gap, vals);
+	elias_fano_array arr;
+	arr.init(vals.size(), vals.empty() ? 0 : vals.back());
+	for (size_t i = 0; i < vals.size(); i++)
+		arr.append(vals[i]);
+	arr.finalize();
+	assert(arr.size() == vals.size());
+
+	for (size_t i = 0; i < vals.size(); i++)
+		assert(arr.get(i) == vals[i]);
+
+	// Decode the values sequentially.
+	for (size_t k = 0; k < 10 && !vals.empty(); k++) {
+		size_t start = random() % vals.size();
+		size_t len = vals.size() - start;
+		std::vector<uint64_t> decoded(len);
+		arr.get_range(start, len, decoded.data());
+		for (size_t i = 0; i < len; i++)
+			assert(decoded[i] == vals[start + i]);
+	}
+	printf("It takes %ld bytes\n", arr.get_mem_size());
+}
+
+int main()
+{
+	test_array(0, 10);
+	test_array(1, 10);
+	test_array(1000, 1);
+	test_array(1000, 2);
+	test_array(10000, 1000);
+	test_array(100000, 100);
+	test_array(100000, 1UL << 20);
+}
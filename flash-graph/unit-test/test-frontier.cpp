@@ -0,0 +1,85 @@
+#include <stdlib.h>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#define BOOST_TEST_MODULE frontier
+#include <boost/test/included/unit_test.hpp>
+
+#include "frontier.h"
+
+using namespace fg;
+
+const size_t num_vertices = 1024 * 1024;
+
+static void build(vertex_frontier &frontier, std::set<vertex_id_t> &elements,
+		size_t num)
+{
+	for (size_t i = 0; i < num; i++) {
+		vertex_id_t id = random() % num_vertices;
+		elements.insert(id);
+		frontier.add(id);
+	}
+}
+
+static void check(vertex_frontier &frontier,
+		const std::set<vertex_id_t> &elements)
+{
+	BOOST_CHECK_EQUAL(frontier.size(), elements.size());
+	std::vector<vertex_id_t> ids;
+	frontier.get_vertices(ids);
+	BOOST_CHECK(ids.size() == elements.size());
+	BOOST_CHECK(std::equal(ids.begin(), ids.end(), elements.begin()));
+	for (size_t i = 0; i < 1000; i++) {
+		vertex_id_t id = random() % num_vertices;
+		BOOST_CHECK_EQUAL(frontier.contains(id), elements.count(id) > 0);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE (frontiertest) // name of the test suite
+
+BOOST_AUTO_TEST_CASE (test_reps)
+{
+	size_t nums[] = {100, num_vertices / 32, num_vertices / 2};
+	vertex_frontier::rep_type types[] = {vertex_frontier::SPARSE,
+		vertex_frontier::COMPRESSED, vertex_frontier::DENSE};
+	for (int i = 0; i < 3; i++) {
+		vertex_frontier frontier(num_vertices);
+		std::set<vertex_id_t> elements;
+		build(frontier, elements, nums[i]);
+		frontier.optimize();
+		BOOST_CHECK_EQUAL(frontier.get_rep_type(), types[i]);
+		check(frontier, elements);
+	}
+}
+
+BOOST_AUTO_TEST_CASE (test_set_ops)
+{
+	size_t nums[] = {100, num_vertices / 32, num_vertices / 2};
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			vertex_frontier f1(num_vertices), f2(num_vertices);
+			vertex_frontier f3(num_vertices), f4(num_vertices);
+			std::set<vertex_id_t> e1, e2;
+			build(f1, e1, nums[i]);
+			build(f2, e2, nums[j]);
+			f1.optimize();
+			f2.optimize();
+			f3.union_with(f1);
+			f4.union_with(f1);
+
+			std::set<vertex_id_t> u, in;
+			std::set_union(e1.begin(), e1.end(), e2.begin(), e2.end(),
+					std::inserter(u, u.begin()));
+			std::set_intersection(e1.begin(), e1.end(), e2.begin(), e2.end(),
+					std::inserter(in, in.begin()));
+			f3.union_with(f2);
+			check(f3, u);
+			f4.intersect_with(f2);
+			check(f4, in);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <map>
+#include <set>
+#include <vector>
+#include <algorithm>
+
+#include "graph_builder.h"
+#include "vertex.h"
+#include "vertex_index.h"
+
+using namespace fg;
+
+typedef std::pair<vertex_id_t, int> neighbor_t;
+typedef std::map<vertex_id_t, std::vector<neighbor_t> > adj_map_t;
+
+const std::string tmp_dir = "/tmp";
+const std::string adj_file = tmp_dir + "/test-graph_builder.adj";
+const std::string index_file = tmp_dir + "/test-graph_builder.index";
+
+bool neighbor_less(const neighbor_t &n1, const neighbor_t &n2)
+{
+	return n1.first < n2.first;
+}
+
+/*
+ * Read the adjacency lists of all vertices in a part of the graph file
+ * and compare them with the expected ones.
+ */
+size_t check_part(FILE *f, size_t num_vertices, adj_map_t &expected,
+		bool check_attr)
+{
+	size_t tot_edges = 0;
+	size_t header_size = ext_mem_undirected_vertex::get_header_size();
+	for (size_t id = 0; id < num_vertices; id++) {
+		ext_mem_undirected_vertex header;
+		BOOST_VERIFY(fread(&header, header_size, 1, f) == 1);
+		assert(header.get_id() == id);
+		std::vector<char> buf(header.get_size());
+		memcpy(buf.data(), &header, header_size);
+		if (buf.size() > header_size)
+			BOOST_VERIFY(fread(buf.data() + header_size,
+						buf.size() - header_size, 1, f) == 1);
+		const ext_mem_undirected_vertex *v
+			= (const ext_mem_undirected_vertex *) buf.data();
+
+		std::vector<neighbor_t> &edges = expected[id];
+		std::stable_sort(edges.begin(), edges.end(), neighbor_less);
+		assert(v->get_num_edges() == edges.size());
+		for (size_t i = 0; i < edges.size(); i++) {
+			assert(v->get_neighbor(i) == edges[i].first);
+			if (check_attr)
+				assert(v->get_edge_data<int>(i) == edges[i].second);
+		}
+		tot_edges += edges.size();
+	}
+	return tot_edges;
+}
+
+void test_build(bool directed, bool dedup, bool remove_self_edges, bool attr,
+		size_t mem_size)
+{
+	printf("build a %s graph (dedup: %d, remove self edges: %d, attr: %d) with %ld bytes\n",
+			directed ? "directed" : "undirected", dedup, remove_self_edges,
+			attr, mem_size);
+	// Generate the edge lists in two files.
+	size_t num_vertices = 3000;
+	size_t num_edges = 40000;
+	std::vector<std::string> files;
+	files.push_back(tmp_dir + "/test-graph_builder1.txt");
+	files.push_back(tmp_dir + "/test-graph_builder2.txt");
+	FILE *fs[2];
+	for (int i = 0; i < 2; i++) {
+		fs[i] = fopen(files[i].c_str(), "w");
+		assert(fs[i]);
+		fprintf(fs[i], "# a comment\n");
+	}
+	std::vector<std::pair<vertex_id_t, vertex_id_t> > edges;
+	for (size_t i = 0; i < num_edges; i++) {
+		vertex_id_t from = random() % num_vertices;
+		vertex_id_t to = random() % (num_vertices - 1);
+		if (i % 1000 == 0)
+			to = from;
+		FILE *f = fs[i % 3 == 0];
+		if (attr)
+			fprintf(f, "%u %u %u\n", from, to, (from * 31 + to) % 100);
+		else
+			fprintf(f, "  %u\t%u\n", from, to);
+		edges.push_back(std::pair<vertex_id_t, vertex_id_t>(from, to));
+	}
+	fclose(fs[0]);
+	fclose(fs[1]);
+
+	utils::ext_mem_graph_builder::options opts;
+	opts.directed = directed;
+	opts.dedup = dedup;
+	opts.remove_self_edges = remove_self_edges;
+	if (attr)
+		opts.attr_type = "I";
+	opts.mem_size = mem_size;
+	opts.tmp_dir = tmp_dir;
+	utils::ext_mem_graph_builder::stats stats
+		= utils::ext_mem_graph_builder::build(files, adj_file, index_file, opts);
+	printf("%ld runs, %d merge passes\n", stats.num_runs,
+			stats.num_merge_passes);
+
+	// Compute the expected adjacency lists.
+	vertex_id_t max_id = 0;
+	adj_map_t in_edges, out_edges;
+	std::set<std::pair<vertex_id_t, vertex_id_t> > added;
+	for (size_t i = 0; i < edges.size(); i++) {
+		vertex_id_t from = edges[i].first;
+		vertex_id_t to = edges[i].second;
+		int val = (from * 31 + to) % 100;
+		max_id = std::max(max_id, std::max(from, to));
+		if (remove_self_edges && from == to)
+			continue;
+		bool new_edge = added.insert(edges[i]).second;
+		if (directed) {
+			if (dedup && !new_edge)
+				continue;
+			out_edges[from].push_back(neighbor_t(to, val));
+			in_edges[to].push_back(neighbor_t(from, val));
+		}
+		else {
+			bool new_rev_edge = added.insert(
+					std::pair<vertex_id_t, vertex_id_t>(to, from)).second;
+			if (!dedup || new_edge)
+				out_edges[from].push_back(neighbor_t(to, val));
+			if (from != to && (!dedup || new_rev_edge))
+				out_edges[to].push_back(neighbor_t(from, val));
+		}
+	}
+	assert(stats.num_input_edges == num_edges);
+	assert(stats.num_vertices == max_id + 1);
+
+	FILE *f = fopen(adj_file.c_str(), "r");
+	assert(f);
+	graph_header header;
+	BOOST_VERIFY(fread(&header, sizeof(header), 1, f) == 1);
+	assert(header.is_directed_graph() == directed);
+	assert(header.get_num_vertices() == stats.num_vertices);
+	assert(header.get_num_edges() == stats.num_edges);
+	fseek(f, graph_header::get_header_size(), SEEK_SET);
+	// An edge and its reverse edge in an undirected graph may have
+	// different attributes, so we can only check them in a directed graph.
+	if (directed)
+		check_part(f, stats.num_vertices, in_edges, attr);
+	size_t num_adj_entries = check_part(f, stats.num_vertices, out_edges,
+			attr && directed);
+	assert(fgetc(f) == EOF);
+	fclose(f);
+	// An undirected self edge is stored once in the adjacency list.
+	size_t num_self_edges = 0;
+	for (adj_map_t::const_iterator it = out_edges.begin();
+			it != out_edges.end(); it++)
+		for (size_t i = 0; i < it->second.size(); i++)
+			if (it->second[i].first == it->first)
+				num_self_edges++;
+	if (!remove_self_edges && !directed)
+		assert(num_self_edges > 0);
+	assert(stats.num_edges == (directed ? num_adj_entries
+				: (num_adj_entries + num_self_edges) / 2));
+
+	vertex_index::ptr index = vertex_index::load(index_file);
+	in_mem_query_vertex_index::ptr query_index
+		= in_mem_query_vertex_index::create(index, true);
+	for (vertex_id_t id = 0; id < stats.num_vertices; id++) {
+		if (directed)
+			assert(query_index->get_num_edges(id, IN_EDGE)
+					== in_edges[id].size());
+		assert(query_index->get_num_edges(id, OUT_EDGE)
+				== out_edges[id].size());
+	}
+
+	unlink(files[0].c_str());
+	unlink(files[1].c_str());
+	unlink(adj_file.c_str());
+	unlink(index_file.c_str());
+}
+
+/*
+ * Write the adjacency lists of a random graph in the order of vertex IDs.
+ * Some vertices are skipped and should get empty adjacency lists.
+ */
+void test_image_writer(bool directed)
+{
+	printf("write a %s image in the order of vertex IDs\n",
+			directed ? "directed" : "undirected");
+	size_t num_vertices = 3000;
+	// The last vertices don't have edges.
+	std::set<std::pair<vertex_id_t, vertex_id_t> > edges;
+	for (size_t i = 0; i < 20000; i++) {
+		vertex_id_t from = random() % (num_vertices - 10);
+		vertex_id_t to = random() % (num_vertices - 10);
+		// Some vertices don't have edges.
+		if (from % 7 == 0 || to % 7 == 0)
+			continue;
+		edges.insert(std::pair<vertex_id_t, vertex_id_t>(from, to));
+		if (!directed)
+			edges.insert(std::pair<vertex_id_t, vertex_id_t>(to, from));
+	}
+	adj_map_t in_edges, out_edges;
+	std::map<vertex_id_t, std::vector<vertex_id_t> > in_neighs, out_neighs;
+	std::set<std::pair<vertex_id_t, vertex_id_t> >::const_iterator it;
+	for (it = edges.begin(); it != edges.end(); it++) {
+		out_neighs[it->first].push_back(it->second);
+		out_edges[it->first].push_back(neighbor_t(it->second, 0));
+		if (directed) {
+			in_neighs[it->second].push_back(it->first);
+			in_edges[it->second].push_back(neighbor_t(it->first, 0));
+		}
+	}
+
+	utils::ext_mem_image_writer writer(adj_file, directed, tmp_dir);
+	size_t num_adj_entries = 0;
+	for (vertex_id_t id = 0; id < num_vertices - 10; id++) {
+		if (out_neighs[id].empty() && in_neighs[id].empty())
+			continue;
+		std::sort(in_neighs[id].begin(), in_neighs[id].end());
+		num_adj_entries += out_neighs[id].size() + in_neighs[id].size();
+		if (directed)
+			writer.add_vertex(id, in_neighs[id].data(), in_neighs[id].size(),
+					out_neighs[id].data(), out_neighs[id].size());
+		else
+			writer.add_vertex(id, out_neighs[id].data(),
+					out_neighs[id].size());
+	}
+	size_t num_edges = writer.close(num_vertices, index_file);
+	size_t num_self_edges = 0;
+	for (it = edges.begin(); it != edges.end(); it++)
+		if (it->first == it->second)
+			num_self_edges++;
+	// An undirected self edge is stored once in the adjacency list.
+	assert(num_edges == (directed ? num_adj_entries / 2
+				: (num_adj_entries + num_self_edges) / 2));
+
+	FILE *f = fopen(adj_file.c_str(), "r");
+	assert(f);
+	graph_header header;
+	BOOST_VERIFY(fread(&header, sizeof(header), 1, f) == 1);
+	assert(header.is_directed_graph() == directed);
+	assert(header.get_num_vertices() == num_vertices);
+	assert(header.get_num_edges() == num_edges);
+	fseek(f, graph_header::get_header_size(), SEEK_SET);
+	if (directed)
+		check_part(f, num_vertices, in_edges, false);
+	check_part(f, num_vertices, out_edges, false);
+	assert(fgetc(f) == EOF);
+	fclose(f);
+
+	vertex_index::ptr index = vertex_index::load(index_file);
+	in_mem_query_vertex_index::ptr query_index
+		= in_mem_query_vertex_index::create(index, true);
+	for (vertex_id_t id = 0; id < num_vertices; id++) {
+		if (directed)
+			assert(query_index->get_num_edges(id, IN_EDGE)
+					== in_edges[id].size());
+		assert(query_index->get_num_edges(id, OUT_EDGE)
+				== out_edges[id].size());
+	}
+	unlink(adj_file.c_str());
+	unlink(index_file.c_str());
+}
+
+/*
+ * A line with a missing or bad field is skipped and doesn't take
+ * the numbers in the next line.
+ */
+void test_bad_lines()
+{
+	printf("skip the lines with missing or bad fields\n");
+	std::vector<std::string> files;
+	files.push_back(tmp_dir + "/test-graph_builder1.txt");
+	FILE *f = fopen(files[0].c_str(), "w");
+	assert(f);
+	fprintf(f, "0 1 10\n");
+	// The attribute is missing.
+	fprintf(f, "1 2\n");
+	fprintf(f, "2 3 30\n");
+	// The destination and the attribute are missing.
+	fprintf(f, "3\n");
+	fprintf(f, "4 5 50\n");
+	// Bad fields.
+	fprintf(f, "5 x 60\n");
+	fprintf(f, "6 7 7x\n");
+	fprintf(f, "  7\t8 80  \n");
+	// The last line doesn't end with a newline.
+	fprintf(f, "8 9 90");
+	fclose(f);
+
+	utils::ext_mem_graph_builder::options opts;
+	opts.directed = true;
+	opts.attr_type = "I";
+	opts.tmp_dir = tmp_dir;
+	utils::ext_mem_graph_builder::stats stats
+		= utils::ext_mem_graph_builder::build(files, adj_file, index_file, opts);
+	assert(stats.num_input_edges == 5);
+	assert(stats.num_edges == 5);
+	assert(stats.num_vertices == 10);
+
+	adj_map_t in_edges, out_edges;
+	vertex_id_t froms[] = {0, 2, 4, 7, 8};
+	for (size_t i = 0; i < sizeof(froms) / sizeof(froms[0]); i++) {
+		vertex_id_t from = froms[i];
+		out_edges[from].push_back(neighbor_t(from + 1, (from + 1) * 10));
+		in_edges[from + 1].push_back(neighbor_t(from, (from + 1) * 10));
+	}
+	f = fopen(adj_file.c_str(), "r");
+	assert(f);
+	fseek(f, graph_header::get_header_size(), SEEK_SET);
+	check_part(f, stats.num_vertices, in_edges, true);
+	check_part(f, stats.num_vertices, out_edges, true);
+	assert(fgetc(f) == EOF);
+	fclose(f);
+
+	unlink(files[0].c_str());
+	unlink(adj_file.c_str());
+	unlink(index_file.c_str());
+}
+
+int main()
+{
+	for (int directed = 0; directed < 2; directed++)
+		for (int dedup = 0; dedup < 2; dedup++)
+			for (int remove_self_edges = 0; remove_self_edges < 2;
+					remove_self_edges++)
+				for (int attr = 0; attr < 2; attr++) {
+					// A small memory size forces multiple merge passes.
+					test_build(directed, dedup, remove_self_edges, attr,
+							64 * 1024);
+					test_build(directed, dedup, remove_self_edges, attr,
+							256 * 1024 * 1024);
+				}
+	test_image_writer(false);
+	test_image_writer(true);
+	test_bad_lines();
+}
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "graph_delta.h"
+
+using namespace fg;
+
+const size_t num_vertices = 1000;
+
+/*
+ * Serialize an edge list in the format of the graph image.
+ */
+void serialize(vertex_id_t id, const std::vector<vertex_id_t> &edges,
+		std::vector<char> &buf, mem_byte_array &arr)
+{
+	buf.resize(ext_mem_undirected_vertex::num_edges2vsize(edges.size(), 0));
+	ext_mem_undirected_vertex *v = new (buf.data()) ext_mem_undirected_vertex(
+			id, edges.size(), 0);
+	for (size_t i = 0; i < edges.size(); i++)
+		v->set_neighbor(i, edges[i]);
+	arr.set_data(buf.data(), buf.size());
+}
+
+void read_edges(const page_vertex &v, edge_type type,
+		std::vector<vertex_id_t> &edges)
+{
+	edges.clear();
+	edge_seq_iterator it = v.get_neigh_seq_it(type);
+	while (it.has_next())
+		edges.push_back(it.next());
+	assert(edges.size() == v.get_num_edges(type));
+}
+
+void test_directed_delta()
+{
+	printf("test directed graph delta\n");
+	graph_header header(graph_type::DIRECTED, num_vertices, 0, 0);
+	graph_delta::ptr delta = graph_delta::create(header);
+	delta->add_edge(1, 5);
+	delta->add_edge(1, 3);
+	delta->delete_edge(1, 7);
+	delta->add_edge(2, 1);
+	// Adding and deleting the same edge cancels each other.
+	delta->add_edge(1, 8);
+	delta->delete_edge(1, 8);
+	assert(delta->has_delta(1));
+	assert(!delta->has_delta(0));
+
+	std::vector<vertex_id_t> in_edges, out_edges;
+	in_edges.push_back(4);
+	out_edges.push_back(2);
+	out_edges.push_back(7);
+	out_edges.push_back(9);
+	std::vector<char> in_buf, out_buf;
+	mem_byte_array in_arr, out_arr;
+	serialize(1, in_edges, in_buf, in_arr);
+	serialize(1, out_edges, out_buf, out_arr);
+	page_directed_vertex base(in_arr, out_arr);
+
+	merged_page_vertex merged(*delta, base);
+	std::vector<vertex_id_t> edges;
+	read_edges(merged.get_vertex(), OUT_EDGE, edges);
+	vertex_id_t expected_out[] = {2, 3, 5, 9};
+	assert(edges == std::vector<vertex_id_t>(expected_out, expected_out + 4));
+	read_edges(merged.get_vertex(), IN_EDGE, edges);
+	vertex_id_t expected_in[] = {2, 4};
+	assert(edges == std::vector<vertex_id_t>(expected_in, expected_in + 2));
+
+	// Only the out-edges are requested.
+	page_directed_vertex out_base(out_arr, false);
+	merged_page_vertex out_merged(*delta, out_base);
+	assert(out_merged.get_vertex().get_num_edges(IN_EDGE) == 0);
+	assert(out_merged.get_vertex().get_num_edges(OUT_EDGE) == 4);
+
+	std::string seg_file = "/tmp/test-graph_delta.seg";
+	assert(delta->dump_segment(seg_file));
+	graph_delta::ptr loaded = graph_delta::create(header);
+	assert(loaded->load_segment(seg_file));
+	assert(loaded->get_num_updates() == delta->get_num_updates());
+	std::vector<vertex_id_t> ids1, ids2;
+	delta->get_updated_vertices(ids1);
+	loaded->get_updated_vertices(ids2);
+	assert(ids1 == ids2);
+	merged_page_vertex merged1(*loaded, base);
+	read_edges(merged1.get_vertex(), OUT_EDGE, edges);
+	assert(edges == std::vector<vertex_id_t>(expected_out, expected_out + 4));
+
+	// A segment can't be applied to a different graph.
+	graph_header undirected_header(graph_type::UNDIRECTED, num_vertices,
+			0, 0);
+	graph_delta::ptr undirected = graph_delta::create(undirected_header);
+	assert(!undirected->load_segment(seg_file));
+	unlink(seg_file.c_str());
+}
+
+void test_undirected_delta()
+{
+	printf("test undirected graph delta\n");
+	graph_header header(graph_type::UNDIRECTED, num_vertices, 0, 0);
+	graph_delta::ptr delta = graph_delta::create(header);
+	delta->add_edge(3, 1);
+	delta->delete_edge(6, 1);
+	assert(delta->has_delta(3));
+	assert(delta->has_delta(6));
+
+	std::vector<vertex_id_t> base_edges;
+	base_edges.push_back(0);
+	base_edges.push_back(6);
+	std::vector<char> buf;
+	mem_byte_array arr;
+	serialize(1, base_edges, buf, arr);
+	page_undirected_vertex base(arr);
+	merged_page_vertex merged(*delta, base);
+	std::vector<vertex_id_t> edges;
+	read_edges(merged.get_vertex(), OUT_EDGE, edges);
+	vertex_id_t expected[] = {0, 3};
+	assert(edges == std::vector<vertex_id_t>(expected, expected + 2));
+}
+
+int main()
+{
+	test_directed_delta();
+	test_undirected_delta();
+}
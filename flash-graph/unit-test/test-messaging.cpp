@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "messaging.h"
+
+using namespace fg;
+
+class count_message: public vertex_message
+{
+	int count;
+public:
+	count_message(int count): vertex_message(sizeof(count_message), false) {
+		this->count = count;
+	}
+
+	int get_count() const {
+		return count;
+	}
+
+	void add(int count) {
+		this->count += count;
+	}
+};
+
+class count_combiner: public vertex_msg_combiner
+{
+public:
+	void combine(vertex_message &combined, const vertex_message &msg) const {
+		((count_message &) combined).add(((const count_message &) msg).get_count());
+	}
+};
+
+/*
+ * Collect the messages in the queue. It returns the number of messages
+ * received by each vertex and adds the counts in the messages to `counts'.
+ */
+std::vector<int> drain(msg_queue *queue, std::vector<int> &counts)
+{
+	std::vector<int> num_msgs(counts.size());
+	while (!queue->is_empty()) {
+		message msg;
+		int ret = queue->fetch(&msg, 1);
+		assert(ret == 1);
+		vertex_message *objs[64];
+		int num;
+		while ((num = msg.get_next(objs, 64)) > 0)
+			for (int i = 0; i < num; i++) {
+				count_message *cmsg = (count_message *) objs[i];
+				vertex_id_t id = cmsg->get_dest().id;
+				assert(id < counts.size());
+				num_msgs[id]++;
+				counts[id] += cmsg->get_count();
+			}
+	}
+	return num_msgs;
+}
+
+/*
+ * Send `num_rounds' messages to every vertex in a partition, flushing
+ * the sender every `flush_interval' messages.
+ */
+void test_combine(size_t part_size, int num_rounds, size_t flush_interval)
+{
+	printf("combine %d messages to each of %ld vertices, flush every %ld\n",
+			num_rounds, part_size, flush_interval);
+	std::shared_ptr<slab_allocator> alloc(new slab_allocator("test-msg",
+				4096 * 4, 1024 * 1024, INT_MAX, 0));
+	msg_queue *queue = msg_queue::create(0, "test-queue", 16, INT_MAX);
+	simple_msg_sender *sender = simple_msg_sender::create(0, alloc, queue);
+	combine_msg_sender *combiner = combine_msg_sender::create(
+			vertex_msg_combiner::ptr(new count_combiner()), *sender, part_size);
+
+	std::vector<vertex_id_t> ids(part_size);
+	for (size_t i = 0; i < ids.size(); i++)
+		ids[i] = i;
+	std::vector<int> counts(part_size);
+	std::vector<int> num_msgs(part_size);
+	size_t num_sent = 0;
+	for (int round = 0; round < num_rounds; round++) {
+		std::random_shuffle(ids.begin(), ids.end());
+		for (size_t i = 0; i < ids.size(); i++) {
+			count_message msg(1);
+			msg.set_dest(local_vid_t(ids[i]));
+			combiner->send(msg);
+			if (++num_sent % flush_interval == 0) {
+				combiner->flush();
+				std::vector<int> ret = drain(queue, counts);
+				for (size_t j = 0; j < ret.size(); j++)
+					num_msgs[j] += ret[j];
+			}
+		}
+	}
+	combiner->flush();
+	std::vector<int> ret = drain(queue, counts);
+	for (size_t j = 0; j < ret.size(); j++)
+		num_msgs[j] += ret[j];
+
+	size_t tot_msgs = 0;
+	for (size_t i = 0; i < part_size; i++) {
+		assert(counts[i] == num_rounds);
+		tot_msgs += num_msgs[i];
+	}
+	assert(tot_msgs + combiner->get_num_combined() == combiner->get_num_sent());
+	// Without intermediate flushes, each vertex receives a single message
+	// if all destinations fit in the sender.
+	if (flush_interval > num_sent && part_size <= 64 * 1024)
+		for (size_t i = 0; i < part_size; i++)
+			assert(num_msgs[i] == 1);
+
+	combine_msg_sender::destroy(combiner);
+	simple_msg_sender::destroy(sender);
+	msg_queue::destroy(queue);
+}
+
+int main()
+{
+	size_t part_sizes[] = {1000, 1024, 65536, 65537, 200000};
+	for (size_t i = 0; i < sizeof(part_sizes) / sizeof(part_sizes[0]); i++) {
+		// Every vertex in the partition gets a message before a flush.
+		test_combine(part_sizes[i], 3, -1);
+		// Flush the sender when it's partially filled.
+		test_combine(part_sizes[i], 3, 777);
+	}
+}
@@ -1,44 +1,175 @@
 #include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
 
 #include "partitioner.h"
+#include "graph_file_header.h"
+#include "vertex.h"
+#include "vertex_index.h"
+#include "vertex_index_constructor.h"
 
 using namespace fg;
 
 const int num_parts = 16;
 const int M = 1024 * 1024;
 
+void check_partitioner(graph_partitioner &partitioner, size_t num_vertices)
+{
+	std::vector<vertex_id_t> parts[num_parts];
+	printf("there are %ld vertices\n", num_vertices);
+	for (int i = 0; i < num_parts; i++) {
+		partitioner.get_all_vertices_in_part(i, num_vertices, parts[i]);
+		size_t computed_part_size = partitioner.get_part_size(i,
+				num_vertices);
+		assert(computed_part_size == parts[i].size());
+	}
+	for (vertex_id_t id = 0; id < num_vertices; id++) {
+		int part_id;
+		off_t off;
+		partitioner.map2loc(id, part_id, off);
+		assert(part_id == partitioner.map(id));
+		assert(parts[part_id][off] == id);
+	}
+	for (int part_id = 0; part_id < num_parts; part_id++) {
+		for (off_t off = 0; off < (off_t) parts[part_id].size(); off++) {
+			vertex_id_t id;
+			partitioner.loc2map(part_id, off, id);
+			assert(id == parts[part_id][off]);
+		}
+	}
+	size_t tot = 0;
+	for (int i = 0; i < num_parts; i++)
+		tot += parts[i].size();
+	printf("There are %ld vertices in all partitions\n", tot);
+	assert(num_vertices == tot);
+}
+
 void test_partitioner(graph_partitioner &partitioner)
 {
 	for (int k = 0; k < 100; k++) {
-		std::vector<vertex_id_t> parts[num_parts];
 		size_t num_vertices = random() % M + M;
-		printf("there are %ld vertices\n", num_vertices);
-		for (int i = 0; i < num_parts; i++) {
-			partitioner.get_all_vertices_in_part(i, num_vertices, parts[i]);
-			size_t computed_part_size = partitioner.get_part_size(i,
-					num_vertices);
-			assert(computed_part_size == parts[i].size());
-		}
-		for (vertex_id_t id = 0; id < num_vertices; id++) {
-			int part_id;
-			off_t off;
-			partitioner.map2loc(id, part_id, off);
-			assert(part_id == partitioner.map(id));
-			assert(parts[part_id][off] == id);
-		}
-		for (int part_id = 0; part_id < num_parts; part_id++) {
-			for (off_t off = 0; off < parts[part_id].size(); off++) {
-				vertex_id_t id;
-				partitioner.loc2map(part_id, off, id);
-				assert(id == parts[part_id][off]);
-			}
+		check_partitioner(partitioner, num_vertices);
+	}
+}
+
+void test_edge_balanced_partitioner()
+{
+	for (int k = 0; k < 10; k++) {
+		size_t num_vertices = random() % M + M;
+		std::vector<vertex_id_t> part_starts(num_parts + 1);
+		part_starts[0] = 0;
+		for (int i = 1; i < num_parts; i++)
+			part_starts[i] = random() % num_vertices;
+		part_starts[num_parts] = num_vertices;
+		// Some of the partitions may be empty.
+		std::sort(part_starts.begin(), part_starts.end());
+		edge_balanced_graph_partitioner::ptr partitioner
+			= edge_balanced_graph_partitioner::create(part_starts);
+		check_partitioner(*partitioner, num_vertices);
+
+		const char *file = "/tmp/test-partitioner.part";
+		assert(partitioner->dump(file, 1, 1000));
+		edge_balanced_graph_partitioner::ptr loaded
+			= edge_balanced_graph_partitioner::load(file, num_vertices,
+					num_parts, 1, 1000);
+		assert(loaded);
+		for (int i = 0; i <= num_parts; i++)
+			assert(loaded->get_part_start(i) == part_starts[i]);
+		assert(edge_balanced_graph_partitioner::load(file, num_vertices + 1,
+					num_parts, 1, 1000) == NULL);
+		// The partitions computed with a different configuration
+		// can't be used.
+		assert(edge_balanced_graph_partitioner::load(file, num_vertices,
+					num_parts / 2, 1, 1000) == NULL);
+		assert(edge_balanced_graph_partitioner::load(file, num_vertices,
+					num_parts, 4, 1000) == NULL);
+		assert(edge_balanced_graph_partitioner::load(file, num_vertices,
+					num_parts, 1, 100) == NULL);
+		unlink(file);
+	}
+}
+
+/*
+ * Build the vertex index of a directed graph with a skewed degree
+ * distribution. Most vertices have a few edges and a small number of
+ * hub vertices have thousands of edges.
+ */
+in_mem_query_vertex_index::ptr create_skewed_index(size_t num_vertices,
+		std::vector<vsize_t> &degrees)
+{
+	vertex_index_construct::ptr cindex
+		= vertex_index_construct::create_compressed(true, 0);
+	size_t num_edges = 0;
+	for (size_t i = 0; i < num_vertices; i++) {
+		in_mem_directed_vertex<empty_data> v(i, 0);
+		int num_out = random() % 4;
+		int num_in = random() % 4;
+		// Put a cluster of hubs at the beginning of the ID space as well
+		// as some random hubs in the rest of the graph.
+		if (i < 8 || random() % 500 == 0) {
+			num_out += 2000 + random() % 6000;
+			num_in += random() % 2000;
 		}
-		size_t tot = 0;
-		for (int i = 0; i < num_parts; i++)
-			tot += parts[i].size();
-		printf("There are %ld vertices in all partitions\n", tot);
-		assert(num_vertices == tot);
+		for (int j = 0; j < num_out; j++)
+			v.add_out_edge(edge<empty_data>(i, random() % num_vertices));
+		for (int j = 0; j < num_in; j++)
+			v.add_in_edge(edge<empty_data>(random() % num_vertices, i));
+		degrees.push_back(num_out + num_in);
+		num_edges += num_out;
+		cindex->add_vertex(v);
+	}
+	graph_header header(graph_type::DIRECTED, num_vertices, num_edges, 0);
+	vertex_index::ptr raw_index = cindex->dump(header, true);
+	return in_mem_query_vertex_index::create(raw_index, true);
+}
+
+/*
+ * The degree-balanced cut should give every partition about the same
+ * number of edges, no matter how skewed the degree distribution is.
+ */
+void test_degree_balanced_cut(int num_vparts)
+{
+	printf("test degree-balanced cut with %d vertical parts\n", num_vparts);
+	const size_t num_vertices = 100000;
+	const vsize_t min_vpart_degree = 4000;
+	std::vector<vsize_t> degrees;
+	in_mem_query_vertex_index::ptr index = create_skewed_index(num_vertices,
+			degrees);
+	for (size_t id = 0; id < num_vertices; id++)
+		assert(index->get_num_edges(id, edge_type::BOTH_EDGES) == degrees[id]);
+
+	edge_balanced_graph_partitioner::ptr partitioner
+		= edge_balanced_graph_partitioner::create(*index, num_vertices,
+				num_parts, num_vparts, min_vpart_degree);
+	check_partitioner(*partitioner, num_vertices);
+	if (num_vparts > 1)
+		assert(partitioner->get_hub_degree() <= min_vpart_degree);
+	else
+		assert(partitioner->get_hub_degree()
+				== std::numeric_limits<vsize_t>::max());
+
+	// Compute the cost of each partition in the same way as the partitioner.
+	std::vector<size_t> costs(num_parts);
+	size_t tot_cost = 0;
+	size_t max_vertex_cost = 0;
+	for (size_t id = 0; id < num_vertices; id++) {
+		size_t cost = degrees[id];
+		if (cost >= partitioner->get_hub_degree())
+			cost /= num_vparts;
+		cost++;
+		costs[partitioner->map(id)] += cost;
+		tot_cost += cost;
+		max_vertex_cost = std::max(max_vertex_cost, cost);
 	}
+	// A partition can't exceed its share of the cost by more than
+	// the cost of a single vertex.
+	size_t max_cost = *std::max_element(costs.begin(), costs.end());
+	size_t min_cost = *std::min_element(costs.begin(), costs.end());
+	printf("partition cost: min: %ld, max: %ld, avg: %ld, max vertex: %ld\n",
+			min_cost, max_cost, tot_cost / num_parts, max_vertex_cost);
+	for (int i = 0; i < num_parts; i++)
+		assert(costs[i] <= tot_cost / num_parts + max_vertex_cost + 1);
 }
 
 int main()
@@ -51,4 +182,8 @@ int main()
 	modulo_graph_partitioner m_partitioner(num_parts);
 	test_partitioner(m_partitioner);
 
+	printf("test edge_balanced_graph_partitioner\n");
+	test_edge_balanced_partitioner();
+	test_degree_balanced_cut(1);
+	test_degree_balanced_cut(4);
 }
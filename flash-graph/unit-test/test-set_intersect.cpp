@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "set_intersect.h"
+
+using namespace fg;
+
+class match_collector
+{
+public:
+	std::vector<std::pair<size_t, size_t> > matches;
+
+	void operator()(size_t i, size_t j) {
+		matches.push_back(std::pair<size_t, size_t>(i, j));
+	}
+};
+
+/*
+ * Generate a sorted array with `num' elements in [0, range).
+ */
+void gen_sorted(size_t num, size_t range, bool unique,
+		std::vector<vertex_id_t> &arr)
+{
+	arr.clear();
+	for (size_t i = 0; i < num; i++)
+		arr.push_back(random() % range);
+	std::sort(arr.begin(), arr.end());
+	if (unique)
+		arr.resize(std::unique(arr.begin(), arr.end()) - arr.begin());
+}
+
+/*
+ * Every element in `b' that exists in `a' is matched once.
+ */
+void get_expected(const std::vector<vertex_id_t> &a,
+		const std::vector<vertex_id_t> &b,
+		std::vector<std::pair<size_t, size_t> > &matches)
+{
+	matches.clear();
+	for (size_t j = 0; j < b.size(); j++) {
+		std::vector<vertex_id_t>::const_iterator it = std::lower_bound(
+				a.begin(), a.end(), b[j]);
+		if (it != a.end() && *it == b[j])
+			matches.push_back(std::pair<size_t, size_t>(it - a.begin(), j));
+	}
+}
+
+void test_kernels(size_t num_a, size_t num_b, size_t range)
+{
+	printf("test intersection of %ld and %ld elements in [0, %ld)\n",
+			num_a, num_b, range);
+	std::vector<vertex_id_t> a, b;
+	gen_sorted(num_a, range, true, a);
+	gen_sorted(num_b, range, false, b);
+	std::vector<std::pair<size_t, size_t> > expected;
+	get_expected(a, b, expected);
+
+	sorted_id_set set;
+	set.init(a.data(), a.size(), true);
+	intersect_method methods[] = {INTERSECT_AUTO, INTERSECT_MERGE,
+		INTERSECT_SIMD, INTERSECT_GALLOP, INTERSECT_BITMAP};
+	for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+		match_collector collector;
+		size_t ret = intersect(methods[i], set, b.data(), b.size(),
+				collector);
+		assert(ret == expected.size());
+		assert(collector.matches == expected);
+	}
+	// Galloping in the other direction.
+	match_collector collector;
+	size_t ret = intersect_gallop(a.data(), a.size(), b.data(),
+			std::min(b.size(), a.size() / 64), collector);
+	std::vector<vertex_id_t> short_b(b.begin(),
+			b.begin() + std::min(b.size(), a.size() / 64));
+	get_expected(a, short_b, expected);
+	assert(ret == expected.size());
+	assert(collector.matches == expected);
+}
+
+void test_id_set()
+{
+	printf("test sorted ID set\n");
+	std::vector<vertex_id_t> ids;
+	gen_sorted(1000, 10000, true, ids);
+	sorted_id_set dense;
+	dense.init(ids.data(), ids.size(), true);
+	assert(dense.has_index());
+	sorted_id_set no_index;
+	no_index.init(ids.data(), ids.size(), false);
+	assert(!no_index.has_index());
+	for (vertex_id_t id = 0; id < 11000; id++) {
+		std::vector<vertex_id_t>::const_iterator it = std::lower_bound(
+				ids.begin(), ids.end(), id);
+		off_t expected = it != ids.end() && *it == id ? it - ids.begin() : -1;
+		assert(dense.find_idx(id) == expected);
+		assert(no_index.find_idx(id) == expected);
+	}
+
+	// The IDs are too sparse to build an index.
+	gen_sorted(100, 1000000, true, ids);
+	sorted_id_set sparse;
+	sparse.init(ids.data(), ids.size(), true);
+	assert(!sparse.has_index());
+
+	// We can't build an index on duplicated IDs.
+	ids.clear();
+	ids.push_back(1);
+	ids.push_back(1);
+	ids.push_back(2);
+	sorted_id_set dups;
+	dups.init(ids.data(), ids.size(), true);
+	assert(!dups.has_index());
+}
+
+int main()
+{
+	printf("SIMD level: %d\n", get_simd_level());
+	test_kernels(0, 100, 1000);
+	test_kernels(100, 0, 1000);
+	test_kernels(7, 9, 20);
+	test_kernels(1000, 1000, 2000);
+	test_kernels(1000, 1000, 100000);
+	test_kernels(10000, 300, 20000);
+	test_kernels(300, 10000, 20000);
+	test_kernels(100000, 100, 1000000);
+	// Many duplicates in `b'.
+	test_kernels(50, 5000, 100);
+	test_id_set();
+}
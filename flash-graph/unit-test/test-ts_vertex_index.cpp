@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "ts_graph.h"
+
+using namespace fg;
+
+typedef std::vector<ts_edge_data> ts_list_t;
+
+/*
+ * Generate the sorted timestamps of the edges of vertices. Some vertices
+ * have no edges and many timestamps are duplicated.
+ */
+void gen_timestamps(size_t num_vertices, std::vector<ts_list_t> &lists,
+		std::vector<vsize_t> &num_edges)
+{
+	lists.resize(num_vertices);
+	num_edges.resize(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++) {
+		size_t num = random() % 5 == 0 ? 0 : random() % 300;
+		time_t start = random() % 1000;
+		for (size_t j = 0; j < num; j++)
+			lists[i].push_back(ts_edge_data(start + random() % 500));
+		std::sort(lists[i].begin(), lists[i].end());
+		num_edges[i] = num;
+	}
+}
+
+size_t count_edges(const ts_list_t &list, time_t start, time_t interval)
+{
+	size_t num = 0;
+	for (size_t i = 0; i < list.size(); i++)
+		if (list[i].get_timestamp() >= start
+				&& list[i].get_timestamp() < start + interval)
+			num++;
+	return num;
+}
+
+void check_index(const ts_vertex_index &index, edge_type type,
+		const std::vector<ts_list_t> &lists)
+{
+	for (size_t i = 0; i < 200; i++) {
+		time_t start = random() % 1600;
+		time_t interval = random() % 100 + 1;
+		size_t num_exact = 0;
+		size_t num_empty = 0;
+		for (vertex_id_t id = 0; id < lists.size(); id++) {
+			const ts_list_t &list = lists[id];
+			assert(index.get_num_edges(id, type) == list.size());
+			ts_vertex_index::edge_range range = index.get_edge_range(id, type,
+					start, interval);
+			size_t num = count_edges(list, start, interval);
+			// The range has to contain all edges in the time window.
+			assert(range.first <= range.second);
+			assert(range.second <= list.size());
+			assert(count_edges(ts_list_t(list.begin() + range.first,
+							list.begin() + range.second), start, interval) == num);
+			// The range is only larger than the edges in the time window
+			// by at most an interval at each end.
+			if (num > 0) {
+				size_t first = std::lower_bound(list.begin(), list.end(),
+						ts_edge_data(start)) - list.begin();
+				size_t last = first + num;
+				assert(first - range.first <= ts_vertex_index::INTERVAL);
+				assert(range.second - last <= ts_vertex_index::INTERVAL);
+			}
+			else if (!index.has_edges(id, type, start, interval))
+				num_empty++;
+
+			vsize_t exact_num;
+			if (index.get_num_edges(id, type, start, interval, exact_num)) {
+				assert(exact_num == num);
+				num_exact++;
+			}
+		}
+		assert(num_exact >= num_empty);
+	}
+}
+
+void test_index(size_t num_vertices)
+{
+	printf("test the temporal index of %ld vertices\n", num_vertices);
+	std::vector<ts_list_t> in_lists, out_lists;
+	std::vector<vsize_t> num_in_edges, num_out_edges;
+	gen_timestamps(num_vertices, in_lists, num_in_edges);
+	gen_timestamps(num_vertices, out_lists, num_out_edges);
+	ts_vertex_index::ptr index = ts_vertex_index::create(num_vertices,
+			num_in_edges.data(), num_out_edges.data());
+	for (vertex_id_t id = 0; id < num_vertices; id++) {
+		index->set_timestamps(id, IN_EDGE, in_lists[id].begin());
+		index->set_timestamps(id, OUT_EDGE, out_lists[id].begin());
+	}
+	check_index(*index, IN_EDGE, in_lists);
+	check_index(*index, OUT_EDGE, out_lists);
+
+	std::string file = "/tmp/test-ts_vertex_index";
+	index->dump(file);
+	ts_vertex_index::ptr index1 = ts_vertex_index::load(file);
+	unlink(file.c_str());
+	assert(index1->get_num_vertices() == num_vertices);
+	assert(index1->get_mem_size() > 0 || num_vertices == 0);
+	check_index(*index1, IN_EDGE, in_lists);
+	check_index(*index1, OUT_EDGE, out_lists);
+}
+
+int main()
+{
+	test_index(0);
+	test_index(1);
+	test_index(1000);
+}
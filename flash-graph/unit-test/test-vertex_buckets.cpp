@@ -0,0 +1,117 @@
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#define BOOST_TEST_MODULE vertex_buckets
+#include <boost/test/included/unit_test.hpp>
+
+#include "vertex_buckets.h"
+
+using namespace fg;
+
+const size_t num_vertices = 100000;
+
+BOOST_AUTO_TEST_SUITE (vertex_buckets_test) // name of the test suite
+
+/*
+ * Without updates, the vertices are extracted in the order of their
+ * priorities, including the priorities beyond the first window.
+ */
+BOOST_AUTO_TEST_CASE (test_order)
+{
+	std::vector<size_t> prios(num_vertices);
+	std::vector<bool> removed(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++)
+		prios[i] = random() % 10000;
+	vertex_buckets buckets(num_vertices, [&](vertex_id_t id) -> size_t {
+			return removed[id] ? vertex_buckets::NULL_BUCKET : prios[id];
+			});
+
+	std::vector<vertex_id_t> ids;
+	size_t bucket;
+	size_t prev = 0;
+	size_t num = 0;
+	while ((bucket = buckets.next_bucket(ids)) != vertex_buckets::NULL_BUCKET) {
+		BOOST_CHECK(bucket >= prev);
+		BOOST_CHECK(!ids.empty());
+		for (size_t i = 0; i < ids.size(); i++) {
+			BOOST_CHECK_EQUAL(prios[ids[i]], bucket);
+			BOOST_CHECK(!removed[ids[i]]);
+			removed[ids[i]] = true;
+		}
+		num += ids.size();
+		prev = bucket;
+	}
+	BOOST_CHECK_EQUAL(num, num_vertices);
+}
+
+/*
+ * Compute the coreness of a random graph by peeling with the buckets and
+ * compare it with peeling one vertex at a time.
+ */
+BOOST_AUTO_TEST_CASE (test_peeling)
+{
+	const size_t n = 2000;
+	std::vector<std::vector<vertex_id_t> > adj(n);
+	for (size_t i = 0; i < n * 10; i++) {
+		vertex_id_t u = random() % n;
+		vertex_id_t v = random() % n;
+		if (u == v)
+			continue;
+		adj[u].push_back(v);
+		adj[v].push_back(u);
+	}
+
+	std::vector<size_t> expected(n);
+	std::vector<size_t> degrees(n);
+	std::vector<bool> removed(n);
+	for (size_t i = 0; i < n; i++)
+		degrees[i] = adj[i].size();
+	size_t k = 0;
+	for (size_t num = 0; num < n; num++) {
+		vertex_id_t min_v = 0;
+		size_t min_degree = vertex_buckets::NULL_BUCKET;
+		for (size_t i = 0; i < n; i++)
+			if (!removed[i] && degrees[i] < min_degree) {
+				min_degree = degrees[i];
+				min_v = i;
+			}
+		k = std::max(k, min_degree);
+		expected[min_v] = k;
+		removed[min_v] = true;
+		for (size_t j = 0; j < adj[min_v].size(); j++)
+			degrees[adj[min_v][j]]--;
+	}
+
+	std::vector<size_t> cores(n);
+	for (size_t i = 0; i < n; i++) {
+		degrees[i] = adj[i].size();
+		removed[i] = false;
+	}
+	vertex_buckets buckets(n, [&](vertex_id_t id) -> size_t {
+			return removed[id] ? vertex_buckets::NULL_BUCKET : degrees[id];
+			});
+	std::vector<vertex_id_t> ids;
+	size_t bucket;
+	while ((bucket = buckets.next_bucket(ids)) != vertex_buckets::NULL_BUCKET) {
+		for (size_t i = 0; i < ids.size(); i++) {
+			cores[ids[i]] = bucket;
+			removed[ids[i]] = true;
+		}
+		std::vector<vertex_id_t> updated;
+		for (size_t i = 0; i < ids.size(); i++) {
+			const std::vector<vertex_id_t> &neighs = adj[ids[i]];
+			for (size_t j = 0; j < neighs.size(); j++) {
+				if (removed[neighs[j]])
+					continue;
+				degrees[neighs[j]]--;
+				updated.push_back(neighs[j]);
+			}
+		}
+		buckets.update(updated.data(), updated.size());
+	}
+	BOOST_CHECK(std::equal(cores.begin(), cores.end(), expected.begin()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -167,8 +167,83 @@ void test_undirected_vertex_index()
 		assert(large_vertices1[i] == large_vertices2[i]);
 }
 
+/*
+ * The Elias-Fano vertex index should locate vertices in the same way as
+ * the compressed vertex index.
+ */
+void test_ef_vertex_index(bool directed)
+{
+	printf("test Elias-Fano vertex index of a%s graph\n",
+			directed ? " directed" : "n undirected");
+	vertex_index_construct::ptr cindex
+		= vertex_index_construct::create_compressed(directed, 0);
+	size_t num_edges = 0;
+	for (int i = 0; i < 10000; i++) {
+		if (directed) {
+			in_mem_directed_vertex<empty_data> v(i, 0);
+			if (random() % 5 == 0)
+				num_edges += construct_large_vertex(v);
+			cindex->add_vertex(v);
+		}
+		else {
+			in_mem_undirected_vertex<empty_data> v(i, 0);
+			if (random() % 5 == 0)
+				num_edges += construct_large_vertex(v);
+			cindex->add_vertex(v);
+		}
+	}
+	graph_header header(directed ? graph_type::DIRECTED : graph_type::UNDIRECTED,
+			10000, num_edges, 0);
+	vertex_index::ptr raw_index = cindex->dump(header, true);
+
+	in_mem_query_vertex_index::ptr index1
+		= in_mem_query_vertex_index::create(raw_index, true);
+	in_mem_query_vertex_index::ptr index2
+		= in_mem_query_vertex_index::create(raw_index, true, true);
+	assert(!index1->is_elias_fano());
+	assert(index2->is_elias_fano());
+	for (vertex_id_t id = 0; id < 10000; id++) {
+		assert(index1->get_num_edges(id, edge_type::IN_EDGE)
+				== index2->get_num_edges(id, edge_type::IN_EDGE));
+		assert(index1->get_num_edges(id, edge_type::OUT_EDGE)
+				== index2->get_num_edges(id, edge_type::OUT_EDGE));
+	}
+
+	if (directed) {
+		in_mem_cdirected_vertex_index::ptr cindex
+			= in_mem_cdirected_vertex_index::cast(index1);
+		in_mem_ef_directed_vertex_index::ptr ef_index
+			= in_mem_ef_directed_vertex_index::cast(index2);
+		std::vector<directed_vertex_entry> entries(10000);
+		ef_index->get_vertices(0, entries.size(), entries.data());
+		for (vertex_id_t id = 0; id < 10000; id++) {
+			directed_vertex_entry e1 = cindex->get_vertex(id);
+			directed_vertex_entry e2 = ef_index->get_vertex(id);
+			assert(e1.get_in_off() == e2.get_in_off());
+			assert(e1.get_out_off() == e2.get_out_off());
+			assert(entries[id].get_in_off() == e2.get_in_off());
+			assert(entries[id].get_out_off() == e2.get_out_off());
+		}
+	}
+	else {
+		in_mem_cundirected_vertex_index::ptr cindex
+			= in_mem_cundirected_vertex_index::cast(index1);
+		in_mem_ef_undirected_vertex_index::ptr ef_index
+			= in_mem_ef_undirected_vertex_index::cast(index2);
+		std::vector<vertex_offset> offs(10000);
+		ef_index->get_vertices(0, offs.size(), offs.data());
+		for (vertex_id_t id = 0; id < 10000; id++) {
+			assert(cindex->get_vertex(id).get_off()
+					== ef_index->get_vertex(id).get_off());
+			assert(offs[id].get_off() == ef_index->get_vertex(id).get_off());
+		}
+	}
+}
+
 int main()
 {
 	test_directed_vertex_index();
 	test_undirected_vertex_index();
+	test_ef_vertex_index(true);
+	test_ef_vertex_index(false);
 }
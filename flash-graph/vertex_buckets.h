@@ -0,0 +1,171 @@
+#ifndef __VERTEX_BUCKETS_H__
+#define __VERTEX_BUCKETS_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <assert.h>
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "FG_basic_types.h"
+
+namespace fg
+{
+
+/*
+ * This keeps vertices in buckets by an integer priority for peeling
+ * algorithms such as k-core decomposition. A peeling algorithm repeatedly
+ * takes the vertices in the lowest non-empty bucket, runs them in the graph
+ * engine, and reports the vertices whose priorities have changed.
+ *
+ * The priorities are owned by the application, and the buckets read them
+ * with `get_bucket'. Like Julienne, a vertex isn't removed from its old
+ * bucket when its priority changes. It's inserted to the new bucket and
+ * the stale entry is dropped when the old bucket is extracted. Only
+ * a window of NUM_OPEN buckets is materialized. The vertices beyond
+ * the window stay in an overflow bucket, which is redistributed when
+ * the window is exhausted.
+ *
+ * The priority of a vertex can only decrease. A vertex whose priority
+ * drops below the current bucket is processed in the current bucket.
+ * A vertex extracted from a bucket should be removed by the application
+ * before the next bucket is extracted.
+ */
+class vertex_buckets
+{
+public:
+	static const size_t NULL_BUCKET = std::numeric_limits<size_t>::max();
+	/*
+	 * It returns the priority of a vertex, or NULL_BUCKET if the vertex
+	 * has been removed.
+	 */
+	typedef std::function<size_t (vertex_id_t)> bucket_func;
+private:
+	static const size_t NUM_OPEN = 128;
+
+	bucket_func get_bucket;
+	// The first bucket in the window.
+	size_t base;
+	// The bucket being extracted.
+	size_t curr;
+	std::vector<std::vector<vertex_id_t> > open;
+	std::vector<vertex_id_t> overflow;
+
+	void insert(vertex_id_t id, size_t bucket) {
+		bucket = std::max(bucket, curr);
+		if (bucket < base + NUM_OPEN)
+			open[bucket - base].push_back(id);
+		else
+			overflow.push_back(id);
+	}
+
+	/*
+	 * Move the window to the lowest bucket in the overflow bucket.
+	 * It returns false if there aren't vertices left.
+	 */
+	bool next_window() {
+		std::vector<vertex_id_t> remaining;
+		size_t min_bucket = NULL_BUCKET;
+		for (size_t i = 0; i < overflow.size(); i++) {
+			size_t bucket = get_bucket(overflow[i]);
+			if (bucket == NULL_BUCKET)
+				continue;
+			remaining.push_back(overflow[i]);
+			min_bucket = std::min(min_bucket, bucket);
+		}
+		overflow.clear();
+		if (remaining.empty())
+			return false;
+
+		base = curr = std::max(min_bucket, curr);
+		for (size_t i = 0; i < remaining.size(); i++)
+			insert(remaining[i], get_bucket(remaining[i]));
+		return true;
+	}
+public:
+	/*
+	 * Put vertices [0, num_vertices) in the buckets.
+	 */
+	vertex_buckets(size_t num_vertices, bucket_func func): open(NUM_OPEN) {
+		this->get_bucket = func;
+		base = 0;
+		curr = 0;
+		for (size_t i = 0; i < num_vertices; i++) {
+			size_t bucket = get_bucket(i);
+			if (bucket != NULL_BUCKET)
+				insert(i, bucket);
+		}
+	}
+
+	/*
+	 * The bucket that was extracted last time.
+	 */
+	size_t get_curr_bucket() const {
+		return curr;
+	}
+
+	/*
+	 * Notify the buckets of the vertices whose priorities have decreased.
+	 */
+	void update(const vertex_id_t ids[], size_t num) {
+		for (size_t i = 0; i < num; i++) {
+			size_t bucket = get_bucket(ids[i]);
+			// A vertex beyond the window is still in the overflow bucket.
+			if (bucket == NULL_BUCKET || bucket >= base + NUM_OPEN)
+				continue;
+			insert(ids[i], bucket);
+		}
+	}
+
+	/*
+	 * Extract the vertices in the lowest non-empty bucket.
+	 * It returns the bucket, or NULL_BUCKET if there aren't vertices left.
+	 * The vertices are sorted.
+	 */
+	size_t next_bucket(std::vector<vertex_id_t> &ids) {
+		ids.clear();
+		while (true) {
+			for (; curr < base + NUM_OPEN; curr++) {
+				std::vector<vertex_id_t> &bucket = open[curr - base];
+				for (size_t i = 0; i < bucket.size(); i++) {
+					size_t b = get_bucket(bucket[i]);
+					if (b != NULL_BUCKET && std::max(b, curr) == curr)
+						ids.push_back(bucket[i]);
+				}
+				bucket.clear();
+				if (!ids.empty()) {
+					std::sort(ids.begin(), ids.end());
+					ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+					return curr;
+				}
+			}
+			if (!next_window())
+				return NULL_BUCKET;
+		}
+	}
+};
+
+}
+
+#endif
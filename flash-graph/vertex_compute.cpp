@@ -26,6 +26,23 @@ using namespace safs;
 namespace fg
 {
 
+/*
+ * Run the vertex program on a vertex whose adjacency list has been read.
+ * If the vertex has updated edges, its adjacency list is merged with
+ * the updates first.
+ */
+static inline void run_vertex_program(const graph_engine &graph,
+		vertex_program &prog, compute_vertex &v, const page_vertex &pg_v)
+{
+	const graph_delta *delta = graph.get_graph_delta();
+	if (delta && delta->has_delta(pg_v.get_id())) {
+		merged_page_vertex merged(*delta, pg_v);
+		prog.run(v, merged.get_vertex());
+	}
+	else
+		prog.run(v, pg_v);
+}
+
 request_range vertex_compute::get_next_request()
 {
 	// Get the next vertex.
@@ -100,14 +117,16 @@ void vertex_compute::run(page_byte_array &array)
 	num_complete_fetched++;
 	start_run();
 	page_undirected_vertex pg_v(array);
-	issue_thread->get_vertex_program(v.is_part()).run(*v, pg_v);
+	run_vertex_program(*graph, issue_thread->get_vertex_program(v.is_part()),
+			*v, pg_v);
 	finish_run();
 }
 
 void directed_vertex_compute::run_on_page_vertex(page_directed_vertex &pg_v)
 {
 	start_run();
-	issue_thread->get_vertex_program(v.is_part()).run(*v, pg_v);
+	run_vertex_program(*graph, issue_thread->get_vertex_program(v.is_part()),
+			*v, pg_v);
 	finish_run();
 }
 
@@ -252,7 +271,7 @@ void merged_undirected_vertex_compute::run(page_byte_array &array)
 		assert(pg_v.get_id() == id);
 		compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
 		start_run(v);
-		curr_vprog.run(*v, pg_v);
+		run_vertex_program(get_graph(), curr_vprog, *v, pg_v);
 		finish_run(v);
 		off += pg_v.get_size();
 	}
@@ -274,7 +293,7 @@ void merged_directed_vertex_compute::run_on_array(page_byte_array &array)
 		assert(pg_v.get_id() == id);
 		compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
 		start_run(v);
-		curr_vprog.run(*v, pg_v);
+		run_vertex_program(get_graph(), curr_vprog, *v, pg_v);
 		finish_run(v);
 		if (in_part)
 			off += pg_v.get_in_size();
@@ -299,7 +318,7 @@ void merged_directed_vertex_compute::run_on_arrays(page_byte_array &in_arr,
 		assert(pg_v.get_id() == id);
 		compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
 		start_run(v);
-		curr_vprog.run(*v, pg_v);
+		run_vertex_program(get_graph(), curr_vprog, *v, pg_v);
 		finish_run(v);
 		in_off += pg_v.get_in_size();
 		out_off += pg_v.get_out_size();
@@ -377,7 +396,7 @@ void sparse_undirected_vertex_compute::run(page_byte_array &arr)
 			assert(pg_v.get_id() == id);
 			compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
 			start_run(v);
-			curr_vprog.run(*v, pg_v);
+			run_vertex_program(get_graph(), curr_vprog, *v, pg_v);
 			finish_run(v);
 			off += pg_v.get_size();
 		}
@@ -402,7 +421,7 @@ void sparse_directed_vertex_compute::run_on_array(page_byte_array &arr)
 			assert(pg_v.get_id() == id);
 			compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
 			start_run(v);
-			curr_vprog.run(*v, pg_v);
+			run_vertex_program(get_graph(), curr_vprog, *v, pg_v);
 			finish_run(v);
 			if (in_part)
 				off += pg_v.get_in_size();
@@ -437,7 +456,7 @@ void sparse_directed_vertex_compute::run_on_arrays(page_byte_array &in_arr,
 			assert(pg_v.get_id() == id);
 			compute_vertex_pointer v(&get_graph().get_vertex(pg_v.get_id()));
 			start_run(v);
-			curr_vprog.run(*v, pg_v);
+			run_vertex_program(get_graph(), curr_vprog, *v, pg_v);
 			finish_run(v);
 			in_off += pg_v.get_in_size();
 			out_off += pg_v.get_out_size();
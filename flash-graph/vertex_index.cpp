@@ -777,10 +777,111 @@ public:
 	}
 };
 
+in_mem_ef_undirected_vertex_index::in_mem_ef_undirected_vertex_index(
+		vertex_index &index): in_mem_query_vertex_index(false, true, true)
+{
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	// We get the locations of vertices from the compressed index.
+	in_mem_cundirected_vertex_index::ptr cindex
+		= in_mem_cundirected_vertex_index::create(index);
+	num_vertices = cindex->get_num_vertices();
+	edge_data_size = index.get_graph_header().get_edge_data_size();
+
+	off_t end_off = 0;
+	if (num_vertices > 0)
+		end_off = cindex->get_vertex(num_vertices - 1).get_off()
+			+ cindex->get_size(num_vertices - 1);
+	offs.init(num_vertices + 1, end_off);
+	off_t off = 0;
+	for (vertex_id_t id = 0; id < num_vertices; id++) {
+		if (id % compressed_vertex_entry::ENTRY_SIZE == 0)
+			off = cindex->get_vertex(id).get_off();
+		offs.append(off);
+		off += cindex->get_size(id);
+	}
+	offs.append(end_off);
+	offs.finalize();
+
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("init in-mem Elias-Fano index (%1% bytes) takes %2% seconds")
+		% get_mem_size() % time_diff(start, end);
+}
+
+void in_mem_ef_undirected_vertex_index::get_vertices(vertex_id_t start_id,
+		size_t num, vertex_offset vs[]) const
+{
+	elias_fano_array::const_iterator it = offs.get_iterator(start_id);
+	for (size_t i = 0; i < num; i++)
+		vs[i] = vertex_offset(it.next());
+}
+
+in_mem_ef_directed_vertex_index::in_mem_ef_directed_vertex_index(
+		vertex_index &index): in_mem_query_vertex_index(true, true, true)
+{
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	// We get the locations of vertices from the compressed index.
+	in_mem_cdirected_vertex_index::ptr cindex
+		= in_mem_cdirected_vertex_index::create(index);
+	num_vertices = cindex->get_num_vertices();
+	edge_data_size = index.get_graph_header().get_edge_data_size();
+
+	off_t end_in_off = 0;
+	off_t end_out_off = 0;
+	if (num_vertices > 0) {
+		directed_vertex_entry e = cindex->get_vertex(num_vertices - 1);
+		end_in_off = e.get_in_off() + cindex->get_in_size(num_vertices - 1);
+		end_out_off = e.get_out_off() + cindex->get_out_size(num_vertices - 1);
+	}
+	in_offs.init(num_vertices + 1, end_in_off);
+	out_offs.init(num_vertices + 1, end_out_off);
+	off_t in_off = 0;
+	off_t out_off = 0;
+	for (vertex_id_t id = 0; id < num_vertices; id++) {
+		if (id % compressed_vertex_entry::ENTRY_SIZE == 0) {
+			directed_vertex_entry e = cindex->get_vertex(id);
+			in_off = e.get_in_off();
+			out_off = e.get_out_off();
+		}
+		in_offs.append(in_off);
+		out_offs.append(out_off);
+		in_off += cindex->get_in_size(id);
+		out_off += cindex->get_out_size(id);
+	}
+	in_offs.append(end_in_off);
+	out_offs.append(end_out_off);
+	in_offs.finalize();
+	out_offs.finalize();
+
+	gettimeofday(&end, NULL);
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("init in-mem Elias-Fano index (%1% bytes) takes %2% seconds")
+		% get_mem_size() % time_diff(start, end);
+}
+
+void in_mem_ef_directed_vertex_index::get_vertices(vertex_id_t start_id,
+		size_t num, directed_vertex_entry vs[]) const
+{
+	elias_fano_array::const_iterator in_it = in_offs.get_iterator(start_id);
+	elias_fano_array::const_iterator out_it = out_offs.get_iterator(start_id);
+	for (size_t i = 0; i < num; i++) {
+		off_t in_off = in_it.next();
+		vs[i] = directed_vertex_entry(in_off, out_it.next());
+	}
+}
+
 in_mem_query_vertex_index::ptr in_mem_query_vertex_index::create(
-		vertex_index::ptr index, bool compress)
+		vertex_index::ptr index, bool compress, bool elias_fano)
 {
-	if (index->is_compressed() || compress) {
+	if (elias_fano) {
+		if (index->get_graph_header().is_directed_graph())
+			return in_mem_ef_directed_vertex_index::create(*index);
+		else
+			return in_mem_ef_undirected_vertex_index::create(*index);
+	}
+	else if (index->is_compressed() || compress) {
 		if (index->get_graph_header().is_directed_graph())
 			return in_mem_cdirected_vertex_index::create(*index);
 		else
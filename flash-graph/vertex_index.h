@@ -30,6 +30,7 @@
 
 #include "vertex.h"
 #include "graph_file_header.h"
+#include "elias_fano.h"
 
 namespace fg
 {
@@ -640,14 +641,22 @@ class in_mem_query_vertex_index
 {
 	bool directed;
 	bool compressed;
+	bool elias_fano;
 protected:
-	in_mem_query_vertex_index(bool directed, bool compressed) {
+	in_mem_query_vertex_index(bool directed, bool compressed,
+			bool elias_fano = false) {
 		this->directed = directed;
 		this->compressed = compressed;
+		this->elias_fano = elias_fano;
 	}
 public:
 	typedef std::shared_ptr<in_mem_query_vertex_index> ptr;
-	static ptr create(vertex_index::ptr index, bool compress);
+	/*
+	 * If `elias_fano' is true, the locations of vertices are stored with
+	 * Elias-Fano coding instead of in compressed vertex entries.
+	 */
+	static ptr create(vertex_index::ptr index, bool compress,
+			bool elias_fano = false);
 
 	bool is_directed() const {
 		return directed;
@@ -657,6 +666,10 @@ public:
 		return compressed;
 	}
 
+	bool is_elias_fano() const {
+		return elias_fano;
+	}
+
 	virtual vsize_t get_num_edges(vertex_id_t id, edge_type type) const = 0;
 	virtual vertex_index::ptr get_raw_index() const = 0;
 };
@@ -686,6 +699,7 @@ public:
 
 	static ptr cast(in_mem_query_vertex_index::ptr index) {
 		assert(index->is_compressed());
+		assert(!index->is_elias_fano());
 		assert(!index->is_directed());
 		return std::static_pointer_cast<in_mem_cundirected_vertex_index,
 			   in_mem_query_vertex_index>(index);
@@ -751,6 +765,7 @@ public:
 
 	static ptr cast(in_mem_query_vertex_index::ptr index) {
 		assert(index->is_compressed());
+		assert(!index->is_elias_fano());
 		assert(index->is_directed());
 		return std::static_pointer_cast<in_mem_cdirected_vertex_index,
 			   in_mem_query_vertex_index>(index);
@@ -820,6 +835,170 @@ public:
 	void verify_against(directed_vertex_index &index);
 };
 
+/*
+ * This is the in-memory vertex index for an undirected graph that stores
+ * the locations of vertices with Elias-Fano coding. It takes a few bits
+ * for each vertex and gets the location of any vertex in constant time
+ * without decoding the other vertices in a compressed vertex entry.
+ */
+class in_mem_ef_undirected_vertex_index: public in_mem_query_vertex_index
+{
+	size_t num_vertices;
+	size_t edge_data_size;
+	// It has an additional entry for the end of the last vertex.
+	elias_fano_array offs;
+
+	in_mem_ef_undirected_vertex_index(vertex_index &index);
+public:
+	typedef std::shared_ptr<in_mem_ef_undirected_vertex_index> ptr;
+
+	static ptr cast(in_mem_query_vertex_index::ptr index) {
+		assert(index->is_elias_fano());
+		assert(!index->is_directed());
+		return std::static_pointer_cast<in_mem_ef_undirected_vertex_index,
+			   in_mem_query_vertex_index>(index);
+	}
+
+	static ptr create(vertex_index &index) {
+		return ptr(new in_mem_ef_undirected_vertex_index(index));
+	}
+
+	size_t get_num_vertices() const {
+		return num_vertices;
+	}
+
+	size_t get_size(vertex_id_t id) const {
+		elias_fano_array::const_iterator it = offs.get_iterator(id);
+		off_t off = it.next();
+		return it.next() - off;
+	}
+
+	vsize_t get_num_edges(vertex_id_t id, edge_type type) const {
+		return ext_mem_undirected_vertex::vsize2num_edges(get_size(id),
+				edge_data_size);
+	}
+
+	vertex_index::ptr get_raw_index() const {
+		return vertex_index::ptr();
+	}
+
+	vertex_offset get_vertex(vertex_id_t id) const {
+		return vertex_offset(offs.get(id));
+	}
+
+	/*
+	 * Get the locations of the vertices in [start_id, start_id + num).
+	 * It's much cheaper than getting the locations one by one.
+	 */
+	void get_vertices(vertex_id_t start_id, size_t num,
+			vertex_offset vs[]) const;
+
+	const elias_fano_array &get_offs() const {
+		return offs;
+	}
+
+	size_t get_mem_size() const {
+		return offs.get_mem_size();
+	}
+};
+
+/*
+ * This is the in-memory vertex index for a directed graph that stores
+ * the locations of the in-parts and out-parts of vertices with Elias-Fano
+ * coding.
+ */
+class in_mem_ef_directed_vertex_index: public in_mem_query_vertex_index
+{
+	size_t num_vertices;
+	size_t edge_data_size;
+	// They have an additional entry for the end of the last vertex.
+	elias_fano_array in_offs;
+	elias_fano_array out_offs;
+
+	in_mem_ef_directed_vertex_index(vertex_index &index);
+
+	static size_t get_size(const elias_fano_array &offs, vertex_id_t id) {
+		elias_fano_array::const_iterator it = offs.get_iterator(id);
+		off_t off = it.next();
+		return it.next() - off;
+	}
+public:
+	typedef std::shared_ptr<in_mem_ef_directed_vertex_index> ptr;
+
+	static ptr cast(in_mem_query_vertex_index::ptr index) {
+		assert(index->is_elias_fano());
+		assert(index->is_directed());
+		return std::static_pointer_cast<in_mem_ef_directed_vertex_index,
+			   in_mem_query_vertex_index>(index);
+	}
+
+	static ptr create(vertex_index &index) {
+		return ptr(new in_mem_ef_directed_vertex_index(index));
+	}
+
+	size_t get_num_vertices() const {
+		return num_vertices;
+	}
+
+	size_t get_in_size(vertex_id_t id) const {
+		return get_size(in_offs, id);
+	}
+
+	size_t get_out_size(vertex_id_t id) const {
+		return get_size(out_offs, id);
+	}
+
+	vsize_t get_num_in_edges(vertex_id_t id) const {
+		return ext_mem_undirected_vertex::vsize2num_edges(get_in_size(id),
+				edge_data_size);
+	}
+
+	vsize_t get_num_out_edges(vertex_id_t id) const {
+		return ext_mem_undirected_vertex::vsize2num_edges(get_out_size(id),
+				edge_data_size);
+	}
+
+	virtual vsize_t get_num_edges(vertex_id_t id, edge_type type) const {
+		switch (type) {
+			case edge_type::IN_EDGE:
+				return get_num_in_edges(id);
+			case edge_type::OUT_EDGE:
+				return get_num_out_edges(id);
+			case edge_type::BOTH_EDGES:
+				return get_num_in_edges(id) + get_num_out_edges(id);
+			default:
+				ABORT_MSG("wrong edge type");
+		}
+	}
+
+	vertex_index::ptr get_raw_index() const {
+		return vertex_index::ptr();
+	}
+
+	directed_vertex_entry get_vertex(vertex_id_t id) const {
+		return directed_vertex_entry(in_offs.get(id), out_offs.get(id));
+	}
+
+	/*
+	 * Get the locations of the vertices in [start_id, start_id + num).
+	 * It's much cheaper than getting the locations one by one.
+	 */
+	void get_vertices(vertex_id_t start_id, size_t num,
+			directed_vertex_entry vs[]) const;
+
+	const elias_fano_array &get_in_offs() const {
+		return in_offs;
+	}
+
+	const elias_fano_array &get_out_offs() const {
+		return out_offs;
+	}
+
+	size_t get_mem_size() const {
+		return in_offs.get_mem_size() + out_offs.get_mem_size();
+	}
+};
+
 static inline int get_index_entry_size(graph_type type)
 {
 	switch (type) {
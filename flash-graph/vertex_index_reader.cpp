@@ -149,7 +149,7 @@ public:
 };
 
 /*
- * This template accesses the compressed vertex index in memory.
+ * This template accesses the compressed or Elias-Fano vertex index in memory.
  */
 template<class vertex_index_type, class iterator_type>
 class in_mem_cindex_reader: public vertex_index_reader
@@ -186,7 +186,15 @@ vertex_index_reader::ptr vertex_index_reader::create(
 		const in_mem_query_vertex_index::ptr index, bool directed)
 {
 	bool compressed = index->is_compressed();
-	if (!compressed && directed)
+	if (index->is_elias_fano() && directed)
+		return in_mem_cindex_reader<in_mem_ef_directed_vertex_index,
+			   ef_directed_index_iterator>::create(
+					   in_mem_ef_directed_vertex_index::cast(index));
+	else if (index->is_elias_fano() && !directed)
+		return in_mem_cindex_reader<in_mem_ef_undirected_vertex_index,
+			   ef_undirected_index_iterator>::create(
+					   in_mem_ef_undirected_vertex_index::cast(index));
+	else if (!compressed && directed)
 		return in_mem_vindex_reader_impl<directed_vertex_entry>::create(
 				index->get_raw_index());
 	else if (!compressed && !directed)
@@ -294,6 +294,120 @@ public:
 	}
 };
 
+/*
+ * This iterates on the Elias-Fano vertex index of an undirected graph.
+ * It decodes the locations of vertices sequentially.
+ */
+class ef_undirected_index_iterator: public index_iterator
+{
+	size_t begin;
+	size_t idx;
+	size_t end;
+	const in_mem_ef_undirected_vertex_index &index;
+	elias_fano_array::const_iterator it;
+
+	void init_bufs() {
+		new (curr_buf) vertex_offset(it.next());
+		new (next_buf) vertex_offset(it.next());
+	}
+public:
+	ef_undirected_index_iterator(const in_mem_ef_undirected_vertex_index &_index,
+			const id_range_t &range): index(_index), it(
+				_index.get_offs().get_iterator(range.first)) {
+		init_bufs();
+		begin = idx = range.first;
+		end = range.second;
+		_has_next = true;
+	}
+
+	virtual void move_next() {
+		const vertex_offset *v_next_off
+			= reinterpret_cast<const vertex_offset *>(next_buf);
+		vertex_offset e = *v_next_off;
+		new (curr_buf) vertex_offset(e);
+		idx++;
+		_has_next = (idx < end);
+		if (_has_next)
+			new (next_buf) vertex_offset(it.next());
+	}
+
+	virtual bool move_to(off_t rel_idx) {
+		this->idx = begin + rel_idx;
+		if ((size_t) idx < end) {
+			it = index.get_offs().get_iterator(idx);
+			init_bufs();
+			_has_next = true;
+		}
+		else
+			_has_next = false;
+		return _has_next;
+	}
+
+	virtual int get_num_vertices() const {
+		return end - idx;
+	}
+};
+
+/*
+ * This iterates on the Elias-Fano vertex index of a directed graph.
+ */
+class ef_directed_index_iterator: public index_iterator
+{
+	size_t begin;
+	size_t idx;
+	size_t end;
+	const in_mem_ef_directed_vertex_index &index;
+	elias_fano_array::const_iterator in_it;
+	elias_fano_array::const_iterator out_it;
+
+	void init_bufs() {
+		off_t in_off = in_it.next();
+		new (curr_buf) directed_vertex_entry(in_off, out_it.next());
+		in_off = in_it.next();
+		new (next_buf) directed_vertex_entry(in_off, out_it.next());
+	}
+public:
+	ef_directed_index_iterator(const in_mem_ef_directed_vertex_index &_index,
+			const id_range_t &range): index(_index), in_it(
+				_index.get_in_offs().get_iterator(range.first)), out_it(
+				_index.get_out_offs().get_iterator(range.first)) {
+		init_bufs();
+		begin = idx = range.first;
+		end = range.second;
+		_has_next = true;
+	}
+
+	virtual void move_next() {
+		const directed_vertex_entry *v_next_entry
+			= reinterpret_cast<const directed_vertex_entry *>(next_buf);
+		directed_vertex_entry e = *v_next_entry;
+		new (curr_buf) directed_vertex_entry(e);
+		idx++;
+		_has_next = (idx < end);
+		if (_has_next) {
+			off_t in_off = in_it.next();
+			new (next_buf) directed_vertex_entry(in_off, out_it.next());
+		}
+	}
+
+	virtual bool move_to(off_t rel_idx) {
+		this->idx = begin + rel_idx;
+		if ((size_t) idx < end) {
+			in_it = index.get_in_offs().get_iterator(idx);
+			out_it = index.get_out_offs().get_iterator(idx);
+			init_bufs();
+			_has_next = true;
+		}
+		else
+			_has_next = false;
+		return _has_next;
+	}
+
+	virtual int get_num_vertices() const {
+		return end - idx;
+	}
+};
+
 /*
  * This interface defines the method invoked in vertex_index_reader.
  * It is designed to compute on multiple index entries. If we require
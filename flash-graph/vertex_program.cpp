@@ -25,6 +25,7 @@
 #include "messaging.h"
 #include "worker_thread.h"
 #include "message_processor.h"
+#include "frontier.h"
 
 namespace fg
 {
@@ -39,6 +40,8 @@ vertex_program::~vertex_program()
 		multicast_msg_sender::destroy(multicast_senders[i]);
 	for (unsigned i = 0; i < activate_senders.size(); i++)
 		multicast_msg_sender::destroy(activate_senders[i]);
+	for (unsigned i = 0; i < combine_senders.size(); i++)
+		combine_msg_sender::destroy(combine_senders[i]);
 }
 
 void vertex_program::init(graph_engine *graph, worker_thread *t)
@@ -72,6 +75,13 @@ void vertex_program::init_messaging(const std::vector<worker_thread *> &threads,
 		activate_sender->init(msg);
 		activate_senders.push_back(activate_sender);
 	}
+	vertex_msg_combiner::ptr combiner = graph->get_msg_combiner();
+	if (combiner) {
+		for (unsigned i = 0; i < threads.size(); i++)
+			combine_senders.push_back(combine_msg_sender::create(combiner,
+						*msg_senders[i], graph->get_partitioner()->get_part_size(i,
+							graph->get_num_vertices())));
+	}
 }
 
 void vertex_program::multicast_msg(vertex_id_t ids[], int num,
@@ -83,7 +93,9 @@ void vertex_program::multicast_msg(vertex_id_t ids[], int num,
 	if (num == 0)
 		return;
 
-	if (num < graph->get_num_threads() * 2) {
+	// Messages to different vertices can't be merged in a multicast message,
+	// so we send them one by one if they can be combined.
+	if (num < graph->get_num_threads() * 2 || !combine_senders.empty()) {
 		for (int i = 0; i < num; i++)
 			this->send_msg(ids[i], msg);
 		return;
@@ -113,7 +125,7 @@ void vertex_program::multicast_msg(edge_seq_iterator &it, vertex_message &msg)
 	if (num_dests == 0)
 		return;
 
-	if (num_dests < graph->get_num_threads() * 2) {
+	if (num_dests < graph->get_num_threads() * 2 || !combine_senders.empty()) {
 		PAGE_FOREACH(vertex_id_t, id, it) {
 			this->send_msg(id, msg);
 		} PAGE_FOREACH_END
@@ -150,12 +162,16 @@ void vertex_program::send_msg(vertex_id_t dest, vertex_message &msg)
 		// the flush message.
 		get_activate_sender(part_id).flush();
 		get_multicast_sender(part_id).flush();
+		if (!combine_senders.empty())
+			combine_senders[part_id]->flush_combined();
 		get_msg_sender(part_id).flush();
 
 		simple_msg_sender &sender = get_flush_msg_sender(part_id);
 		sender.send_cached(msg);
 		sender.flush();
 	}
+	else if (!combine_senders.empty())
+		combine_senders[part_id]->send(msg);
 	else {
 		simple_msg_sender &sender = get_msg_sender(part_id);
 		sender.send_cached(msg);
@@ -196,6 +212,44 @@ void vertex_program::activate_vertices(vertex_id_t ids[], int num)
 	}
 }
 
+namespace
+{
+
+/*
+ * This collects the vertices in a frontier and activates them in batches.
+ */
+class frontier_activator
+{
+	static const size_t BATCH_SIZE = 4096;
+	vertex_program &prog;
+	std::vector<vertex_id_t> buf;
+public:
+	frontier_activator(vertex_program &_prog): prog(_prog) {
+		buf.reserve(BATCH_SIZE);
+	}
+
+	void operator()(vertex_id_t id) {
+		buf.push_back(id);
+		if (buf.size() == BATCH_SIZE)
+			flush();
+	}
+
+	void flush() {
+		if (!buf.empty())
+			prog.activate_vertices(buf.data(), buf.size());
+		buf.clear();
+	}
+};
+
+}
+
+void vertex_program::activate_vertices(vertex_frontier &frontier)
+{
+	frontier_activator activator(*this);
+	frontier.for_each(activator);
+	activator.flush();
+}
+
 void vertex_program::activate_vertices(edge_seq_iterator &it)
 {
 	worker_thread *curr = (worker_thread *) thread::get_curr_thread();
@@ -245,6 +299,8 @@ void vertex_program::activate_vertices(edge_seq_iterator &it)
 
 void vertex_program::flush_msgs()
 {
+	for (size_t i = 0; i < combine_senders.size(); i++)
+		combine_senders[i]->flush_combined();
 	for (size_t i = 0; i < msg_senders.size(); i++)
 		msg_senders[i]->flush();
 	for (size_t i = 0; i < multicast_senders.size(); i++)
@@ -303,4 +359,20 @@ vsize_t vertex_program::get_num_edges(vertex_id_t id) const
 	return graph->get_num_edges(id);
 }
 
+size_t vertex_program::get_num_combiner_msgs() const
+{
+	size_t num = 0;
+	for (size_t i = 0; i < combine_senders.size(); i++)
+		num += combine_senders[i]->get_num_sent();
+	return num;
+}
+
+size_t vertex_program::get_num_combined_msgs() const
+{
+	size_t num = 0;
+	for (size_t i = 0; i < combine_senders.size(); i++)
+		num += combine_senders[i]->get_num_combined();
+	return num;
+}
+
 }
@@ -35,6 +35,7 @@ class compute_vertex;
 class page_vertex;
 class vertex_message;
 class worker_thread;
+class vertex_frontier;
 
 /**
  *  This class allows users to customize the default `vertex_program`.
@@ -59,6 +60,9 @@ class vertex_program
 	std::vector<simple_msg_sender *> flush_msg_senders;
 	std::vector<multicast_msg_sender *> multicast_senders;
 	std::vector<multicast_msg_sender *> activate_senders;
+	// The senders that merge messages to the same vertex. They're only
+	// created when the graph engine has a message combiner.
+	std::vector<combine_msg_sender *> combine_senders;
     
 	multicast_msg_sender &get_activate_sender(int thread_id) const {
 		return *activate_senders[thread_id];
@@ -206,6 +210,13 @@ public:
      *  \param it An `edge_seq_iterator` defining which vertices to activate in the next iteration.
 	 */
 	void activate_vertices(edge_seq_iterator &it);
+
+	/**
+	 * \brief Activate all vertices in a frontier to be processed in
+	 * the next level (iteration).
+	 *  \param frontier The set of vertices to be activated.
+	 */
+	void activate_vertices(vertex_frontier &frontier);
     
     /**
 	 * \brief Activate a singel vertex to be processed in the next level (iteration).
@@ -229,6 +240,18 @@ public:
 	vertex_id_t get_vertex_id(compute_vertex_pointer v) const;
 	vertex_id_t get_vertex_id(const compute_vertex &v) const;
 	vsize_t get_num_edges(vertex_id_t id) const;
+
+	/**
+	 * \brief Get the number of point-to-point messages sent by
+	 * the vertex program to the message combiner.
+	 */
+	size_t get_num_combiner_msgs() const;
+
+	/**
+	 * \brief Get the number of messages that have been merged to another
+	 * message to the same vertex by the message combiner.
+	 */
+	size_t get_num_combined_msgs() const;
 	int get_partition_id() const {
 		return part_id;
 	}
@@ -0,0 +1,218 @@
+#ifndef __VERTEX_STATE_H__
+#define __VERTEX_STATE_H__
+
+/*
+ * Copyright 2014 Open Connectome Project (http://openconnecto.me)
+ * Written by Da Zheng (zhengda1936@gmail.com)
+ *
+ * This file is part of FlashGraph.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <numa.h>
+
+#include <memory>
+#include <vector>
+#include <type_traits>
+
+#include "graph_engine.h"
+#include "partitioner.h"
+#include "FG_vector.h"
+
+namespace fg
+{
+
+/**
+ * \brief A column of vertex state stored in the structure-of-arrays layout.
+ *
+ * The graph engine keeps compute_vertex objects in arrays of structs, so
+ * reading one field of a neighbor through graph_engine::get_vertex pulls
+ * the whole object into the CPU cache. Instead, a vertex program can
+ * declare the fields that are read by other vertices as columns. A column
+ * is partitioned in the same way as the vertices in the graph engine:
+ * the i-th partition belongs to the i-th worker thread and is allocated
+ * on the NUMA node where the worker thread runs.
+ *
+ * A column doesn't synchronize accesses. The same as the fields in
+ * compute_vertex, a vertex should only modify its own entries, and other
+ * vertices may see the old or the new value.
+ *
+ * The entries are constructed in raw NUMA memory and never destroyed,
+ * so the type of the entries has to be trivially copyable.
+ */
+template<class T>
+class vertex_column
+{
+	static_assert(std::is_trivially_copyable<T>::value,
+			"the entries of a vertex column must be trivially copyable");
+
+	// We keep a reference to the graph engine so the partitioner stays alive.
+	graph_engine::ptr graph;
+	const graph_partitioner &partitioner;
+	std::vector<T *> part_arrs;
+	std::vector<size_t> part_sizes;
+
+	vertex_column(graph_engine::ptr graph,
+			const T &init_val): partitioner(*graph->get_partitioner()) {
+		this->graph = graph;
+		int num_parts = graph->get_num_threads();
+		int num_nodes = graph->get_num_nodes();
+		part_arrs.resize(num_parts);
+		part_sizes.resize(num_parts);
+		for (int i = 0; i < num_parts; i++) {
+			part_sizes[i] = partitioner.get_part_size(i,
+					graph->get_num_vertices());
+			// We don't want an empty allocation for an empty partition.
+			part_arrs[i] = (T *) numa_alloc_onnode(
+					sizeof(T) * std::max(part_sizes[i], 1UL), i % num_nodes);
+			assert(part_arrs[i]);
+		}
+		fill(init_val);
+	}
+public:
+	typedef std::shared_ptr<vertex_column<T> > ptr;
+
+	/**
+	 * \brief Create a column for all vertices in the graph.
+	 * \param graph The graph engine whose vertices the column belongs to.
+	 * \param init_val The initial value of all entries.
+	 */
+	static ptr create(graph_engine::ptr graph, const T &init_val = T()) {
+		return ptr(new vertex_column<T>(graph, init_val));
+	}
+
+	~vertex_column() {
+		for (size_t i = 0; i < part_arrs.size(); i++)
+			numa_free(part_arrs[i], sizeof(T) * std::max(part_sizes[i], 1UL));
+	}
+
+	/**
+	 * \brief Set all entries in the column to the same value.
+	 * **parallel**
+	 */
+	void fill(const T &val) {
+#pragma omp parallel for
+		for (size_t i = 0; i < part_arrs.size(); i++) {
+			for (size_t j = 0; j < part_sizes[i]; j++)
+				new (part_arrs[i] + j) T(val);
+		}
+	}
+
+	size_t get_num_parts() const {
+		return part_arrs.size();
+	}
+
+	size_t get_part_size(int part_id) const {
+		return part_sizes[part_id];
+	}
+
+	/**
+	 * \brief Get the entries of a partition. They're ordered by the
+	 * local IDs of the vertices in the partition.
+	 */
+	T *get_part(int part_id) {
+		return part_arrs[part_id];
+	}
+
+	const T *get_part(int part_id) const {
+		return part_arrs[part_id];
+	}
+
+	T &get(vertex_id_t id) {
+		int part_id;
+		off_t off;
+		partitioner.map2loc(id, part_id, off);
+		return part_arrs[part_id][off];
+	}
+
+	const T &get(vertex_id_t id) const {
+		int part_id;
+		off_t off;
+		partitioner.map2loc(id, part_id, off);
+		return part_arrs[part_id][off];
+	}
+
+	T &get(int part_id, local_vid_t id) {
+		return part_arrs[part_id][id.id];
+	}
+
+	const T &get(int part_id, local_vid_t id) const {
+		return part_arrs[part_id][id.id];
+	}
+
+	/**
+	 * \brief Get the entry of a vertex in the vertex program that runs
+	 * the vertex. It avoids mapping the vertex ID to its location.
+	 */
+	T &get(const vertex_program &prog, const compute_vertex &v) {
+		int part_id = prog.get_partition_id();
+		return get(part_id,
+				graph->get_graph_index().get_local_id(part_id, v));
+	}
+
+	/**
+	 * \brief Gather the values of vertices at the given locations.
+	 * The locations can be computed once by the partitioner and used to
+	 * gather multiple columns. The loop doesn't have virtual calls.
+	 */
+	void gather(const vertex_loc_t locs[], size_t num, T vals[]) const {
+		for (size_t i = 0; i < num; i++)
+			vals[i] = part_arrs[locs[i].first][locs[i].second.id];
+	}
+
+	/**
+	 * \brief Gather the values of the vertices in an edge list.
+	 * \param it The iterator on the edge list. It's consumed by the method.
+	 * \param vals The buffer that has space for all vertices in `it'.
+	 * \return The number of values gathered.
+	 */
+	size_t gather(edge_seq_iterator &it, T vals[]) const {
+		static thread_local std::vector<vertex_loc_t> locs;
+		size_t num = it.get_num_tot_entries();
+		if (locs.size() < num)
+			locs.resize(num);
+		num = partitioner.map2loc(it, locs.data(), num);
+		gather(locs.data(), num, vals);
+		return num;
+	}
+
+	size_t gather(const vertex_id_t ids[], size_t num, T vals[]) const {
+		for (size_t i = 0; i < num; i++)
+			vals[i] = get(ids[i]);
+		return num;
+	}
+
+	/**
+	 * \brief Copy the column to an FG_vector indexed by vertex ID.
+	 * **parallel**
+	 */
+	typename FG_vector<T>::ptr conv2FG_vector() const {
+		size_t num_vertices = graph->get_num_vertices();
+		typename FG_vector<T>::ptr vec = FG_vector<T>::create(num_vertices);
+#pragma omp parallel for
+		for (size_t i = 0; i < part_arrs.size(); i++) {
+			for (size_t j = 0; j < part_sizes[i]; j++) {
+				vertex_id_t id;
+				partitioner.loc2map(i, j, id);
+				if (id < num_vertices)
+					vec->set(id, part_arrs[i][j]);
+			}
+		}
+		return vec;
+	}
+};
+
+}
+
+#endif
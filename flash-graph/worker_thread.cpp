@@ -17,6 +17,8 @@
  * limitations under the License.
  */
 
+#include <sched.h>
+
 #include <atomic>
 
 #include "io_interface.h"
@@ -330,6 +332,8 @@ void customized_vertex_queue::init(worker_thread &t)
 	get_compute_vertex_pointers(vertices, vpart_ps);
 
 	scheduler->schedule(*vprog, sorted_vertices);
+	if (graph.is_async_mode())
+		defer_vertices(t);
 	bool forward = true;
 	if (graph_conf.get_elevator_enabled())
 		forward = graph.get_curr_level() % 2;
@@ -337,6 +341,30 @@ void customized_vertex_queue::init(worker_thread &t)
 	pthread_spin_unlock(&lock);
 }
 
+/*
+ * The scheduler may only allow the first part of the scheduled vertices
+ * to run now. The remaining vertices are activated again, so they are
+ * scheduled with the vertices activated in the next level.
+ */
+void customized_vertex_queue::defer_vertices(worker_thread &t)
+{
+	size_t num_runs = scheduler->get_num_runnable(*vprog, sorted_vertices);
+	if (num_runs >= sorted_vertices.size())
+		return;
+	// We have to run at least one vertex to make progress.
+	num_runs = std::max(num_runs, 1UL);
+	size_t num_kept = num_runs;
+	for (size_t i = num_runs; i < sorted_vertices.size(); i++) {
+		compute_vertex_pointer v = sorted_vertices[i];
+		// The vertically partitioned vertices always run.
+		if (v.is_part())
+			sorted_vertices[num_kept++] = v;
+		else
+			t.activate_vertex(index.get_local_id(part_id, *v));
+	}
+	sorted_vertices.resize(num_kept);
+}
+
 worker_thread::worker_thread(graph_engine *graph,
 		file_io_factory::shared_ptr graph_factory,
 		file_io_factory::shared_ptr index_factory,
@@ -351,6 +379,8 @@ worker_thread::worker_thread(graph_engine *graph,
 	this->vprogram = prog;
 	this->vpart_vprogram = vpart_prog;
 	start_all = false;
+	async_level = 0;
+	prof = NULL;
 	this->worker_id = worker_id;
 	this->graph = graph;
 	this->io = NULL;
@@ -424,6 +454,8 @@ void worker_thread::init()
 				new default_vertex_queue(*graph, worker_id, get_node_id()));
 
 	io = create_io(graph_factory, this);
+	if (graph->get_profiler())
+		prof = &graph->get_profiler()->get_thread(worker_id);
 	if (graph->get_in_mem_index())
 		index_reader = simple_index_reader::create(
 				graph->get_in_mem_index(),
@@ -508,16 +540,25 @@ int worker_thread::process_activated_vertices(int max)
 
 	process_vertex_buf.resize(max);
 	int num = curr_activated_vertices->fetch(process_vertex_buf.data(), max);
-	if (num == 0) {
+	// In the asynchronous mode, a thread refills its queue as soon as
+	// it has processed its own vertices. If it stole vertices, a vertex
+	// might run in two threads at the same time.
+	if (num == 0 && !graph->is_async_mode()) {
 		assert(curr_activated_vertices->is_empty());
+		prof_timer timer(prof, PROF_STEAL);
 		num = balancer->steal_activated_vertices(process_vertex_buf.data(),
 				max);
 	}
-	if (num > 0) {
-		num_activated_vertices_in_level.inc(num);
+	if (num == 0)
+		return 0;
+
+	num_activated_vertices_in_level.inc(num);
+	if (!graph->is_async_mode())
 		graph->process_vertices(num);
-	}
+	if (prof)
+		prof->add_active(num);
 
+	prof_timer timer(prof, PROF_COMPUTE);
 	for (int i = 0; i < num; i++) {
 		compute_vertex_pointer info = process_vertex_buf[i];
 		// We execute the pre-run to determine if the vertex has completed
@@ -534,13 +575,12 @@ int worker_thread::process_activated_vertices(int max)
 	return num;
 }
 
-size_t worker_thread::enter_next_level()
+/*
+ * If vertices have request the notification of the end of an iteration,
+ * this is the place to notify them.
+ */
+void worker_thread::notify_vertices_iter_end()
 {
-	// We have to make sure all messages sent by other threads are processed.
-	msg_processor->process_msgs();
-
-	// If vertices have request the notification of the end of an iteration,
-	// this is the place to notify them.
 	if (notify_vertices->get_num_set_bits() > 0) {
 		std::vector<vertex_id_t> vertex_buf;
 		const size_t stride = 1024 * 64;
@@ -555,6 +595,28 @@ size_t worker_thread::enter_next_level()
 			}
 		}
 	}
+}
+
+size_t worker_thread::enter_next_level()
+{
+	// We have to make sure all messages sent by other threads are processed.
+	{
+		prof_timer timer(prof, PROF_MSG);
+		size_t num_msgs = msg_processor->process_msgs();
+		if (prof)
+			prof->add_msgs(num_msgs);
+	}
+	{
+		prof_timer timer(prof, PROF_COMPUTE);
+		notify_vertices_iter_end();
+	}
+
+	if (graph->need_checkpoint()) {
+		std::vector<vertex_id_t> local_ids;
+		next_activated_vertices->finalize();
+		next_activated_vertices->get_active_vertices(local_ids);
+		graph->checkpoint_part(worker_id, local_ids);
+	}
 
 	curr_activated_vertices->init(*this);
 	assert(next_activated_vertices->get_num_active_vertices() == 0);
@@ -563,27 +625,72 @@ size_t worker_thread::enter_next_level()
 	return curr_activated_vertices->get_num_vertices();
 }
 
+/*
+ * This runs activated vertices, processes messages and issues I/O requests
+ * once. It returns the number of vertices that start to run.
+ */
+int worker_thread::process_vertices_step()
+{
+	balancer->process_completed_stolen_vertices();
+	int num = process_activated_vertices(
+			graph->get_max_processing_vertices()
+			- get_num_vertices_processing());
+	{
+		prof_timer timer(prof, PROF_MSG);
+		size_t num_msgs = msg_processor->process_msgs();
+		if (prof)
+			prof->add_msgs(num_msgs);
+	}
+
+	prof_timer timer(prof, PROF_IO_WAIT);
+	index_reader->wait4complete(0);
+	if (prof) {
+		size_t num_bytes = 0;
+		for (size_t i = 0; i < adj_reqs.size(); i++)
+			num_bytes += adj_reqs[i].get_size();
+		prof->add_bytes(num_bytes);
+	}
+	io->access(adj_reqs.data(), adj_reqs.size());
+	adj_reqs.clear();
+	if (io->num_pending_ios() == 0 && index_reader->get_num_pending_tasks() > 0)
+		index_reader->wait4complete(1);
+	io->wait4complete(min(io->num_pending_ios() / 10, 2));
+	return num;
+}
+
+void worker_thread::start_prof_level(int level)
+{
+	size_t num_accesses = 0;
+	size_t num_hits = 0;
+	io->get_cache_stats(num_accesses, num_hits);
+	prof->start_level(level, num_accesses, num_hits);
+}
+
+void worker_thread::end_prof_level()
+{
+	size_t num_accesses = 0;
+	size_t num_hits = 0;
+	io->get_cache_stats(num_accesses, num_hits);
+	prof->end_level(num_accesses, num_hits);
+}
+
 /**
  * This method is the main function of the graph engine.
  */
 void worker_thread::run()
 {
+	if (graph->is_async_mode()) {
+		run_async();
+		stop();
+		return;
+	}
+
 	while (true) {
+		if (prof)
+			start_prof_level(graph->get_curr_level());
 		int num_visited = 0;
-		int num;
 		do {
-			balancer->process_completed_stolen_vertices();
-			num = process_activated_vertices(
-					graph->get_max_processing_vertices()
-					- get_num_vertices_processing());
-			num_visited += num;
-			msg_processor->process_msgs();
-			index_reader->wait4complete(0);
-			io->access(adj_reqs.data(), adj_reqs.size());
-			adj_reqs.clear();
-			if (io->num_pending_ios() == 0 && index_reader->get_num_pending_tasks() > 0)
-				index_reader->wait4complete(1);
-			io->wait4complete(min(io->num_pending_ios() / 10, 2));
+			num_visited += process_vertices_step();
 			// If there are vertices being processed, we need to call
 			// wait4complete to complete processing them.
 		} while (get_num_vertices_processing() > 0
@@ -621,12 +728,89 @@ void worker_thread::run()
 		balancer->reset();
 
 		bool completed = graph->progress_next_level();
+		if (prof)
+			end_prof_level();
 		if (completed)
 			break;
 	}
 	stop();
 }
 
+/*
+ * In the asynchronous mode, a thread moves to the next level as soon as
+ * it has completed the vertices in its own level.
+ */
+size_t worker_thread::enter_next_async_level()
+{
+	msg_processor->process_msgs();
+	notify_vertices_iter_end();
+	async_level++;
+	graph->set_async_level(async_level);
+	curr_activated_vertices->init(*this);
+	return curr_activated_vertices->get_num_vertices();
+}
+
+/*
+ * The thread has no activated vertices. It waits until it receives
+ * messages from other threads or all threads are idle.
+ * It returns true if the graph engine has completed.
+ */
+bool worker_thread::wait4quiescence()
+{
+	prof_timer timer(prof, PROF_IDLE);
+	graph->enter_idle();
+	while (true) {
+		if (!msg_processor->get_msg_queue().is_empty()) {
+			graph->leave_idle();
+			return false;
+		}
+		if (graph->check_quiescence())
+			return true;
+		sched_yield();
+	}
+}
+
+void worker_thread::run_async()
+{
+	graph->set_async_level(async_level);
+	while (true) {
+		if (prof)
+			start_prof_level(async_level);
+		do {
+			process_vertices_step();
+			// Other threads are waiting for messages. We shouldn't keep
+			// the messages in the local buffers.
+			if (graph->get_num_idle_threads() > 0) {
+				vprogram->flush_msgs();
+				vpart_vprogram->flush_msgs();
+			}
+		} while (get_num_vertices_processing() > 0
+				|| !curr_activated_vertices->is_empty());
+		assert(index_reader->get_num_pending_tasks() == 0);
+		assert(io->num_pending_ios() == 0);
+		assert(active_computes.size() == 0);
+		assert(num_activated_vertices_in_level.get()
+				== num_completed_vertices_in_level.get());
+		num_activated_vertices_in_level = atomic_number<long>(0);
+		num_completed_vertices_in_level = atomic_number<long>(0);
+
+		vprogram->run_on_iteration_end();
+		vpart_vprogram->run_on_iteration_end();
+		size_t num_activates = enter_next_async_level();
+		// A thread has to flush all of its messages before it becomes idle.
+		vprogram->flush_msgs();
+		vpart_vprogram->flush_msgs();
+		bool completed = num_activates == 0 && wait4quiescence();
+		if (prof)
+			end_prof_level();
+		if (completed)
+			break;
+	}
+	BOOST_LOG_TRIVIAL(info)
+		<< boost::format("worker %1% completes after %2% levels")
+		% worker_id % async_level;
+}
+
 int worker_thread::steal_activated_vertices(compute_vertex_pointer vertices[], int num)
 {
 	// This method is called in the context of other worker threads,
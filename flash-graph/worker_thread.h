@@ -47,6 +47,11 @@ class worker_thread;
  * vertices in an iteration. The bitmap is used when there are many active
  * vertices in an iteration; the vector is used when there are only a few
  * vertices in an iteration.
+ *
+ * The vector keeps duplicated vertex IDs until finalize(), so it switches
+ * to the bitmap at a fixed size (MAX_ACTIVE_V) instead of at a density.
+ * This set doesn't use vertex_frontier; a vertex_frontier built by
+ * a vertex program is added to it with activate_vertices().
  */
 class active_vertex_set
 {
@@ -149,6 +154,18 @@ public:
 		bitmap_fetch_idx = scan_pointer(active_map.get_num_longs(), forward);
 	}
 
+	/*
+	 * Get the local IDs of the active vertices without resetting them.
+	 */
+	void get_active_vertices(std::vector<vertex_id_t> &local_ids) const {
+		if (active_v.empty())
+			active_map.get_set_bits(local_ids);
+		else {
+			for (size_t i = 0; i < active_v.size(); i++)
+				local_ids.push_back(active_v[i].id);
+		}
+	}
+
 	void fetch_reset_active_vertices(size_t max_num,
 			std::vector<local_vid_t> &local_ids);
 	void fetch_reset_active_vertices(std::vector<local_vid_t> &local_ids);
@@ -239,6 +256,7 @@ class customized_vertex_queue: public active_vertex_queue
 
 	void get_compute_vertex_pointers(const std::vector<vertex_id_t> &vertices,
 		std::vector<vpart_vertex_pointer> &vpart_ps);
+	void defer_vertices(worker_thread &t);
 public:
 	customized_vertex_queue(vertex_program::ptr vprog,
 			vertex_scheduler::ptr scheduler, int part_id): fetch_idx(0,
@@ -353,6 +371,10 @@ class worker_thread: public thread
 	atomic_number<long> num_activated_vertices_in_level;
 	// The number of vertices completed in the current level.
 	atomic_number<long> num_completed_vertices_in_level;
+	// The level of the thread in the asynchronous mode.
+	int async_level;
+	// It's NULL if the graph engine isn't profiled.
+	thread_profiler *prof;
 
 	/*
 	 * Get the number of vertices being processed in the current level.
@@ -362,6 +384,13 @@ class worker_thread: public thread
 			- num_completed_vertices_in_level.get();
 	}
 	int process_activated_vertices(int max);
+	int process_vertices_step();
+	void start_prof_level(int level);
+	void end_prof_level();
+	void notify_vertices_iter_end();
+	size_t enter_next_async_level();
+	bool wait4quiescence();
+	void run_async();
 public:
 	worker_thread(graph_engine *graph, std::shared_ptr<safs::file_io_factory> graph_factory,
 			std::shared_ptr<safs::file_io_factory> index_factory, vertex_program::ptr prog,
@@ -449,6 +478,10 @@ public:
 		return worker_id;
 	}
 
+	thread_profiler *get_profiler() const {
+		return prof;
+	}
+
 	vertex_program &get_vertex_program(bool part) {
 		return part ? *vpart_vprogram : *vprogram;
 	}
@@ -749,6 +749,17 @@ public:
 		T curr() const {
 			return *data;
 		}
+
+		/*
+		 * Get the remaining elements in the page as an array and
+		 * move to the end of the page.
+		 */
+		const T *next_span(int &num) {
+			const T *span = data;
+			num = data_end - data;
+			data = data_end;
+			return span;
+		}
 	};
 
 	/**
@@ -844,6 +855,20 @@ public:
 			return curr_page_it.next();
 		}
 
+		/**
+		 * This method gets the remaining elements in the current page
+		 * as an array and moves the iterator to the end of the page.
+		 * The elements in a page are contiguous, so a loop on the array
+		 * doesn't check page boundaries.
+		 * \param num the number of elements in the array.
+		 * \return the array, or NULL if there are no more elements.
+		 */
+		const T *next_page_span(int &num) {
+			if (!has_next())
+				return NULL;
+			return curr_page_it.next_span(num);
+		}
+
 		bool move_to(size_t idx) {
 			off = start + idx * sizeof(T);
 			if (off >= end)
@@ -334,6 +334,12 @@ public:
 		return num_fast_process;
 	}
 
+	virtual bool get_cache_stats(size_t &num_accesses, size_t &num_hits) const {
+		num_accesses = num_pg_accesses;
+		num_hits = cache_hits;
+		return true;
+	}
+
 	virtual void print_state() {
 #ifdef STATISTICS
 		printf("global cached io %d has %d pending reqs and %ld reqs from underlying\n",
@@ -17,8 +17,17 @@
  * limitations under the License.
  */
 
+#include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
 #include <boost/format.hpp>
 
+#include "log.h"
 #include "in_mem_io.h"
 #include "slab_allocator.h"
 #include "native_file.h"
@@ -51,6 +60,42 @@ public:
 	}
 };
 
+class munmap_delete
+{
+	size_t size;
+public:
+	munmap_delete(size_t size) {
+		this->size = size;
+	}
+
+	void operator()(char *buf) const {
+		munmap(buf, size);
+	}
+};
+
+const uint64_t SHM_MAGIC = 0x314d48535f414d55UL;
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+const int MAX_SHM_NODES = 64;
+#ifndef HUGETLBFS_MAGIC
+#define HUGETLBFS_MAGIC 0x958458f6
+#endif
+
+/*
+ * The header at the beginning of a shared NUMA buffer. The data of each
+ * NUMA node starts at an aligned offset in the shared memory.
+ */
+struct shm_header
+{
+	uint64_t magic;
+	// It's set after the data is loaded.
+	volatile int ready;
+	int num_nodes;
+	size_t range_size;
+	size_t length;
+	size_t buf_offs[MAX_SHM_NODES];
+	size_t buf_lens[MAX_SHM_NODES];
+};
+
 }
 
 NUMA_buffer::NUMA_buffer(std::shared_ptr<char> data, size_t length,
@@ -80,9 +125,24 @@ NUMA_buffer::NUMA_buffer(size_t length,
 	length = ROUNDUP(length, PAGE_SIZE);
 	this->length = length;
 	bufs.resize(mapper.get_num_nodes());
-	buf_lens.resize(bufs.size());
+	get_buf_lens(length, mapper, buf_lens);
 
-	// Calculate the data size in each NUMA node.
+	// Allocate memory for each NUMA node.
+	for (size_t i = 0; i < bufs.size(); i++) {
+		if (buf_lens[i] > 0) {
+			bufs[i] = std::shared_ptr<char>(
+					(char *) numa_alloc_onnode(buf_lens[i], i),
+					numa_delete(buf_lens[i]));
+			assert(bufs[i]);
+		}
+	}
+}
+
+void NUMA_buffer::get_buf_lens(size_t length, const NUMA_mapper &mapper,
+		std::vector<size_t> &buf_lens)
+{
+	buf_lens.clear();
+	buf_lens.resize(mapper.get_num_nodes());
 	size_t last_off = length - 1;
 	for (size_t i = 0; i < buf_lens.size(); i++) {
 		auto loc = mapper.map2physical(last_off);
@@ -97,16 +157,6 @@ NUMA_buffer::NUMA_buffer(size_t length,
 			break;
 		last_off = ROUND(last_off, mapper.get_range_size()) - 1;
 	}
-
-	// Allocate memory for each NUMA node.
-	for (size_t i = 0; i < bufs.size(); i++) {
-		if (buf_lens[i] > 0) {
-			bufs[i] = std::shared_ptr<char>(
-					(char *) numa_alloc_onnode(buf_lens[i], i),
-					numa_delete(buf_lens[i]));
-			assert(bufs[i]);
-		}
-	}
 }
 
 NUMA_buffer::data_loc_info NUMA_buffer::get_data_loc(off_t off,
@@ -213,17 +263,24 @@ NUMA_buffer::ptr NUMA_buffer::load(const std::string &file_name,
 	FILE *fd = fopen(file_name.c_str(), "r");
 	if (fd == NULL) {
 		int err = errno;
-		fclose(fd);
 		throw io_exception(boost::str(boost::format("can't open %1%: %2%")
 					% file_name % strerror(err)));
 	}
-	for (off_t off = 0; off < file_size;) {
-		size_t load_size = std::min(mapper.get_range_size(),
-				(size_t) (file_size - off));
-		data_info data = numa_buf->get_data(off, load_size);
+	numa_buf->load_file(fd, file_name, file_size);
+	fclose(fd);
+
+	return numa_buf;
+}
+
+void NUMA_buffer::load_file(FILE *fd, const std::string &file_name,
+		size_t file_size)
+{
+	for (size_t off = 0; off < file_size;) {
+		size_t load_size = std::min(mapper.get_range_size(), file_size - off);
+		data_info data = get_data(off, load_size);
 		// The total size of all physical buffers may be larger than
 		// the NUMA buffer size.
-		size_t size = std::min(data.second, (size_t) (file_size - off));
+		size_t size = std::min(data.second, file_size - off);
 		if (fread(data.first, size, 1, fd) != 1) {
 			int err = errno;
 			fclose(fd);
@@ -235,8 +292,248 @@ NUMA_buffer::ptr NUMA_buffer::load(const std::string &file_name,
 		if (off < file_size)
 			assert(off % mapper.get_range_size() == 0);
 	}
-	fclose(fd);
+}
+
+NUMA_buffer::ptr NUMA_buffer::load_shared(const std::string &file_name,
+		const std::string &shm_file, const NUMA_mapper &mapper, int timeout)
+{
+	native_file local_f(file_name);
+	if (!local_f.exist())
+		throw io_exception(boost::str(
+					boost::format("Linux file %1% doesn't exist") % file_name));
+	ssize_t file_size = local_f.get_size();
+	assert(file_size > 0);
+	if (mapper.get_num_nodes() > (size_t) MAX_SHM_NODES)
+		throw io_exception("too many NUMA nodes for a shared buffer");
+
+	// Only one process creates the shared buffer. The others attach to it.
+	// The loading process holds an exclusive lock on the file until
+	// the data is ready, so the others can tell if it died. The file is
+	// locked under a temporary name before it becomes visible.
+	int fd;
+	while (true) {
+		std::string tmp_file = shm_file + ".XXXXXX";
+		std::vector<char> tmp_name(tmp_file.begin(), tmp_file.end());
+		tmp_name.push_back(0);
+		fd = mkstemp(tmp_name.data());
+		if (fd < 0)
+			throw io_exception(boost::str(boost::format(
+							"can't create %1%: %2%") % tmp_name.data()
+						% strerror(errno)));
+		fchmod(fd, 0644);
+		flock(fd, LOCK_EX);
+		// The header with the magic number is written before the file
+		// becomes visible, so other processes only remove a stale buffer
+		// created by us.
+		shm_header init_header;
+		memset(&init_header, 0, sizeof(init_header));
+		init_header.magic = SHM_MAGIC;
+		if (pwrite(fd, &init_header, sizeof(init_header), 0)
+				!= (ssize_t) sizeof(init_header)) {
+			int err = errno;
+			unlink(tmp_name.data());
+			close(fd);
+			throw io_exception(boost::str(boost::format(
+							"can't write to %1%: %2%") % tmp_name.data()
+						% strerror(err)));
+		}
+		int ret = link(tmp_name.data(), shm_file.c_str());
+		int err = errno;
+		unlink(tmp_name.data());
+		if (ret == 0)
+			break;
+		close(fd);
+		if (err != EEXIST)
+			throw io_exception(boost::str(boost::format(
+							"can't create %1%: %2%") % shm_file % strerror(err)));
 
+		int attach_fd = open(shm_file.c_str(), O_RDONLY);
+		// The buffer has been removed. Try to create it again.
+		if (attach_fd < 0 && errno == ENOENT)
+			continue;
+		else if (attach_fd < 0)
+			throw io_exception(boost::str(boost::format(
+							"can't open %1%: %2%") % shm_file % strerror(errno)));
+		NUMA_buffer::ptr buf = attach_shared(attach_fd, shm_file, timeout);
+		if (buf)
+			return buf;
+		BOOST_LOG_TRIVIAL(warning) << boost::format(
+				"the process loading data to %1% died; load the data again")
+			% shm_file;
+	}
+
+	// Huge pages are used if the file is in hugetlbfs.
+	std::vector<char> dir(shm_file.begin(), shm_file.end());
+	dir.push_back(0);
+	struct statfs fs;
+	size_t align = PAGE_SIZE;
+	if (statfs(dirname(dir.data()), &fs) == 0
+			&& (unsigned long) fs.f_type == HUGETLBFS_MAGIC)
+		align = HUGE_PAGE_SIZE;
+
+	NUMA_buffer::ptr numa_buf(new NUMA_buffer(mapper));
+	numa_buf->length = ROUNDUP(file_size, PAGE_SIZE);
+	get_buf_lens(numa_buf->length, mapper, numa_buf->buf_lens);
+	shm_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SHM_MAGIC;
+	header.num_nodes = mapper.get_num_nodes();
+	header.range_size = mapper.get_range_size();
+	header.length = numa_buf->length;
+	size_t map_size = ROUNDUP(sizeof(header), align);
+	for (int i = 0; i < header.num_nodes; i++) {
+		header.buf_offs[i] = map_size;
+		header.buf_lens[i] = numa_buf->buf_lens[i];
+		map_size += ROUNDUP(numa_buf->buf_lens[i], align);
+	}
+
+	char *addr = NULL;
+	if (ftruncate(fd, map_size) == 0)
+		addr = (char *) mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED, fd, 0);
+	if (addr == NULL || addr == MAP_FAILED) {
+		int err = errno;
+		unlink(shm_file.c_str());
+		close(fd);
+		throw io_exception(boost::str(boost::format("can't map %1%: %2%")
+					% shm_file % strerror(err)));
+	}
+	std::shared_ptr<char> base(addr, munmap_delete(map_size));
+	memcpy(addr, &header, sizeof(header));
+	numa_buf->bufs.resize(header.num_nodes);
+	for (int i = 0; i < header.num_nodes; i++) {
+		if (header.buf_lens[i] == 0)
+			continue;
+		// The pages of the node are allocated on the node when they are
+		// first touched.
+		if (i <= numa_max_node())
+			numa_tonode_memory(addr + header.buf_offs[i],
+					ROUNDUP(header.buf_lens[i], align), i);
+		numa_buf->bufs[i] = std::shared_ptr<char>(base,
+				addr + header.buf_offs[i]);
+	}
+
+	FILE *f = fopen(file_name.c_str(), "r");
+	if (f == NULL) {
+		int err = errno;
+		unlink(shm_file.c_str());
+		close(fd);
+		throw io_exception(boost::str(boost::format("can't open %1%: %2%")
+					% file_name % strerror(err)));
+	}
+	try {
+		numa_buf->load_file(f, file_name, file_size);
+	} catch (io_exception &e) {
+		unlink(shm_file.c_str());
+		close(fd);
+		throw;
+	}
+	fclose(f);
+	__sync_synchronize();
+	((shm_header *) addr)->ready = 1;
+	// The mapping holds a reference to the file, so closing the file
+	// doesn't release the lock.
+	flock(fd, LOCK_UN);
+	close(fd);
+	BOOST_LOG_TRIVIAL(info) << boost::format(
+			"load %1% to shared memory %2% (%3% bytes)")
+		% file_name % shm_file % map_size;
+	return numa_buf;
+}
+
+NUMA_buffer::ptr NUMA_buffer::attach_shared(const std::string &shm_file,
+		int timeout)
+{
+	int fd = open(shm_file.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw io_exception(boost::str(boost::format("can't open %1%: %2%")
+					% shm_file % strerror(errno)));
+	NUMA_buffer::ptr buf = attach_shared(fd, shm_file, timeout);
+	if (buf == NULL)
+		throw io_exception(boost::str(boost::format(
+						"the process loading data to %1% died") % shm_file));
+	return buf;
+}
+
+NUMA_buffer::ptr NUMA_buffer::attach_shared(int fd,
+		const std::string &shm_file, int timeout)
+{
+	// Wait until the loading process releases the lock on the file.
+	// We take the lock exclusively, so only one process decides whether
+	// the buffer is stale and removes it.
+	time_t deadline = time(NULL) + timeout;
+	bool waited = false;
+	while (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+		if (errno != EWOULDBLOCK || time(NULL) >= deadline) {
+			int err = errno == EWOULDBLOCK ? ETIMEDOUT : errno;
+			close(fd);
+			throw io_exception(boost::str(boost::format(
+							"can't wait for %1% to be loaded: %2%")
+						% shm_file % strerror(err)));
+		}
+		if (!waited)
+			BOOST_LOG_TRIVIAL(info) << boost::format(
+					"wait for another process to load data to %1%") % shm_file;
+		waited = true;
+		usleep(10000);
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		int err = errno;
+		close(fd);
+		throw io_exception(boost::str(boost::format("can't stat %1%: %2%")
+					% shm_file % strerror(err)));
+	}
+	// The buffer has been removed, either by the loading process after
+	// a failure or by another process that found it stale.
+	if (st.st_nlink == 0) {
+		close(fd);
+		return NUMA_buffer::ptr();
+	}
+	// The loading process writes the header before the file is visible.
+	// We never remove a file that doesn't have it.
+	if ((size_t) st.st_size < sizeof(shm_header)) {
+		flock(fd, LOCK_UN);
+		close(fd);
+		throw io_exception(shm_file + " isn't a shared NUMA buffer");
+	}
+	size_t map_size = st.st_size;
+	char *addr = (char *) mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		int err = errno;
+		close(fd);
+		throw io_exception(boost::str(boost::format("can't map %1%: %2%")
+					% shm_file % strerror(err)));
+	}
+	std::shared_ptr<char> base(addr, munmap_delete(map_size));
+	const shm_header *header = (const shm_header *) addr;
+	if (header->magic != SHM_MAGIC || header->num_nodes > MAX_SHM_NODES) {
+		flock(fd, LOCK_UN);
+		close(fd);
+		throw io_exception(shm_file + " isn't a shared NUMA buffer");
+	}
+	// The loading process died before the data is ready.
+	if (!header->ready) {
+		unlink(shm_file.c_str());
+		close(fd);
+		return NUMA_buffer::ptr();
+	}
+	flock(fd, LOCK_UN);
+	close(fd);
+	__sync_synchronize();
+
+	NUMA_mapper mapper(header->num_nodes,
+			__builtin_ctzl(header->range_size));
+	NUMA_buffer::ptr numa_buf(new NUMA_buffer(mapper));
+	numa_buf->length = header->length;
+	numa_buf->bufs.resize(header->num_nodes);
+	numa_buf->buf_lens.resize(header->num_nodes);
+	for (int i = 0; i < header->num_nodes; i++) {
+		numa_buf->buf_lens[i] = header->buf_lens[i];
+		if (header->buf_lens[i] > 0)
+			numa_buf->bufs[i] = std::shared_ptr<char>(base,
+					addr + header->buf_offs[i]);
+	}
 	return numa_buf;
 }
 
@@ -29,6 +29,12 @@
 namespace safs
 {
 
+/*
+ * The maximal time (in seconds) to wait for another process to load data
+ * to a shared buffer.
+ */
+const int SHM_WAIT_TIMEOUT = 1800;
+
 class NUMA_buffer
 {
 	std::vector<std::shared_ptr<char> > bufs;
@@ -50,9 +56,25 @@ class NUMA_buffer
 		}
 	};
 	data_loc_info get_data_loc(off_t off, size_t size) const;
+	/*
+	 * Calculate the data size in each NUMA node.
+	 */
+	static void get_buf_lens(size_t length, const NUMA_mapper &mapper,
+			std::vector<size_t> &buf_lens);
+	void load_file(FILE *f, const std::string &file_name, size_t file_size);
+	/*
+	 * Attach to the shared buffer opened in `fd'. It returns NULL if
+	 * the process loading the buffer died; the stale buffer is removed,
+	 * so the caller can load the data again.
+	 */
+	static std::shared_ptr<NUMA_buffer> attach_shared(int fd,
+			const std::string &shm_file, int timeout);
 
 	NUMA_buffer(std::shared_ptr<char>, size_t length, const NUMA_mapper &mapper);
 	NUMA_buffer(size_t length, const NUMA_mapper &mapper);
+	NUMA_buffer(const NUMA_mapper &mapper): mapper(mapper) {
+		length = 0;
+	}
 public:
 	typedef std::pair<const char *, size_t> cdata_info;
 	typedef std::pair<char *, size_t> data_info;
@@ -63,6 +85,25 @@ public:
 	 */
 	static ptr load(const std::string &file, const NUMA_mapper &mapper);
 	static ptr load_safs(const std::string &file, const NUMA_mapper &mapper);
+	/*
+	 * Load data in a file to a buffer in shared memory, so that other
+	 * processes can attach to the buffer with `attach_shared' instead of
+	 * loading the data again. `shm_file' is a file in a memory filesystem,
+	 * such as /dev/shm or a hugetlbfs mount point for huge pages. The data
+	 * in each NUMA node is bound to the node. If `shm_file' exists, the data
+	 * has been loaded by another process and we attach to it. If that
+	 * process died before the data is ready, we load the data instead.
+	 * The shared buffer lives until `shm_file' is removed.
+	 */
+	static ptr load_shared(const std::string &file, const std::string &shm_file,
+			const NUMA_mapper &mapper, int timeout = SHM_WAIT_TIMEOUT);
+	/*
+	 * Attach to a buffer in shared memory read-only. If another process is
+	 * still loading data to the buffer, it waits until the data is ready,
+	 * for at most `timeout' seconds.
+	 */
+	static ptr attach_shared(const std::string &shm_file,
+			int timeout = SHM_WAIT_TIMEOUT);
 
 	static ptr create(std::shared_ptr<char>, size_t length,
 			const NUMA_mapper &mapper);
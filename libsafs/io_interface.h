@@ -251,6 +251,17 @@ public:
 	virtual void print_state() {
 	}
 
+	/**
+	 * This method gets the statistics of the page cache accessed by
+	 * the I/O instance.
+	 * \param num_accesses the number of pages accessed.
+	 * \param num_hits the number of the accessed pages found in the cache.
+	 * \return false if the I/O instance doesn't access the page cache.
+	 */
+	virtual bool get_cache_stats(size_t &num_accesses, size_t &num_hits) const {
+		return false;
+	}
+
 	virtual io_interface *clone(thread *t) const {
 		return NULL;
 	}
@@ -1,3 +1,8 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+
 #include "in_mem_io.h"
 
 using namespace safs;
@@ -108,8 +113,109 @@ void test_load_save()
 		test_load_save(i * range_size + range_size / 2);
 }
 
+/*
+ * Create a shared buffer that looks like its loading process died before
+ * the data is ready. Only the magic number is set in its header.
+ */
+int create_stale_buf(const char *shm_file)
+{
+	const uint64_t magic = 0x314d48535f414d55UL;
+	int fd = open(shm_file, O_RDWR | O_CREAT, 0644);
+	assert(fd >= 0);
+	std::vector<char> header(PAGE_SIZE);
+	memcpy(header.data(), &magic, sizeof(magic));
+	BOOST_VERIFY(write(fd, header.data(), header.size())
+			== (ssize_t) header.size());
+	return fd;
+}
+
+void test_load_shared(size_t length)
+{
+	printf("test load a shared buffer\n");
+	size_t num_nodes = numa_num_configured_nodes();
+	NUMA_mapper mapper(num_nodes, range_size_log);
+
+	NUMA_buffer::ptr buf = create_buf(length, mapper);
+	std::unique_ptr<char[]> raw_buf(new char[length]);
+	buf->copy_to(raw_buf.get(), length, 0);
+	char *tmp_file = tempnam("/tmp/", "test");
+	buf->dump(tmp_file);
+	char *shm_file = tempnam("/dev/shm/", "test");
+
+	// A file that isn't a shared buffer is never removed.
+	int fd = open(shm_file, O_RDWR | O_CREAT, 0644);
+	assert(fd >= 0);
+	close(fd);
+	bool failed = false;
+	try {
+		NUMA_buffer::attach_shared(shm_file, 1);
+	} catch (io_exception &e) {
+		failed = true;
+	}
+	assert(failed);
+	failed = false;
+	try {
+		NUMA_buffer::load_shared(tmp_file, shm_file, mapper, 1);
+	} catch (io_exception &e) {
+		failed = true;
+	}
+	assert(failed);
+	assert(access(shm_file, F_OK) == 0);
+	unlink(shm_file);
+
+	// A process died before the data is ready.
+	fd = create_stale_buf(shm_file);
+	close(fd);
+	failed = false;
+	try {
+		NUMA_buffer::attach_shared(shm_file, 1);
+	} catch (io_exception &e) {
+		failed = true;
+	}
+	assert(failed);
+	// The stale buffer is removed.
+	assert(access(shm_file, F_OK) < 0);
+
+	// Another process holds the lock while loading data.
+	fd = create_stale_buf(shm_file);
+	flock(fd, LOCK_EX);
+	failed = false;
+	try {
+		NUMA_buffer::attach_shared(shm_file, 1);
+	} catch (io_exception &e) {
+		failed = true;
+	}
+	assert(failed);
+
+	// The loading process dies while we are waiting for it. We should load
+	// the data instead.
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(fd);
+		NUMA_buffer::ptr buf1 = NUMA_buffer::load_shared(tmp_file,
+				shm_file, mapper, 10);
+		std::unique_ptr<char[]> raw_buf1(new char[length]);
+		buf1->copy_to(raw_buf1.get(), length, 0);
+		_exit(memcmp(raw_buf.get(), raw_buf1.get(), length) == 0 ? 0 : 1);
+	}
+	sleep(1);
+	close(fd);
+	int status;
+	waitpid(pid, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	NUMA_buffer::ptr buf2 = NUMA_buffer::attach_shared(shm_file);
+	std::unique_ptr<char[]> raw_buf2(new char[length]);
+	buf2->copy_to(raw_buf2.get(), length, 0);
+	assert(memcmp(raw_buf.get(), raw_buf2.get(), length) == 0);
+
+	unlink(shm_file);
+	unlink(tmp_file);
+}
+
 int main()
 {
 	test_in_mem();
 	test_load_save();
+	test_load_shared(range_size * 3 + range_size / 2);
 }
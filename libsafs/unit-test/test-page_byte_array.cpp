@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <vector>
+
+#include "cache.h"
+
+using namespace safs;
+
+/*
+ * The pages of the byte array aren't contiguous in memory, so an iterator
+ * that walks over a page boundary without getting the next page reads
+ * the wrong data.
+ */
+class scattered_byte_array: public page_byte_array
+{
+	std::vector<char *> pages;
+	off_t off_in_first_page;
+	size_t size;
+public:
+	scattered_byte_array(off_t off_in_first_page, size_t size) {
+		this->off_in_first_page = off_in_first_page;
+		this->size = size;
+		size_t num_pages = ROUNDUP_PAGE(off_in_first_page + size) / PAGE_SIZE;
+		for (size_t i = 0; i < num_pages; i++) {
+			// Leave a gap between pages.
+			char *page = (char *) valloc(PAGE_SIZE * 2);
+			memset(page, 0xff, PAGE_SIZE * 2);
+			pages.push_back(page);
+		}
+	}
+
+	~scattered_byte_array() {
+		for (size_t i = 0; i < pages.size(); i++)
+			free(pages[i]);
+	}
+
+	/*
+	 * Store the elements in the array, starting from `off_in_first_page'.
+	 */
+	void set_data(const std::vector<int> &vals) {
+		assert(vals.size() * sizeof(int) <= size);
+		for (size_t i = 0; i < vals.size(); i++) {
+			off_t off = off_in_first_page + i * sizeof(int);
+			*(int *) (pages[off / PAGE_SIZE] + off % PAGE_SIZE) = vals[i];
+		}
+	}
+
+	virtual void lock() {
+	}
+
+	virtual void unlock() {
+	}
+
+	virtual off_t get_offset() const {
+		return 0;
+	}
+
+	virtual size_t get_size() const {
+		return size;
+	}
+
+	virtual page_byte_array *clone() {
+		return NULL;
+	}
+
+	virtual off_t get_offset_in_first_page() const {
+		return off_in_first_page;
+	}
+
+	virtual const char *get_page(int idx) const {
+		return pages[idx];
+	}
+};
+
+/*
+ * Iterate the elements in [start, end) of the array with next_page_span.
+ */
+void test_page_span(const scattered_byte_array &arr,
+		const std::vector<int> &vals, size_t start, size_t end)
+{
+	printf("iterate [%ld, %ld) with %ld bytes in the first page\n",
+			start, end, arr.get_offset_in_first_page());
+	page_byte_array::seq_const_iterator<int> it = arr.get_seq_iterator<int>(
+			start * sizeof(int), end * sizeof(int));
+	std::vector<int> res;
+	size_t num_spans = 0;
+	const int *span;
+	int num;
+	while ((span = it.next_page_span(num)) != NULL) {
+		assert(num > 0);
+		off_t span_start = arr.get_offset_in_first_page()
+			+ (start + res.size()) * sizeof(int);
+		// A span never crosses a page boundary.
+		assert(span_start % PAGE_SIZE + num * sizeof(int) <= PAGE_SIZE);
+		// Only the first span starts in the middle of a page.
+		assert(num_spans == 0 || span_start % PAGE_SIZE == 0);
+		res.insert(res.end(), span, span + num);
+		num_spans++;
+	}
+	assert(!it.has_next());
+	assert(res.size() == end - start);
+	for (size_t i = 0; i < res.size(); i++)
+		assert(res[i] == vals[start + i]);
+
+	off_t first = arr.get_offset_in_first_page() + start * sizeof(int);
+	off_t last = arr.get_offset_in_first_page() + end * sizeof(int);
+	size_t expected_spans = start == end ? 0
+		: (ROUNDUP_PAGE(last) - ROUND_PAGE(first)) / PAGE_SIZE;
+	assert(num_spans == expected_spans);
+
+	// Mix next() with next_page_span().
+	it = arr.get_seq_iterator<int>(start * sizeof(int), end * sizeof(int));
+	res.clear();
+	if (it.has_next())
+		res.push_back(it.next());
+	while ((span = it.next_page_span(num)) != NULL)
+		res.insert(res.end(), span, span + num);
+	assert(res.size() == end - start);
+	for (size_t i = 0; i < res.size(); i++)
+		assert(res[i] == vals[start + i]);
+}
+
+void test_page_span(off_t off_in_first_page)
+{
+	size_t num_vals = PAGE_SIZE * 3 / sizeof(int) + 10;
+	std::vector<int> vals(num_vals);
+	for (size_t i = 0; i < vals.size(); i++)
+		vals[i] = random();
+	scattered_byte_array arr(off_in_first_page, num_vals * sizeof(int));
+	arr.set_data(vals);
+
+	size_t ints_per_page = PAGE_SIZE / sizeof(int);
+	size_t first_page_ints = (PAGE_SIZE - off_in_first_page) / sizeof(int);
+	// The entire array.
+	test_page_span(arr, vals, 0, num_vals);
+	// An empty list.
+	test_page_span(arr, vals, 5, 5);
+	if (first_page_ints > 3) {
+		// The list is inside the first page.
+		test_page_span(arr, vals, 1, first_page_ints - 1);
+		// The list ends at the end of the first page.
+		test_page_span(arr, vals, 3, first_page_ints);
+	}
+	// The list starts in the middle of a page and crosses pages.
+	test_page_span(arr, vals, first_page_ints > 7 ? 7 : 0,
+			first_page_ints + ints_per_page + 3);
+	// The list starts at the beginning of a page.
+	test_page_span(arr, vals, first_page_ints, num_vals);
+	// The list starts in the middle of the second page.
+	test_page_span(arr, vals, first_page_ints + 11, num_vals - 1);
+}
+
+int main()
+{
+	test_page_span(0);
+	test_page_span(100 * sizeof(int));
+	test_page_span(PAGE_SIZE - sizeof(int));
+}
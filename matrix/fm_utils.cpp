@@ -729,203 +729,30 @@ struct coo_less
 	}
 };
 
-class block_nz_data
-{
-	size_t entry_size;
-	std::vector<char> data;
-	size_t num_entries;
-public:
-	block_nz_data(size_t entry_size) {
-		this->entry_size = entry_size;
-		num_entries = 0;
-	}
-
-	void clear() {
-		num_entries = 0;
-		data.clear();
-	}
-
-	void push_back(char *new_entry) {
-		assert(entry_size > 0);
-		if (data.empty())
-			data.resize(16 * entry_size);
-		// If full
-		else if (data.size() == entry_size * num_entries)
-			data.resize(data.size() * 2);
-		memcpy(&data[num_entries * entry_size], new_entry, entry_size);
-		num_entries++;
-	}
-
-	void append(const char *new_entries, size_t num) {
-		assert(entry_size > 0);
-		if (data.empty())
-			data.resize(num * entry_size);
-		else if (data.size() < (this->num_entries + num) * entry_size)
-			data.resize((this->num_entries + num) * entry_size);
-		memcpy(&data[num_entries * entry_size], new_entries, entry_size * num);
-		num_entries += num;
-	}
-
-	const char *get_data() const {
-		if (entry_size == 0)
-			return NULL;
-		else
-			return data.data();
-	}
-
-	size_t get_size() const {
-		return num_entries;
-	}
-
-	bool is_empty() const {
-		if (entry_size == 0)
-			return true;
-		else
-			return data.empty();
-	}
-};
-
 }
 
 void part_2d_apply_operate::run(const void *key, const local_vv_store &val,
 		local_vec_store &out) const
 {
-	size_t block_height = block_size.get_num_rows();
-	size_t block_width = block_size.get_num_cols();
-	size_t num_blocks = ceil(((double) row_len) / block_width);
 	factor_value_t block_row_id = *(const factor_value_t *) key;
-	size_t tot_num_non_zeros = 0;
-	size_t max_row_parts = 0;
-	const fg::ext_mem_undirected_vertex *first_v
-		= (const fg::ext_mem_undirected_vertex *) val.get_raw_arr(0);
-	fg::vertex_id_t start_vid = first_v->get_id();
-	std::vector<std::vector<const fg::ext_mem_undirected_vertex *> > edge_dist_map(
-			num_blocks);
+	std::vector<const fg::ext_mem_undirected_vertex *> rows(val.get_num_vecs());
 	for (size_t i = 0; i < val.get_num_vecs(); i++) {
-		const fg::ext_mem_undirected_vertex *v
-			= (const fg::ext_mem_undirected_vertex *) val.get_raw_arr(i);
-		assert(val.get_length(i) == v->get_size());
-		assert(v->get_id() / block_height == (size_t) block_row_id);
-		tot_num_non_zeros += v->get_num_edges();
-		// I definitely over estimate the number of row parts.
-		// If a row doesn't have many non-zero entries, I assume that
-		// the non-zero entries distribute evenly across all row parts.
-		max_row_parts += std::min(num_blocks, v->get_num_edges());
-
-		// Fill the edge distribution map.
-		for (size_t i = 0; i < v->get_num_edges(); i++) {
-			size_t vector_idx = v->get_neighbor(i) / block_width;
-			if (edge_dist_map[vector_idx].empty()
-					|| edge_dist_map[vector_idx].back() != v)
-				edge_dist_map[vector_idx].push_back(v);
-		}
+		rows[i] = (const fg::ext_mem_undirected_vertex *) val.get_raw_arr(i);
+		assert(val.get_length(i) == rows[i]->get_size());
+		assert(rows[i]->get_edge_data_size() == nz_size);
 	}
 
-	// Containers of non-zero values.
-	block_nz_data data(nz_size);
-	block_nz_data single_nz_data(nz_size);
-
-	std::vector<size_t> neigh_idxs(val.get_num_vecs());
-	// The maximal size of a block.
-	size_t max_block_size
-		// Even if a block is empty, its header still exists. The size is
-		// accurate.
-		= sizeof(sparse_block_2d) * num_blocks
-		// Each block has an empty row part in the end to indicate the end
-		// of the block.
-		+ sparse_row_part::get_size(0) * num_blocks
-		// The size for row part headers is highly over estimated.
-		+ sizeof(sparse_row_part) * max_row_parts
-		// The size is accurate.
-		+ sparse_row_part::get_col_entry_size() * tot_num_non_zeros
-		// The size of the non-zero entries.
-		+ nz_size * tot_num_non_zeros;
+	size_t max_block_size = get_max_block_row_size(rows, row_len, nz_size,
+			block_size);
 	out.resize(max_block_size);
-	size_t curr_size = 0;
-	// The maximal size of a row part.
-	size_t max_row_size = sparse_row_part::get_size(block_width);
-	std::unique_ptr<char[]> buf = std::unique_ptr<char[]>(new char[max_row_size]);
-	std::vector<fg::vertex_id_t> local_neighs;
-	size_t num_non_zeros = 0;
-	// Iterate columns. Actually it strides instead of iterating all columns.
-	for (size_t col_idx = 0; col_idx < row_len; col_idx += block_width) {
-		sparse_block_2d *block
-			= new (out.get_raw_arr() + curr_size) sparse_block_2d(
-					block_row_id, col_idx / block_width);
-		data.clear();
-		single_nz_data.clear();
-		const std::vector<const fg::ext_mem_undirected_vertex *> &v_ptrs
-			= edge_dist_map[col_idx / block_width];
-		std::vector<coo_nz_t> single_nnz;
-		// Iterate the vectors in the vector_vector one by one.
-		for (size_t i = 0; i < v_ptrs.size(); i++) {
-			const fg::ext_mem_undirected_vertex *v = v_ptrs[i];
-			fg::vertex_id_t row_idx = v->get_id() - start_vid;
-			assert(v->get_edge_data_size() == nz_size);
-			assert(neigh_idxs[row_idx] < v->get_num_edges());
-			assert(v->get_neighbor(neigh_idxs[row_idx]) >= col_idx
-					&& v->get_neighbor(neigh_idxs[row_idx]) < col_idx + block_width);
-
-			size_t idx = neigh_idxs[row_idx];
-			local_neighs.clear();
-			for (; idx < v->get_num_edges()
-					&& v->get_neighbor(idx) < col_idx + block_width; idx++)
-				local_neighs.push_back(v->get_neighbor(idx));
-			// Get all edge data.
-			if (nz_size > 0 && local_neighs.size() == 1)
-				single_nz_data.push_back(v->get_raw_edge_data(neigh_idxs[row_idx]));
-			else if (nz_size > 0) {
-				size_t tmp_idx = neigh_idxs[row_idx];
-				for (; tmp_idx < v->get_num_edges()
-						&& v->get_neighbor(tmp_idx) < col_idx + block_width;
-						tmp_idx++)
-					data.push_back(v->get_raw_edge_data(tmp_idx));
-				assert(tmp_idx == idx);
-			}
-			size_t local_nnz = local_neighs.size();
-			assert(local_nnz <= block_width);
-			neigh_idxs[row_idx] = idx;
-
-			if (local_neighs.size() > 1) {
-				sparse_row_part *part = new (buf.get()) sparse_row_part(row_idx);
-				rp_edge_iterator edge_it = part->get_edge_iterator();
-				for (size_t k = 0; k < local_neighs.size(); k++)
-					edge_it.append(block_size, local_neighs[k]);
-				assert(block->get_size(nz_size) + sparse_row_part::get_size(local_nnz)
-						+ local_nnz * nz_size <= max_block_size - curr_size);
-				block->append(*part, sparse_row_part::get_size(local_nnz));
-			}
-			else if (local_neighs.size() == 1)
-				single_nnz.push_back(coo_nz_t(row_idx, local_neighs[0]));
-		}
-		if (!single_nnz.empty()) {
-			assert(block->get_size(nz_size)
-					+ single_nnz.size() * sizeof(local_coo_t)
-					+ single_nnz.size() * nz_size <= max_block_size - curr_size);
-			block->add_coo(single_nnz, block_size);
-		}
-		if (!single_nz_data.is_empty())
-			data.append(single_nz_data.get_data(), single_nz_data.get_size());
-		// After we finish adding rows to a block, we need to finalize it.
-		block->finalize(data.get_data(), data.get_size() * nz_size);
-		if (!block->is_empty()) {
-			curr_size += block->get_size(nz_size);
-			block->verify(block_size);
-		}
-		num_non_zeros += block->get_nnz();
-	}
-	assert(tot_num_non_zeros == num_non_zeros);
-	// If the block row doesn't have any non-zero entries, let's insert an
-	// empty block row, so the matrix index can work correctly.
-	if (curr_size == 0) {
-		curr_size = sizeof(sparse_block_2d);
-		const sparse_block_2d *block
-			= (const sparse_block_2d *) out.get_raw_arr();
-		assert(block->is_empty());
-	}
+	size_t curr_size = part_2d_block_row(rows, block_row_id, row_len, nz_size,
+			block_size, out.get_raw_arr(), max_block_size);
 	out.resize(curr_size);
 
 #ifdef VERIFY_ENABLED
+	size_t tot_num_non_zeros = 0;
+	for (size_t i = 0; i < rows.size(); i++)
+		tot_num_non_zeros += rows[i]->get_num_edges();
 	std::vector<coo_nz_t> all_coos;
 	block_row_iterator br_it((const sparse_block_2d *) out.get_raw_arr(),
 			(const sparse_block_2d *) (out.get_raw_arr() + curr_size));
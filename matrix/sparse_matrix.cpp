@@ -191,6 +191,29 @@ bool hilbert_exec_order::exec(block_compute_task &task,
 	return true;
 }
 
+/*
+ * The order of processing the blocks in a super block of
+ * a 2D-partitioned matrix.
+ */
+static block_exec_order::ptr get_2d_exec_order(size_t num_block_rows,
+		size_t num_block_cols)
+{
+	if (num_block_rows != num_block_cols) {
+		BOOST_LOG_TRIVIAL(error) << "hilbert order requires a square.";
+		return block_exec_order::ptr();
+	}
+	double log2_nbr = log2(num_block_rows);
+	if (log2_nbr != floor(log2_nbr)) {
+		BOOST_LOG_TRIVIAL(error)
+			<< "hilbert order requires a dimension of 2^n";
+		return block_exec_order::ptr();
+	}
+	if (matrix_conf.use_hilbert_order())
+		return block_exec_order::ptr(new hilbert_exec_order(num_block_rows));
+	else
+		return block_exec_order::ptr(new seq_exec_order());
+}
+
 bool EM_matrix_stream::filled_local_store::write(
 		local_matrix_store::const_ptr portion,
 		off_t global_start_row, off_t global_start_col)
@@ -280,6 +303,7 @@ block_compute_task::block_compute_task(const matrix_io &_io,
 			_io), block_size(mat.get_block_size())
 {
 	this->entry_size = mat.get_entry_size();
+	this->fg_rows = mat.is_fg_2d_matrix();
 	size_t num_block_rows
 		= ceil(((double) io.get_num_rows()) / block_size.get_num_rows());
 	if (order->is_valid_size(num_block_rows, num_block_rows))
@@ -325,15 +349,68 @@ block_compute_task::~block_compute_task()
 	local_mem_buffer::cache_irreg(buf);
 }
 
-/*
- * A block compute task processes data in multiple block rows.
- * It's up to us in what order we should process the blocks in these block rows.
- */
 void block_compute_task::run(char *buf, size_t size)
 {
 	off_t orig_off = io.get_loc().get_offset();
 	off_t local_off = orig_off - ROUND_PAGE(orig_off);
 	assert(local_off + io.get_size() <= size);
+	if (fg_rows)
+		run_on_fg_rows();
+	else
+		run_on_block_rows(block_rows);
+}
+
+/*
+ * The block rows in the buffer are in the FlashGraph format. We partition
+ * the rows into 2D blocks in a local buffer first. The 2D blocks only live
+ * while the task runs, so the graph doesn't need to be converted to
+ * a 2D-partitioned matrix on disks.
+ */
+void block_compute_task::run_on_fg_rows()
+{
+	size_t block_row_start
+		= io.get_top_left().get_row_idx() / block_size.get_num_rows();
+	size_t num_block_rows = block_rows.size() - 1;
+	std::vector<std::vector<const fg::ext_mem_undirected_vertex *> > rows(
+			num_block_rows);
+	size_t max_size = 0;
+	for (size_t i = 0; i < num_block_rows; i++) {
+		const char *p = block_rows[i];
+		while (p < block_rows[i + 1]) {
+			const fg::ext_mem_undirected_vertex *v
+				= (const fg::ext_mem_undirected_vertex *) p;
+			rows[i].push_back(v);
+			p += v->get_size();
+		}
+		assert(p == block_rows[i + 1]);
+		max_size += get_max_block_row_size(rows[i], io.get_num_cols(),
+				entry_size, block_size);
+	}
+
+	local_mem_buffer::irreg_buf_t blocks_buf = local_mem_buffer::get_irreg();
+	if (blocks_buf.second == NULL || blocks_buf.first < max_size) {
+		std::shared_ptr<char> tmp((char *) valloc(max_size), buf_deleter());
+		blocks_buf = local_mem_buffer::irreg_buf_t(max_size, tmp);
+	}
+	std::vector<char *> blocks(num_block_rows + 1);
+	size_t size = 0;
+	for (size_t i = 0; i < num_block_rows; i++) {
+		blocks[i] = blocks_buf.second.get() + size;
+		size += part_2d_block_row(rows[i], block_row_start + i,
+				io.get_num_cols(), entry_size, block_size, blocks[i],
+				max_size - size);
+	}
+	blocks[num_block_rows] = blocks_buf.second.get() + size;
+	run_on_block_rows(blocks);
+	local_mem_buffer::cache_irreg(blocks_buf);
+}
+
+/*
+ * A block compute task processes data in multiple block rows.
+ * It's up to us in what order we should process the blocks in these block rows.
+ */
+void block_compute_task::run_on_block_rows(const std::vector<char *> &block_rows)
+{
 	size_t block_row_start
 		= io.get_top_left().get_row_idx() / block_size.get_num_rows();
 	size_t num_block_rows
@@ -570,6 +647,69 @@ void fg_row_compute_task::run(char *buf, size_t size)
 	}
 }
 
+/*
+ * Get the locations of the rows in the adjacency file for every `step'
+ * rows. The last entry is the end of the adjacency lists. For a directed
+ * graph, `out_offs' locates the out-edge lists and `in_offs' locates
+ * the in-edge lists.
+ */
+static void get_fg_row_offs(fg::vertex_index::ptr index, size_t step,
+		std::vector<off_t> &out_offs, std::vector<off_t> &in_offs)
+{
+	fg::vsize_t num_vertices = index->get_num_vertices();
+	bool directed = index->get_graph_header().is_directed_graph();
+	if (!directed && index->is_compressed()) {
+		fg::in_mem_cundirected_vertex_index::ptr uindex
+			= fg::in_mem_cundirected_vertex_index::create(*index);
+		for (size_t i = 0; i < num_vertices; i += step) {
+			fg::vertex_offset off = uindex->get_vertex(i);
+			out_offs.push_back(off.get_off());
+		}
+		size_t graph_size = uindex->get_vertex(num_vertices - 1).get_off()
+			+ uindex->get_size(num_vertices - 1);
+		out_offs.push_back(graph_size);
+	}
+	else if (!directed) {
+		fg::undirected_vertex_index::ptr uindex
+			= fg::undirected_vertex_index::cast(index);
+		for (size_t i = 0; i < num_vertices; i += step) {
+			fg::ext_mem_vertex_info info = uindex->get_vertex_info(i);
+			out_offs.push_back(info.get_off());
+		}
+		out_offs.push_back(uindex->get_graph_size());
+	}
+	else if (index->is_compressed()) {
+		fg::in_mem_cdirected_vertex_index::ptr dindex
+			= fg::in_mem_cdirected_vertex_index::create(*index);
+		for (size_t i = 0; i < num_vertices; i += step) {
+			fg::directed_vertex_entry ventry = dindex->get_vertex(i);
+			out_offs.push_back(ventry.get_out_off());
+			in_offs.push_back(ventry.get_in_off());
+		}
+		fg::directed_vertex_entry ventry = dindex->get_vertex(num_vertices - 1);
+		out_offs.push_back(ventry.get_out_off()
+				+ dindex->get_out_size(num_vertices - 1));
+		in_offs.push_back(ventry.get_in_off()
+				+ dindex->get_in_size(num_vertices - 1));
+	}
+	else {
+		fg::directed_vertex_index::ptr dindex
+			= fg::directed_vertex_index::cast(index);
+		for (size_t i = 0; i < num_vertices; i += step) {
+			fg::ext_mem_vertex_info info = dindex->get_vertex_info_out(i);
+			out_offs.push_back(info.get_off());
+
+			info = dindex->get_vertex_info_in(i);
+			in_offs.push_back(info.get_off());
+		}
+		fg::ext_mem_vertex_info info
+			= dindex->get_vertex_info_out(num_vertices - 1);
+		out_offs.push_back(info.get_off() + info.get_size());
+		info = dindex->get_vertex_info_in(num_vertices - 1);
+		in_offs.push_back(info.get_off() + info.get_size());
+	}
+}
+
 /*
  * Sparse square symmetric matrix. It is partitioned in rows.
  */
@@ -640,28 +780,10 @@ sparse_matrix::ptr fg_sparse_sym_matrix::create(fg::FG_graph::ptr fg,
 				safs::REMOTE_ACCESS), num_vertices, entry_type);
 
 	// Generate the matrix index from the vertex index.
-	if (index->is_compressed()) {
-		fg::in_mem_cundirected_vertex_index::ptr uindex
-			= fg::in_mem_cundirected_vertex_index::create(*index);
-		for (size_t i = 0; i < num_vertices;
-				i += matrix_conf.get_row_block_size()) {
-			fg::vertex_offset off = uindex->get_vertex(i);
-			m->blocks.emplace_back(off.get_off());
-		}
-		size_t graph_size = uindex->get_vertex(num_vertices - 1).get_off()
-			+ uindex->get_size(num_vertices - 1);
-		m->blocks.emplace_back(graph_size);
-	}
-	else {
-		fg::undirected_vertex_index::ptr uindex
-			= fg::undirected_vertex_index::cast(index);
-		for (size_t i = 0; i < num_vertices;
-				i += matrix_conf.get_row_block_size()) {
-			fg::ext_mem_vertex_info info = uindex->get_vertex_info(i);
-			m->blocks.emplace_back(info.get_off());
-		}
-		m->blocks.emplace_back(uindex->get_graph_size());
-	}
+	std::vector<off_t> offs, in_offs;
+	get_fg_row_offs(index, matrix_conf.get_row_block_size(), offs, in_offs);
+	for (size_t i = 0; i < offs.size(); i++)
+		m->blocks.emplace_back(offs[i]);
 
 	return sparse_matrix::ptr(m);
 }
@@ -745,40 +867,118 @@ sparse_matrix::ptr fg_sparse_asym_matrix::create(fg::FG_graph::ptr fg,
 	fg_sparse_asym_matrix *m = new fg_sparse_asym_matrix(fg->get_graph_io_factory(
 				safs::REMOTE_ACCESS), num_vertices, entry_type);
 
-	if (index->is_compressed()) {
-		fg::in_mem_cdirected_vertex_index::ptr dindex
-			= fg::in_mem_cdirected_vertex_index::create(*index);
-		for (size_t i = 0; i < num_vertices;
-				i += matrix_conf.get_row_block_size()) {
-			fg::directed_vertex_entry ventry = dindex->get_vertex(i);
-			m->out_blocks->emplace_back(ventry.get_out_off());
-			m->in_blocks->emplace_back(ventry.get_in_off());
-		}
-		fg::directed_vertex_entry ventry = dindex->get_vertex(num_vertices - 1);
-		m->out_blocks->emplace_back(ventry.get_out_off()
-				+ dindex->get_out_size(num_vertices - 1));
-		m->in_blocks->emplace_back(ventry.get_in_off()
-				+ dindex->get_in_size(num_vertices - 1));
+	// Generate the matrix index from the vertex index.
+	std::vector<off_t> out_offs, in_offs;
+	get_fg_row_offs(index, matrix_conf.get_row_block_size(), out_offs,
+			in_offs);
+	for (size_t i = 0; i < out_offs.size(); i++) {
+		m->out_blocks->emplace_back(out_offs[i]);
+		m->in_blocks->emplace_back(in_offs[i]);
 	}
-	else {
-		fg::directed_vertex_index::ptr dindex
-			= fg::directed_vertex_index::cast(index);
-		// Generate the matrix index from the vertex index.
-		for (size_t i = 0; i < num_vertices;
-				i += matrix_conf.get_row_block_size()) {
-			fg::ext_mem_vertex_info info = dindex->get_vertex_info_out(i);
-			m->out_blocks->emplace_back(info.get_off());
 
-			info = dindex->get_vertex_info_in(i);
-			m->in_blocks->emplace_back(info.get_off());
-		}
-		fg::ext_mem_vertex_info info
-			= dindex->get_vertex_info_out(num_vertices - 1);
-		m->out_blocks->emplace_back(info.get_off() + info.get_size());
-		info = dindex->get_vertex_info_in(num_vertices - 1);
-		m->in_blocks->emplace_back(info.get_off() + info.get_size());
+	return sparse_matrix::ptr(m);
+}
+
+/*
+ * Sparse square matrix in the FlashGraph format. The rows of a block row
+ * are partitioned into 2D blocks in memory when they are read, so SpMM
+ * runs on the blocks in the same way as on a 2D-partitioned matrix.
+ * The matrix index locates the block rows in the adjacency file, and
+ * the graph is only read.
+ */
+class fg_block_sparse_matrix: public sparse_matrix
+{
+	block_2d_size block_size;
+	// index indexes the original matrix and t_index indexes
+	// the transpose of the matrix. They are the same for a symmetric matrix.
+	SpM_2d_index::ptr index;
+	SpM_2d_index::ptr t_index;
+	safs::file_io_factory::shared_ptr factory;
+
+	fg_block_sparse_matrix(safs::file_io_factory::shared_ptr factory,
+			size_t nrows, const scalar_type *entry_type, bool symmetric,
+			const block_2d_size &_block_size): sparse_matrix(nrows,
+				entry_type, symmetric, true), block_size(_block_size) {
+		this->factory = factory;
+	}
+public:
+	static ptr create(fg::FG_graph::ptr, const scalar_type *entry_type,
+			const block_2d_size &block_size);
+
+	virtual safs::file_io_factory::shared_ptr get_io_factory() const {
+		return factory;
+	}
+
+	virtual sparse_matrix::ptr transpose() const {
+		fg_block_sparse_matrix *ret = new fg_block_sparse_matrix(*this);
+		ret->sparse_matrix::_transpose();
+		ret->index = this->t_index;
+		ret->t_index = this->index;
+		return sparse_matrix::ptr(ret);
 	}
 
+	virtual matrix_io_generator::ptr create_io_gen(
+			const detail::matrix_store &in) const {
+		size_t sblock_size = detail::cal_super_block_size(get_block_size(),
+				in.get_entry_size() * in.get_num_cols());
+		return matrix_io_generator::create(index, factory->get_file_id(),
+				sblock_size, 1);
+	}
+
+	virtual const block_2d_size &get_block_size() const {
+		return block_size;
+	}
+
+	virtual void get_block_row_offs(const std::vector<off_t> &block_row_idxs,
+			std::vector<off_t> &offs) const {
+		offs.resize(block_row_idxs.size());
+		for (size_t i = 0; i < block_row_idxs.size(); i++)
+			offs[i] = index->get_block_row_off(block_row_idxs[i]);
+	}
+
+	virtual block_exec_order::ptr get_multiply_order(
+			size_t num_block_rows, size_t num_block_cols) const {
+		return get_2d_exec_order(num_block_rows, num_block_cols);
+	}
+};
+
+sparse_matrix::ptr fg_block_sparse_matrix::create(fg::FG_graph::ptr fg,
+		const scalar_type *entry_type, const block_2d_size &block_size)
+{
+	fg::vertex_index::ptr index = fg->get_index_data();
+	assert(index != NULL);
+	const fg::graph_header &header = index->get_graph_header();
+	if (entry_type && entry_type->get_size()
+			!= (size_t) header.get_edge_data_size()) {
+		BOOST_LOG_TRIVIAL(error)
+			<< "the entry type doesn't match the edge data in the graph";
+		return sparse_matrix::ptr();
+	}
+
+	fg::vsize_t num_vertices = index->get_num_vertices();
+	bool directed = header.is_directed_graph();
+	fg_block_sparse_matrix *m = new fg_block_sparse_matrix(
+			fg->get_graph_io_factory(safs::REMOTE_ACCESS), num_vertices,
+			entry_type, !directed, block_size);
+
+	// The matrix index locates the block rows in the adjacency file,
+	// so the offsets are the locations of the rows at the beginning of
+	// the block rows.
+	std::vector<off_t> out_offs, in_offs;
+	get_fg_row_offs(index, block_size.get_num_rows(), out_offs, in_offs);
+	prim_type type = prim_type::P_BOOL;
+	if (entry_type)
+		type = entry_type->get_type();
+	matrix_header mheader(matrix_type::SPARSE, m->get_entry_size(),
+			num_vertices, num_vertices, matrix_layout_t::L_ROW_2D, type,
+			block_size);
+	m->index = SpM_2d_index::create(mheader, out_offs);
+	if (directed)
+		m->t_index = SpM_2d_index::create(mheader, in_offs);
+	else
+		m->t_index = m->index;
+	assert(m->index && m->t_index);
+
 	return sparse_matrix::ptr(m);
 }
 
@@ -794,6 +994,12 @@ sparse_matrix::ptr sparse_matrix::create(fg::FG_graph::ptr fg,
 		return detail::fg_sparse_sym_matrix::create(fg, entry_type);
 }
 
+sparse_matrix::ptr sparse_matrix::create(fg::FG_graph::ptr fg,
+		const scalar_type *entry_type, const block_2d_size &block_size)
+{
+	return detail::fg_block_sparse_matrix::create(fg, entry_type, block_size);
+}
+
 /////////////// The code for native 2D-partitioned sparse matrix ///////////////
 
 namespace detail
@@ -864,20 +1070,7 @@ public:
 
 	virtual block_exec_order::ptr get_multiply_order(
 			size_t num_block_rows, size_t num_block_cols) const {
-		if (num_block_rows != num_block_cols) {
-			BOOST_LOG_TRIVIAL(error) << "hilbert order requires a square.";
-			return block_exec_order::ptr();
-		}
-		double log2_nbr = log2(num_block_rows);
-		if (log2_nbr != floor(log2_nbr)) {
-			BOOST_LOG_TRIVIAL(error)
-				<< "hilbert order requires a dimension of 2^n";
-			return block_exec_order::ptr();
-		}
-		if (matrix_conf.use_hilbert_order())
-			return block_exec_order::ptr(new hilbert_exec_order(num_block_rows));
-		else
-			return block_exec_order::ptr(new seq_exec_order());
+		return get_2d_exec_order(num_block_rows, num_block_cols);
 	}
 };
 
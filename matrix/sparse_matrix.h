@@ -252,6 +252,12 @@ class block_compute_task: public compute_task
 	local_mem_buffer::irreg_buf_t buf;
 	size_t real_io_size;
 	size_t entry_size;
+	// Whether the block rows in the buffer are stored in the FlashGraph
+	// format. If so, they are partitioned into 2D blocks before computation.
+	bool fg_rows;
+
+	void run_on_block_rows(const std::vector<char *> &block_rows);
+	void run_on_fg_rows();
 protected:
 	block_2d_size block_size;
 public:
@@ -647,6 +653,9 @@ class sparse_matrix: public detail::EM_object
 {
 	// Whether the matrix is represented by the FlashGraph format.
 	bool is_fg;
+	// Whether the rows in the FlashGraph format are partitioned into
+	// 2D blocks in memory when they are read.
+	bool is_fg_2d;
 	size_t nrows;
 	size_t ncols;
 	// The type of a non-zero entry.
@@ -663,18 +672,20 @@ protected:
 	// This constructor is used for the sparse matrix stored
 	// in the FlashGraph format.
 	sparse_matrix(size_t num_vertices, const scalar_type *entry_type,
-			bool symmetric) {
+			bool symmetric, bool part_2d = false) {
 		this->nrows = num_vertices;
 		this->ncols = num_vertices;
 		this->entry_type = entry_type;
 		this->symmetric = symmetric;
 		this->is_fg = true;
+		this->is_fg_2d = part_2d;
 	}
 
 	sparse_matrix(size_t nrows, size_t ncols, const scalar_type *entry_type,
 			bool symmetric) {
 		this->symmetric = symmetric;
 		this->is_fg = false;
+		this->is_fg_2d = false;
 		this->nrows = nrows;
 		this->ncols = ncols;
 		this->entry_type = entry_type;
@@ -699,6 +710,14 @@ public:
 	 * This creates a sparse matrix sotred in the FlashGraph format.
 	 */
 	static ptr create(fg::FG_graph::ptr, const scalar_type *entry_type);
+	/*
+	 * This creates a sparse matrix stored in the FlashGraph format whose
+	 * rows are partitioned into 2D blocks in memory when they are read,
+	 * so SpMM runs on the blocks as on a 2D-partitioned matrix without
+	 * converting the graph.
+	 */
+	static ptr create(fg::FG_graph::ptr, const scalar_type *entry_type,
+			const block_2d_size &block_size);
 	/*
 	 * This create a symmetric sparse matrix partitioned in 2D dimensions.
 	 * The sparse matrix is stored in memory.
@@ -726,6 +745,10 @@ public:
 		return is_fg;
 	}
 
+	bool is_fg_2d_matrix() const {
+		return is_fg_2d;
+	}
+
 	std::vector<safs::io_interface::ptr> create_ios() const;
 
 	/*
@@ -826,7 +849,7 @@ spmm_creator<DenseType, SparseType>::spmm_creator(const sparse_matrix &_mat,
 		size_t num_in_cols): mat(_mat)
 {
 	// This initialization only for 2D partitioned sparse matrix.
-	if (!mat.is_fg_matrix()) {
+	if (!mat.is_fg_matrix() || mat.is_fg_2d_matrix()) {
 		// We only handle the case the element size is 2^n.
 		assert(1 << ((size_t) log2(sizeof(DenseType))) == sizeof(DenseType));
 		// Hilbert curve requires that there are 2^n block rows and block columns.
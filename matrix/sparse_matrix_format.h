@@ -394,6 +394,21 @@ public:
 	void verify(const block_2d_size &block_size) const;
 };
 
+/*
+ * These two functions partition the rows of a block row in the FlashGraph
+ * format into 2D blocks. The rows have to be sorted by their IDs and
+ * `row_len' is the number of columns of the matrix.
+ * The first function estimates the maximal storage size of the blocks.
+ * The second one serializes the blocks to `out' and returns their size.
+ */
+size_t get_max_block_row_size(
+		const std::vector<const fg::ext_mem_undirected_vertex *> &rows,
+		size_t row_len, size_t nz_size, const block_2d_size &block_size);
+size_t part_2d_block_row(
+		const std::vector<const fg::ext_mem_undirected_vertex *> &rows,
+		size_t block_row_idx, size_t row_len, size_t nz_size,
+		const block_2d_size &block_size, char *out, size_t max_size);
+
 /*
  * This allows users to iterate the blocks in a block row.
  */
@@ -164,6 +164,61 @@ public:
 	}
 };
 
+sparse_matrix::ptr load_2d_matrix(const std::string &type,
+		const std::string &matrix_file, const std::string &index_file,
+		const std::string &t_matrix_file, const std::string &t_index_file)
+{
+	// Load index.
+	SpM_2d_index::ptr index;
+	safs::safs_file idx_f(safs::get_sys_RAID_conf(), index_file);
+	if (idx_f.exist())
+		index = SpM_2d_index::safs_load(index_file);
+	else
+		index = SpM_2d_index::load(index_file);
+	SpM_2d_index::ptr t_index;
+	if (type == "SVD") {
+		safs::safs_file t_idx_f(safs::get_sys_RAID_conf(), t_index_file);
+		if (t_idx_f.exist())
+			t_index = SpM_2d_index::safs_load(t_index_file);
+		else
+			t_index = SpM_2d_index::load(t_index_file);
+	}
+
+	// Load matrix.
+	sparse_matrix::ptr mat;
+	safs::safs_file mat_f(safs::get_sys_RAID_conf(), matrix_file);
+	if (type == "SVD" && mat_f.exist())
+		mat = sparse_matrix::create(
+				index, safs::create_io_factory(matrix_file, safs::REMOTE_ACCESS),
+				t_index, safs::create_io_factory(t_matrix_file,
+					safs::REMOTE_ACCESS));
+	else if (type == "SVD")
+		mat = sparse_matrix::create(
+				index, SpM_2d_storage::load(matrix_file, index),
+				t_index, SpM_2d_storage::load(t_matrix_file, t_index));
+	else if (mat_f.exist())
+		mat = sparse_matrix::create(index,
+				safs::create_io_factory(matrix_file, safs::REMOTE_ACCESS));
+	else
+		mat = sparse_matrix::create(index,
+				SpM_2d_storage::load(matrix_file, index));
+	return mat;
+}
+
+/*
+ * The rows of the graph are partitioned into 2D blocks in memory when
+ * they are read, so we don't need to convert the graph to a 2D-partitioned
+ * matrix first.
+ */
+sparse_matrix::ptr load_fg_matrix(const std::string &graph_file,
+		const std::string &index_file, config_map::ptr configs)
+{
+	fg::FG_graph::ptr fg = fg::FG_graph::create(graph_file, index_file,
+			configs);
+	return sparse_matrix::create(fg, NULL,
+			block_2d_size(block_max_num_rows, block_max_num_cols));
+}
+
 void print_usage()
 {
 	fprintf(stderr, "eigensolver conf_file matrix_file index_file nev [options]\n");
@@ -175,6 +230,7 @@ void print_usage()
 	fprintf(stderr, "-o file: output eigenvectors\n");
 	fprintf(stderr, "-T type: eigen, SVD, NA_eigen (normalized adjacency)\n");
 	fprintf(stderr, "-c num: The number of cached matrices\n");
+	fprintf(stderr, "-g: the matrix is a graph in the FlashGraph format\n");
 }
 
 int main (int argc, char *argv[])
@@ -189,7 +245,8 @@ int main (int argc, char *argv[])
 	double tol = -1;
 	bool in_mem = true;
 	size_t num_cached = 1;
-	while ((opt = getopt(argc, argv, "b:n:s:t:eo:T:c:")) != -1) {
+	bool use_fg = false;
+	while ((opt = getopt(argc, argv, "b:n:s:t:eo:T:c:g")) != -1) {
 		num_opts++;
 		switch (opt) {
 			case 'b':
@@ -223,6 +280,9 @@ int main (int argc, char *argv[])
 				num_cached = atoi(optarg);
 				num_opts++;
 				break;
+			case 'g':
+				use_fg = true;
+				break;
 			default:
 				print_usage();
 				abort();
@@ -231,7 +291,8 @@ int main (int argc, char *argv[])
 
 	argv += 1 + num_opts;
 	argc -= 1 + num_opts;
-	if ((type != "SVD" && argc < 4) || (type == "SVD" && argc < 6)) {
+	// A graph in the FlashGraph format has both the matrix and its transpose.
+	if (argc < 4 || (type == "SVD" && !use_fg && argc < 6)) {
 		print_usage();
 		exit(1);
 	}
@@ -242,7 +303,7 @@ int main (int argc, char *argv[])
 	std::string t_matrix_file;
 	std::string t_index_file;
 	int nev;
-	if (type == "SVD") {
+	if (type == "SVD" && !use_fg) {
 		t_matrix_file = argv[3];
 		t_index_file = argv[4];
 		nev = atoi(argv[5]);
@@ -270,40 +331,12 @@ int main (int argc, char *argv[])
 	config_map::ptr configs = config_map::create(conf_file);
 	init_flash_matrix(configs);
 
-	// Load index.
-	SpM_2d_index::ptr index;
-	safs::safs_file idx_f(safs::get_sys_RAID_conf(), index_file);
-	if (idx_f.exist())
-		index = SpM_2d_index::safs_load(index_file);
-	else
-		index = SpM_2d_index::load(index_file);
-	SpM_2d_index::ptr t_index;
-	if (type == "SVD") {
-		safs::safs_file t_idx_f(safs::get_sys_RAID_conf(), t_index_file);
-		if (t_idx_f.exist())
-			t_index = SpM_2d_index::safs_load(t_index_file);
-		else
-			t_index = SpM_2d_index::load(t_index_file);
-	}
-
-	// Load matrix.
 	sparse_matrix::ptr mat;
-	safs::safs_file mat_f(safs::get_sys_RAID_conf(), matrix_file);
-	if (type == "SVD" && mat_f.exist())
-		mat = sparse_matrix::create(
-				index, safs::create_io_factory(matrix_file, safs::REMOTE_ACCESS),
-				t_index, safs::create_io_factory(t_matrix_file,
-					safs::REMOTE_ACCESS));
-	else if (type == "SVD")
-		mat = sparse_matrix::create(
-				index, SpM_2d_storage::load(matrix_file, index),
-				t_index, SpM_2d_storage::load(t_matrix_file, t_index));
-	else if (mat_f.exist())
-		mat = sparse_matrix::create(index,
-				safs::create_io_factory(matrix_file, safs::REMOTE_ACCESS));
+	if (use_fg)
+		mat = load_fg_matrix(matrix_file, index_file, configs);
 	else
-		mat = sparse_matrix::create(index,
-				SpM_2d_storage::load(matrix_file, index));
+		mat = load_2d_matrix(type, matrix_file, index_file, t_matrix_file,
+				t_index_file);
 
 	eigen_res res;
 	if (type == "SVD")
@@ -123,17 +123,8 @@ void test_multiply_block(edge_list::ptr el)
 	test_spmm_block(mat.first, mat.second, degrees);
 }
 
-void test_spmm_fg(fg::FG_graph::ptr fg)
+void test_spmm_fg(sparse_matrix::ptr spm)
 {
-	printf("test SpMM on FlashGraph matrix\n");
-	sparse_matrix::ptr spm;
-	if (fg->get_graph_header().has_edge_data()) {
-		assert(fg->get_graph_header().get_edge_data_size() == sizeof(float));
-		spm = sparse_matrix::create(fg, &get_scalar_type<float>());
-	}
-	else
-		spm = sparse_matrix::create(fg, NULL);
-
 	size_t num_cols = spm->get_num_cols();
 	size_t num_rows = spm->get_num_rows();
 	detail::mem_matrix_store::ptr in_mat
@@ -156,7 +147,19 @@ void test_multiply_fg(edge_list::ptr el)
 {
 	printf("Multiply on FlashGraph matrix\n");
 	fg::FG_graph::ptr fg = create_fg_graph("test", el);
-	test_spmm_fg(fg);
+	const scalar_type *entry_type = NULL;
+	if (fg->get_graph_header().has_edge_data()) {
+		assert(fg->get_graph_header().get_edge_data_size() == sizeof(float));
+		entry_type = &get_scalar_type<float>();
+	}
+
+	printf("test SpMM on FlashGraph matrix\n");
+	test_spmm_fg(sparse_matrix::create(fg, entry_type));
+	// The rows are partitioned into 2D blocks in memory, so the result
+	// should be the same as above.
+	printf("test SpMM on FlashGraph matrix partitioned in 2D\n");
+	test_spmm_fg(sparse_matrix::create(fg, entry_type,
+				block_2d_size(1024, 1024)));
 }
 
 int main()